@@ -134,8 +134,7 @@ enum class ControlCommand {
     FLUSH_FILTER_CACHE = 12,
 
     /**
-     * Write stopwatch data in human-readable text format into the
-     * given pipe.
+     * Obsolete.  Use #STOPWATCH_RING.
      */
     STOPWATCH_PIPE = 13,
 
@@ -149,6 +148,15 @@ enum class ControlCommand {
      * Drop items from the HTTP cache with the given tag.
      */
     FLUSH_HTTP_CACHE = 15,
+
+    /**
+     * Write stopwatch data in binary format into the given file
+     * (which is mapped into memory as a ring buffer, see
+     * StopwatchRing.hxx).  An optional payload specifies the
+     * sampling rate (32 bit, network byte order): only one of this
+     * many requests is recorded.
+     */
+    STOPWATCH_RING = 16,
 };
 
 struct ControlStats {
@@ -213,6 +221,52 @@ struct ControlStats {
      */
     uint64_t http_traffic_received;
     uint64_t http_traffic_sent;
+
+    /**
+     * Number of incremental memory compression slices, the total
+     * time spent compressing and the longest single compression
+     * pause [microseconds].
+     */
+    uint64_t compress_slices;
+    uint64_t compress_time;
+    uint64_t compress_max_pause;
+
+    /**
+     * Filter cache lookups served by the hot tier, by the main
+     * cache, and misses.
+     */
+    uint64_t filter_cache_hot_hits;
+    uint64_t filter_cache_hits;
+    uint64_t filter_cache_misses;
+
+    /**
+     * Lookups in the compiled regular expression cache, the total
+     * time spent compiling regular expressions and the compile
+     * time saved by the cache [microseconds].
+     */
+    uint64_t regex_cache_hits, regex_cache_misses;
+    uint64_t regex_compile_time, regex_compile_time_saved;
+
+    /**
+     * Total size of I/O buffers in each size class (4 kB, 16 kB,
+     * 32 kB, 64 kB, 256 kB).
+     */
+    uint64_t io_buffers_class_size[5];
+
+    /**
+     * Histograms of the time from launching a CGI program until
+     * its response header was received, [0] for programs launched
+     * directly and [1] for programs launched by a zygote.  Each
+     * element is the number of samples in one bucket (not
+     * cumulative); the upper bucket bounds are 1, 2, 5, 10, 20,
+     * 50, 100, 200, 500, 1000, 2000, 5000 ms and infinity.
+     */
+    uint64_t cgi_spawn_latency[2][13];
+
+    /**
+     * The sum of all #cgi_spawn_latency samples [microseconds].
+     */
+    uint64_t cgi_spawn_latency_sum[2];
 };
 
 struct ControlHeader {
@@ -14,8 +14,11 @@ class Stats:
         if len(payload) < 48:
             raise MalformedResponseError()
 
-        fmt = '>IIIIQQQQQQQQQQQQQ'
-        expected_length = struct.calcsize(fmt)
+        fmt = '>IIIIQQQQQQQQQQQQQQQQQQQQQQQQQQQQ'
+        # cgi_spawn_latency[2][13], cgi_spawn_latency_sum[2]
+        cgi_fmt = '>' + 'Q' * 28
+        base_length = struct.calcsize(fmt)
+        expected_length = base_length + struct.calcsize(cgi_fmt)
 
         if len(payload) > expected_length:
             payload = payload[:expected_length]
@@ -33,5 +36,18 @@ class Stats:
         self.filter_cache_brutto_size, \
         self.nfs_cache_size, self.nfs_cache_brutto_size, \
         self.io_buffers_size, self.io_buffers_brutto_size, \
-        self.http_traffic_received, self.http_traffic_sent = \
-        struct.unpack(fmt, payload)
+        self.http_traffic_received, self.http_traffic_sent, \
+        self.compress_slices, self.compress_time, \
+        self.compress_max_pause, \
+        self.filter_cache_hot_hits, self.filter_cache_hits, \
+        self.filter_cache_misses, \
+        self.regex_cache_hits, self.regex_cache_misses, \
+        self.regex_compile_time, self.regex_compile_time_saved, \
+        self.io_buffers_4k_size, self.io_buffers_16k_size, \
+        self.io_buffers_32k_size, self.io_buffers_64k_size, \
+        self.io_buffers_256k_size = \
+        struct.unpack(fmt, payload[:base_length])
+
+        cgi = struct.unpack(cgi_fmt, payload[base_length:])
+        self.cgi_spawn_latency = (cgi[0:13], cgi[13:26])
+        self.cgi_spawn_latency_sum = cgi[26:28]
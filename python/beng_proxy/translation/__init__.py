@@ -5,11 +5,13 @@
 #
 
 from .protocol import *
-from .serialize import PacketReader, packet_header, write_packet
+from .serialize import PacketReader, packet_header, write_packet, \
+    MUX_HEADER_SIZE, mux_header, parse_mux_header
 from .request import Request
 from .response import Response
 
 from . import protocol
 __all__ = ['PacketReader', 'packet_header', 'write_packet',
+           'MUX_HEADER_SIZE', 'mux_header', 'parse_mux_header',
            'Request', 'Response'] + \
           [x for x in protocol.__dict__ if x[:10] == 'TRANSLATE_' or x[:7] == 'HEADER_']
@@ -65,3 +65,18 @@ def write_packet(f, command, payload = b''):
     assert isinstance(payload, str)
     f.write(packet_header(command, len(payload)))
     f.write(payload)
+
+MUX_HEADER_SIZE = 8
+
+def mux_header(request_id, length):
+    """Generate the header of a frame for the multiplexed protocol
+    (see beng-proxy option "translate_multiplex")."""
+
+    return struct.pack('II', request_id, length)
+
+def parse_mux_header(data):
+    """Parse the header of a frame for the multiplexed protocol.
+    Returns a tuple (request_id, length)."""
+
+    assert len(data) >= MUX_HEADER_SIZE
+    return struct.unpack('II', data[:MUX_HEADER_SIZE])
@@ -33,20 +33,60 @@
 #include "DefaultFifoBuffer.hxx"
 #include "memory/fb_pool.hxx"
 
+#include <algorithm>
+
 void
 DefaultFifoBuffer::Allocate() noexcept
 {
-	SliceFifoBuffer::Allocate(fb_pool_get());
+	SliceFifoBuffer::Allocate(fb_pool_get(size_class));
 }
 
 void
 DefaultFifoBuffer::AllocateIfNull() noexcept
 {
-	SliceFifoBuffer::AllocateIfNull(fb_pool_get());
+	if (IsNull())
+		Allocate();
+	else if (GetAvailable() >= GetCapacity() / 2)
+		Grow();
 }
 
 void
 DefaultFifoBuffer::CycleIfEmpty() noexcept
 {
-	SliceFifoBuffer::CycleIfEmpty(fb_pool_get());
+	SliceFifoBuffer::CycleIfEmpty(fb_pool_get(size_class));
+}
+
+void
+DefaultFifoBuffer::FreeIfEmpty() noexcept
+{
+	if (!IsDefined() || !empty())
+		return;
+
+	/* the allocation may have been swapped with another buffer,
+	   so look at its actual capacity */
+	const unsigned current = fb_size_class(GetCapacity());
+	Free();
+
+	size_class = current > min_size_class ? current - 1 : min_size_class;
+}
+
+bool
+DefaultFifoBuffer::Grow() noexcept
+{
+	assert(IsDefined());
+
+	const unsigned next = fb_size_class(GetCapacity()) + 1;
+	if (next >= FB_N_SIZE_CLASSES)
+		return false;
+
+	SliceFifoBuffer other(fb_pool_get(next));
+	const auto r = Read();
+	std::copy(r.begin(), r.end(), other.Write().begin());
+	other.Append(r.size());
+
+	/* the old allocation is freed by the destructor of
+	   "other" */
+	swap(other);
+	size_class = next;
+	return true;
 }
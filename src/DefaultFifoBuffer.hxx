@@ -35,16 +35,63 @@
 
 #include "memory/SliceFifoBuffer.hxx"
 
+#include <cstdint>
+
 /**
  * A frontend for #SliceFifoBuffer which allows to replace it with a
  * simple heap-allocated buffer when some client code gets copied to
  * another project.
+ *
+ * The buffer size adapts to the traffic: allocations pick one of
+ * the #FB_SIZE_CLASSES.  The buffer grows while data accumulates in
+ * it (bulk transfers, long header lines) and the next allocation
+ * after it has been freed while empty uses the next smaller class;
+ * an idle buffer holds no memory at all.
  */
 class DefaultFifoBuffer : public SliceFifoBuffer {
+	/**
+	 * The size class for the next allocation.
+	 */
+	uint_least8_t size_class;
+
+	/**
+	 * Never shrink below this size class.
+	 */
+	const uint_least8_t min_size_class;
+
 public:
+	/**
+	 * The default size class is 16 kB, which is large enough for
+	 * the longest HTTP header line we accept.
+	 */
+	explicit DefaultFifoBuffer(unsigned _min_size_class=1) noexcept
+		:size_class(_min_size_class),
+		 min_size_class(_min_size_class) {}
+
 	void Allocate() noexcept;
+
+	/**
+	 * Allocate a buffer if there is none.  If there is one and it
+	 * is at least half full, try to grow it.  #BufferedSocket
+	 * calls this before each read.
+	 */
 	void AllocateIfNull() noexcept;
+
 	void CycleIfEmpty() noexcept;
+
+	/**
+	 * Free the buffer if it is empty, and let the next allocation
+	 * use a smaller size class.
+	 */
+	void FreeIfEmpty() noexcept;
+
+	/**
+	 * Move the data to a buffer of the next larger size class.
+	 *
+	 * @return false if the buffer is already at the largest size
+	 * class
+	 */
+	bool Grow() noexcept;
 };
 
 #endif
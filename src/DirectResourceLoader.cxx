@@ -150,7 +150,8 @@ try {
 		return;
 
 	case ResourceAddress::Type::CGI:
-		cgi_new(spawn_service, event_loop, &pool, parent_stopwatch,
+		cgi_new(spawn_service, cgi_zygote_pool,
+			event_loop, &pool, parent_stopwatch,
 			method, &address.GetCgi(),
 			GetRemoteHost(xff, pool, headers),
 			headers, std::move(body),
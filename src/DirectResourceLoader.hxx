@@ -38,6 +38,7 @@
 
 class EventLoop;
 class SpawnService;
+class CgiZygotePool;
 class WasStock;
 class MultiWasStock;
 class RemoteWasStock;
@@ -64,6 +65,7 @@ class DirectResourceLoader final : public ResourceLoader {
 	TcpBalancer *tcp_balancer;
 	AnyHttpClient any_http_client;
 	SpawnService &spawn_service;
+	CgiZygotePool *const cgi_zygote_pool;
 	LhttpStock *lhttp_stock;
 	FcgiStock *fcgi_stock;
 #ifdef HAVE_LIBWAS
@@ -89,6 +91,7 @@ public:
 			     NgHttp2::Stock &_nghttp2_stock,
 #endif
 			     SpawnService &_spawn_service,
+			     CgiZygotePool *_cgi_zygote_pool,
 			     LhttpStock *_lhttp_stock,
 			     FcgiStock *_fcgi_stock,
 #ifdef HAVE_LIBWAS
@@ -113,6 +116,7 @@ public:
 #endif
 				 _ssl_client_factory),
 		 spawn_service(_spawn_service),
+		 cgi_zygote_pool(_cgi_zygote_pool),
 		 lhttp_stock(_lhttp_stock),
 		 fcgi_stock(_fcgi_stock),
 #ifdef HAVE_LIBWAS
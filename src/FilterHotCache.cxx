@@ -0,0 +1,250 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FilterHotCache.hxx"
+#include "AllocatorPtr.hxx"
+#include "pool/pool.hxx"
+
+#include <cassert>
+#include <cstring>
+#include <functional>
+
+FilterHotCache::Item::Item(PoolPtr &&_pool, std::string_view _key,
+			   const char *_tag, std::size_t _hash,
+			   std::chrono::steady_clock::time_point _expires,
+			   http_status_t _status, const StringMap &_headers,
+			   std::span<const std::byte> _body,
+			   std::size_t _size) noexcept
+	:PoolHolder(std::move(_pool)),
+	 key(AllocatorPtr{pool}.DupZ(_key)),
+	 tag(AllocatorPtr{pool}.CheckDup(_tag)),
+	 hash(_hash), expires(_expires),
+	 status(_status), headers(pool, _headers),
+	 body((const std::byte *)p_memdup(pool, _body.data(), _body.size()),
+	      _body.size()),
+	 size(_size)
+{
+}
+
+void
+FilterHotCache::Item::Destroy() noexcept
+{
+	pool_trash(pool);
+	this->~Item();
+}
+
+FilterHotCache::FilterHotCache(struct pool &_pool,
+			       std::size_t _max_size) noexcept
+	:pool(_pool), max_size(_max_size),
+	 /* track more keys than we can store, so candidates can
+	    build up popularity before they are admitted */
+	 sketch(16 * MAX_ITEMS)
+{
+}
+
+FilterHotCache::~FilterHotCache() noexcept
+{
+	Clear();
+}
+
+std::size_t
+FilterHotCache::Hash(std::string_view key) noexcept
+{
+	return std::hash<std::string_view>{}(key);
+}
+
+std::size_t
+FilterHotCache::CalcSize(std::string_view key, const char *tag,
+			 const StringMap &headers,
+			 std::span<const std::byte> body) noexcept
+{
+	std::size_t size = sizeof(Item) + key.size() + 1 + body.size();
+
+	if (tag != nullptr)
+		size += std::strlen(tag) + 1;
+
+	for (const auto &i : headers)
+		size += sizeof(i) + std::strlen(i.key) + std::strlen(i.value) + 2;
+
+	return size;
+}
+
+FilterHotCache::Slot *
+FilterHotCache::FindSlot(std::string_view key, std::size_t hash) noexcept
+{
+	for (std::size_t i = hash & TABLE_MASK;; i = (i + 1) & TABLE_MASK) {
+		auto &slot = table[i];
+		if (slot.item == nullptr)
+			return nullptr;
+
+		if (slot.hash == hash && key == slot.item->key)
+			return &slot;
+	}
+}
+
+inline void
+FilterHotCache::Insert(Item &item) noexcept
+{
+	assert(n_items < MAX_ITEMS);
+
+	std::size_t i = item.hash & TABLE_MASK;
+	while (table[i].item != nullptr)
+		i = (i + 1) & TABLE_MASK;
+
+	table[i] = {item.hash, &item};
+	lru.push_back(item);
+	size += item.size;
+	++n_items;
+}
+
+void
+FilterHotCache::Evict(Item &item) noexcept
+{
+	auto *slot = FindSlot(item.key, item.hash);
+	assert(slot != nullptr);
+	assert(slot->item == &item);
+
+	/* backward-shift deletion: move following entries of the
+	   probe sequence into the gap, so lookups never need
+	   tombstones */
+	std::size_t i = slot - table.data();
+	table[i] = {};
+
+	for (std::size_t j = (i + 1) & TABLE_MASK; table[j].item != nullptr;
+	     j = (j + 1) & TABLE_MASK) {
+		const std::size_t ideal = table[j].hash & TABLE_MASK;
+
+		/* can the entry at "j" stay there, i.e. is its ideal
+		   position cyclically inside (i, j]? */
+		const bool stays = i <= j
+			? (i < ideal && ideal <= j)
+			: (i < ideal || ideal <= j);
+		if (stays)
+			continue;
+
+		table[i] = table[j];
+		table[j] = {};
+		i = j;
+	}
+
+	item.unlink();
+	assert(size >= item.size);
+	size -= item.size;
+	--n_items;
+
+	item.Destroy();
+}
+
+FilterHotCache::Item *
+FilterHotCache::Get(std::string_view key, std::size_t hash,
+		    std::chrono::steady_clock::time_point now) noexcept
+{
+	auto *slot = FindSlot(key, hash);
+	if (slot == nullptr)
+		return nullptr;
+
+	auto &item = *slot->item;
+	if (now >= item.expires) {
+		Evict(item);
+		return nullptr;
+	}
+
+	/* move to the end of the LRU list */
+	item.unlink();
+	lru.push_back(item);
+
+	return &item;
+}
+
+void
+FilterHotCache::Offer(std::string_view key, std::size_t hash,
+		      const char *tag,
+		      std::chrono::steady_clock::time_point expires,
+		      http_status_t status, const StringMap &headers,
+		      std::span<const std::byte> body) noexcept
+{
+	if (body.size() > MAX_OBJECT_SIZE || FindSlot(key, hash) != nullptr)
+		return;
+
+	const std::size_t item_size = CalcSize(key, tag, headers, body);
+	if (item_size > max_size)
+		return;
+
+	const unsigned frequency = sketch.Estimate(hash);
+	if (frequency < 2)
+		/* don't bother copying objects which have been
+		   requested only once */
+		return;
+
+	/* make room, but only by evicting items which are less
+	   popular than the candidate */
+	while (n_items >= MAX_ITEMS || size + item_size > max_size) {
+		assert(!lru.empty());
+
+		auto &victim = lru.front();
+		if (sketch.Estimate(victim.hash) >= frequency)
+			return;
+
+		Evict(victim);
+	}
+
+	auto *item = NewFromPool<Item>(pool_new_linear(&pool, "FilterHotCacheItem",
+						       1024 + key.size() + body.size()),
+				       key, tag, hash, expires,
+				       status, headers, body, item_size);
+	Insert(*item);
+}
+
+void
+FilterHotCache::Remove(std::string_view key, std::size_t hash) noexcept
+{
+	if (auto *slot = FindSlot(key, hash))
+		Evict(*slot->item);
+}
+
+void
+FilterHotCache::FlushTag(std::string_view tag) noexcept
+{
+	for (auto i = lru.begin(); i != lru.end();) {
+		auto &item = *i;
+		++i;
+		if (item.tag != nullptr && tag == item.tag)
+			Evict(item);
+	}
+}
+
+void
+FilterHotCache::Clear() noexcept
+{
+	while (!lru.empty())
+		Evict(lru.front());
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "strmap.hxx"
+#include "http/Status.h"
+#include "pool/Holder.hxx"
+#include "util/FrequencySketch.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+/**
+ * A small in-memory tier in front of the #FilterCache for the most
+ * popular small objects.  Each item is a copy of a filter cache item
+ * with the body in one contiguous buffer, which can be served with
+ * istream_memory_new() (and thus with writev()) without going
+ * through the #Cache hash table, the item lock and #Rubber.
+ *
+ * Admission is TinyLFU-style: a #FrequencySketch counts all
+ * lookups, and a candidate displaces the least recently used item
+ * only if it is more popular.
+ */
+class FilterHotCache {
+public:
+	struct Item final : PoolHolder, IntrusiveListHook {
+		const char *const key;
+
+		/**
+		 * The cache tag for FlushTag(); may be nullptr.
+		 */
+		const char *const tag;
+
+		const std::size_t hash;
+
+		const std::chrono::steady_clock::time_point expires;
+
+		const http_status_t status;
+
+		const StringMap headers;
+
+		const std::span<const std::byte> body;
+
+		/**
+		 * The number of bytes accounted for this item; see
+		 * CalcSize().
+		 */
+		const std::size_t size;
+
+		Item(PoolPtr &&_pool, std::string_view _key, const char *_tag,
+		     std::size_t _hash,
+		     std::chrono::steady_clock::time_point _expires,
+		     http_status_t _status, const StringMap &_headers,
+		     std::span<const std::byte> _body,
+		     std::size_t _size) noexcept;
+
+		using PoolHolder::GetPool;
+
+		void Destroy() noexcept;
+	};
+
+	/**
+	 * Objects larger than this are never admitted.
+	 */
+	static constexpr std::size_t MAX_OBJECT_SIZE = 64 * 1024;
+
+	static constexpr std::size_t MAX_ITEMS = 512;
+
+private:
+	struct pool &pool;
+
+	const std::size_t max_size;
+	std::size_t size = 0, n_items = 0;
+
+	/**
+	 * An open-addressing hash table with linear probing; twice
+	 * as large as #MAX_ITEMS to keep the probe sequences short.
+	 * Storing the hash next to the pointer avoids dereferencing
+	 * items of other keys.
+	 */
+	struct Slot {
+		std::size_t hash;
+		Item *item;
+	};
+
+	static constexpr std::size_t TABLE_SIZE = 2 * MAX_ITEMS;
+	static constexpr std::size_t TABLE_MASK = TABLE_SIZE - 1;
+
+	std::array<Slot, TABLE_SIZE> table{};
+
+	/**
+	 * All items, least recently used first.
+	 */
+	IntrusiveList<Item> lru;
+
+	FrequencySketch sketch;
+
+public:
+	FilterHotCache(struct pool &_pool, std::size_t _max_size) noexcept;
+	~FilterHotCache() noexcept;
+
+	FilterHotCache(const FilterHotCache &) = delete;
+	FilterHotCache &operator=(const FilterHotCache &) = delete;
+
+	[[gnu::pure]]
+	static std::size_t Hash(std::string_view key) noexcept;
+
+	/**
+	 * Calculate the number of bytes accounted for an item with
+	 * the given contents.  This is used both for the admission
+	 * check and for the total size, so they always agree.
+	 */
+	[[gnu::pure]]
+	static std::size_t CalcSize(std::string_view key, const char *tag,
+				    const StringMap &headers,
+				    std::span<const std::byte> body) noexcept;
+
+	std::size_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * Record an access to the given key.  This must be called
+	 * for every lookup, including misses, so the admission
+	 * policy sees the real popularity.
+	 */
+	void Touch(std::size_t hash) noexcept {
+		sketch.Increment(hash);
+	}
+
+	/**
+	 * Look up an item.  Expired items are removed.
+	 */
+	Item *Get(std::string_view key, std::size_t hash,
+		  std::chrono::steady_clock::time_point now) noexcept;
+
+	/**
+	 * Offer an object which was just served from the underlying
+	 * cache for admission.  It is copied if it passes the
+	 * admission policy.
+	 */
+	void Offer(std::string_view key, std::size_t hash, const char *tag,
+		   std::chrono::steady_clock::time_point expires,
+		   http_status_t status, const StringMap &headers,
+		   std::span<const std::byte> body) noexcept;
+
+	void Remove(std::string_view key, std::size_t hash) noexcept;
+
+	void FlushTag(std::string_view tag) noexcept;
+
+	void Clear() noexcept;
+
+private:
+	Slot *FindSlot(std::string_view key, std::size_t hash) noexcept;
+
+	void Insert(Item &item) noexcept;
+
+	/**
+	 * Remove the item from the hash table and from the LRU list,
+	 * and destroy it.
+	 */
+	void Evict(Item &item) noexcept;
+};
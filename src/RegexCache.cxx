@@ -0,0 +1,67 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RegexCache.hxx"
+#include "lib/pcre/UniqueRegex.hxx"
+
+static std::string
+MakeKey(const char *pattern, bool anchored, bool capture) noexcept
+{
+	std::string key;
+	key.push_back(anchored ? 'a' : '-');
+	key.push_back(capture ? 'c' : '-');
+	key.append(pattern);
+	return key;
+}
+
+SharedRegex
+RegexCache::Get(const char *pattern, bool anchored, bool capture)
+{
+	auto key = MakeKey(pattern, anchored, capture);
+
+	if (const auto *item = cache.Get(key)) {
+		++stats.hits;
+		stats.saved_time += item->compile_time;
+		return item->regex;
+	}
+
+	++stats.misses;
+
+	const auto start = std::chrono::steady_clock::now();
+	auto regex = std::make_shared<const UniqueRegex>(pattern, anchored,
+							 capture);
+	const auto compile_time = std::chrono::steady_clock::now() - start;
+	stats.compile_time += compile_time;
+
+	cache.Put(std::move(key), Item{regex, compile_time});
+	return regex;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Cache.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class UniqueRegex;
+
+/**
+ * A reference to a compiled regular expression which may be shared
+ * by several owners.
+ */
+using SharedRegex = std::shared_ptr<const UniqueRegex>;
+
+/**
+ * A cache of compiled (and JIT-compiled) regular expressions, keyed
+ * by pattern and compile flags.  Translation responses tend to
+ * repeat the same few patterns over and over; with this cache, each
+ * of them is compiled only once.
+ *
+ * The compiled objects are reference counted: evicting an entry
+ * from the cache does not affect those who are still using it.
+ *
+ * This class is not thread-safe.
+ */
+class RegexCache {
+	struct Item {
+		SharedRegex regex;
+
+		/**
+		 * How long did it take to compile this regex?
+		 */
+		std::chrono::steady_clock::duration compile_time;
+	};
+
+	Cache<std::string, Item, 4096, 4093> cache;
+
+public:
+	struct Stats {
+		uint64_t hits = 0, misses = 0;
+
+		/**
+		 * The total time spent compiling regular expressions.
+		 */
+		std::chrono::steady_clock::duration compile_time{};
+
+		/**
+		 * The total time which would have been spent
+		 * compiling regular expressions without this cache.
+		 */
+		std::chrono::steady_clock::duration saved_time{};
+	};
+
+private:
+	Stats stats;
+
+public:
+	/**
+	 * Look up a compiled regular expression; compile it on a
+	 * cache miss.
+	 *
+	 * Throws Pcre::Error on error.
+	 */
+	SharedRegex Get(const char *pattern, bool anchored, bool capture);
+
+	const Stats &GetStats() const noexcept {
+		return stats;
+	}
+};
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The binary format of the stopwatch ring buffer.  beng-proxy writes
+ * one #StopwatchRing::Record for each finished stopwatch span into a
+ * shared memory file, and a reader (e.g. "cm4all-beng-control
+ * stopwatch-dump") can reconstruct the trees of spans from it, even
+ * while beng-proxy is still writing.
+ *
+ * There is only one writer per file; readers never modify it.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace StopwatchRing {
+
+static constexpr uint32_t MAGIC = 0x62707377; // "bpsw"
+static constexpr uint32_t VERSION = 1;
+
+static constexpr std::size_t MAX_NAME = 64;
+static constexpr std::size_t MAX_EVENTS = 8;
+static constexpr std::size_t MAX_EVENT_NAME = 20;
+
+struct Event {
+	/**
+	 * The time of this event relative to the start of the span
+	 * [microseconds].
+	 */
+	uint32_t time;
+
+	/**
+	 * The event name (null-terminated, possibly truncated).
+	 */
+	char name[MAX_EVENT_NAME];
+};
+
+struct Record {
+	/**
+	 * The position of this record plus one.  This is written last
+	 * (and reset to 0 before the other attributes are modified),
+	 * which allows the reader to detect records which were
+	 * overwritten while it was copying them.
+	 */
+	uint64_t sequence;
+
+	/**
+	 * All spans which belong to the same (sampled) request share
+	 * the same trace id.
+	 */
+	uint64_t trace_id;
+
+	/**
+	 * The id of this span and of its parent span (0 for the root
+	 * span of a trace).
+	 */
+	uint32_t span_id, parent_id;
+
+	/**
+	 * The start time (CLOCK_MONOTONIC) [nanoseconds].
+	 */
+	uint64_t start;
+
+	/**
+	 * The duration of this span [microseconds].
+	 */
+	uint32_t duration;
+
+	uint32_t n_events;
+
+	char name[MAX_NAME];
+
+	Event events[MAX_EVENTS];
+};
+
+static_assert(sizeof(Record) % 8 == 0);
+
+struct Header {
+	uint32_t magic, version;
+
+	/**
+	 * The number of records following this header.
+	 */
+	uint32_t capacity;
+
+	uint32_t record_size;
+
+	/**
+	 * The total number of records which have ever been written.
+	 * The next record will be written at (head % capacity).
+	 */
+	uint64_t head;
+
+	uint64_t reserved[5];
+
+	/**
+	 * Calculate the capacity for the given file size.
+	 */
+	static constexpr std::size_t CapacityForSize(std::size_t size) noexcept {
+		return size > sizeof(Header)
+			? (size - sizeof(Header)) / sizeof(Record)
+			: 0;
+	}
+
+	bool IsValid(std::size_t size) const noexcept {
+		return magic == MAGIC && version == VERSION &&
+			record_size == sizeof(Record) &&
+			capacity > 0 && capacity <= CapacityForSize(size);
+	}
+
+	Record &GetRecord(uint64_t position) noexcept {
+		return reinterpret_cast<Record *>(this + 1)[position % capacity];
+	}
+
+	const Record &GetRecord(uint64_t position) const noexcept {
+		return reinterpret_cast<const Record *>(this + 1)[position % capacity];
+	}
+
+	uint64_t LoadHead() const noexcept {
+		return std::atomic_ref{const_cast<uint64_t &>(head)}
+			.load(std::memory_order_acquire);
+	}
+};
+
+static_assert(sizeof(Header) == 64);
+
+/**
+ * Copy a record from the (concurrently written) ring buffer.
+ *
+ * @return true if the record at the given position was copied
+ * successfully, false if it has been overwritten already (or is
+ * being written right now)
+ */
+inline bool
+ReadRecord(const Header &header, uint64_t position, Record &dest) noexcept
+{
+	const auto &src = header.GetRecord(position);
+	auto &sequence = const_cast<uint64_t &>(src.sequence);
+
+	const uint64_t before = std::atomic_ref{sequence}
+		.load(std::memory_order_acquire);
+	if (before != position + 1)
+		return false;
+
+	dest = src;
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return std::atomic_ref{sequence}.load(std::memory_order_relaxed) == before;
+}
+
+} // namespace StopwatchRing
@@ -48,6 +48,21 @@ BpConfig::HandleSet(std::string_view name, const char *value)
 		max_connections = ParsePositiveLong(value, 1024 * 1024);
 	} else if (name == "tcp_stock_limit"sv) {
 		tcp_stock_limit = ParseUnsignedLong(value);
+	} else if (name == "slow_start"sv) {
+		slow_start = std::chrono::seconds(ParseUnsignedLong(value));
+	} else if (name == "outlier_errors"sv) {
+		outlier.consecutive_errors = ParseUnsignedLong(value);
+	} else if (name == "outlier_latency_factor"sv) {
+		outlier.latency_factor = ParseUnsignedLong(value);
+	} else if (name == "outlier_latency_samples"sv) {
+		outlier.latency_samples = ParsePositiveLong(value, 1000);
+	} else if (name == "outlier_min_latency"sv) {
+		outlier.min_latency = std::chrono::milliseconds(ParseUnsignedLong(value));
+	} else if (name == "stats_file"sv) {
+		if (*value != '/')
+			throw std::runtime_error("Absolute path expected");
+
+		stats_file = value;
 	} else if (name == "lhttp_stock_limit"sv) {
 		lhttp_stock_limit = ParseUnsignedLong(value);
 	} else if (name == "lhttp_stock_max_idle"sv) {
@@ -60,6 +75,8 @@ BpConfig::HandleSet(std::string_view name, const char *value)
 		was_stock_limit = ParseUnsignedLong(value);
 	} else if (name == "was_stock_max_idle"sv) {
 		was_stock_max_idle = ParseUnsignedLong(value);
+	} else if (name == "was_shm"sv) {
+		was_shm = ParseBool(value);
 	} else if (name == "multi_was_stock_limit"sv) {
 		multi_was_stock_limit = ParseUnsignedLong(value);
 	} else if (name == "multi_was_stock_max_idle"sv) {
@@ -80,10 +97,22 @@ BpConfig::HandleSet(std::string_view name, const char *value)
 		translate_cache_size = ParseUnsignedLong(value);
 	} else if (name == "translate_stock_limit"sv) {
 		translate_stock_limit = ParseUnsignedLong(value);
+	} else if (name == "translate_multiplex"sv) {
+		translate_multiplex = ParseUnsignedLong(value);
 	} else if (name == "stopwatch"sv) {
 		/* deprecated */
 	} else if (name == "dump_widget_tree"sv) {
 		/* deprecated */
+	} else if (name == "early_hints"sv) {
+		early_hints = ParseBool(value);
+	} else if (name == "template_cache"sv) {
+		template_cache = ParseBool(value);
+	} else if (name == "open_file_cache"sv) {
+		open_file_cache = ParseBool(value);
+	} else if (name == "delegate_fd_cache"sv) {
+		delegate_fd_cache = ParseBool(value);
+	} else if (name == "cgi_zygote"sv) {
+		cgi_zygote = value;
 	} else if (name == "verbose_response"sv) {
 		verbose_response = ParseBool(value);
 	} else if (name == "session_cookie"sv) {
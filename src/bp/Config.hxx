@@ -36,11 +36,13 @@
 #include "ssl/Config.hxx"
 #include "http/CookieSameSite.hxx"
 #include "net/SocketConfig.hxx"
+#include "net/OutlierConfig.hxx"
 #include "spawn/Config.hxx"
 
 #include <forward_list>
 #include <chrono>
 #include <string_view>
+#include <vector>
 
 #include <stddef.h>
 
@@ -131,6 +133,13 @@ struct BpConfig {
 
 	std::forward_list<AllocatedSocketAddress> translation_sockets;
 
+	/**
+	 * Sets of equivalent translation servers (replicas).  The
+	 * first address of each set is the one which appears in
+	 * #translation_sockets (or in Listener::translation_sockets).
+	 */
+	std::forward_list<std::vector<AllocatedSocketAddress>> translation_replicas;
+
 	/** maximum number of simultaneous connections */
 	unsigned max_connections = 32768;
 
@@ -143,8 +152,34 @@ struct BpConfig {
 	unsigned translate_cache_size = 131072;
 	unsigned translate_stock_limit = 32;
 
+	/**
+	 * If non-zero, then the multiplexed translation protocol is
+	 * used with up to this many connections to each translation
+	 * server.
+	 */
+	unsigned translate_multiplex = 0;
+
 	unsigned tcp_stock_limit = 0;
 
+	/**
+	 * Backend servers which have just recovered from a failure
+	 * get only a fraction of the traffic for this duration (see
+	 * FailureManager::SetSlowStart()).
+	 */
+	std::chrono::seconds slow_start{};
+
+	/**
+	 * Settings for the passive outlier detection (see
+	 * FailureManager::SetOutlierConfig()).
+	 */
+	OutlierConfig outlier;
+
+	/**
+	 * If not empty, then statistics are published in this
+	 * shared memory file (see StatsSegmentWriter).
+	 */
+	std::string stats_file;
+
 	unsigned lhttp_stock_limit = 0, lhttp_stock_max_idle = 8;
 	unsigned fcgi_stock_limit = 0, fcgi_stock_max_idle = 8;
 
@@ -164,6 +199,42 @@ struct BpConfig {
 
 	bool http_cache_obey_no_cache = true;
 
+	/**
+	 * Send "103 Early Hints" with preload links harvested from
+	 * previous responses?
+	 */
+	bool early_hints = false;
+
+	/**
+	 * Remember the parser events of templates with a strong ETag,
+	 * to skip the XML parser the next time?
+	 */
+	bool template_cache = false;
+
+	/**
+	 * Keep static files open for a short while, to skip the path
+	 * lookups for hot files?
+	 */
+	bool open_file_cache = false;
+
+	/**
+	 * Remember file descriptors received from delegate helper
+	 * processes?
+	 */
+	bool delegate_fd_cache = false;
+
+	/**
+	 * The path of the "cgi-zygote" helper program; empty
+	 * disables CGI zygotes.
+	 */
+	std::string cgi_zygote;
+
+	/**
+	 * Offer a shared memory ring transport to new WAS child
+	 * processes?
+	 */
+	bool was_shm = false;
+
 	SpawnConfig spawn;
 
 	SslClientConfig ssl_client;
@@ -132,6 +132,30 @@ ParseListenerHandler(const char *s)
 		throw LineParser::Error("Unknown handler");
 }
 
+/**
+ * Parse the value(s) of "translation_socket".  More than one
+ * address declares a set of equivalent replicas; the first address
+ * is added to @a sockets, and the whole set to
+ * BpConfig::translation_replicas.
+ */
+static void
+ParseTranslationSocket(BpConfig &config,
+		       std::forward_list<AllocatedSocketAddress> &sockets,
+		       FileLineParser &line)
+{
+	std::vector<AllocatedSocketAddress> addresses;
+
+	do {
+		addresses.emplace_back(ParseSocketAddress(line.ExpectValue(),
+							  0, false));
+	} while (!line.IsEnd());
+
+	sockets.emplace_front(addresses.front());
+
+	if (addresses.size() > 1)
+		config.translation_replicas.emplace_front(std::move(addresses));
+}
+
 void
 BpConfigParser::Listener::ParseLine(FileLineParser &line)
 {
@@ -240,8 +264,8 @@ BpConfigParser::Listener::ParseLine(FileLineParser &line)
 		else
 			throw LineParser::Error("yes/no expected");
 	} else if (StringIsEqual(word, "translation_socket")) {
-		config.translation_sockets.emplace_front(ParseSocketAddress(line.ExpectValueAndEnd(),
-									    0, false));
+		ParseTranslationSocket(parent.config, config.translation_sockets,
+				       line);
 	} else if (strcmp(word, "handler") == 0) {
 		config.handler = ParseListenerHandler(line.ExpectValueAndEnd());
 	} else
@@ -345,8 +369,7 @@ BpConfigParser::ParseLine2(FileLineParser &line)
 		config.emulate_mod_auth_easy = line.NextBool();
 		line.ExpectEnd();
 	} else if (StringIsEqual(word, "translation_socket")) {
-		config.translation_sockets.emplace_front(ParseSocketAddress(line.ExpectValueAndEnd(),
-									    0, false));
+		ParseTranslationSocket(config, config.translation_sockets, line);
 	} else
 		throw LineParser::Error("Unknown option");
 }
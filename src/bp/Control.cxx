@@ -43,8 +43,10 @@
 #include "translation/InvalidateParser.hxx"
 #include "pool/tpool.hxx"
 #include "pool/pool.hxx"
+#include "pool/NameStats.hxx"
 #include "net/SocketAddress.hxx"
 #include "io/Logger.hxx"
+#include "util/ByteOrder.hxx"
 #include "util/SpanCast.hxx"
 #include "AllocatorPtr.hxx"
 #include "stopwatch.hxx"
@@ -53,6 +55,8 @@
 #include "lib/avahi/Publisher.hxx"
 #endif
 
+#include <string.h>
+
 using namespace BengProxy;
 
 static void
@@ -103,13 +107,21 @@ query_stats(BpInstance *instance, ControlServer *server,
 }
 
 static void
-HandleStopwatchPipe(std::span<const std::byte> payload,
+HandleStopwatchRing(std::span<const std::byte> payload,
 		    std::span<UniqueFileDescriptor> fds)
 {
-	if (!payload.empty() || fds.size() != 1 || !fds.front().IsPipe())
-		throw std::runtime_error("Malformed STOPWATCH_PIPE packet");
+	uint32_t sample_rate = 1;
+
+	if (payload.size() == sizeof(sample_rate)) {
+		memcpy(&sample_rate, payload.data(), sizeof(sample_rate));
+		sample_rate = FromBE32(sample_rate);
+	} else if (!payload.empty())
+		throw std::runtime_error("Malformed STOPWATCH_RING packet");
+
+	if (fds.size() != 1 || !fds.front().IsRegularFile())
+		throw std::runtime_error("Malformed STOPWATCH_RING packet");
 
-	stopwatch_enable(std::move(fds.front()));
+	stopwatch_enable(std::move(fds.front()), sample_rate);
 }
 
 void
@@ -135,8 +147,10 @@ BpInstance::OnControlPacket(ControlServer &control_server,
 		break;
 
 	case ControlCommand::DUMP_POOLS:
-		if (is_privileged)
+		if (is_privileged) {
 			pool_dump_tree(root_pool);
+			pool_dump_name_stats();
+		}
 		break;
 
 	case ControlCommand::ENABLE_NODE:
@@ -198,7 +212,10 @@ BpInstance::OnControlPacket(ControlServer &control_server,
 		break;
 
 	case ControlCommand::STOPWATCH_PIPE:
-		HandleStopwatchPipe(payload, fds);
+		throw std::runtime_error("STOPWATCH_PIPE is obsolete");
+
+	case ControlCommand::STOPWATCH_RING:
+		HandleStopwatchRing(payload, fds);
 		break;
 
 	case ControlCommand::DISCARD_SESSION:
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Request.hxx"
+#include "Instance.hxx"
+#include "EarlyHintsCache.hxx"
+#include "http/EarlyHints.hxx"
+#include "http/Headers.hxx"
+#include "http/IncomingRequest.hxx"
+
+#include <utility>
+
+static std::string
+MakeEarlyHintsKey(const char *host, const char *uri)
+{
+	std::string key{host};
+	key.append(uri);
+	return key;
+}
+
+void
+Request::SendEarlyHints() noexcept
+{
+	auto *cache = instance.early_hints_cache.get();
+	if (cache == nullptr || request.method != HTTP_METHOD_GET ||
+	    translate.request.host == nullptr ||
+	    std::exchange(early_hints_sent, true))
+		return;
+
+	const auto *link =
+		cache->Get(MakeEarlyHintsKey(translate.request.host,
+					     request.uri));
+	if (link != nullptr)
+		request.SendEarlyHints(*link);
+}
+
+void
+Request::HarvestEarlyHints(http_status_t status,
+			   const HttpHeaders &headers) noexcept
+{
+	auto *cache = instance.early_hints_cache.get();
+	if (cache == nullptr || request.method != HTTP_METHOD_GET ||
+	    translate.request.host == nullptr ||
+	    status != HTTP_STATUS_OK)
+		return;
+
+	const char *link = headers.Get("link");
+
+	try {
+		auto key = MakeEarlyHintsKey(translate.request.host,
+					     request.uri);
+		auto hints = link != nullptr
+			? FilterEarlyHintsLinks(link)
+			: std::string{};
+		if (hints.empty())
+			/* forget stale hints */
+			cache->Remove(key);
+		else
+			cache->PutOrReplace(std::move(key), std::move(hints));
+	} catch (...) {
+		/* out of memory - ignore, this is just an
+		   optimization */
+	}
+}
@@ -226,8 +226,16 @@ Request::EmulateModAuthEasy(const FileAddress &address,
 			    UniqueFileDescriptor &fd,
 			    const struct statx &st) noexcept
 {
-	if (!CheckAccessFileFor(handler.file.base, request.headers,
-				address.path)) {
+	FileDescriptor base;
+
+	try {
+		base = GetFileBase();
+	} catch (...) {
+		LogDispatchError(std::current_exception());
+		return true;
+	}
+
+	if (!CheckAccessFileFor(base, request.headers, address.path)) {
 		DispatchUnauthorized(*this);
 		return true;
 	}
@@ -34,6 +34,7 @@
 #include "file/Address.hxx"
 #include "Request.hxx"
 #include "Instance.hxx"
+#include "OpenFileCache.hxx"
 #include "http/HeaderWriter.hxx"
 #include "http/PHeaderUtil.hxx"
 #include "http/Headers.hxx"
@@ -45,17 +46,32 @@
 #include "translation/Vary.hxx"
 #include "system/Error.hxx"
 #include "io/Open.hxx"
+#include "util/Exception.hxx"
 #include "util/StringCompare.hxx"
 
 #ifdef HAVE_URING
+#include "io/UringOpen.hxx"
 #include "io/UringOpenStat.hxx"
 #include "event/uring/Manager.hxx"
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 
+/**
+ * May this error be remembered with OpenFileCache::PutAbsent()?  Only
+ * errors which say that the file does not exist qualify; anything
+ * else (e.g. EMFILE or EACCES) may be transient.
+ */
+static bool
+IsAbsentError(std::exception_ptr ep) noexcept
+{
+	const auto *e = FindNested<std::system_error>(ep);
+	return e != nullptr && (IsErrno(*e, ENOENT) || IsErrno(*e, ENOTDIR));
+}
+
 void
 Request::DispatchFile(const char *path, UniqueFileDescriptor fd,
 		      const struct statx &st,
@@ -131,29 +147,63 @@ Request::DispatchFile(const char *path, UniqueFileDescriptor fd,
 }
 
 bool
-Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
-				const struct statx &st,
-				const char *encoding) noexcept
+Request::OpenCompressedFile(const char *path,
+			    UniqueFileDescriptor &fd,
+			    struct statx &st) noexcept
 {
-	const TranslateResponse &tr = *translate.response;
 	const auto &address = *handler.file.address;
 
-	/* open compressed file */
+	auto *const open_file_cache = instance.open_file_cache.get();
+	const auto cached = open_file_cache != nullptr
+		? open_file_cache->Get(address.base, path, fd, st)
+		: OpenFileCache::Result::MISS;
+
+	switch (cached) {
+	case OpenFileCache::Result::MISS:
+		break;
 
-	UniqueFileDescriptor compressed_fd;
+	case OpenFileCache::Result::FOUND:
+		return true;
+
+	case OpenFileCache::Result::ABSENT:
+		return false;
+	}
 
 	try {
-		compressed_fd = OpenReadOnly(handler.file.base, path);
+		fd = OpenReadOnly(GetFileBase(), path);
 	} catch (...) {
+		if (open_file_cache != nullptr &&
+		    IsAbsentError(std::current_exception()))
+			open_file_cache->PutAbsent(address.base, path);
 		return false;
 	}
 
-	struct statx st2;
-	if (statx(compressed_fd.Get(), "", AT_EMPTY_PATH,
-		  STATX_TYPE|STATX_MTIME|STATX_INO|STATX_SIZE, &st2) < 0 ||
-	    !S_ISREG(st2.stx_mode))
+	if (statx(fd.Get(), "", AT_EMPTY_PATH,
+		  STATX_TYPE|STATX_MTIME|STATX_INO|STATX_SIZE, &st) < 0)
 		return false;
 
+	if (!S_ISREG(st.stx_mode)) {
+		if (open_file_cache != nullptr)
+			open_file_cache->PutAbsent(address.base, path);
+		return false;
+	}
+
+	if (open_file_cache != nullptr)
+		open_file_cache->Put(address.base, path, fd, st);
+
+	return true;
+}
+
+void
+Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
+				const struct statx &st,
+				const char *encoding,
+				UniqueFileDescriptor compressed_fd,
+				const struct statx &st2) noexcept
+{
+	const TranslateResponse &tr = *translate.response;
+	const auto &address = *handler.file.address;
+
 	/* response headers with information from uncompressed file */
 
 	const char *override_content_type = translate.content_type;
@@ -189,36 +239,28 @@ Request::DispatchCompressedFile(const char *path, FileDescriptor fd,
 			 istream_file_fd_new(instance.event_loop, pool,
 					     path, std::move(compressed_fd),
 					     0, st2.stx_size));
-	return true;
 }
 
-bool
-Request::CheckCompressedFile(const char *path, FileDescriptor fd,
-			     const struct statx &st,
-			     const char *encoding) noexcept
+void
+Request::CollectCompressedVariants(const FileAddress &address) noexcept
 {
-	return path != nullptr &&
-		http_client_accepts_encoding(request.headers, encoding) &&
-		DispatchCompressedFile(path, fd, st, encoding);
-}
+	const AllocatorPtr alloc(pool);
 
-bool
-Request::CheckAutoCompressedFile(const char *path, FileDescriptor fd,
-				 const struct statx &st,
-				 const char *encoding, const char *suffix) noexcept
-{
-	assert(encoding != nullptr);
-	assert(path != nullptr);
-	assert(suffix != nullptr);
-	assert(*suffix == '.');
-	assert(suffix[1] != 0);
+	if (address.deflated != nullptr &&
+	    http_client_accepts_encoding(request.headers, "deflate"))
+		AddCompressedVariant(address.deflated, "deflate");
 
-	if (!http_client_accepts_encoding(request.headers, encoding))
-		return false;
+	if (address.auto_brotli_path &&
+	    http_client_accepts_encoding(request.headers, "br"))
+		AddCompressedVariant(alloc.Concat(address.path, ".br"), "br");
 
-	const AllocatorPtr alloc(pool);
-	const char *compressed_path = alloc.Concat(path, suffix);
-	return DispatchCompressedFile(compressed_path, fd, st, encoding);
+	if (address.auto_gzipped &&
+	    http_client_accepts_encoding(request.headers, "gzip"))
+		AddCompressedVariant(alloc.Concat(address.path, ".gz"), "gzip");
+
+	if (address.gzipped != nullptr &&
+	    http_client_accepts_encoding(request.headers, "gzip"))
+		AddCompressedVariant(address.gzipped, "gzip");
 }
 
 inline bool
@@ -247,18 +289,202 @@ Request::MaybeEmulateModAuthEasy(const FileAddress &address,
 	return EmulateModAuthEasy(address, fd, st);
 }
 
+FileDescriptor
+Request::GetFileBase()
+{
+	if (handler.file.base == FileDescriptor::Undefined()) {
+		const auto &address = *handler.file.address;
+		if (address.base != nullptr)
+			handler.file.base =
+				handler.file.base_ = OpenPath(address.base);
+		else
+			handler.file.base = FileDescriptor(AT_FDCWD);
+	}
+
+	return handler.file.base;
+}
+
+/**
+ * Add a newly opened file to the #OpenFileCache (if enabled).
+ */
+static void
+PutOpenFileCache(OpenFileCache *cache, const FileAddress &address,
+		 FileDescriptor fd, const struct statx &st) noexcept
+{
+	if (cache != nullptr && S_ISREG(st.stx_mode))
+		cache->Put(address.base, address.path, fd, st);
+}
+
 #ifdef HAVE_URING
 
+void
+Request::StartOpenFile() noexcept
+{
+	auto &file = handler.file;
+	file.step = FileStep::FILE;
+	UringOpenStat(*instance.uring, pool,
+		      file.base, file.address->path,
+		      *this, cancel_ptr);
+}
+
+void
+Request::ProbeNextCompressedVariant() noexcept
+{
+	auto &file = handler.file;
+	const auto &address = *file.address;
+	auto *const open_file_cache = instance.open_file_cache.get();
+
+	while (file.next_variant < file.n_variants) {
+		const auto &variant = file.variants[file.next_variant];
+
+		if (open_file_cache != nullptr) {
+			UniqueFileDescriptor compressed_fd;
+			struct statx compressed_st;
+
+			switch (open_file_cache->Get(address.base, variant.path,
+						     compressed_fd,
+						     compressed_st)) {
+			case OpenFileCache::Result::MISS:
+				break;
+
+			case OpenFileCache::Result::FOUND:
+				DispatchCompressedFile(variant.path,
+						       file.fd, file.st,
+						       variant.encoding,
+						       std::move(compressed_fd),
+						       compressed_st);
+				return;
+
+			case OpenFileCache::Result::ABSENT:
+				++file.next_variant;
+				continue;
+			}
+		}
+
+		if (file.base == FileDescriptor::Undefined()) {
+			/* the file was found in the OpenFileCache,
+			   and the base directory has not been opened
+			   yet */
+			if (address.base != nullptr) {
+				file.step = FileStep::VARIANT_BASE;
+				UringOpen(*instance.uring,
+					  FileDescriptor(AT_FDCWD),
+					  address.base, O_PATH,
+					  *this, cancel_ptr);
+				return;
+			}
+
+			file.base = FileDescriptor(AT_FDCWD);
+		}
+
+		file.step = FileStep::VARIANT;
+		UringOpenStat(*instance.uring, pool,
+			      file.base, variant.path,
+			      *this, cancel_ptr);
+		return;
+	}
+
+	/* no precompressed variant available: send the file
+	   itself */
+
+	const struct file_request file_request(file.st.stx_size);
+	DispatchFile(address.path, std::move(file.fd), file.st,
+		     file_request);
+}
+
 void
 Request::OnOpenStat(UniqueFileDescriptor fd,
 		    struct statx &st) noexcept
 {
-	HandleFileAddress(*handler.file.address, std::move(fd), st);
+	auto &file = handler.file;
+	const auto &address = *file.address;
+	auto *const open_file_cache = instance.open_file_cache.get();
+
+	if (file.step == FileStep::VARIANT) {
+		const auto &variant = file.variants[file.next_variant++];
+
+		if (!S_ISREG(st.stx_mode)) {
+			if (open_file_cache != nullptr)
+				open_file_cache->PutAbsent(address.base,
+							   variant.path);
+
+			ProbeNextCompressedVariant();
+			return;
+		}
+
+		if (open_file_cache != nullptr)
+			open_file_cache->Put(address.base, variant.path,
+					     fd, st);
+
+		DispatchCompressedFile(variant.path, file.fd, file.st,
+				       variant.encoding,
+				       std::move(fd), st);
+		return;
+	}
+
+	assert(file.step == FileStep::FILE);
+
+	PutOpenFileCache(open_file_cache, address, fd, st);
+	HandleFileAddress(address, std::move(fd), st);
 }
 
 void
 Request::OnOpenStatError(std::exception_ptr e) noexcept
 {
+	auto &file = handler.file;
+
+	if (file.step == FileStep::VARIANT) {
+		/* this variant is not available; try the next one */
+		const auto &variant = file.variants[file.next_variant++];
+
+		if (auto *c = instance.open_file_cache.get();
+		    c != nullptr && IsAbsentError(e))
+			c->PutAbsent(file.address->base, variant.path);
+
+		ProbeNextCompressedVariant();
+		return;
+	}
+
+	LogDispatchError(std::move(e));
+}
+
+void
+Request::OnUringOpen(UniqueFileDescriptor fd) noexcept
+{
+	auto &file = handler.file;
+	file.base = file.base_ = std::move(fd);
+
+	switch (file.step) {
+	case FileStep::BASE:
+		StartOpenFile();
+		return;
+
+	case FileStep::VARIANT_BASE:
+		ProbeNextCompressedVariant();
+		return;
+
+	case FileStep::FILE:
+	case FileStep::VARIANT:
+		break;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
+
+void
+Request::OnUringOpenError(std::exception_ptr e) noexcept
+{
+	auto &file = handler.file;
+
+	if (file.step == FileStep::VARIANT_BASE) {
+		/* give up on the precompressed variants, send the
+		   file we already have */
+		file.next_variant = file.n_variants;
+		ProbeNextCompressedVariant();
+		return;
+	}
+
 	LogDispatchError(std::move(e));
 }
 
@@ -289,28 +515,43 @@ Request::HandleFileAddress(const FileAddress &address) noexcept
 
 	/* open the file */
 
-	if (address.base != nullptr) {
-		// TODO: use uring
-		try {
-			handler.file.base =
-				handler.file.base_ = OpenPath(address.base);
-		} catch (...) {
-			LogDispatchError(std::current_exception());
+	handler.file.base = FileDescriptor::Undefined();
+
+	auto *const open_file_cache = instance.open_file_cache.get();
+	if (open_file_cache != nullptr) {
+		UniqueFileDescriptor fd;
+		struct statx st;
+
+		if (open_file_cache->Get(address.base, path, fd, st) ==
+		    OpenFileCache::Result::FOUND) {
+			HandleFileAddress(address, std::move(fd), st);
 			return;
 		}
-	} else
-		handler.file.base = FileDescriptor(AT_FDCWD);
+	}
 
 #ifdef HAVE_URING
 	if (instance.uring) {
-		UringOpenStat(*instance.uring, pool,
-			      handler.file.base,
-			      path,
-			      *this, cancel_ptr);
+		if (address.base != nullptr) {
+			handler.file.step = FileStep::BASE;
+			UringOpen(*instance.uring, FileDescriptor(AT_FDCWD),
+				  address.base, O_PATH,
+				  *this, cancel_ptr);
+		} else {
+			handler.file.base = FileDescriptor(AT_FDCWD);
+			StartOpenFile();
+		}
+
 		return;
 	}
 #endif
 
+	try {
+		GetFileBase();
+	} catch (...) {
+		LogDispatchError(std::current_exception());
+		return;
+	}
+
 	UniqueFileDescriptor fd;
 	struct statx st;
 
@@ -325,6 +566,7 @@ Request::HandleFileAddress(const FileAddress &address) noexcept
 		return;
 	}
 
+	PutOpenFileCache(open_file_cache, address, fd, st);
 	HandleFileAddress(address, std::move(fd), st);
 }
 
@@ -362,16 +604,39 @@ Request::HandleFileAddress(const FileAddress &address,
 
 	/* precompressed? */
 
+	auto &file = handler.file;
+	file.n_variants = file.next_variant = 0;
+
 	if (!compressed &&
 	    file_request.range.type == HttpRangeRequest::Type::NONE &&
-	    !IsTransformationEnabled() &&
-	    (CheckCompressedFile(address.deflated, fd, st, "deflate") ||
-	     (address.auto_brotli_path &&
-	      CheckAutoCompressedFile(address.path, fd, st, "br", ".br")) ||
-	     (address.auto_gzipped &&
-	      CheckAutoCompressedFile(address.path, fd, st, "gzip", ".gz")) ||
-	     CheckCompressedFile(address.gzipped, fd, st, "gzip")))
+	    !IsTransformationEnabled())
+		CollectCompressedVariants(address);
+
+#ifdef HAVE_URING
+	if (instance.uring && file.n_variants > 0) {
+		/* probe the variants asynchronously; meanwhile, keep
+		   the file open, it is the fallback */
+		file.fd = std::move(fd);
+		file.st = st;
+		ProbeNextCompressedVariant();
 		return;
+	}
+#endif
+
+	for (unsigned i = 0; i < file.n_variants; ++i) {
+		const auto &variant = file.variants[i];
+
+		UniqueFileDescriptor compressed_fd;
+		struct statx compressed_st;
+		if (OpenCompressedFile(variant.path,
+				       compressed_fd, compressed_st)) {
+			DispatchCompressedFile(variant.path, fd, st,
+					       variant.encoding,
+					       std::move(compressed_fd),
+					       compressed_st);
+			return;
+		}
+	}
 
 	/* build the response */
 
@@ -381,8 +646,6 @@ Request::HandleFileAddress(const FileAddress &address,
 static bool
 PathExists(const FileAddress &address)
 {
-	// TODO: use uring
-
 	struct statx st;
 
 	if (address.base != nullptr) {
@@ -423,15 +686,36 @@ ErrnoToHttpStatus(int e) noexcept
 }
 
 void
-Request::HandlePathExists(const FileAddress &address) noexcept
+Request::OnPathExists(int error) noexcept
+{
+	translate.request.status = error == 0
+		? HTTP_STATUS_OK
+		: ErrnoToHttpStatus(error);
+	translate.request.path_exists = true;
+	SubmitTranslateRequest();
+}
+
+void
+Request::HandlePathExists([[maybe_unused]] const TranslateResponse &response,
+			  const FileAddress &address) noexcept
 {
+#ifdef HAVE_URING
+	if (instance.uring) {
+		StartFileCheck(response, FileCheck::PATH_EXISTS,
+			       address.base, address.path,
+			       AT_SYMLINK_NOFOLLOW|AT_STATX_SYNC_AS_STAT, 0);
+		return;
+	}
+#endif
+
+	bool exists;
+
 	try {
-		translate.request.status = PathExists(address)
-			? HTTP_STATUS_OK
-			: ErrnoToHttpStatus(errno);
-		translate.request.path_exists = true;
-		SubmitTranslateRequest();
+		exists = PathExists(address);
 	} catch (...) {
 		LogDispatchError(std::current_exception());
+		return;
 	}
+
+	OnPathExists(exists ? 0 : errno);
 }
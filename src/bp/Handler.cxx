@@ -64,7 +64,12 @@
 #include "HttpMessageResponse.hxx"
 #include "ResourceLoader.hxx"
 
+#ifdef HAVE_URING
+#include "event/uring/Manager.hxx"
+#endif
+
 #include <assert.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 using std::string_view_literals::operator""sv;
@@ -186,6 +191,11 @@ Request::HandleTranslatedRequest2(const TranslateResponse &response) noexcept
 		args.Get("focus") != nullptr;
 
 	if (address.IsDefined()) {
+		/* translation and all access checks have passed; the
+		   hints can be sent while the resource is being
+		   generated */
+		SendEarlyHints();
+
 		HandleAddress(address);
 	} else if (CheckHandleRedirectBounceStatus(response)) {
 		/* done */
@@ -475,13 +485,12 @@ fill_translate_request_user(Request &request,
 	}
 }
 
-[[gnu::pure]]
 static const TranslationLayoutItem *
 FindLayoutItem(ConstBuffer<TranslationLayoutItem> items,
-	       const char *uri) noexcept
+	       const char *uri, RegexCache &regex_cache) noexcept
 {
 	for (const auto &i : items)
-		if (i.Match(uri))
+		if (i.Match(uri, regex_cache))
 			return &i;
 
 	return nullptr;
@@ -514,7 +523,8 @@ Request::RepeatTranslation(const TranslateResponse &response) noexcept
 
 		translate.request.layout = response.layout;
 		translate.request.layout_item = FindLayoutItem(response.layout_items,
-							       uri);
+							       uri,
+							       instance.regex_cache);
 	}
 
 	if (response.check.data() != nullptr) {
@@ -863,23 +873,103 @@ Request::OnTranslateResponse2(const TranslateResponse &response)
 	if (CheckHandleProbePathSuffixes(response))
 		return;
 
-	/* check ENOTDIR */
-	if (response.enotdir.data() != nullptr && !CheckFileEnotdir(response))
+	ContinueFileChecks(response, FileCheck::ENOTDIR);
+}
+
+void
+Request::ContinueFileChecks(const TranslateResponse &response,
+			    FileCheck check) noexcept
+{
+	switch (check) {
+	case FileCheck::ENOTDIR:
+		/* check ENOTDIR */
+		if (response.enotdir.data() != nullptr &&
+		    !CheckFileEnotdir(response))
+			return;
+
+		[[fallthrough]];
+
+	case FileCheck::FILE_NOT_FOUND:
+		/* check if the file exists */
+		if (response.file_not_found.data() != nullptr &&
+		    !CheckFileNotFound(response))
+			return;
+
+		[[fallthrough]];
+
+	case FileCheck::DIRECTORY_INDEX:
+		/* check if it's a directory */
+		if (response.directory_index.data() != nullptr &&
+		    !CheckDirectoryIndex(response))
+			return;
+
+		break;
+
+	case FileCheck::PATH_EXISTS:
+		assert(false);
+		gcc_unreachable();
+	}
+
+	HandleTranslatedRequest(response);
+}
+
+#ifdef HAVE_URING
+
+void
+Request::StartFileCheck(const TranslateResponse &response,
+			FileCheck check,
+			const char *base, const char *path,
+			int flags, unsigned mask) noexcept
+{
+	file_check.response = &response;
+	file_check.check = check;
+
+	UringStatAt(*instance.uring, base, path, flags, mask,
+		    *this, cancel_ptr);
+}
+
+void
+Request::OnFileCheck(int error, const struct statx *st) noexcept
+{
+	const auto &response = *file_check.response;
+
+	switch (file_check.check) {
+	case FileCheck::ENOTDIR:
+		if (error == ENOTDIR && !SubmitEnotdir(response))
+			return;
+
+		ContinueFileChecks(response, FileCheck::FILE_NOT_FOUND);
 		return;
 
-	/* check if the file exists */
-	if (response.file_not_found.data() != nullptr &&
-	    !CheckFileNotFound(response))
+	case FileCheck::FILE_NOT_FOUND:
+		if (error == ENOENT) {
+			SubmitFileNotFound(response);
+			return;
+		}
+
+		ContinueFileChecks(response, FileCheck::DIRECTORY_INDEX);
 		return;
 
-	/* check if it's a directory */
-	if (response.directory_index.data() != nullptr &&
-	    !CheckDirectoryIndex(response))
+	case FileCheck::DIRECTORY_INDEX:
+		if (error == 0 && S_ISDIR(st->stx_mode)) {
+			SubmitDirectoryIndex(response);
+			return;
+		}
+
+		HandleTranslatedRequest(response);
 		return;
 
-	HandleTranslatedRequest(response);
+	case FileCheck::PATH_EXISTS:
+		OnPathExists(error);
+		return;
+	}
+
+	assert(false);
+	gcc_unreachable();
 }
 
+#endif
+
 inline bool
 Request::CheckHandleReadFile(const TranslateResponse &response) noexcept
 {
@@ -921,15 +1011,13 @@ Request::CheckHandlePathExists(const TranslateResponse &response) noexcept
 		return true;
 	}
 
-	// TODO use io_uring
-
 	if (response.address.type != ResourceAddress::Type::LOCAL) {
 		LogDispatchError(HTTP_STATUS_BAD_GATEWAY,
 				 "PATH_EXISTS without PATH", 1);
 		return true;
 	}
 
-	HandlePathExists(response.address.GetFile());
+	HandlePathExists(response, response.address.GetFile());
 	return true;
 }
 
@@ -33,7 +33,12 @@
 #include "Instance.hxx"
 #include "Listener.hxx"
 #include "Connection.hxx"
+#include "EarlyHintsCache.hxx"
+#include "XmlTemplateCache.hxx"
+#include "OpenFileCache.hxx"
+#include "cgi/Zygote.hxx"
 #include "memory/fb_pool.hxx"
+#include "stats/SegmentWriter.hxx"
 #include "control/Server.hxx"
 #include "control/Local.hxx"
 #include "cluster/TcpBalancer.hxx"
@@ -87,8 +92,13 @@ BpInstance::BpInstance(BpConfig &&_config) noexcept
 	 shutdown_listener(event_loop, BIND_THIS_METHOD(ShutdownCallback)),
 	 sighup_event(event_loop, SIGHUP, BIND_THIS_METHOD(ReloadEventCallback)),
 	 compress_timer(event_loop, BIND_THIS_METHOD(OnCompressTimer)),
+	 stats_segment_timer(event_loop,
+			     BIND_THIS_METHOD(OnStatsSegmentTimer)),
 	 session_save_timer(event_loop, BIND_THIS_METHOD(SaveSessions))
 {
+	failure_manager.SetSlowStart(config.slow_start);
+	failure_manager.SetOutlierConfig(config.outlier);
+
 	ForkCow(false);
 	ScheduleCompress();
 }
@@ -128,6 +138,10 @@ BpInstance::FreeStocksAndCaches() noexcept
 		filter_cache = nullptr;
 	}
 
+	early_hints_cache.reset();
+	xml_template_cache.reset();
+	open_file_cache.reset();
+
 	if (lhttp_stock != nullptr) {
 		lhttp_stock_free(lhttp_stock);
 		lhttp_stock = nullptr;
@@ -161,6 +175,8 @@ BpInstance::FreeStocksAndCaches() noexcept
 		delegate_stock = nullptr;
 	}
 
+	cgi_zygote_pool.reset();
+
 #ifdef HAVE_LIBNFS
 	if (nfs_cache != nullptr) {
 		nfs_cache_free(nfs_cache);
@@ -35,6 +35,7 @@
 #include "PInstance.hxx"
 #include "CommandLine.hxx"
 #include "Config.hxx"
+#include "RegexCache.hxx"
 #include "stats/TaggedHttpStats.hxx"
 #include "lib/avahi/ErrorHandler.hxx"
 #include "event/SignalEvent.hxx"
@@ -81,7 +82,12 @@ class NfsStock;
 class NfsCache;
 class HttpCache;
 class FilterCache;
+class EarlyHintsCache;
+class XmlTemplateCache;
+class OpenFileCache;
+class CgiZygotePool;
 class SessionManager;
+class StatsSegmentWriter;
 namespace Uring { class Manager; }
 class BPListener;
 struct BpConnection;
@@ -113,6 +119,13 @@ struct BpInstance final : PInstance, ControlHandler, SpawnServerClientHandler,
 
 	FarTimerEvent compress_timer;
 
+	/**
+	 * Publishes statistics in a shared memory file; see
+	 * BpConfig::stats_file.
+	 */
+	std::unique_ptr<StatsSegmentWriter> stats_segment;
+	FarTimerEvent stats_segment_timer;
+
 	/**
 	 * Registry for jobs running in background, created by the request
 	 * handler code.
@@ -149,6 +162,12 @@ struct BpInstance final : PInstance, ControlHandler, SpawnServerClientHandler,
 	/* stock */
 	FailureManager failure_manager;
 
+	/**
+	 * Compiled regular expressions shared by all translation
+	 * caches and by LAYOUT lookups.
+	 */
+	RegexCache regex_cache;
+
 	std::unique_ptr<TranslationStockBuilder> translation_stocks;
 	std::shared_ptr<MultiTranslationService> uncached_translation_service;
 
@@ -175,6 +194,30 @@ struct BpInstance final : PInstance, ControlHandler, SpawnServerClientHandler,
 
 	FilterCache *filter_cache = nullptr;
 
+	/**
+	 * Preload links for "103 Early Hints"; only allocated if
+	 * enabled in the configuration.
+	 */
+	std::unique_ptr<EarlyHintsCache> early_hints_cache;
+
+	/**
+	 * Pre-tokenized templates for the #XmlProcessor; only
+	 * allocated if enabled in the configuration.
+	 */
+	std::unique_ptr<XmlTemplateCache> xml_template_cache;
+
+	/**
+	 * Open file descriptors of static files; only allocated if
+	 * enabled in the configuration.
+	 */
+	std::unique_ptr<OpenFileCache> open_file_cache;
+
+	/**
+	 * Launches CGI programs via "cgi-zygote" processes (if
+	 * enabled) and collects CGI latency statistics.
+	 */
+	std::unique_ptr<CgiZygotePool> cgi_zygote_pool;
+
 	LhttpStock *lhttp_stock = nullptr;
 	FcgiStock *fcgi_stock = nullptr;
 
@@ -244,6 +287,14 @@ struct BpInstance final : PInstance, ControlHandler, SpawnServerClientHandler,
 	[[gnu::pure]]
 	BengProxy::ControlStats GetStats() const noexcept;
 
+	/**
+	 * Open the file specified by BpConfig::stats_file and start
+	 * publishing statistics in it periodically.
+	 *
+	 * Throws on error.
+	 */
+	void EnableStatsSegment();
+
 	/* virtual methods from class ControlHandler */
 	void OnControlPacket(ControlServer &control_server,
 			     BengProxy::ControlCommand command,
@@ -263,6 +314,9 @@ struct BpInstance final : PInstance, ControlHandler, SpawnServerClientHandler,
 private:
 	bool AllocatorCompressCallback() noexcept;
 
+	void PublishStats() noexcept;
+	void OnStatsSegmentTimer() noexcept;
+
 	void SaveSessions() noexcept;
 
 	void FreeStocksAndCaches() noexcept;
@@ -35,6 +35,9 @@
 #include "Listener.hxx"
 #include "Connection.hxx"
 #include "Global.hxx"
+#include "EarlyHintsCache.hxx"
+#include "XmlTemplateCache.hxx"
+#include "OpenFileCache.hxx"
 #include "pool/pool.hxx"
 #include "memory/fb_pool.hxx"
 #include "session/Manager.hxx"
@@ -55,6 +58,7 @@
 #include "was/MStock.hxx"
 #include "was/RStock.hxx"
 #include "delegate/Stock.hxx"
+#include "cgi/Zygote.hxx"
 #include "fcache.hxx"
 #include "thread/Pool.hxx"
 #include "pipe_stock.hxx"
@@ -182,6 +186,7 @@ BpInstance::ShutdownCallback() noexcept
 #endif
 
 	compress_timer.Cancel();
+	stats_segment_timer.Cancel();
 
 	zombie_reaper.Disable();
 
@@ -409,6 +414,9 @@ try {
 		instance.ScheduleSaveSessions();
 	}
 
+	if (!instance.config.stats_file.empty())
+		instance.EnableStatsSegment();
+
 	local_control_handler_init(&instance);
 
 	try {
@@ -455,7 +463,12 @@ try {
 	assert(!instance.config.translation_sockets.empty());
 
 	instance.translation_stocks =
-		std::make_unique<TranslationStockBuilder>(instance.config.translate_stock_limit);
+		std::make_unique<TranslationStockBuilder>(instance.failure_manager,
+							  instance.config.translate_stock_limit,
+							  instance.config.translate_multiplex);
+	for (const auto &i : instance.config.translation_replicas)
+		instance.translation_stocks->AddReplicas(i);
+
 	instance.uncached_translation_service =
 		std::make_unique<MultiTranslationService>();
 
@@ -463,6 +476,7 @@ try {
 		instance.translation_caches =
 			std::make_unique<TranslationCacheBuilder>(*instance.translation_stocks,
 								  instance.root_pool,
+								  instance.regex_cache,
 								  instance.config.translate_cache_size);
 		instance.cached_translation_service =
 			std::make_unique<MultiTranslationService>();
@@ -508,7 +522,8 @@ try {
 					  *instance.spawn_service,
 					  child_log_socket, child_log_options,
 					  instance.config.was_stock_limit,
-					  instance.config.was_stock_max_idle);
+					  instance.config.was_stock_max_idle,
+					  instance.config.was_shm);
 	instance.multi_was_stock =
 		new MultiWasStock(instance.config.multi_was_stock_limit,
 				  instance.config.multi_was_stock_max_idle,
@@ -523,7 +538,8 @@ try {
 #endif
 
 	instance.delegate_stock = delegate_stock_new(instance.event_loop,
-						     *instance.spawn_service);
+						     *instance.spawn_service,
+						     instance.config.delegate_fd_cache);
 
 #ifdef HAVE_LIBNFS
 	instance.nfs_stock = nfs_stock_new(instance.event_loop);
@@ -533,6 +549,13 @@ try {
 					   instance.event_loop);
 #endif
 
+	instance.cgi_zygote_pool =
+		std::make_unique<CgiZygotePool>(instance.event_loop,
+						*instance.spawn_service,
+						instance.config.cgi_zygote.empty()
+						? nullptr
+						: instance.config.cgi_zygote.c_str());
+
 	instance.direct_resource_loader =
 		new DirectResourceLoader(instance.event_loop,
 #ifdef HAVE_URING
@@ -544,6 +567,7 @@ try {
 					 *instance.nghttp2_stock,
 #endif
 					 *instance.spawn_service,
+					 instance.cgi_zygote_pool.get(),
 					 instance.lhttp_stock,
 					 instance.fcgi_stock,
 #ifdef HAVE_LIBWAS
@@ -572,6 +596,18 @@ try {
 
 	instance.pipe_stock = new PipeStock(instance.event_loop);
 
+	if (instance.config.early_hints)
+		instance.early_hints_cache = std::make_unique<EarlyHintsCache>();
+
+	if (instance.config.template_cache)
+		instance.xml_template_cache =
+			std::make_unique<XmlTemplateCache>(instance.root_pool,
+							   instance.event_loop);
+
+	if (instance.config.open_file_cache)
+		instance.open_file_cache =
+			std::make_unique<OpenFileCache>(instance.event_loop);
+
 	if (instance.config.filter_cache_size > 0) {
 		instance.filter_cache = filter_cache_new(instance.root_pool,
 							 instance.config.filter_cache_size,
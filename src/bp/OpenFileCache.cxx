@@ -0,0 +1,103 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "OpenFileCache.hxx"
+#include "event/Loop.hxx"
+#include "io/Reopen.hxx"
+
+static std::string
+MakeKey(const char *base, const char *path) noexcept
+{
+	std::string key;
+	if (base != nullptr)
+		key = base;
+
+	/* the null byte cannot occur in paths, so it's a safe
+	   separator */
+	key.push_back('\0');
+	key.append(path);
+	return key;
+}
+
+OpenFileCache::Result
+OpenFileCache::Get(const char *base, const char *path,
+		   UniqueFileDescriptor &fd, struct statx &st) noexcept
+{
+	const auto key = MakeKey(base, path);
+	auto *item = cache.Get(key);
+	if (item == nullptr)
+		return Result::MISS;
+
+	if (event_loop.SteadyNow() >= item->expires) {
+		cache.Remove(key);
+		return Result::MISS;
+	}
+
+	if (!item->fd.IsDefined())
+		return Result::ABSENT;
+
+	fd = ReopenReadOnly(item->fd);
+	if (!fd.IsDefined())
+		/* out of file descriptors, or the file has become
+		   inaccessible */
+		return Result::MISS;
+
+	st = item->st;
+	return Result::FOUND;
+}
+
+void
+OpenFileCache::Put(const char *base, const char *path,
+		   Item &&item) noexcept
+{
+	item.expires = event_loop.SteadyNow() + TTL;
+	cache.PutOrReplace(MakeKey(base, path), std::move(item));
+}
+
+void
+OpenFileCache::Put(const char *base, const char *path,
+		   FileDescriptor fd, const struct statx &st) noexcept
+{
+	Item item;
+	item.fd = fd.Duplicate();
+	if (!item.fd.IsDefined())
+		return;
+
+	item.st = st;
+	Put(base, path, std::move(item));
+}
+
+void
+OpenFileCache::PutAbsent(const char *base, const char *path) noexcept
+{
+	Put(base, path, Item{});
+}
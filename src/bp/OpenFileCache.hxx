@@ -0,0 +1,130 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/Cache.hxx"
+
+#include <chrono>
+#include <string>
+
+#include <sys/stat.h>
+
+class EventLoop;
+
+/**
+ * Remembers open file descriptors and statx() results of static
+ * files, so hot files can be served without walking their path
+ * again.  The
+ * same cache remembers whether precompressed variants (".br",
+ * ".gz") exist.
+ *
+ * Entries are not revalidated; they simply expire after
+ * #TTL, therefore modifications may be noticed with a delay of up
+ * to that duration.
+ */
+class OpenFileCache {
+	/**
+	 * How long are cached entries valid?
+	 */
+	static constexpr std::chrono::steady_clock::duration TTL =
+		std::chrono::seconds{2};
+
+	struct Item {
+		/**
+		 * An O_RDONLY file descriptor; undefined if the file
+		 * is known to be unavailable.
+		 */
+		UniqueFileDescriptor fd;
+
+		struct statx st;
+
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	EventLoop &event_loop;
+
+	Cache<std::string, Item, 1024, 1021> cache;
+
+public:
+	enum class Result {
+		/**
+		 * Nothing is known about this file.
+		 */
+		MISS,
+
+		/**
+		 * The file exists; the cached file was reopened.
+		 */
+		FOUND,
+
+		/**
+		 * The file is known to be unavailable.
+		 */
+		ABSENT,
+	};
+
+	explicit OpenFileCache(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	/**
+	 * Look up a file.
+	 *
+	 * @param base the "base" directory (see #FileAddress) or
+	 * nullptr if #path is absolute
+	 * @param fd on #Result::FOUND, this receives a new file
+	 * descriptor with its own open file description (reopened
+	 * via /proc/self/fd), because its file offset may be used,
+	 * e.g. by a child process which reads it as stdin
+	 * @param st on #Result::FOUND, this receives the cached
+	 * statx() result
+	 */
+	Result Get(const char *base, const char *path,
+		   UniqueFileDescriptor &fd, struct statx &st) noexcept;
+
+	/**
+	 * Add a regular file to the cache.
+	 */
+	void Put(const char *base, const char *path,
+		 FileDescriptor fd, const struct statx &st) noexcept;
+
+	/**
+	 * Remember that this file does not exist (ENOENT, ENOTDIR)
+	 * or is not a regular file.  Do not call this for other
+	 * errors, which may be transient.
+	 */
+	void PutAbsent(const char *base, const char *path) noexcept;
+
+private:
+	void Put(const char *base, const char *path, Item &&item) noexcept;
+};
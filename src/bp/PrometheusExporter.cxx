@@ -34,6 +34,11 @@
 #include "Instance.hxx"
 #include "prometheus/Stats.hxx"
 #include "prometheus/HttpStats.hxx"
+#include "prometheus/PoolStats.hxx"
+#include "prometheus/ThreadQueueStats.hxx"
+#include "pool/NameStats.hxx"
+#include "stats/ThreadQueueStats.hxx"
+#include "thread/Pool.hxx"
 #include "beng-proxy/Control.hxx"
 #include "http/Headers.hxx"
 #include "http/IncomingRequest.hxx"
@@ -50,6 +55,8 @@ BpPrometheusExporter::HandleHttpRequest(IncomingHttpRequest &request,
 
 	const char *process = "bp";
 	Prometheus::Write(buffer, process, instance.GetStats());
+	Prometheus::Write(buffer, process, pool_get_name_stats());
+	Prometheus::Write(buffer, process, thread_pool_get_stats());
 
 	for (const auto &[name, stats] : instance.listener_stats)
 		Prometheus::Write(buffer, process, name.c_str(), stats);
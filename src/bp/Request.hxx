@@ -56,6 +56,10 @@
 
 #ifdef HAVE_URING
 #include "io/uring/Handler.hxx"
+#include "io/UringOpen.hxx"
+#include "io/UringStatAt.hxx"
+
+#include <sys/stat.h>
 #endif
 
 #include <exception>
@@ -87,7 +91,8 @@ namespace Co { template<typename T> class Task; }
 class Request final : public HttpResponseHandler, DelegateHandler,
 		      TranslateHandler,
 #ifdef HAVE_URING
-		      Uring::OpenStatHandler,
+		      Uring::OpenStatHandler, UringOpenHandler,
+		      UringStatHandler,
 #endif
 #ifdef HAVE_LIBNFS
 		      NfsCacheHandler,
@@ -239,6 +244,63 @@ private:
 		bool had_internal_redirect = false;
 	} translate;
 
+	/**
+	 * The file system checks requested by the translation
+	 * server.  The first three are performed in this order by
+	 * ContinueFileChecks().
+	 */
+	enum class FileCheck : uint_least8_t {
+		ENOTDIR,
+		FILE_NOT_FOUND,
+		DIRECTORY_INDEX,
+		PATH_EXISTS,
+	};
+
+	struct CompressedVariant {
+		const char *path;
+
+		/**
+		 * The "Content-Encoding" value.
+		 */
+		const char *encoding;
+	};
+
+#ifdef HAVE_URING
+	enum class FileStep : uint_least8_t {
+		/**
+		 * Opening the "base" directory.
+		 */
+		BASE,
+
+		/**
+		 * Opening the file.
+		 */
+		FILE,
+
+		/**
+		 * Opening the "base" directory (which was skipped
+		 * because the file was found in the #OpenFileCache)
+		 * for probing the precompressed variants.
+		 */
+		VARIANT_BASE,
+
+		/**
+		 * Opening a precompressed variant.
+		 */
+		VARIANT,
+	};
+
+	/**
+	 * State of an asynchronous check requested by the
+	 * translation server; see StartFileCheck().
+	 */
+	struct {
+		const TranslateResponse *response;
+
+		FileCheck check;
+	} file_check;
+#endif
+
 	/**
 	 * Area for handler-specific state variables.
 	 */
@@ -248,7 +310,35 @@ private:
 
 			UniqueFileDescriptor base_;
 
+			/**
+			 * The "base" directory; undefined if it was
+			 * not needed yet (see GetFileBase()).
+			 */
 			FileDescriptor base;
+
+			/**
+			 * Precompressed variants which may be sent
+			 * instead of the file, in order of
+			 * preference; see CollectCompressedVariants().
+			 */
+			CompressedVariant variants[4];
+
+			uint_least8_t n_variants, next_variant;
+
+#ifdef HAVE_URING
+			/**
+			 * What is the pending io_uring operation
+			 * for?
+			 */
+			FileStep step;
+
+			/**
+			 * The file itself, kept open while the
+			 * #variants are being probed asynchronously.
+			 */
+			UniqueFileDescriptor fd;
+			struct statx st;
+#endif
 		} file;
 
 		struct {
@@ -391,6 +481,12 @@ private:
 	 */
 	bool compressed = false;
 
+	/**
+	 * Was SendEarlyHints() already called?  It is called again
+	 * for each CHAIN response, but only the first one counts.
+	 */
+	bool early_hints_sent = false;
+
 #ifndef NDEBUG
 	bool response_sent = false;
 #endif
@@ -488,6 +584,14 @@ public:
 
 	bool CheckFileNotFound(const TranslateResponse &response) noexcept;
 
+	/**
+	 * The file requested by #TranslationCommand::FILE_NOT_FOUND
+	 * does not exist; retranslate.
+	 *
+	 * @return false (to stop handling the request)
+	 */
+	bool SubmitFileNotFound(const TranslateResponse &response) noexcept;
+
 	bool CheckHandleReadFile(const TranslateResponse &response) noexcept;
 	bool CheckHandlePathExists(const TranslateResponse &response) noexcept;
 	bool CheckHandleProbePathSuffixes(const TranslateResponse &response) noexcept;
@@ -524,6 +628,15 @@ public:
 
 	void HandleTokenAuth(const TranslateResponse &response) noexcept;
 
+	/**
+	 * Returns the "base" directory of the current #FileAddress,
+	 * opening it if that has not been done already (it is
+	 * skipped if the file was found in the #OpenFileCache).
+	 *
+	 * Throws on error.
+	 */
+	FileDescriptor GetFileBase();
+
 	bool EvaluateFileRequest(FileDescriptor fd, const struct statx &st,
 				 struct file_request &file_request) noexcept;
 
@@ -531,18 +644,51 @@ public:
 			  const struct statx &st,
 			  const struct file_request &file_request) noexcept;
 
-	bool DispatchCompressedFile(const char *path, FileDescriptor fd,
+	/**
+	 * Send a precompressed variant of a file.
+	 *
+	 * @param fd the uncompressed file, used for the response
+	 * headers
+	 */
+	void DispatchCompressedFile(const char *path, FileDescriptor fd,
 				    const struct statx &st,
-				    const char *encoding) noexcept;
+				    const char *encoding,
+				    UniqueFileDescriptor compressed_fd,
+				    const struct statx &compressed_st) noexcept;
 
-	bool CheckCompressedFile(const char *path, FileDescriptor fd,
-				 const struct statx &st,
-				 const char *encoding) noexcept;
+	/**
+	 * Open a precompressed variant (synchronously).
+	 *
+	 * @return false if the file is not available
+	 */
+	bool OpenCompressedFile(const char *path,
+				UniqueFileDescriptor &fd,
+				struct statx &st) noexcept;
+
+	/**
+	 * Fill handler.file.variants with the precompressed variants
+	 * of the file which are accepted by the client.
+	 */
+	void CollectCompressedVariants(const FileAddress &address) noexcept;
 
-	bool CheckAutoCompressedFile(const char *path, FileDescriptor fd,
-				     const struct statx &st,
-				     const char *encoding,
-				     const char *suffix) noexcept;
+	void AddCompressedVariant(const char *path,
+				  const char *encoding) noexcept {
+		auto &file = handler.file;
+		file.variants[file.n_variants++] = {path, encoding};
+	}
+
+#ifdef HAVE_URING
+	/**
+	 * Open the file (handler.file.address) with io_uring.
+	 */
+	void StartOpenFile() noexcept;
+
+	/**
+	 * Look for the next precompressed variant with io_uring, or
+	 * send the file itself if there is none.
+	 */
+	void ProbeNextCompressedVariant() noexcept;
+#endif
 
 	bool EmulateModAuthEasy(const FileAddress &address,
 				UniqueFileDescriptor &fd,
@@ -557,7 +703,40 @@ public:
 			       UniqueFileDescriptor fd,
 			       const struct statx &st) noexcept;
 
-	void HandlePathExists(const FileAddress &address) noexcept;
+	void HandlePathExists(const TranslateResponse &response,
+			      const FileAddress &address) noexcept;
+
+	/**
+	 * Send the result of #TranslationCommand::PATH_EXISTS to the
+	 * translation server.
+	 *
+	 * @param error 0 if the path exists, an errno value otherwise
+	 */
+	void OnPathExists(int error) noexcept;
+
+	/**
+	 * Perform the file system checks requested by the
+	 * translation server, starting with the given one, and then
+	 * handle the request.
+	 */
+	void ContinueFileChecks(const TranslateResponse &response,
+				FileCheck check) noexcept;
+
+#ifdef HAVE_URING
+	/**
+	 * Start an asynchronous statx() for the given check.  Its
+	 * result will be evaluated by OnFileCheck().
+	 */
+	void StartFileCheck(const TranslateResponse &response,
+			    FileCheck check,
+			    const char *base, const char *path,
+			    int flags, unsigned mask) noexcept;
+
+	/**
+	 * @param error 0 on success, an errno value on failure
+	 */
+	void OnFileCheck(int error, const struct statx *st) noexcept;
+#endif
 
 	void HandleDelegateAddress(const DelegateAddress &address,
 				   const char *path) noexcept;
@@ -712,6 +891,23 @@ public:
 					 void *relocate_ctx,
 					 const HeaderForwardSettings &settings) noexcept;
 
+	/**
+	 * Send a "103 Early Hints" response to the client if a
+	 * previous response for the same URI contained preload
+	 * links.  This must be called only after the translation
+	 * server has accepted the request and all access checks have
+	 * passed, or else the hints would leak to clients which are
+	 * not allowed to see the resource.
+	 */
+	void SendEarlyHints() noexcept;
+
+	/**
+	 * Remember the preload links of this response for
+	 * SendEarlyHints().
+	 */
+	void HarvestEarlyHints(http_status_t status,
+			       const HttpHeaders &headers) noexcept;
+
 	void DispatchResponseDirect(http_status_t status, HttpHeaders headers,
 				    UnusedIstreamPtr body) noexcept;
 
@@ -757,7 +953,8 @@ private:
 	void InvokeXmlProcessor(http_status_t status,
 				StringMap &response_headers,
 				UnusedIstreamPtr response_body,
-				const Transformation &transformation) noexcept;
+				const Transformation &transformation,
+				const char *template_key) noexcept;
 
 	void HandleProxyWidget(UnusedIstreamPtr body,
 			       Widget &widget, const WidgetRef *proxy_ref,
@@ -871,10 +1068,19 @@ private:
 	 * retranslate.
 	 *
 	 * @return true to continue handling the request, false on
-	 * error or if retranslation has been triggered
+	 * error, if retranslation has been triggered or if an
+	 * asynchronous check has been started (see StartFileCheck())
 	 */
 	bool CheckDirectoryIndex(const TranslateResponse &response) noexcept;
 
+	/**
+	 * The path is a directory; retranslate with
+	 * #TranslationCommand::DIRECTORY_INDEX.
+	 *
+	 * @return false (to stop handling the request)
+	 */
+	bool SubmitDirectoryIndex(const TranslateResponse &response) noexcept;
+
 	/* FILE_ENOTDIR handler */
 
 	bool SubmitEnotdir(const TranslateResponse &response) noexcept;
@@ -883,8 +1089,9 @@ private:
 	 * The #TranslateResponse contains #TRANSLATE_ENOTDIR.  Check this
 	 * condition and retranslate.
 	 *
-	 * @return true to continue handling the request, false on error or if
-	 * retranslation has been triggered
+	 * @return true to continue handling the request, false on error, if
+	 * retranslation has been triggered or if an asynchronous check
+	 * has been started (see StartFileCheck())
 	 */
 	bool CheckFileEnotdir(const TranslateResponse &response) noexcept;
 
@@ -925,6 +1132,19 @@ private:
 	void OnOpenStat(UniqueFileDescriptor fd,
 			struct statx &st) noexcept override;
 	void OnOpenStatError(std::exception_ptr e) noexcept override;
+
+	/* virtual methods from class UringOpenHandler */
+	void OnUringOpen(UniqueFileDescriptor fd) noexcept override;
+	void OnUringOpenError(std::exception_ptr e) noexcept override;
+
+	/* virtual methods from class UringStatHandler */
+	void OnUringStat(const struct statx &st) noexcept override {
+		OnFileCheck(0, &st);
+	}
+
+	void OnUringStatError(int error) noexcept override {
+		OnFileCheck(error, nullptr);
+	}
 #endif
 
 #ifdef HAVE_LIBNFS
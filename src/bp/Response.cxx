@@ -56,6 +56,7 @@
 #include "strmap.hxx"
 #include "ProcessorHeaders.hxx"
 #include "XmlProcessor.hxx"
+#include "XmlTemplateCache.hxx"
 #include "CssProcessor.hxx"
 #include "TextProcessor.hxx"
 #include "istream/istream_deflate.hxx"
@@ -72,6 +73,7 @@
 #include "uri/Verify.hxx"
 #include "util/DeleteDisposer.hxx"
 #include "util/StringBuffer.hxx"
+#include "util/StringCompare.hxx"
 #include "util/StringSplit.hxx"
 #include "FilterStatus.hxx"
 
@@ -216,7 +218,8 @@ inline void
 Request::InvokeXmlProcessor(http_status_t status,
 			    StringMap &response_headers,
 			    UnusedIstreamPtr response_body,
-			    const Transformation &transformation) noexcept
+			    const Transformation &transformation,
+			    const char *template_key) noexcept
 {
 	assert(!response_sent);
 
@@ -317,7 +320,9 @@ Request::InvokeXmlProcessor(http_status_t status,
 						  std::move(response_body),
 						  widget,
 						  std::move(ctx),
-						  transformation.u.processor.options);
+						  transformation.u.processor.options,
+						  instance.xml_template_cache.get(),
+						  template_key);
 		assert(response_body);
 
 		InvokeResponse(status,
@@ -642,6 +647,8 @@ Request::DispatchResponseDirect(http_status_t status, HttpHeaders headers,
 		WriteCsrfToken(headers);
 	}
 
+	HarvestEarlyHints(status, headers);
+
 	if (body)
 		body = NewAutoPipeIstream(&pool, std::move(body), instance.pipe_stock);
 
@@ -698,6 +705,23 @@ Request::ApplyFilter(http_status_t status, StringMap &&headers2,
 			      *this, cancel_ptr);
 }
 
+/**
+ * Determine the #XmlTemplateCache key for the given template
+ * response.
+ */
+static const char *
+MakeTemplateKey(AllocatorPtr alloc, const char *resource_tag,
+		const StringMap &headers) noexcept
+{
+	const char *etag = headers.Get("etag");
+	if (etag == nullptr || StringStartsWith(etag, "W/"sv))
+		/* only a strong ETag guarantees that the template is
+		   the same, byte for byte */
+		return nullptr;
+
+	return resource_tag_append_etag(alloc, resource_tag, headers);
+}
+
 void
 Request::ApplyTransformation(http_status_t status, StringMap &&headers,
 			     UnusedIstreamPtr response_body,
@@ -713,11 +737,19 @@ Request::ApplyTransformation(http_status_t status, StringMap &&headers,
 		break;
 
 	case Transformation::Type::PROCESS:
-		/* processor responses cannot be cached */
-		resource_tag = nullptr;
-
-		InvokeXmlProcessor(status, headers, std::move(response_body),
-				   transformation);
+		{
+			const char *template_key =
+				instance.xml_template_cache
+				? MakeTemplateKey(pool, resource_tag, headers)
+				: nullptr;
+
+			/* processor responses cannot be cached */
+			resource_tag = nullptr;
+
+			InvokeXmlProcessor(status, headers,
+					   std::move(response_body),
+					   transformation, template_key);
+		}
 		break;
 
 	case Transformation::Type::PROCESS_CSS:
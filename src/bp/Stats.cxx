@@ -35,13 +35,19 @@
 #include "fs/Stock.hxx"
 #include "stock/Stats.hxx"
 #include "memory/fb_pool.hxx"
-#include "memory/SlicePool.hxx"
 #include "translation/Builder.hxx"
 #include "http/cache/Public.hxx"
 #include "fcache.hxx"
 #include "nfs/Cache.hxx"
 #include "session/Manager.hxx"
 #include "stats/AllocatorStats.hxx"
+#include "stats/CompressStats.hxx"
+#include "stats/CacheStats.hxx"
+#include "stats/LatencyHistogram.hxx"
+#include "stats/Segment.hxx"
+#include "stats/SegmentWriter.hxx"
+#include "thread/Pool.hxx"
+#include "cgi/Zygote.hxx"
 #include "beng-proxy/Control.hxx"
 #include "util/ByteOrder.hxx"
 
@@ -87,11 +93,105 @@ BpInstance::GetStats() const noexcept
 	stats.nfs_cache_brutto_size = ToBE64(nfs_cache_stats.brutto_size);
 #endif
 
-	const auto io_buffers_stats = fb_pool_get().GetStats();
+	CompressStats compress_stats;
+	if (http_cache != nullptr)
+		compress_stats += http_cache_get_compress_stats(*http_cache);
+	if (filter_cache != nullptr)
+		compress_stats += filter_cache_get_compress_stats(*filter_cache);
+#ifdef HAVE_LIBNFS
+	if (nfs_cache != nullptr)
+		compress_stats += nfs_cache_get_compress_stats(*nfs_cache);
+#endif
+
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	stats.compress_slices = ToBE64(compress_stats.n_slices);
+	stats.compress_time = ToBE64(duration_cast<microseconds>(compress_stats.total_duration).count());
+	stats.compress_max_pause = ToBE64(duration_cast<microseconds>(compress_stats.max_duration).count());
+
+	if (filter_cache != nullptr) {
+		const auto &fcache_lookups = filter_cache_get_cache_stats(*filter_cache);
+		stats.filter_cache_hot_hits = ToBE64(fcache_lookups.hot_hits);
+		stats.filter_cache_hits = ToBE64(fcache_lookups.hits);
+		stats.filter_cache_misses = ToBE64(fcache_lookups.misses);
+	}
+
+	const auto &regex_stats = regex_cache.GetStats();
+	stats.regex_cache_hits = ToBE64(regex_stats.hits);
+	stats.regex_cache_misses = ToBE64(regex_stats.misses);
+	stats.regex_compile_time = ToBE64(duration_cast<microseconds>(regex_stats.compile_time).count());
+	stats.regex_compile_time_saved = ToBE64(duration_cast<microseconds>(regex_stats.saved_time).count());
+
+	const auto io_buffers_stats = fb_pool_get_stats();
 	stats.io_buffers_size = ToBE64(io_buffers_stats.netto_size);
 	stats.io_buffers_brutto_size = ToBE64(io_buffers_stats.brutto_size);
 
+	static_assert(std::size(stats.io_buffers_class_size) == FB_N_SIZE_CLASSES);
+	for (unsigned i = 0; i < FB_N_SIZE_CLASSES; ++i)
+		stats.io_buffers_class_size[i] =
+			ToBE64(fb_pool_get_stats(i).netto_size);
+
+	if (cgi_zygote_pool) {
+		for (unsigned zygote = 0; zygote < 2; ++zygote) {
+			const auto &latency = cgi_zygote_pool->GetLatency(zygote);
+
+			static_assert(std::size(stats.cgi_spawn_latency[0]) ==
+				      LatencyHistogram::N_BUCKETS);
+			for (unsigned i = 0; i < LatencyHistogram::N_BUCKETS; ++i)
+				stats.cgi_spawn_latency[zygote][i] =
+					ToBE64(latency.buckets[i]);
+
+			stats.cgi_spawn_latency_sum[zygote] =
+				ToBE64(duration_cast<microseconds>(latency.sum).count());
+		}
+	}
+
 	/* TODO: add stats from all worker processes;  */
 
 	return stats;
 }
+
+static constexpr Event::Duration STATS_SEGMENT_INTERVAL = std::chrono::seconds(1);
+
+void
+BpInstance::EnableStatsSegment()
+{
+	stats_segment = std::make_unique<StatsSegmentWriter>(config.stats_file.c_str(),
+							     "bp");
+	PublishStats();
+	stats_segment_timer.Schedule(STATS_SEGMENT_INTERVAL);
+}
+
+void
+BpInstance::PublishStats() noexcept
+{
+	/* collect everything which is not a plain copy before
+	   entering the seqlock, to keep the readers' retry window
+	   small */
+
+	const auto control = GetStats();
+
+	StockStats tcp_stock_stats{};
+	tcp_stock->AddStats(tcp_stock_stats);
+	fs_stock->AddStats(tcp_stock_stats);
+
+	const auto thread_queue_stats = thread_pool_get_stats();
+
+	auto &data = stats_segment->BeginUpdate();
+	data.control = control;
+	data.tcp_stock = tcp_stock_stats;
+	data.thread_queue = thread_queue_stats;
+
+	for (const auto &[name, tagged_stats] : listener_stats)
+		for (const auto &[tag, stats] : tagged_stats.per_tag)
+			data.AddHttp(name, tag.c_str(), stats);
+
+	stats_segment->EndUpdate();
+}
+
+void
+BpInstance::OnStatsSegmentTimer() noexcept
+{
+	PublishStats();
+	stats_segment_timer.Schedule(STATS_SEGMENT_INTERVAL);
+}
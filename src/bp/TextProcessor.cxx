@@ -139,23 +139,82 @@ EscapeValue(struct pool &pool, const char *v) noexcept
 			   : std::string_view{});
 }
 
+/**
+ * All entities expanded by text_processor().
+ */
+static constexpr std::string_view entities[] = {
+	"&c:type;"sv,
+	"&c:class;"sv,
+	"&c:local;"sv,
+	"&c:id;"sv,
+	"&c:path;"sv,
+	"&c:prefix;"sv,
+	"&c:uri;"sv,
+	"&c:base;"sv,
+	"&c:frame;"sv,
+	"&c:view;"sv,
+	"&c:session;"sv, /* obsolete as of version 15.29 */
+};
+
+static constexpr std::string_view
+NullableStringView(const char *s) noexcept
+{
+	return s != nullptr ? std::string_view{s} : std::string_view{};
+}
+
+size_t
+text_processor_match_entity(std::string_view s) noexcept
+{
+	if (!s.starts_with("&c:"sv))
+		return 0;
+
+	for (const auto i : entities)
+		if (s.starts_with(i))
+			return i.size();
+
+	return 0;
+}
+
+std::string_view
+text_processor_expand_entity(struct pool &pool, std::string_view entity,
+			     const Widget &widget,
+			     const WidgetContext &ctx) noexcept
+{
+	if (entity == "&c:type;"sv)
+		return NullableStringView(widget.class_name);
+	else if (entity == "&c:class;"sv)
+		return NullableStringView(widget.GetQuotedClassName());
+	else if (entity == "&c:local;"sv)
+		return NullableStringView(widget.cls->local_uri);
+	else if (entity == "&c:id;"sv)
+		return NullableStringView(widget.id);
+	else if (entity == "&c:path;"sv)
+		return NullableStringView(widget.GetIdPath());
+	else if (entity == "&c:prefix;"sv)
+		return NullableStringView(widget.GetPrefix());
+	else if (entity == "&c:uri;"sv)
+		return EscapeValue(pool, ctx.absolute_uri);
+	else if (entity == "&c:base;"sv)
+		return EscapeValue(pool, base_uri(&pool, ctx.uri));
+	else if (entity == "&c:frame;"sv)
+		return EscapeValue(pool, strmap_get_checked(ctx.args, "frame"));
+	else if (entity == "&c:view;"sv)
+		return NullableStringView(widget.GetEffectiveView()->name);
+	else
+		return {};
+}
+
 static SubstTree
 processor_subst_beng_widget(struct pool &pool,
 			    const Widget &widget,
 			    const WidgetContext &ctx) noexcept
 {
 	SubstTree subst;
-	subst.Add(pool, "&c:type;", widget.class_name);
-	subst.Add(pool, "&c:class;", widget.GetQuotedClassName());
-	subst.Add(pool, "&c:local;", widget.cls->local_uri);
-	subst.Add(pool, "&c:id;", widget.id);
-	subst.Add(pool, "&c:path;", widget.GetIdPath());
-	subst.Add(pool, "&c:prefix;", widget.GetPrefix());
-	subst.Add(pool, "&c:uri;", EscapeValue(pool, ctx.absolute_uri));
-	subst.Add(pool, "&c:base;", EscapeValue(pool, base_uri(&pool, ctx.uri)));
-	subst.Add(pool, "&c:frame;", EscapeValue(pool, strmap_get_checked(ctx.args, "frame")));
-	subst.Add(pool, "&c:view;", widget.GetEffectiveView()->name);
-	subst.Add(pool, "&c:session;", nullptr); /* obsolete as of version 15.29 */
+	for (const auto i : entities)
+		/* the keys are string literals, so they are
+		   null-terminated */
+		subst.Add(pool, i.data(),
+			  text_processor_expand_entity(pool, i, widget, ctx));
 	return subst;
 }
 
@@ -32,6 +32,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <string_view>
+
 struct pool;
 struct WidgetContext;
 class UnusedIstreamPtr;
@@ -54,3 +57,22 @@ text_processor_allowed(const StringMap &headers) noexcept;
 UnusedIstreamPtr
 text_processor(struct pool &pool, UnusedIstreamPtr istream,
 	       const Widget &widget, const WidgetContext &ctx) noexcept;
+
+/**
+ * Check whether the given string begins with one of the entities
+ * expanded by text_processor() (e.g. "&c:id;").
+ *
+ * @return the length of the entity or 0 if there is none
+ */
+[[gnu::pure]]
+std::size_t
+text_processor_match_entity(std::string_view s) noexcept;
+
+/**
+ * Expand one entity which was found by
+ * text_processor_match_entity(), just like text_processor() would.
+ */
+std::string_view
+text_processor_expand_entity(struct pool &pool, std::string_view entity,
+			     const Widget &widget,
+			     const WidgetContext &ctx) noexcept;
@@ -31,6 +31,8 @@
  */
 
 #include "XmlProcessor.hxx"
+#include "XmlTemplate.hxx"
+#include "XmlTemplateCache.hxx"
 #include "WidgetContainerParser.hxx"
 #include "TextProcessor.hxx"
 #include "CssProcessor.hxx"
@@ -59,6 +61,9 @@
 #include "util/StringSplit.hxx"
 #include "stopwatch.hxx"
 
+#include <optional>
+#include <stdexcept>
+
 #include <assert.h>
 #include <string.h>
 
@@ -78,7 +83,9 @@ struct UriRewrite {
 	char view[64];
 };
 
-class XmlProcessor final : public ReplaceIstream, WidgetContainerParser {
+class XmlProcessor final
+	: public ReplaceIstream, WidgetContainerParser, XmlTemplateEntityHandler
+{
 	class CdataIstream final : public Istream {
 		friend class XmlProcessor;
 		XmlProcessor &processor;
@@ -97,6 +104,13 @@ class XmlProcessor final : public ReplaceIstream, WidgetContainerParser {
 	const unsigned options;
 
 	XmlParser parser;
+
+	/**
+	 * If set, then the #XmlParser is not used; instead, the events
+	 * of a cached #XmlTemplate are replayed.
+	 */
+	std::optional<XmlTemplatePlayer> player;
+
 	bool had_input;
 
 	UriRewrite uri_rewrite;
@@ -145,7 +159,8 @@ public:
 	XmlProcessor(PoolPtr &&_pool, const StopwatchPtr &parent_stopwatch,
 		     UnusedIstreamPtr &&_input,
 		     Widget &_widget, SharedPoolPtr<WidgetContext> &&_ctx,
-		     unsigned _options) noexcept
+		     unsigned _options,
+		     std::shared_ptr<const XmlTemplate> &&_template) noexcept
 		:ReplaceIstream(std::move(_pool), _ctx->event_loop, std::move(_input)),
 		 WidgetContainerParser(GetPool(), _widget, std::move(_ctx)),
 		 stopwatch(parent_stopwatch, "XmlProcessor"),
@@ -154,6 +169,9 @@ public:
 		 buffer(GetPool(), 128, 2048),
 		 postponed_rewrite(GetPool())
 	{
+		if (_template)
+			player.emplace(std::move(_template), *this, *this);
+
 		if (HasOptionRewriteUrl()) {
 			default_uri_rewrite.base = UriBase::TEMPLATE;
 			default_uri_rewrite.mode = RewriteUriMode::PARTIAL;
@@ -256,10 +274,17 @@ private:
 
 	/* virtual methods from class ReplaceIstream */
 	void Parse(std::span<const std::byte> b) override {
-		parser.Feed((const char *)b.data(), b.size());
+		if (player)
+			player->Feed({(const char *)b.data(), b.size()});
+		else
+			parser.Feed((const char *)b.data(), b.size());
 	}
 
 	void ParseEnd() override {
+		if (player && !player->IsComplete())
+			/* the offsets we have applied are bogus */
+			throw std::runtime_error("Template does not match the cached one");
+
 		ReplaceIstream::Finish();
 	}
 
@@ -280,6 +305,10 @@ private:
 	size_t OnXmlCdata(std::string_view text, bool escaped,
 			  off_t start) noexcept override;
 
+	/* virtual methods from class XmlTemplateEntityHandler */
+	void OnXmlTemplateEntity(off_t start, off_t end,
+				 std::string_view entity) noexcept override;
+
 	/**
 	 * Is this a tag which can have a link attribute?
 	 */
@@ -1088,6 +1117,23 @@ XmlProcessor::OnXmlCdata(std::string_view text,
 	return text.size();
 }
 
+void
+XmlProcessor::OnXmlTemplateEntity(off_t start, off_t end,
+				  std::string_view entity) noexcept
+{
+	/* this is what text_processor() does when the template is
+	   parsed by XmlParser */
+
+	had_input = true;
+
+	const auto value = text_processor_expand_entity(GetPool(), entity,
+							container, *ctx);
+	Replace(start, end,
+		value.empty()
+		? UnusedIstreamPtr{}
+		: istream_string_new(GetPool(), value));
+}
+
 void
 XmlProcessor::OnEof() noexcept
 {
@@ -1138,18 +1184,43 @@ processor_process(struct pool &caller_pool,
 		  UnusedIstreamPtr input,
 		  Widget &widget,
 		  SharedPoolPtr<WidgetContext> ctx,
-		  unsigned options) noexcept
+		  unsigned options,
+		  XmlTemplateCache *template_cache,
+		  const char *template_key) noexcept
 {
 	auto pool = pool_new_linear(&caller_pool, "WidgetLookupProcessor", 32768);
 
-	/* the text processor will expand entities */
-	input = text_processor(pool,
-			       std::move(input),
-			       widget, *ctx);
+	std::shared_ptr<const XmlTemplate> t;
+	if (template_cache != nullptr && template_key != nullptr) {
+		t = template_cache->Get(template_key);
+		if (!t) {
+			input = template_cache->Record(pool, template_key,
+						       std::move(input));
+		} else if (!t->IsReplayable()) {
+			t.reset();
+		} else if (const off_t available = input.GetAvailable(false);
+			   available >= 0 && available != t->GetSize()) {
+			/* this is not the template we have seen
+			   before, even though the ETag is the same;
+			   if the length is unknown, the key (which
+			   contains the strong ETag) is all we have to
+			   rely on */
+			template_cache->Remove(template_key);
+			t.reset();
+		}
+	}
+
+	if (!t)
+		/* the text processor will expand entities */
+		input = text_processor(pool,
+				       std::move(input),
+				       widget, *ctx);
+	/* else: entities will be expanded by OnXmlTemplateEntity() */
 
 	auto *processor =
 		NewFromPool<XmlProcessor>(std::move(pool), parent_stopwatch,
 					  std::move(input),
-					  widget, std::move(ctx), options);
+					  widget, std::move(ctx), options,
+					  std::move(t));
 	return UnusedIstreamPtr(processor);
 }
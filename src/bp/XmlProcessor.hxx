@@ -69,6 +69,7 @@ class StopwatchPtr;
 class UnusedIstreamPtr;
 class Widget;
 class StringMap;
+class XmlTemplateCache;
 
 [[gnu::pure]]
 bool
@@ -78,6 +79,10 @@ processable(const StringMap &headers) noexcept;
  * Process the specified istream, and return the processed stream.
  *
  * @param widget the widget that represents the template
+ * @param template_cache an optional cache for pre-tokenized
+ * templates
+ * @param template_key the #XmlTemplateCache key of this template;
+ * nullptr if it cannot be cached
  */
 UnusedIstreamPtr
 processor_process(struct pool &pool,
@@ -85,4 +90,6 @@ processor_process(struct pool &pool,
 		  UnusedIstreamPtr istream,
 		  Widget &widget,
 		  SharedPoolPtr<WidgetContext> ctx,
-		  unsigned options) noexcept;
+		  unsigned options,
+		  XmlTemplateCache *template_cache=nullptr,
+		  const char *template_key=nullptr) noexcept;
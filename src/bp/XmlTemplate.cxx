@@ -0,0 +1,420 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "XmlTemplate.hxx"
+#include "TextProcessor.hxx"
+#include "pool/tpool.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+using std::string_view_literals::operator""sv;
+
+class XmlTemplateRecorder final : XmlParserHandler {
+	XmlTemplate &t;
+
+	const std::string_view src;
+
+	XmlParser parser;
+
+	/**
+	 * The number of entities found in character data.
+	 */
+	std::size_t n_entities = 0;
+
+	/**
+	 * Are we inside a "script" element?  This mimics the
+	 * (workaround) logic of #WidgetContainerParser.
+	 */
+	bool in_script = false, current_is_script = false;
+
+	/**
+	 * Are we inside a "style" element (which may be fed into the
+	 * CSS processor)?
+	 */
+	bool in_style = false;
+
+	/**
+	 * Are we inside a "c:widget" element?
+	 */
+	bool in_widget = false;
+
+public:
+	XmlTemplateRecorder(struct pool &pool, XmlTemplate &_t,
+			    std::string_view _src) noexcept
+		:t(_t), src(_src), parser(pool, *this) {}
+
+	/**
+	 * @return the number of entities found in character data
+	 */
+	std::size_t Run() noexcept {
+		if (!src.empty())
+			parser.Feed(src.data(), src.size());
+		return n_entities;
+	}
+
+private:
+	uint32_t AddString(std::string_view s) noexcept {
+		const uint32_t offset = t.strings.size();
+		t.strings.append(s);
+		return offset;
+	}
+
+	XmlTemplate::Event &AddEvent(XmlTemplate::EventType type,
+				     off_t start, off_t end,
+				     std::string_view name={}) noexcept {
+		auto &event = t.events.emplace_back();
+		event.type = type;
+		event.start = start;
+		event.end = end;
+		event.name_offset = AddString(name);
+		event.name_length = name.size();
+		event.value_offset = event.value_length = 0;
+		return event;
+	}
+
+	void AddCdata(std::string_view text, bool escaped,
+		      off_t start) noexcept {
+		if (text.empty())
+			return;
+
+		auto &event = AddEvent(XmlTemplate::EventType::CDATA,
+				       start, start + (off_t)text.size());
+		event.escaped = escaped;
+	}
+
+	/* virtual methods from class XmlParserHandler */
+	bool OnXmlTagStart(const XmlParserTag &tag) noexcept override;
+	bool OnXmlTagFinished(const XmlParserTag &tag) noexcept override;
+	void OnXmlAttributeFinished(const XmlParserAttribute &attr) noexcept override;
+	size_t OnXmlCdata(std::string_view text, bool escaped,
+			  off_t start) noexcept override;
+};
+
+bool
+XmlTemplateRecorder::OnXmlTagStart(const XmlParserTag &tag) noexcept
+{
+	/* the CSS processor is stopped by any tag */
+	in_style = false;
+
+	if (in_script && tag.name != "script"sv)
+		/* the processor ignores all tags inside "script" except
+		   for </script> */
+		current_is_script = false;
+	else
+		in_script = current_is_script = tag.name == "script"sv;
+
+	if (tag.name == "c:widget"sv) {
+		if (tag.type == XmlParserTagType::OPEN)
+			in_widget = true;
+		else if (tag.type == XmlParserTagType::CLOSE)
+			in_widget = false;
+	}
+
+	auto &event = AddEvent(XmlTemplate::EventType::TAG_START,
+			       tag.start, tag.start, tag.name);
+	event.tag_type = tag.type;
+
+	/* always parse the attributes; the player drops them if its
+	   handler isn't interested */
+	return true;
+}
+
+bool
+XmlTemplateRecorder::OnXmlTagFinished(const XmlParserTag &tag) noexcept
+{
+	auto &event = AddEvent(XmlTemplate::EventType::TAG_FINISHED,
+			       tag.start, tag.end, tag.name);
+	event.tag_type = tag.type;
+
+	if (current_is_script) {
+		if (tag.type == XmlParserTagType::OPEN)
+			parser.Script();
+		else
+			in_script = false;
+	} else if (tag.name == "style"sv &&
+		   tag.type == XmlParserTagType::OPEN)
+		in_style = true;
+	else if (tag.name == "c:widget"sv &&
+		 tag.type == XmlParserTagType::SHORT)
+		in_widget = false;
+
+	return true;
+}
+
+void
+XmlTemplateRecorder::OnXmlAttributeFinished(const XmlParserAttribute &attr) noexcept
+{
+	auto &event = AddEvent(XmlTemplate::EventType::ATTRIBUTE,
+			       attr.name_start, attr.end, attr.name);
+	event.value_start = attr.value_start;
+	event.value_end = attr.value_end;
+	event.value_offset = AddString(attr.value);
+	event.value_length = attr.value.size();
+}
+
+size_t
+XmlTemplateRecorder::OnXmlCdata(std::string_view text, bool escaped,
+				off_t start) noexcept
+{
+	if (text.data() < src.data() ||
+	    text.data() >= src.data() + src.size()) {
+		/* a string literal from XmlParser::Feed(), not a copy
+		   of the source */
+		auto &event = AddEvent(XmlTemplate::EventType::CDATA_LITERAL,
+				       start, start, text);
+		event.escaped = escaped;
+		return text.size();
+	}
+
+	/* split the character data at text_processor() entities,
+	   which get replaced by the player's handler */
+
+	std::string_view rest = text;
+	off_t rest_start = start;
+
+	for (std::size_t i = 0; i < rest.size();) {
+		const char *amp = (const char *)
+			memchr(rest.data() + i, '&', rest.size() - i);
+		if (amp == nullptr)
+			break;
+
+		i = amp - rest.data();
+
+		const std::size_t length =
+			text_processor_match_entity(rest.substr(i));
+		if (length == 0) {
+			++i;
+			continue;
+		}
+
+		if (in_widget || in_style)
+			/* the processor replaces or extends the whole
+			   element, which conflicts with the entity
+			   substitution */
+			t.replayable = false;
+
+		++n_entities;
+
+		AddCdata(rest.substr(0, i), escaped, rest_start);
+		AddEvent(XmlTemplate::EventType::ENTITY,
+			 rest_start + (off_t)i,
+			 rest_start + (off_t)(i + length),
+			 rest.substr(i, length));
+
+		rest = rest.substr(i + length);
+		rest_start += (off_t)(i + length);
+		i = 0;
+	}
+
+	AddCdata(rest, escaped, rest_start);
+	return text.size();
+}
+
+[[gnu::pure]]
+static std::size_t
+CountEntities(std::string_view src) noexcept
+{
+	std::size_t n = 0;
+
+	for (std::size_t i = 0;; ++i) {
+		i = src.find('&', i);
+		if (i == src.npos)
+			break;
+
+		const std::size_t length =
+			text_processor_match_entity(src.substr(i));
+		if (length > 0) {
+			++n;
+			i += length - 1;
+		}
+	}
+
+	return n;
+}
+
+std::shared_ptr<const XmlTemplate>
+XmlTemplate::Compile(std::string_view src) noexcept
+{
+	auto t = std::make_shared<XmlTemplate>(src.size());
+
+	std::size_t n_entities;
+
+	{
+		const TempPoolLease tpool;
+		XmlTemplateRecorder recorder(tpool, *t, src);
+		n_entities = recorder.Run();
+	}
+
+	if (n_entities != CountEntities(src))
+		/* some entities are not in character data (but in
+		   attribute values or comments); these would have to
+		   be expanded before parsing */
+		t->replayable = false;
+
+	if (t->replayable) {
+		t->events.shrink_to_fit();
+		t->strings.shrink_to_fit();
+	} else {
+		t->events = {};
+		t->strings = {};
+	}
+
+	return t;
+}
+
+inline void
+XmlTemplatePlayer::SkipTag() noexcept
+{
+	/* the handler is not interested in this tag; this emulates
+	   XmlParser's "ELEMENT_BORING" state by dropping the
+	   attributes and the "finished" event */
+
+	const auto events = t->GetEvents();
+
+	while (cursor < events.size() &&
+	       events[cursor].type == XmlTemplate::EventType::ATTRIBUTE)
+		++cursor;
+
+	if (cursor < events.size() &&
+	    events[cursor].type == XmlTemplate::EventType::TAG_FINISHED)
+		++cursor;
+}
+
+bool
+XmlTemplatePlayer::Feed(std::string_view src) noexcept
+{
+	using Type = XmlTemplate::EventType;
+
+	const off_t src_end = position + (off_t)src.size();
+	const auto events = t->GetEvents();
+
+	while (cursor < events.size()) {
+		const auto &event = events[cursor];
+
+		switch (event.type) {
+		case Type::TAG_START:
+			if (event.start >= src_end)
+				break;
+
+			++cursor;
+
+			if (!handler.OnXmlTagStart({event.start, event.start,
+						    t->GetName(event),
+						    event.tag_type}))
+				SkipTag();
+
+			continue;
+
+		case Type::ATTRIBUTE:
+			if (event.end > src_end)
+				break;
+
+			++cursor;
+
+			handler.OnXmlAttributeFinished({
+					event.start,
+					event.value_start, event.value_end,
+					event.end,
+					t->GetName(event),
+					t->GetValue(event),
+				});
+			continue;
+
+		case Type::TAG_FINISHED:
+			if (event.end > src_end)
+				break;
+
+			++cursor;
+
+			if (!handler.OnXmlTagFinished({event.start, event.end,
+						       t->GetName(event),
+						       event.tag_type}))
+				return false;
+
+			continue;
+
+		case Type::CDATA:
+			{
+				/* character data may be submitted in
+				   several chunks, just like XmlParser
+				   does */
+				const off_t start = std::max(event.start,
+							     cdata_position);
+				if (start >= src_end)
+					break;
+
+				assert(start >= position);
+
+				const off_t end = std::min(event.end, src_end);
+				handler.OnXmlCdata(src.substr(start - position,
+							      end - start),
+						   event.escaped, start);
+				cdata_position = end;
+
+				if (end < event.end)
+					break;
+			}
+
+			++cursor;
+			continue;
+
+		case Type::CDATA_LITERAL:
+			if (event.start >= src_end)
+				break;
+
+			++cursor;
+
+			handler.OnXmlCdata(t->GetName(event), event.escaped,
+					   event.start);
+			continue;
+
+		case Type::ENTITY:
+			if (event.end > src_end)
+				break;
+
+			++cursor;
+
+			entity_handler.OnXmlTemplateEntity(event.start, event.end,
+							   t->GetName(event));
+			continue;
+		}
+
+		/* this event needs more source data */
+		break;
+	}
+
+	position = src_end;
+	return true;
+}
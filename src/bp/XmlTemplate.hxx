@@ -0,0 +1,242 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "parser/XmlParser.hxx"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A template which has been tokenized by #XmlParser, i.e. the list
+ * of all parser events with their source offsets.  It can be
+ * replayed (with #XmlTemplatePlayer) to an #XmlParserHandler when
+ * the same template is processed again, which skips the parser.
+ *
+ * The source itself is not stored; the player gets it again from the
+ * caller and takes character data from there.  It is the caller's
+ * responsibility to pass the very same bytes (e.g. by checking a
+ * strong ETag).
+ *
+ * Differences to #XmlParser: attributes are always parsed, even if
+ * OnXmlTagStart() returns false (the player then just drops them);
+ * "script" elements are switched to #XmlParser::Script() regardless
+ * of whether the handler would do that.
+ */
+class XmlTemplate {
+public:
+	enum class EventType : uint8_t {
+		TAG_START,
+		ATTRIBUTE,
+		TAG_FINISHED,
+
+		/**
+		 * Character data which is taken from the source.
+		 */
+		CDATA,
+
+		/**
+		 * Character data which is not a copy of the source at
+		 * the given offset (see #XmlParser::Feed()); it is
+		 * stored in #strings.
+		 */
+		CDATA_LITERAL,
+
+		/**
+		 * A text_processor() entity (e.g. "&c:id;") within
+		 * character data.
+		 */
+		ENTITY,
+	};
+
+	struct Event {
+		EventType type;
+
+		/**
+		 * Only used for #TAG_START and #TAG_FINISHED.
+		 */
+		XmlParserTagType tag_type;
+
+		/**
+		 * Only used for #CDATA and #CDATA_LITERAL.
+		 */
+		bool escaped;
+
+		/**
+		 * The source range of this event; for #ATTRIBUTE, this
+		 * is from the name to the end of the value.
+		 */
+		off_t start, end;
+
+		/**
+		 * Only used for #ATTRIBUTE.
+		 */
+		off_t value_start, value_end;
+
+		/**
+		 * Location of the (lower case) name and the value in
+		 * #strings.  #CDATA_LITERAL uses "name" for the text,
+		 * #ENTITY for the entity.
+		 */
+		uint32_t name_offset, name_length;
+		uint32_t value_offset, value_length;
+	};
+
+private:
+	std::vector<Event> events;
+
+	/**
+	 * Names and attribute values referenced by #events.
+	 */
+	std::string strings;
+
+	/**
+	 * The length of the source.
+	 */
+	off_t size;
+
+	/**
+	 * False if this template contains a construct which cannot be
+	 * replayed; the template is remembered nonetheless, to avoid
+	 * compiling it again and again.
+	 */
+	bool replayable = true;
+
+	friend class XmlTemplateRecorder;
+
+public:
+	explicit XmlTemplate(off_t _size) noexcept
+		:size(_size) {}
+
+	/**
+	 * Tokenize the given template.
+	 */
+	static std::shared_ptr<const XmlTemplate> Compile(std::string_view src) noexcept;
+
+	off_t GetSize() const noexcept {
+		return size;
+	}
+
+	bool IsReplayable() const noexcept {
+		return replayable;
+	}
+
+	std::span<const Event> GetEvents() const noexcept {
+		return events;
+	}
+
+	std::string_view GetName(const Event &event) const noexcept {
+		return {strings.data() + event.name_offset, event.name_length};
+	}
+
+	std::string_view GetValue(const Event &event) const noexcept {
+		return {strings.data() + event.value_offset, event.value_length};
+	}
+
+	/**
+	 * The number of bytes allocated by this object (approximately).
+	 */
+	std::size_t GetMemorySize() const noexcept {
+		return sizeof(*this) + events.capacity() * sizeof(Event) +
+			strings.capacity();
+	}
+};
+
+class XmlTemplateEntityHandler {
+public:
+	/**
+	 * A text_processor() entity has been found in character data.
+	 */
+	virtual void OnXmlTemplateEntity(off_t start, off_t end,
+					 std::string_view entity) noexcept = 0;
+};
+
+/**
+ * Replays an #XmlTemplate to an #XmlParserHandler.  It gets the
+ * source in chunks (like #XmlParser) and submits all events which
+ * have been completed by the source received so far.
+ */
+class XmlTemplatePlayer final {
+	const std::shared_ptr<const XmlTemplate> t;
+
+	XmlParserHandler &handler;
+	XmlTemplateEntityHandler &entity_handler;
+
+	/**
+	 * The index of the next event in XmlTemplate::events.
+	 */
+	std::size_t cursor = 0;
+
+	/**
+	 * The source offset of the next Feed() call.
+	 */
+	off_t position = 0;
+
+	/**
+	 * The source offset up to which the current #CDATA event has
+	 * already been submitted.
+	 */
+	off_t cdata_position = 0;
+
+public:
+	XmlTemplatePlayer(std::shared_ptr<const XmlTemplate> &&_t,
+			  XmlParserHandler &_handler,
+			  XmlTemplateEntityHandler &_entity_handler) noexcept
+		:t(std::move(_t)),
+		 handler(_handler), entity_handler(_entity_handler) {}
+
+	/**
+	 * Submit the next chunk of the source.
+	 *
+	 * @return false if the handler has closed the parser (i.e.
+	 * OnXmlTagFinished() has returned false)
+	 */
+	bool Feed(std::string_view src) noexcept;
+
+	/**
+	 * Has the source been received completely, and were all
+	 * events submitted?
+	 */
+	[[gnu::pure]]
+	bool IsComplete() const noexcept {
+		return position == t->GetSize() &&
+			cursor == t->GetEvents().size();
+	}
+
+private:
+	void SkipTag() noexcept;
+};
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "XmlTemplateCache.hxx"
+#include "XmlTemplate.hxx"
+#include "istream/StringSink.hxx"
+#include "istream/TeeIstream.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "pool/Holder.hxx"
+#include "pool/pool.hxx"
+#include "util/Cancellable.hxx"
+
+class XmlTemplateCache::Recorder final
+	: PoolHolder, public IntrusiveListHook, StringSinkHandler
+{
+	XmlTemplateCache &cache;
+
+public:
+	const std::string key;
+
+private:
+	CancellablePointer cancel_ptr;
+
+public:
+	Recorder(PoolPtr &&_pool, XmlTemplateCache &_cache,
+		 const char *_key, UnusedIstreamPtr input) noexcept
+		:PoolHolder(std::move(_pool)), cache(_cache), key(_key)
+	{
+		NewStringSink(pool, std::move(input), *this, cancel_ptr);
+	}
+
+	/**
+	 * Abort receiving the template.  The caller is responsible
+	 * for unlinking this object from XmlTemplateCache::recorders.
+	 */
+	void Cancel() noexcept {
+		cancel_ptr.Cancel();
+		Destroy();
+	}
+
+private:
+	void Destroy() noexcept {
+		this->~Recorder();
+	}
+
+	/* virtual methods from class StringSinkHandler */
+	void OnStringSinkSuccess(std::string &&value) noexcept override {
+		unlink();
+
+		auto t = XmlTemplate::Compile(value);
+		cache.Put(std::string{key}, std::move(t));
+		Destroy();
+	}
+
+	void OnStringSinkError(std::exception_ptr) noexcept override {
+		/* the template could not be received completely
+		   (e.g. because the request was canceled); nothing
+		   to remember */
+		unlink();
+		Destroy();
+	}
+};
+
+XmlTemplateCache::XmlTemplateCache(struct pool &_pool,
+				   EventLoop &_event_loop) noexcept
+	:pool(_pool), event_loop(_event_loop) {}
+
+XmlTemplateCache::~XmlTemplateCache() noexcept
+{
+	recorders.clear_and_dispose([](Recorder *r){ r->Cancel(); });
+}
+
+std::shared_ptr<const XmlTemplate>
+XmlTemplateCache::Get(const char *key) noexcept
+{
+	const auto *t = cache.Get(key);
+	return t != nullptr ? *t : nullptr;
+}
+
+void
+XmlTemplateCache::Remove(const char *key) noexcept
+{
+	cache.Remove(key);
+}
+
+inline void
+XmlTemplateCache::Put(std::string &&key,
+		      std::shared_ptr<const XmlTemplate> &&t) noexcept
+{
+	cache.PutOrReplace(std::move(key), std::move(t));
+}
+
+UnusedIstreamPtr
+XmlTemplateCache::Record(struct pool &caller_pool, const char *key,
+			 UnusedIstreamPtr input) noexcept
+{
+	const off_t available = input.GetAvailable(false);
+	if (available < 0 || available > MAX_SIZE)
+		return input;
+
+	for (const auto &i : recorders)
+		if (i.key == key)
+			/* another request is already recording this
+			   template */
+			return input;
+
+	auto tee1 = NewTeeIstream(caller_pool, std::move(input),
+				  event_loop, false,
+				  /* in case the processor closes the
+				     template without reading it */
+				  true);
+
+	auto tee2 = AddTeeIstream(tee1,
+				  /* weak, because we are not interested
+				     in the rest of the template after
+				     the processor has given up */
+				  true);
+
+	auto *recorder = NewFromPool<Recorder>(pool_new_linear(&pool,
+							       "XmlTemplateRecorder",
+							       1024),
+					       *this, key, std::move(tee2));
+	recorders.push_back(*recorder);
+
+	return tee1;
+}
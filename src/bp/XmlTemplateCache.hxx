@@ -0,0 +1,99 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "util/Cache.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+struct pool;
+class EventLoop;
+class UnusedIstreamPtr;
+class XmlTemplate;
+
+/**
+ * Remembers the #XmlTemplate of recently processed templates, so
+ * the #XmlProcessor can skip the #XmlParser the next time.  The key
+ * is the resource tag with the (strong) ETag of the unprocessed
+ * template; see resource_tag_append_etag().
+ */
+class XmlTemplateCache {
+	class Recorder;
+
+	struct pool &pool;
+	EventLoop &event_loop;
+
+	Cache<std::string, std::shared_ptr<const XmlTemplate>, 256, 251> cache;
+
+	/**
+	 * Templates which are currently being received.
+	 */
+	IntrusiveList<Recorder> recorders;
+
+public:
+	/**
+	 * Larger templates are not recorded.
+	 */
+	static constexpr off_t MAX_SIZE = 256 * 1024;
+
+	XmlTemplateCache(struct pool &_pool, EventLoop &_event_loop) noexcept;
+	~XmlTemplateCache() noexcept;
+
+	XmlTemplateCache(const XmlTemplateCache &) = delete;
+	XmlTemplateCache &operator=(const XmlTemplateCache &) = delete;
+
+	std::shared_ptr<const XmlTemplate> Get(const char *key) noexcept;
+
+	void Remove(const char *key) noexcept;
+
+	/**
+	 * Copy the given (unprocessed) template into a new recorder,
+	 * which compiles it and adds it to the cache after it has
+	 * been received completely.  Does nothing if the template
+	 * is too large or if it is already being recorded.
+	 *
+	 * @param input the template
+	 * @return the istream to be used by the caller instead of
+	 * #input
+	 */
+	UnusedIstreamPtr Record(struct pool &caller_pool, const char *key,
+				UnusedIstreamPtr input) noexcept;
+
+private:
+	void Put(std::string &&key,
+		 std::shared_ptr<const XmlTemplate> &&t) noexcept;
+};
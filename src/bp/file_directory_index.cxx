@@ -35,6 +35,11 @@
 #include "file/Address.hxx"
 #include "io/StatAt.hxx"
 
+#ifdef HAVE_URING
+#include "Instance.hxx"
+#include "event/uring/Manager.hxx"
+#endif
+
 #include <assert.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -61,6 +66,15 @@ Request::CheckDirectoryIndex(const TranslateResponse &response) noexcept
 	assert(response.directory_index.data() != nullptr);
 
 	if (response.test_path != nullptr) {
+#ifdef HAVE_URING
+		if (instance.uring) {
+			StartFileCheck(response, FileCheck::DIRECTORY_INDEX,
+				       nullptr, response.test_path,
+				       AT_STATX_DONT_SYNC, STATX_TYPE);
+			return false;
+		}
+#endif
+
 		if (!IsDirectory(nullptr, response.test_path))
 			return true;
 	} else {
@@ -79,6 +93,17 @@ Request::CheckDirectoryIndex(const TranslateResponse &response) noexcept
 			return false;
 
 		case ResourceAddress::Type::LOCAL:
+#ifdef HAVE_URING
+			if (instance.uring) {
+				const auto &file = response.address.GetFile();
+				StartFileCheck(response,
+					       FileCheck::DIRECTORY_INDEX,
+					       file.base, file.path,
+					       AT_STATX_DONT_SYNC, STATX_TYPE);
+				return false;
+			}
+#endif
+
 			if (!IsDirectory(response.address.GetFile()))
 				return true;
 
@@ -88,6 +113,12 @@ Request::CheckDirectoryIndex(const TranslateResponse &response) noexcept
 		}
 	}
 
+	return SubmitDirectoryIndex(response);
+}
+
+bool
+Request::SubmitDirectoryIndex(const TranslateResponse &response) noexcept
+{
 	if (++translate.n_directory_index > 4) {
 		LogDispatchError(HTTP_STATUS_BAD_GATEWAY,
 				 "Got too many consecutive DIRECTORY_INDEX packets",
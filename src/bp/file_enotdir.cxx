@@ -40,6 +40,11 @@
 #include "io/StatAt.hxx"
 #include "AllocatorPtr.hxx"
 
+#ifdef HAVE_URING
+#include "Instance.hxx"
+#include "event/uring/Manager.hxx"
+#endif
+
 #include <assert.h>
 #include <fcntl.h>
 #include <string.h>
@@ -152,6 +157,15 @@ Request::CheckFileEnotdir(const TranslateResponse &response) noexcept
 		return false;
 	}
 
+#ifdef HAVE_URING
+	if (instance.uring) {
+		StartFileCheck(response, FileCheck::ENOTDIR,
+			       get_file_base(response), path,
+			       AT_STATX_DONT_SYNC, STATX_TYPE);
+		return false;
+	}
+#endif
+
 	if (IsEnotdir(get_file_base(response), path))
 		return SubmitEnotdir(response);
 
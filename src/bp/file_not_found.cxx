@@ -37,6 +37,11 @@
 #include "http/local/Address.hxx"
 #include "io/StatAt.hxx"
 
+#ifdef HAVE_URING
+#include "Instance.hxx"
+#include "event/uring/Manager.hxx"
+#endif
+
 #include <assert.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -126,9 +131,25 @@ Request::CheckFileNotFound(const TranslateResponse &response) noexcept
 		return false;
 	}
 
+#ifdef HAVE_URING
+	if (instance.uring) {
+		StartFileCheck(response, FileCheck::FILE_NOT_FOUND,
+			       get_file_base(response), path,
+			       AT_SYMLINK_NOFOLLOW|AT_STATX_DONT_SYNC,
+			       STATX_TYPE);
+		return false;
+	}
+#endif
+
 	if (!IsEnoent(get_file_base(response), path))
 		return true;
 
+	return SubmitFileNotFound(response);
+}
+
+bool
+Request::SubmitFileNotFound(const TranslateResponse &response) noexcept
+{
 	if (++translate.n_file_not_found > 20) {
 		LogDispatchError(HTTP_STATUS_BAD_GATEWAY,
 				 "got too many consecutive FILE_NOT_FOUND packets",
@@ -113,6 +113,7 @@ Cache::ItemRemoved(CacheItem *item) noexcept
 
 	size -= item->size;
 
+	item->OnRemoved();
 	item->Release();
 
 	if (size == 0)
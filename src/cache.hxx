@@ -134,6 +134,13 @@ public:
 		return true;
 	}
 
+	/**
+	 * This item has been removed from the #Cache (expired,
+	 * evicted, replaced or flushed).  If it is locked, Destroy()
+	 * will be called later.
+	 */
+	virtual void OnRemoved() noexcept {}
+
 	virtual void Destroy() noexcept = 0;
 
 	[[gnu::pure]]
@@ -38,6 +38,7 @@
 #include "istream/UnusedPtr.hxx"
 #include "istream/istream_null.hxx"
 #include "stopwatch.hxx"
+#include "stats/LatencyHistogram.hxx"
 #include "http/ResponseHandler.hxx"
 #include "memory/fb_pool.hxx"
 #include "memory/SliceFifoBuffer.hxx"
@@ -52,6 +53,9 @@
 class CGIClient final : Istream, IstreamSink, Cancellable, DestructAnchor {
 	const StopwatchPtr stopwatch;
 
+	LatencyHistogram *const latency;
+	const std::chrono::steady_clock::time_point start_time;
+
 	SliceFifoBuffer buffer;
 
 	CGIParser parser;
@@ -71,6 +75,8 @@ class CGIClient final : Istream, IstreamSink, Cancellable, DestructAnchor {
 public:
 	CGIClient(struct pool &_pool, StopwatchPtr &&_stopwatch,
 		  UnusedIstreamPtr _input,
+		  LatencyHistogram *_latency,
+		  std::chrono::steady_clock::time_point _start_time,
 		  HttpResponseHandler &_handler,
 		  CancellablePointer &cancel_ptr);
 
@@ -131,6 +137,9 @@ public:
 inline bool
 CGIClient::ReturnResponse()
 {
+	if (latency != nullptr)
+		latency->Add(std::chrono::steady_clock::now() - start_time);
+
 	http_status_t status = parser.GetStatus();
 	auto headers = std::move(parser).GetHeaders();
 
@@ -451,10 +460,13 @@ CGIClient::Cancel() noexcept
 inline
 CGIClient::CGIClient(struct pool &_pool, StopwatchPtr &&_stopwatch,
 		     UnusedIstreamPtr _input,
+		     LatencyHistogram *_latency,
+		     std::chrono::steady_clock::time_point _start_time,
 		     HttpResponseHandler &_handler,
 		     CancellablePointer &cancel_ptr)
 	:Istream(_pool), IstreamSink(std::move(_input)),
 	 stopwatch(std::move(_stopwatch)),
+	 latency(_latency), start_time(_start_time),
 	 buffer(fb_pool_get()),
 	 handler(_handler)
 {
@@ -466,10 +478,12 @@ CGIClient::CGIClient(struct pool &_pool, StopwatchPtr &&_stopwatch,
 void
 cgi_client_new(struct pool &pool, StopwatchPtr stopwatch,
 	       UnusedIstreamPtr input,
+	       LatencyHistogram *latency,
+	       std::chrono::steady_clock::time_point start_time,
 	       HttpResponseHandler &handler,
 	       CancellablePointer &cancel_ptr)
 {
 	NewFromPool<CGIClient>(pool, pool, std::move(stopwatch),
-			       std::move(input),
+			       std::move(input), latency, start_time,
 			       handler, cancel_ptr);
 }
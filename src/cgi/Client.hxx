@@ -32,7 +32,10 @@
 
 #pragma once
 
+#include <chrono>
+
 struct pool;
+struct LatencyHistogram;
 class StopwatchPtr;
 class UnusedIstreamPtr;
 class HttpResponseHandler;
@@ -42,9 +45,13 @@ class CancellablePointer;
  * Communicate with a CGI script.
  *
  * @param input the stream received from the child process
+ * @param latency if not nullptr, then the time from #start_time
+ * until the response header was received is added to this histogram
  */
 void
 cgi_client_new(struct pool &pool, StopwatchPtr stopwatch,
 	       UnusedIstreamPtr input,
+	       LatencyHistogram *latency,
+	       std::chrono::steady_clock::time_point start_time,
 	       HttpResponseHandler &handler,
 	       CancellablePointer &cancel_ptr);
@@ -34,13 +34,15 @@
 #include "Address.hxx"
 #include "Client.hxx"
 #include "Launch.hxx"
+#include "Zygote.hxx"
 #include "util/AbortFlag.hxx"
 #include "stopwatch.hxx"
 #include "http/ResponseHandler.hxx"
 #include "istream/UnusedPtr.hxx"
 
 void
-cgi_new(SpawnService &spawn_service, EventLoop &event_loop,
+cgi_new(SpawnService &spawn_service, CgiZygotePool *zygotes,
+	EventLoop &event_loop,
 	struct pool *pool,
 	const StopwatchPtr &parent_stopwatch,
 	http_method_t method,
@@ -54,12 +56,18 @@ cgi_new(SpawnService &spawn_service, EventLoop &event_loop,
 
 	AbortFlag abort_flag(cancel_ptr);
 
+	const auto start_time = std::chrono::steady_clock::now();
+
+	CgiZygote *const zygote = zygotes != nullptr
+		? zygotes->Get(address->options)
+		: nullptr;
+
 	UnusedIstreamPtr input;
 
 	try {
 		input = cgi_launch(event_loop, pool, method, address,
 				   remote_addr, headers, std::move(body),
-				   spawn_service);
+				   spawn_service, zygote);
 	} catch (...) {
 		if (abort_flag.aborted) {
 			/* the operation was aborted - don't call the
@@ -74,5 +82,10 @@ cgi_new(SpawnService &spawn_service, EventLoop &event_loop,
 	stopwatch.RecordEvent("fork");
 
 	cgi_client_new(*pool, std::move(stopwatch),
-		       std::move(input), handler, cancel_ptr);
+		       std::move(input),
+		       zygotes != nullptr
+		       ? &zygotes->GetLatency(zygote != nullptr)
+		       : nullptr,
+		       start_time,
+		       handler, cancel_ptr);
 }
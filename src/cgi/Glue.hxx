@@ -40,15 +40,20 @@ class StopwatchPtr;
 class EventLoop;
 class UnusedIstreamPtr;
 class SpawnService;
+class CgiZygotePool;
 class StringMap;
 class HttpResponseHandler;
 class CancellablePointer;
 
 /**
  * Run a CGI script.
+ *
+ * @param zygotes an optional #CgiZygotePool which may launch the
+ * script and which collects latency statistics
  */
 void
-cgi_new(SpawnService &spawn_service, EventLoop &event_loop,
+cgi_new(SpawnService &spawn_service, CgiZygotePool *zygotes,
+	EventLoop &event_loop,
 	struct pool *pool,
 	const StopwatchPtr &parent_stopwatch,
 	http_method_t method,
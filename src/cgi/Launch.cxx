@@ -32,11 +32,15 @@
 
 #include "Launch.hxx"
 #include "Address.hxx"
+#include "Zygote.hxx"
+#include "ZygoteProtocol.hxx"
 #include "istream/UnusedPtr.hxx"
 #include "strmap.hxx"
 #include "product.h"
 #include "spawn/IstreamSpawn.hxx"
 #include "spawn/Prepared.hxx"
+#include "spawn/ProcessHandle.hxx"
+#include "io/UniqueFileDescriptor.hxx"
 #include "util/CharUtil.hxx"
 #include "AllocatorPtr.hxx"
 
@@ -64,10 +68,13 @@ StringFallback(const char *value, const char *fallback)
 }
 
 /**
- * Throws std::runtime_error on error.
+ * Set up the arguments and the environment of a CGI program.
+ *
+ * @param p a #PreparedChildProcess or a #CgiZygoteCommand
  */
+template<typename P>
 static void
-PrepareCgi(struct pool &pool, PreparedChildProcess &p,
+PrepareCgi(struct pool &pool, P &p,
 	   http_method_t method,
 	   const CgiAddress &address,
 	   const char *remote_addr,
@@ -154,22 +161,60 @@ PrepareCgi(struct pool &pool, PreparedChildProcess &p,
 		p.Append(i);
 	if (arg != nullptr)
 		p.Append(arg);
-
-	address.options.CopyTo(p);
 }
 
+namespace {
+
+class CgiZygoteLauncher final : public ChildProcessLauncher {
+	CgiZygote &zygote;
+	const CgiZygoteCommand &command;
+
+public:
+	CgiZygoteLauncher(CgiZygote &_zygote,
+			  const CgiZygoteCommand &_command) noexcept
+		:zygote(_zygote), command(_command) {}
+
+	std::unique_ptr<ChildProcessHandle> Launch(UniqueFileDescriptor stdin_fd,
+						   UniqueFileDescriptor stdout_fd) override {
+		return zygote.Spawn(command, std::move(stdin_fd),
+				    std::move(stdout_fd));
+	}
+};
+
+} // anonymous namespace
+
 UnusedIstreamPtr
 cgi_launch(EventLoop &event_loop, struct pool *pool,
 	   http_method_t method,
 	   const CgiAddress *address,
 	   const char *remote_addr,
 	   const StringMap &headers, UnusedIstreamPtr body,
-	   SpawnService &spawn_service)
+	   SpawnService &spawn_service, CgiZygote *zygote)
 {
+	const off_t content_length = body ? body.GetAvailable(false) : -1;
+
+	if (zygote != nullptr) {
+		CgiZygoteCommand command;
+		PrepareCgi(*pool, command, method,
+			   *address, remote_addr, headers,
+			   content_length);
+
+		/* very large environments (from huge request
+		   headers) don't fit into one packet; these are
+		   launched the traditional way */
+		if (command.GetArgs().size() + command.GetEnv().size() <
+		    CGI_ZYGOTE_MAX_PAYLOAD - sizeof(CgiZygoteSpawnPayload)) {
+			CgiZygoteLauncher launcher(*zygote, command);
+			return SpawnChildProcess(event_loop, pool,
+						 std::move(body), launcher);
+		}
+	}
+
 	PreparedChildProcess p;
 	PrepareCgi(*pool, p, method,
 		   *address, remote_addr, headers,
-		   body ? body.GetAvailable(false) : -1);
+		   content_length);
+	address->options.CopyTo(p);
 
 	return SpawnChildProcess(event_loop, pool,
 				 cgi_address_name(address), std::move(body),
@@ -38,6 +38,7 @@ struct pool;
 class EventLoop;
 class UnusedIstreamPtr;
 class SpawnService;
+class CgiZygote;
 struct CgiAddress;
 class StringMap;
 
@@ -45,10 +46,13 @@ class StringMap;
  * Launch a CGI script.
  *
  * Throws std::runtime_error on error.
+ *
+ * @param zygote a ready #CgiZygote for the address's #ChildOptions
+ * which shall launch the script; nullptr to use the #SpawnService
  */
 UnusedIstreamPtr
 cgi_launch(EventLoop &event_loop, struct pool *pool, http_method_t method,
 	   const CgiAddress *address,
 	   const char *remote_addr,
 	   const StringMap &headers, UnusedIstreamPtr body,
-	   SpawnService &spawn_service);
+	   SpawnService &spawn_service, CgiZygote *zygote);
@@ -0,0 +1,374 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Zygote.hxx"
+#include "ZygoteProtocol.hxx"
+#include "spawn/Interface.hxx"
+#include "spawn/Prepared.hxx"
+#include "spawn/ChildOptions.hxx"
+#include "spawn/ProcessHandle.hxx"
+#include "spawn/ExitListener.hxx"
+#include "net/SendMessage.hxx"
+#include "net/ScmRightsBuilder.hxx"
+#include "io/Iovec.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+
+#include <cassert>
+#include <stdexcept>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+/**
+ * A process launched by a #CgiZygote.
+ */
+class CgiZygoteChild final : public ChildProcessHandle {
+	friend class CgiZygote;
+
+	/**
+	 * The zygote; nullptr after the process has exited or after
+	 * the zygote has gone away.
+	 */
+	CgiZygote *zygote;
+
+	const uint32_t id;
+
+	ExitListener *listener = nullptr;
+
+public:
+	CgiZygoteChild(CgiZygote &_zygote, uint32_t _id) noexcept
+		:zygote(&_zygote), id(_id) {}
+
+	~CgiZygoteChild() noexcept {
+		if (zygote != nullptr) {
+			zygote->children.erase(id);
+			zygote->SendKill(id, SIGTERM);
+		}
+	}
+
+	/* virtual methods from class ChildProcessHandle */
+	void SetExitListener(ExitListener &_listener) noexcept override {
+		listener = &_listener;
+	}
+
+	void Kill(int signo) noexcept override {
+		if (zygote != nullptr)
+			zygote->SendKill(id, signo);
+	}
+
+private:
+	void OnExit(int status) noexcept {
+		zygote = nullptr;
+
+		if (listener != nullptr)
+			listener->OnChildProcessExit(status);
+	}
+};
+
+CgiZygote::CgiZygote(CgiZygotePool &_pool, const std::string &_key,
+		     SpawnService &spawn_service, const char *helper_path,
+		     const ChildOptions &options)
+	:pool(_pool), key(_key),
+	 event(pool.GetEventLoop(), BIND_THIS_METHOD(OnSocketReady))
+{
+	UniqueSocketDescriptor child_socket;
+	if (!UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL, SOCK_SEQPACKET, 0,
+						      socket, child_socket))
+		throw MakeErrno("socketpair() failed");
+
+	PreparedChildProcess p;
+	p.Append(helper_path);
+	options.CopyTo(p);
+	p.SetStdin(std::move(child_socket));
+
+	handle = spawn_service.SpawnChildProcess("cgi-zygote", std::move(p));
+
+	event.Open(socket);
+	event.ScheduleRead();
+}
+
+CgiZygote::~CgiZygote() noexcept
+{
+	event.Cancel();
+	AbandonChildren();
+
+	/* closing the socket makes the helper exit */
+}
+
+void
+CgiZygote::AbandonChildren() noexcept
+{
+	auto c = std::move(children);
+	children.clear();
+
+	for (const auto &[id, child] : c)
+		/* pretend the process was killed; its output pipe is
+		   still read until the end */
+		child->OnExit(SIGKILL);
+}
+
+std::unique_ptr<ChildProcessHandle>
+CgiZygote::Spawn(const CgiZygoteCommand &command,
+		 UniqueFileDescriptor stdin_fd,
+		 UniqueFileDescriptor stdout_fd)
+{
+	assert(ready);
+
+	if (++last_id == 0)
+		/* zero is reserved for READY */
+		++last_id;
+
+	const uint32_t id = last_id;
+
+	const CgiZygoteRequestHeader header{
+		id, CgiZygoteRequestCommand::SPAWN, 0,
+	};
+
+	const CgiZygoteSpawnPayload spawn{
+		uint16_t(command.GetArgCount()), 0,
+	};
+
+	const struct iovec v[] = {
+		MakeIovecT(header),
+		MakeIovecT(spawn),
+		MakeIovec(command.GetArgs()),
+		MakeIovec(command.GetEnv()),
+	};
+
+	MessageHeader msg{std::span{v}};
+
+	ScmRightsBuilder<2> b(msg);
+	b.push_back(stdout_fd.Get());
+	if (stdin_fd.IsDefined())
+		b.push_back(stdin_fd.Get());
+	b.Finish(msg);
+
+	SendMessage(socket, msg, MSG_DONTWAIT);
+
+	auto child = std::make_unique<CgiZygoteChild>(*this, id);
+	children.emplace(id, child.get());
+	return child;
+}
+
+void
+CgiZygote::SendKill(uint32_t id, int signo) noexcept
+{
+	const CgiZygoteRequestHeader header{
+		id, CgiZygoteRequestCommand::KILL, 0,
+	};
+
+	const struct iovec v[] = {
+		MakeIovecT(header),
+		MakeIovecT(signo),
+	};
+
+	try {
+		SendMessage(socket, MessageHeader{std::span{v}},
+			    MSG_DONTWAIT);
+	} catch (...) {
+		/* if the socket is broken, the helper has exited,
+		   and OnSocketReady() will notice */
+	}
+}
+
+inline bool
+CgiZygote::ReceiveResponse()
+{
+	CgiZygoteResponse response;
+	ssize_t nbytes = recv(socket.Get(), &response, sizeof(response),
+			      MSG_DONTWAIT);
+	if (nbytes < 0) {
+		if (errno == EAGAIN)
+			return true;
+
+		throw MakeErrno("Failed to receive from cgi-zygote");
+	}
+
+	if (nbytes == 0)
+		return false;
+
+	if ((std::size_t)nbytes != sizeof(response))
+		throw std::runtime_error("Malformed response from cgi-zygote");
+
+	switch (response.command) {
+	case CgiZygoteResponseCommand::READY:
+		ready = true;
+		return true;
+
+	case CgiZygoteResponseCommand::EXIT:
+		if (auto i = children.find(response.id); i != children.end()) {
+			auto *child = i->second;
+			children.erase(i);
+			child->OnExit(response.value);
+		}
+
+		return true;
+	}
+
+	throw std::runtime_error("Unknown response from cgi-zygote");
+}
+
+void
+CgiZygote::OnSocketReady(unsigned) noexcept
+{
+	try {
+		if (!ReceiveResponse())
+			pool.OnZygoteError(*this,
+					   std::make_exception_ptr(std::runtime_error(ready
+										      ? "cgi-zygote has exited"
+										      : "cgi-zygote failed to start")));
+	} catch (...) {
+		pool.OnZygoteError(*this, std::current_exception());
+	}
+}
+
+CgiZygotePool::CgiZygotePool(EventLoop &_event_loop,
+			     SpawnService &_spawn_service,
+			     const char *_helper_path) noexcept
+	:logger("cgi_zygote"),
+	 event_loop(_event_loop), spawn_service(_spawn_service),
+	 helper_path(_helper_path),
+	 cleanup_timer(event_loop, BIND_THIS_METHOD(OnCleanupTimer))
+{
+}
+
+CgiZygotePool::~CgiZygotePool() noexcept = default;
+
+CgiZygote *
+CgiZygotePool::Get(const ChildOptions &options) noexcept
+{
+	if (helper_path == nullptr)
+		return nullptr;
+
+	char buffer[16384];
+	const std::string_view key{
+		buffer, std::size_t(options.MakeId(buffer) - buffer),
+	};
+
+	const auto now = event_loop.SteadyNow();
+
+	auto i = entries.find(key);
+	if (i == entries.end()) {
+		if (entries.size() >= MAX_ENTRIES)
+			return nullptr;
+
+		i = entries.emplace(key, Entry{}).first;
+
+		if (!cleanup_timer.IsPending())
+			cleanup_timer.Schedule(IDLE_TIMEOUT / 4);
+	}
+
+	auto &entry = i->second;
+
+	if (entry.zygote) {
+		entry.last_used = now;
+		return entry.zygote->IsReady() ? entry.zygote.get() : nullptr;
+	}
+
+	if (now - entry.last_used > DEMAND_WINDOW)
+		entry.demand = 0;
+
+	entry.last_used = now;
+
+	if (++entry.demand >= START_DEMAND && now >= entry.retry_after &&
+	    n_zygotes < MAX_ZYGOTES)
+		Start(i, options);
+
+	return nullptr;
+}
+
+void
+CgiZygotePool::Start(std::map<std::string, Entry, std::less<>>::iterator i,
+		     const ChildOptions &options) noexcept
+{
+	auto &entry = i->second;
+	assert(!entry.zygote);
+
+	try {
+		entry.zygote = std::make_unique<CgiZygote>(*this, i->first,
+							   spawn_service,
+							   helper_path,
+							   options);
+		++n_zygotes;
+	} catch (...) {
+		logger(1, "Failed to launch cgi-zygote: ",
+		       std::current_exception());
+		entry.retry_after = event_loop.SteadyNow() + RETRY_DELAY;
+	}
+}
+
+void
+CgiZygotePool::OnZygoteError(CgiZygote &zygote,
+			     std::exception_ptr error) noexcept
+{
+	logger(1, error);
+
+	auto i = entries.find(zygote.GetKey());
+	assert(i != entries.end());
+
+	auto &entry = i->second;
+	assert(entry.zygote.get() == &zygote);
+
+	if (!zygote.IsReady())
+		/* the helper is probably not available inside this
+		   jail; don't try again too soon */
+		entry.retry_after = event_loop.SteadyNow() + RETRY_DELAY;
+
+	entry.demand = 0;
+	--n_zygotes;
+	entry.zygote.reset();
+}
+
+void
+CgiZygotePool::OnCleanupTimer() noexcept
+{
+	const auto now = event_loop.SteadyNow();
+
+	for (auto i = entries.begin(); i != entries.end();) {
+		auto &entry = i->second;
+
+		if (now - entry.last_used >= IDLE_TIMEOUT &&
+		    now >= entry.retry_after &&
+		    (!entry.zygote || entry.zygote->IsIdle())) {
+			if (entry.zygote)
+				--n_zygotes;
+
+			i = entries.erase(i);
+		} else
+			++i;
+	}
+
+	if (!entries.empty())
+		cleanup_timer.Schedule(IDLE_TIMEOUT / 4);
+}
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "stats/LatencyHistogram.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/SocketEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "io/Logger.hxx"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+struct ChildOptions;
+class SpawnService;
+class ChildProcessHandle;
+class UniqueFileDescriptor;
+class CgiZygotePool;
+class CgiZygoteChild;
+
+/**
+ * Collects the arguments and environment variables of a CGI program
+ * to be launched by a #CgiZygote.  It provides the subset of the
+ * #PreparedChildProcess methods used by PrepareCgi().
+ */
+class CgiZygoteCommand {
+	/**
+	 * Null-terminated strings.
+	 */
+	std::string args, env;
+
+	unsigned n_args = 0;
+
+public:
+	void Append(std::string_view arg) noexcept {
+		args.append(arg);
+		args.push_back('\0');
+		++n_args;
+	}
+
+	void SetEnv(std::string_view name, std::string_view value) noexcept {
+		env.append(name);
+		env.push_back('=');
+		env.append(value);
+		env.push_back('\0');
+	}
+
+	unsigned GetArgCount() const noexcept {
+		return n_args;
+	}
+
+	std::span<const std::byte> GetArgs() const noexcept {
+		return std::as_bytes(std::span{args});
+	}
+
+	std::span<const std::byte> GetEnv() const noexcept {
+		return std::as_bytes(std::span{env});
+	}
+};
+
+/**
+ * A "cgi-zygote" helper process which was launched with the
+ * #ChildOptions of a CGI program (i.e. in its namespaces, cgroup and
+ * with its credentials).  It forks and executes CGI programs on
+ * demand.
+ */
+class CgiZygote final {
+	friend class CgiZygoteChild;
+
+	CgiZygotePool &pool;
+
+	/**
+	 * The key of this zygote in #CgiZygotePool (owned by the
+	 * pool).
+	 */
+	const std::string &key;
+
+	std::unique_ptr<ChildProcessHandle> handle;
+
+	UniqueSocketDescriptor socket;
+	SocketEvent event;
+
+	/**
+	 * The children which have not exited yet, by the id
+	 * assigned to them.
+	 */
+	std::map<uint32_t, CgiZygoteChild *> children;
+
+	uint32_t last_id = 0;
+
+	/**
+	 * Has the helper sent #CgiZygoteResponseCommand::READY?
+	 */
+	bool ready = false;
+
+public:
+	/**
+	 * Launch the helper process.  Throws on error.
+	 */
+	CgiZygote(CgiZygotePool &_pool, const std::string &_key,
+		  SpawnService &spawn_service, const char *helper_path,
+		  const ChildOptions &options);
+
+	/**
+	 * Stops the helper process; children which are still
+	 * running are reported as killed.
+	 */
+	~CgiZygote() noexcept;
+
+	CgiZygote(const CgiZygote &) = delete;
+	CgiZygote &operator=(const CgiZygote &) = delete;
+
+	const std::string &GetKey() const noexcept {
+		return key;
+	}
+
+	bool IsReady() const noexcept {
+		return ready;
+	}
+
+	/**
+	 * Are there no running children?
+	 */
+	bool IsIdle() const noexcept {
+		return children.empty();
+	}
+
+	/**
+	 * Ask the helper to fork and execute a program.  Throws on
+	 * error.
+	 *
+	 * @param stdin_fd the standard input; may be undefined
+	 */
+	std::unique_ptr<ChildProcessHandle> Spawn(const CgiZygoteCommand &command,
+						  UniqueFileDescriptor stdin_fd,
+						  UniqueFileDescriptor stdout_fd);
+
+private:
+	void SendKill(uint32_t id, int signo) noexcept;
+
+	/**
+	 * Report all children as killed and forget them.
+	 */
+	void AbandonChildren() noexcept;
+
+	/**
+	 * Receive and handle one response.  Throws on error.
+	 *
+	 * @return false if the helper has exited
+	 */
+	bool ReceiveResponse();
+
+	void OnSocketReady(unsigned events) noexcept;
+};
+
+/**
+ * Manages #CgiZygote instances, one for each distinct #ChildOptions
+ * configuration of recently requested CGI programs.  A zygote is
+ * started in the background once a configuration has been requested
+ * repeatedly, and it is stopped after it has been unused for a
+ * while.
+ *
+ * It also collects latency statistics of all CGI launches, whether
+ * or not they use a zygote.
+ */
+class CgiZygotePool {
+	/**
+	 * A zygote is started after this many requests within
+	 * #DEMAND_WINDOW.
+	 */
+	static constexpr unsigned START_DEMAND = 2;
+
+	static constexpr std::chrono::steady_clock::duration DEMAND_WINDOW =
+		std::chrono::minutes{1};
+
+	/**
+	 * Zygotes (and demand records) which have not been used for
+	 * this long are discarded.
+	 */
+	static constexpr std::chrono::steady_clock::duration IDLE_TIMEOUT =
+		std::chrono::minutes{2};
+
+	/**
+	 * After a zygote has failed to start, wait this long before
+	 * trying again.
+	 */
+	static constexpr std::chrono::steady_clock::duration RETRY_DELAY =
+		std::chrono::minutes{1};
+
+	static constexpr std::size_t MAX_ENTRIES = 256;
+	static constexpr unsigned MAX_ZYGOTES = 32;
+
+	const LLogger logger;
+
+	EventLoop &event_loop;
+	SpawnService &spawn_service;
+
+	/**
+	 * The path of the "cgi-zygote" helper program; nullptr
+	 * disables zygotes.
+	 */
+	const char *const helper_path;
+
+	struct Entry {
+		std::chrono::steady_clock::time_point last_used;
+
+		/**
+		 * Do not start a zygote before this time.
+		 */
+		std::chrono::steady_clock::time_point retry_after;
+
+		/**
+		 * The number of requests within #DEMAND_WINDOW.
+		 */
+		unsigned demand = 0;
+
+		std::unique_ptr<CgiZygote> zygote;
+	};
+
+	/**
+	 * Indexed by ChildOptions::MakeId().
+	 */
+	std::map<std::string, Entry, std::less<>> entries;
+
+	unsigned n_zygotes = 0;
+
+	CoarseTimerEvent cleanup_timer;
+
+	/**
+	 * Time from launching a CGI program until its response
+	 * header was received: [0] for programs launched directly,
+	 * [1] for programs launched by a zygote.
+	 */
+	LatencyHistogram latency[2];
+
+public:
+	/**
+	 * @param _helper_path the path of the "cgi-zygote" program
+	 * (which must be reachable inside all CGI jails) or nullptr
+	 * to disable zygotes
+	 */
+	CgiZygotePool(EventLoop &_event_loop, SpawnService &_spawn_service,
+		      const char *_helper_path) noexcept;
+
+	~CgiZygotePool() noexcept;
+
+	CgiZygotePool(const CgiZygotePool &) = delete;
+	CgiZygotePool &operator=(const CgiZygotePool &) = delete;
+
+	EventLoop &GetEventLoop() const noexcept {
+		return event_loop;
+	}
+
+	/**
+	 * Look up a ready zygote for the given options and record
+	 * the demand.  Returns nullptr if there is none (yet); the
+	 * caller shall then launch the program directly.
+	 */
+	CgiZygote *Get(const ChildOptions &options) noexcept;
+
+	LatencyHistogram &GetLatency(bool zygote) noexcept {
+		return latency[zygote];
+	}
+
+	const LatencyHistogram &GetLatency(bool zygote) const noexcept {
+		return latency[zygote];
+	}
+
+	/**
+	 * Called by #CgiZygote when the helper process has exited or
+	 * failed.  Destroys the #CgiZygote.
+	 */
+	void OnZygoteError(CgiZygote &zygote,
+			   std::exception_ptr error) noexcept;
+
+private:
+	void Start(std::map<std::string, Entry, std::less<>>::iterator i,
+		   const ChildOptions &options) noexcept;
+
+	void OnCleanupTimer() noexcept;
+};
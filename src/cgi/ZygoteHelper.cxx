@@ -0,0 +1,328 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The "cgi-zygote" helper process.  It is launched with the
+ * namespaces, resource limits and credentials of a CGI program, and
+ * then forks and executes CGI programs on behalf of beng-proxy,
+ * which saves the setup costs on each request.
+ */
+
+#include "ZygoteProtocol.hxx"
+
+#include <map>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Maps process ids to the "id" chosen by the client.
+ */
+static std::map<pid_t, uint32_t> children;
+
+static bool
+SendResponse(uint32_t id, CgiZygoteResponseCommand command, int value)
+{
+	const CgiZygoteResponse response{id, command, 0, value};
+
+	ssize_t nbytes = send(0, &response, sizeof(response), 0);
+	if (nbytes < 0) {
+		fprintf(stderr, "send() on zygote socket failed: %s\n",
+			strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+[[noreturn]]
+static void
+Exec(const std::vector<char *> &args, const std::vector<char *> &env,
+     int stdin_fd, int stdout_fd) noexcept
+{
+	sigset_t empty;
+	sigemptyset(&empty);
+	sigprocmask(SIG_SETMASK, &empty, nullptr);
+
+	if (stdin_fd < 0)
+		stdin_fd = open("/dev/null", O_RDONLY|O_NOCTTY);
+
+	/* this replaces the zygote socket */
+	dup2(stdin_fd, STDIN_FILENO);
+	dup2(stdout_fd, STDOUT_FILENO);
+
+	execve(args.front(), args.data(), env.data());
+
+	fprintf(stderr, "Failed to execute %s: %s\n",
+		args.front(), strerror(errno));
+	_exit(127);
+}
+
+static bool
+HandleSpawn(uint32_t id, char *payload, size_t length,
+	    int stdin_fd, int stdout_fd)
+{
+	CgiZygoteSpawnPayload header;
+	if (length < sizeof(header) || stdout_fd < 0 ||
+	    payload[length - 1] != 0) {
+		fprintf(stderr, "malformed SPAWN packet\n");
+		return SendResponse(id, CgiZygoteResponseCommand::EXIT,
+				    W_EXITCODE(127, 0));
+	}
+
+	memcpy(&header, payload, sizeof(header));
+	payload += sizeof(header);
+	length -= sizeof(header);
+
+	std::vector<char *> args, env;
+
+	for (char *end = payload + length; payload < end;
+	     payload += strlen(payload) + 1) {
+		if (args.size() < header.n_args)
+			args.push_back(payload);
+		else
+			env.push_back(payload);
+	}
+
+	if (args.empty()) {
+		fprintf(stderr, "malformed SPAWN packet\n");
+		return SendResponse(id, CgiZygoteResponseCommand::EXIT,
+				    W_EXITCODE(127, 0));
+	}
+
+	args.push_back(nullptr);
+
+	/* the variables from the request override the ones this
+	   process was launched with */
+	for (char **i = environ; *i != nullptr; ++i)
+		env.push_back(*i);
+	env.push_back(nullptr);
+
+	const pid_t pid = fork();
+	if (pid == 0)
+		Exec(args, env, stdin_fd, stdout_fd);
+
+	if (pid < 0) {
+		fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+		return SendResponse(id, CgiZygoteResponseCommand::EXIT,
+				    W_EXITCODE(127, 0));
+	}
+
+	children.emplace(pid, id);
+	return true;
+}
+
+static void
+HandleKill(uint32_t id, const char *payload, size_t length) noexcept
+{
+	int signo;
+	if (length != sizeof(signo)) {
+		fprintf(stderr, "malformed KILL packet\n");
+		return;
+	}
+
+	memcpy(&signo, payload, sizeof(signo));
+
+	for (const auto &[pid, i] : children) {
+		if (i == id) {
+			kill(pid, signo);
+			break;
+		}
+	}
+}
+
+/**
+ * @return false if the socket was closed or on error
+ */
+static bool
+HandleRequest()
+{
+	CgiZygoteRequestHeader header;
+	static char payload[CGI_ZYGOTE_MAX_PAYLOAD];
+
+	struct iovec iov[] = {
+		{&header, sizeof(header)},
+		{payload, sizeof(payload)},
+	};
+
+	int fds[2];
+	alignas(struct cmsghdr) char cmsg_buffer[CMSG_SPACE(sizeof(fds))];
+
+	struct msghdr msg{};
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	msg.msg_control = cmsg_buffer;
+	msg.msg_controllen = sizeof(cmsg_buffer);
+
+	ssize_t nbytes = recvmsg(STDIN_FILENO, &msg, MSG_CMSG_CLOEXEC);
+	if (nbytes < 0) {
+		fprintf(stderr, "recvmsg() on zygote socket failed: %s\n",
+			strerror(errno));
+		return false;
+	}
+
+	if (nbytes == 0)
+		return false;
+
+	/* collect the file descriptors: standard output first, then
+	   (optionally) standard input */
+	int stdout_fd = -1, stdin_fd = -1;
+	if (const struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	    cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+	    cmsg->cmsg_type == SCM_RIGHTS) {
+		const size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(fds, CMSG_DATA(cmsg), n * sizeof(int));
+		if (n >= 1)
+			stdout_fd = fds[0];
+		if (n >= 2)
+			stdin_fd = fds[1];
+	}
+
+	bool result = true;
+
+	if ((size_t)nbytes < sizeof(header) ||
+	    (msg.msg_flags & (MSG_TRUNC|MSG_CTRUNC)) != 0) {
+		fprintf(stderr, "malformed packet on zygote socket\n");
+		result = false;
+	} else {
+		const size_t length = nbytes - sizeof(header);
+
+		switch (header.command) {
+		case CgiZygoteRequestCommand::SPAWN:
+			result = HandleSpawn(header.id, payload, length,
+					     stdin_fd, stdout_fd);
+			break;
+
+		case CgiZygoteRequestCommand::KILL:
+			HandleKill(header.id, payload, length);
+			break;
+
+		default:
+			fprintf(stderr, "unknown command: %d\n",
+				int(header.command));
+			result = false;
+		}
+	}
+
+	if (stdout_fd >= 0)
+		close(stdout_fd);
+	if (stdin_fd >= 0)
+		close(stdin_fd);
+
+	return result;
+}
+
+static bool
+ReapChildren()
+{
+	int status;
+	pid_t pid;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		auto i = children.find(pid);
+		if (i == children.end())
+			continue;
+
+		const uint32_t id = i->second;
+		children.erase(i);
+
+		if (!SendResponse(id, CgiZygoteResponseCommand::EXIT, status))
+			return false;
+	}
+
+	return true;
+}
+
+int
+main(int, char **) noexcept
+{
+	sigset_t signal_mask;
+	sigemptyset(&signal_mask);
+	sigaddset(&signal_mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &signal_mask, nullptr);
+
+	const int signal_fd = signalfd(-1, &signal_mask, SFD_CLOEXEC);
+	if (signal_fd < 0) {
+		fprintf(stderr, "signalfd() failed: %s\n", strerror(errno));
+		return 2;
+	}
+
+	if (!SendResponse(0, CgiZygoteResponseCommand::READY, 0))
+		return 2;
+
+	while (true) {
+		struct pollfd pfds[] = {
+			{STDIN_FILENO, POLLIN, 0},
+			{signal_fd, POLLIN, 0},
+		};
+
+		if (poll(pfds, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+
+			fprintf(stderr, "poll() failed: %s\n",
+				strerror(errno));
+			break;
+		}
+
+		if (pfds[1].revents != 0) {
+			/* multiple SIGCHLD may be coalesced into one;
+			   ReapChildren() collects all of them */
+			struct signalfd_siginfo info;
+			if (read(signal_fd, &info, sizeof(info)) < 0) {
+				fprintf(stderr, "read() on signalfd failed: %s\n",
+					strerror(errno));
+				break;
+			}
+
+			if (!ReapChildren())
+				break;
+		}
+
+		if (pfds[0].revents != 0 && !HandleRequest())
+			break;
+	}
+
+	/* beng-proxy has gone away: don't leave orphans behind */
+	for (const auto &[pid, id] : children)
+		kill(pid, SIGTERM);
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The protocol between beng-proxy and the "cgi-zygote" helper
+ * process.  It is spoken over a SOCK_SEQPACKET socket (the helper's
+ * stdin); each datagram is one packet.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The maximum size of a request payload.
+ */
+static constexpr size_t CGI_ZYGOTE_MAX_PAYLOAD = 65536;
+
+enum class CgiZygoteRequestCommand : uint16_t {
+	/**
+	 * Fork and execute a program.  The payload consists of
+	 * #CgiZygoteSpawnPayload followed by null-terminated
+	 * arguments and then null-terminated environment variables.
+	 * The ancillary message contains the standard output pipe
+	 * and optionally the standard input pipe (in this order).
+	 */
+	SPAWN,
+
+	/**
+	 * Send a signal to a process.  The payload is an "int"
+	 * containing the signal number.
+	 */
+	KILL,
+};
+
+enum class CgiZygoteResponseCommand : uint16_t {
+	/**
+	 * The helper has started and is ready to accept requests.
+	 * The "id" is zero.
+	 */
+	READY,
+
+	/**
+	 * A process has exited (or could not be started).  The
+	 * payload is an "int" containing the waitpid() status.
+	 */
+	EXIT,
+};
+
+struct CgiZygoteRequestHeader {
+	/**
+	 * A number chosen by the client which identifies the
+	 * process.
+	 */
+	uint32_t id;
+
+	CgiZygoteRequestCommand command;
+
+	uint16_t reserved;
+};
+
+struct CgiZygoteSpawnPayload {
+	/**
+	 * The number of arguments; the remaining strings are
+	 * environment variables.
+	 */
+	uint16_t n_args;
+
+	uint16_t reserved;
+};
+
+struct CgiZygoteResponse {
+	uint32_t id;
+
+	CgiZygoteResponseCommand command;
+
+	uint16_t reserved;
+
+	int value;
+};
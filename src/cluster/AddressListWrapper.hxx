@@ -39,7 +39,7 @@
 
 /**
  * Wraps a std::span<const SocketAddress> in an interface for
- * PickFailover() and PickModulo().
+ * PickFailover(), PickModulo() and PickRendezvous().
  */
 class AddressListWrapper : public AddressList, public FailureManagerProxy {
 public:
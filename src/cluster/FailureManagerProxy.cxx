@@ -46,3 +46,10 @@ FailureManagerProxy::Check(const Expiry now, SocketAddress address,
 			   bool allow_fade) const noexcept {
 	return failure_manager.Check(now, address, allow_fade);
 }
+
+unsigned
+FailureManagerProxy::GetSlowStartWeight(const Expiry now,
+					SocketAddress address) const noexcept
+{
+	return failure_manager.GetSlowStartWeight(now, address);
+}
@@ -50,4 +50,8 @@ public:
 	[[gnu::pure]]
 	bool Check(const Expiry now, SocketAddress address,
 		   bool allow_fade) const noexcept;
+
+	[[gnu::pure]]
+	unsigned GetSlowStartWeight(const Expiry now,
+				    SocketAddress address) const noexcept;
 };
@@ -34,6 +34,7 @@
 
 #include "PickFailover.hxx"
 #include "PickModulo.hxx"
+#include "PickRendezvous.hxx"
 #include "StickyMode.hxx"
 #include "RoundRobinBalancer.cxx"
 #include "net/SocketAddress.hxx"
@@ -61,6 +62,14 @@ PickGeneric(Expiry now, StickyMode sticky_mode,
 	case StickyMode::SOURCE_IP:
 	case StickyMode::HOST:
 	case StickyMode::XHOST:
+		if (sticky_hash != 0)
+			return PickRendezvous(now, list,
+					      sticky_hash);
+
+		break;
+
+		/* these modes encode the member index in the sticky
+		   hash, so they rely on PickModulo() */
 	case StickyMode::SESSION_MODULO:
 	case StickyMode::COOKIE:
 	case StickyMode::JVM_ROUTE:
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "StickyHash.hxx"
+#include "util/Expiry.hxx"
+#include "util/FNVHash.hxx"
+
+#include <cstdint>
+#include <iterator>
+
+#include <assert.h>
+
+/**
+ * Calculate the rendezvous weight of one member for the given
+ * #sticky_hash_t.  Both hashes are combined and scrambled with the
+ * MurmurHash3 64 bit finalizer, so every bit of both inputs affects
+ * the result.
+ */
+constexpr uint64_t
+RendezvousWeight(sticky_hash_t sticky_hash, uint32_t member_hash) noexcept
+{
+	uint64_t x = (uint64_t(member_hash) << 32) | sticky_hash;
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/**
+ * Pick an address using rendezvous hashing ("highest random
+ * weight"): each member gets a weight calculated from the
+ * #sticky_hash_t and the member's address, and the member with the
+ * highest weight wins.  If that member is failed, the non-failed
+ * member with the next-highest weight is picked.
+ *
+ * Unlike PickModulo(), adding, removing or failing a member only
+ * reassigns the keys of that member; all other keys stay where they
+ * were.
+ */
+template<typename List>
+[[gnu::pure]]
+const auto &
+PickRendezvous(Expiry now, const List &list, sticky_hash_t sticky_hash) noexcept
+{
+	assert(std::size(list) >= 2);
+
+	const auto begin = std::begin(list), end = std::end(list);
+
+	const auto Weight = [sticky_hash](const auto &member) noexcept {
+		return RendezvousWeight(sticky_hash,
+					FNV1aHash32(member.GetSteadyPart()));
+	};
+
+	auto selected = begin;
+	uint64_t selected_weight = Weight(*selected);
+
+	for (auto i = std::next(begin); i != end; ++i) {
+		const uint64_t weight = Weight(*i);
+		if (weight > selected_weight) {
+			selected = i;
+			selected_weight = weight;
+		}
+	}
+
+	/* only the preferred member is allowed to override
+	   FAILURE_FADE */
+	if (list.Check(now, *selected, true))
+		return *selected;
+
+	auto fallback = end;
+	uint64_t fallback_weight = 0;
+
+	for (auto i = begin; i != end; ++i) {
+		if (i == selected)
+			continue;
+
+		const uint64_t weight = Weight(*i);
+		if ((fallback == end || weight > fallback_weight) &&
+		    list.Check(now, *i, false)) {
+			fallback = i;
+			fallback_weight = weight;
+		}
+	}
+
+	if (fallback == end)
+		/* all addresses failed: */
+		return *selected;
+
+	return *fallback;
+}
@@ -33,6 +33,7 @@
 #pragma once
 
 #include "RoundRobinBalancer.hxx"
+#include "net/FailureInfo.hxx"
 #include "util/Expiry.hxx"
 
 #include <cassert>
@@ -54,6 +55,19 @@ RoundRobinBalancer::Next(const List &list) noexcept
 	return address;
 }
 
+inline bool
+RoundRobinBalancer::AdmitSlowStart(unsigned weight) noexcept
+{
+	if (weight >= FailureInfo::SLOW_START_STEPS)
+		return true;
+
+	/* admit "weight" out of SLOW_START_STEPS turns */
+	if (++slow_start_counter >= FailureInfo::SLOW_START_STEPS)
+		slow_start_counter = 0;
+
+	return slow_start_counter < weight;
+}
+
 template<typename List>
 typename List::const_reference
 RoundRobinBalancer::Get(const Expiry now,
@@ -62,13 +76,25 @@ RoundRobinBalancer::Get(const Expiry now,
 {
 	const auto &first = Next(list);
 	const auto *ret = &first;
+	decltype(ret) warming = nullptr;
 	do {
-		if (list.Check(now, *ret, allow_fade))
-			return *ret;
+		if (list.Check(now, *ret, allow_fade)) {
+			if (AdmitSlowStart(list.GetSlowStartWeight(now, *ret)))
+				return *ret;
+
+			/* this member is in slow start and has to
+			   skip this turn */
+			if (warming == nullptr)
+				warming = ret;
+		}
 
 		ret = &Next(list);
 	} while (ret != &first);
 
+	if (warming != nullptr)
+		/* all good members are in slow start */
+		return *warming;
+
 	/* all addresses failed: */
 	return first;
 }
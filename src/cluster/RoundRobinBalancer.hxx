@@ -42,6 +42,12 @@ class RoundRobinBalancer final {
 	/** the index of the item that will be returned next */
 	unsigned next = 0;
 
+	/**
+	 * Counts the turns of members in slow start; used to admit
+	 * only a fraction of them.
+	 */
+	unsigned slow_start_counter = 0;
+
 public:
 	/**
 	 * Reset the state.  Call this after the list has been
@@ -58,4 +64,10 @@ public:
 private:
 	template<typename List>
 	typename List::const_reference Next(const List &list) noexcept;
+
+	/**
+	 * Decide whether a member with the given slow-start weight
+	 * (see FailureInfo::GetSlowStartWeight()) gets this turn.
+	 */
+	bool AdmitSlowStart(unsigned weight) noexcept;
 };
@@ -31,7 +31,10 @@
  */
 
 #include "Client.hxx"
+#include "StopwatchDump.hxx"
+#include "StopwatchRing.hxx"
 #include "translation/Protocol.hxx"
+#include "stats/LatencyHistogram.hxx"
 #include "io/UniqueFileDescriptor.hxx"
 #include "system/Error.hxx"
 #include "util/ByteOrder.hxx"
@@ -40,9 +43,11 @@
 #include "util/RuntimeError.hxx"
 #include "util/StringCompare.hxx"
 
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 struct Usage {
 	const char *msg = nullptr;
@@ -243,6 +248,43 @@ Stats(const char *server, ConstBuffer<const char *> args)
 	PrintStatsAttribute("io_buffers_brutto_size", stats.io_buffers_brutto_size);
 	PrintStatsAttribute("http_traffic_received", stats.http_traffic_received);
 	PrintStatsAttribute("http_traffic_sent", stats.http_traffic_sent);
+	PrintStatsAttribute("compress_slices", stats.compress_slices);
+	PrintStatsAttribute("compress_time", stats.compress_time);
+	PrintStatsAttribute("compress_max_pause", stats.compress_max_pause);
+	PrintStatsAttribute("filter_cache_hot_hits", stats.filter_cache_hot_hits);
+	PrintStatsAttribute("filter_cache_hits", stats.filter_cache_hits);
+	PrintStatsAttribute("filter_cache_misses", stats.filter_cache_misses);
+	PrintStatsAttribute("regex_cache_hits", stats.regex_cache_hits);
+	PrintStatsAttribute("regex_cache_misses", stats.regex_cache_misses);
+	PrintStatsAttribute("regex_compile_time", stats.regex_compile_time);
+	PrintStatsAttribute("regex_compile_time_saved", stats.regex_compile_time_saved);
+	PrintStatsAttribute("io_buffers_4k_size", stats.io_buffers_class_size[0]);
+	PrintStatsAttribute("io_buffers_16k_size", stats.io_buffers_class_size[1]);
+	PrintStatsAttribute("io_buffers_32k_size", stats.io_buffers_class_size[2]);
+	PrintStatsAttribute("io_buffers_64k_size", stats.io_buffers_class_size[3]);
+	PrintStatsAttribute("io_buffers_256k_size", stats.io_buffers_class_size[4]);
+
+	static constexpr const char *cgi_launchers[] = {"direct", "zygote"};
+	for (unsigned l = 0; l < 2; ++l) {
+		char name[64];
+		for (unsigned i = 0; i < LatencyHistogram::N_BUCKETS; ++i) {
+			if (i < LatencyHistogram::BOUNDS.size())
+				snprintf(name, sizeof(name),
+					 "cgi_spawn_latency_%s_le_%ums",
+					 cgi_launchers[l],
+					 unsigned(LatencyHistogram::BOUNDS[i].count()));
+			else
+				snprintf(name, sizeof(name),
+					 "cgi_spawn_latency_%s_inf",
+					 cgi_launchers[l]);
+
+			PrintStatsAttribute(name, stats.cgi_spawn_latency[l][i]);
+		}
+
+		snprintf(name, sizeof(name), "cgi_spawn_latency_%s_sum",
+			 cgi_launchers[l]);
+		PrintStatsAttribute(name, stats.cgi_spawn_latency_sum[l]);
+	}
 }
 
 static void
@@ -293,29 +335,52 @@ DiscardSession(const char *server, ConstBuffer<const char *> args)
 static void
 Stopwatch(const char *server, ConstBuffer<const char *> args)
 {
+	if (args.empty())
+		throw Usage{"File name missing"};
+
+	const char *path = args.shift();
+
+	uint32_t sample_rate = 1;
+	if (!args.empty())
+		sample_rate = strtoul(args.shift(), nullptr, 10);
+
+	if (sample_rate == 0)
+		throw Usage{"Invalid sample rate"};
+
 	if (!args.empty())
 		throw Usage{"Too many arguments"};
 
-	UniqueFileDescriptor r, w;
-	if (!UniqueFileDescriptor::CreatePipe(r, w))
-		throw MakeErrno("pipe() failed");
+	UniqueFileDescriptor fd;
+	if (!fd.Open(path, O_CREAT|O_TRUNC|O_RDWR, 0600))
+		throw FormatErrno("Failed to create %s", path);
+
+	/* room for 64k records */
+	static constexpr std::size_t size = sizeof(StopwatchRing::Header) +
+		65536 * sizeof(StopwatchRing::Record);
+	if (ftruncate(fd.Get(), size) < 0)
+		throw FormatErrno("Failed to resize %s", path);
+
+	FileDescriptor fds[] = { fd };
 
-	FileDescriptor fds[] = { w };
+	const uint32_t payload = ToBE32(sample_rate);
 
 	BengControlClient client(server);
-	client.Send(BengProxy::ControlCommand::STOPWATCH_PIPE, nullptr, fds);
+	client.Send(BengProxy::ControlCommand::STOPWATCH_RING,
+		    std::as_bytes(std::span{&payload, 1}), fds);
+}
 
-	w.Close();
+static void
+StopwatchDump(ConstBuffer<const char *> args)
+{
+	if (args.empty())
+		throw Usage{"File name missing"};
 
-	while (true) {
-		char buffer[8192];
-		ssize_t nbytes = r.Read(buffer, sizeof(buffer));
-		if (nbytes <= 0)
-			break;
+	const char *path = args.shift();
 
-		if (write(STDOUT_FILENO, buffer, nbytes) < 0)
-			break;
-	}
+	if (!args.empty())
+		throw Usage{"Too many arguments"};
+
+	StopwatchDump(path);
 }
 
 int
@@ -386,6 +451,9 @@ try {
 	} else if (StringIsEqual(command, "stopwatch")) {
 		Stopwatch(server, args);
 		return EXIT_SUCCESS;
+	} else if (StringIsEqual(command, "stopwatch-dump")) {
+		StopwatchDump(args);
+		return EXIT_SUCCESS;
 	} else
 		throw Usage{"Unknown command"};
 } catch (const Usage &u) {
@@ -407,7 +475,8 @@ try {
 		"  flush-nfs-cache\n"
 		"  flush-filter-cache [TAG]\n"
 		"  discard-session ATTACH_ID\n"
-		"  stopwatch\n"
+		"  stopwatch FILE [SAMPLE_RATE]\n"
+		"  stopwatch-dump FILE\n"
 		"\n"
 		"Names for tcache-invalidate:\n",
 		argv[0]);
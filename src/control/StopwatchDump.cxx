@@ -0,0 +1,274 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "StopwatchDump.hxx"
+#include "StopwatchRing.hxx"
+#include "io/Open.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/StringCompare.hxx"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using StopwatchRing::Record;
+
+enum class Phase {
+	TRANSLATION,
+	CONNECT,
+	BACKEND,
+	PROCESSOR,
+	SEND,
+	NONE,
+};
+
+static constexpr const char *phase_names[] = {
+	"translation",
+	"connect",
+	"backend",
+	"processor",
+	"send",
+};
+
+static constexpr std::size_t N_PHASES = std::size(phase_names);
+
+[[gnu::pure]]
+static Phase
+ClassifySpan(const Record &r) noexcept
+{
+	if (r.parent_id == 0)
+		/* the root span is the whole request */
+		return Phase::NONE;
+
+	const char *name = r.name;
+	if (StringStartsWith(name, "translate"))
+		return Phase::TRANSLATION;
+
+	if (StringIsEqual(name, "connect"))
+		return Phase::CONNECT;
+
+	if (StringIsEqual(name, "handler"))
+		return Phase::NONE;
+
+	if (StringStartsWith(name, "widget ") ||
+	    StringEndsWith(name, "Processor"))
+		return Phase::PROCESSOR;
+
+	return Phase::BACKEND;
+}
+
+[[gnu::pure]]
+static const StopwatchRing::Event *
+FindEvent(const Record &r, const char *name) noexcept
+{
+	for (std::size_t i = 0; i < r.n_events; ++i)
+		if (StringIsEqual(r.events[i].name, name))
+			return &r.events[i];
+
+	return nullptr;
+}
+
+static constexpr double
+ToMs(uint64_t us) noexcept
+{
+	return us / 1000.;
+}
+
+struct Trace {
+	std::vector<const Record *> spans;
+
+	const Record *FindRoot() const noexcept {
+		for (const auto *i : spans)
+			if (i->parent_id == 0)
+				return i;
+		return nullptr;
+	}
+
+	void Print(const Record &span, uint64_t root_start,
+		   unsigned indent) const noexcept {
+		printf("%*s%s init=%.3fms", indent, "", span.name,
+		       (span.start - root_start) / 1e6);
+
+		for (std::size_t i = 0; i < span.n_events; ++i)
+			printf(" %s=%.3fms", span.events[i].name,
+			       ToMs(span.events[i].time));
+
+		printf(" total=%.3fms\n", ToMs(span.duration));
+
+		for (const auto *i : spans)
+			if (i->parent_id == span.span_id)
+				Print(*i, root_start, indent + 2);
+	}
+
+	/**
+	 * Calculate the time spent in each phase [microseconds].
+	 */
+	std::array<uint64_t, N_PHASES> GetPhases() const noexcept {
+		std::array<uint64_t, N_PHASES> result{};
+
+		for (const auto *i : spans) {
+			const auto phase = ClassifySpan(*i);
+			if (phase == Phase::NONE)
+				continue;
+
+			uint64_t duration = i->duration;
+			if (phase == Phase::BACKEND) {
+				/* don't count the connect time twice */
+				for (const auto *j : spans)
+					if (j->parent_id == i->span_id &&
+					    ClassifySpan(*j) == Phase::CONNECT)
+						duration -= std::min<uint64_t>(duration, j->duration);
+			}
+
+			result[std::size_t(phase)] += duration;
+		}
+
+		if (const auto *root = FindRoot()) {
+			const auto *headers = FindEvent(*root, "response_headers");
+			const auto *end = FindEvent(*root, "response_end");
+			if (headers != nullptr && end != nullptr &&
+			    end->time >= headers->time)
+				result[std::size_t(Phase::SEND)] =
+					end->time - headers->time;
+		}
+
+		return result;
+	}
+};
+
+static void
+PrintPercentiles(const char *name, std::vector<uint64_t> &values) noexcept
+{
+	if (values.empty())
+		return;
+
+	std::sort(values.begin(), values.end());
+
+	const auto Percentile = [&values](unsigned p){
+		return values[(values.size() - 1) * p / 100];
+	};
+
+	printf("%-12s n=%zu p50=%.3fms p90=%.3fms p99=%.3fms max=%.3fms\n",
+	       name, values.size(),
+	       ToMs(Percentile(50)), ToMs(Percentile(90)),
+	       ToMs(Percentile(99)), ToMs(values.back()));
+}
+
+void
+StopwatchDump(const char *path)
+{
+	const auto fd = OpenReadOnly(path);
+
+	struct stat st;
+	if (fstat(fd.Get(), &st) < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	const std::size_t size = st.st_size;
+	if (size < sizeof(StopwatchRing::Header))
+		throw std::runtime_error("File is too small");
+
+	const void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+			     fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path);
+
+	const auto &header = *(const StopwatchRing::Header *)p;
+	if (!header.IsValid(size))
+		throw std::runtime_error("Not a valid stopwatch file");
+
+	/* copy all records which are still available */
+
+	const uint64_t head = header.LoadHead();
+	const uint64_t first = head > header.capacity
+		? head - header.capacity
+		: 0;
+
+	std::vector<Record> records;
+	records.reserve(head - first);
+
+	for (uint64_t position = first; position < head; ++position) {
+		Record r;
+		if (StopwatchRing::ReadRecord(header, position, r)) {
+			r.name[sizeof(r.name) - 1] = 0;
+			r.n_events = std::min<uint32_t>(r.n_events,
+							StopwatchRing::MAX_EVENTS);
+			for (std::size_t i = 0; i < r.n_events; ++i)
+				r.events[i].name[sizeof(r.events[i].name) - 1] = 0;
+
+			records.push_back(r);
+		}
+	}
+
+	munmap(const_cast<void *>(p), size);
+
+	/* group them by trace */
+
+	std::map<uint64_t, Trace> traces;
+	for (const auto &r : records)
+		traces[r.trace_id].spans.push_back(&r);
+
+	std::array<std::vector<uint64_t>, N_PHASES> phases;
+
+	for (auto &[trace_id, trace] : traces) {
+		std::sort(trace.spans.begin(), trace.spans.end(),
+			  [](const Record *a, const Record *b){
+				  return a->start < b->start;
+			  });
+
+		const auto *root = trace.FindRoot();
+		if (root == nullptr)
+			/* the root span has not finished yet or has
+			   already been overwritten; ignore this
+			   incomplete trace */
+			continue;
+
+		trace.Print(*root, root->start, 0);
+
+		const auto t = trace.GetPhases();
+		for (std::size_t i = 0; i < N_PHASES; ++i)
+			if (t[i] > 0)
+				phases[i].push_back(t[i]);
+	}
+
+	printf("\n");
+
+	for (std::size_t i = 0; i < N_PHASES; ++i)
+		PrintPercentiles(phase_names[i], phases[i]);
+}
@@ -33,191 +33,161 @@
 #include "Client.hxx"
 #include "Handler.hxx"
 #include "Protocol.hxx"
-#include "pool/LeakDetector.hxx"
-#include "event/SocketEvent.hxx"
 #include "net/SocketDescriptor.hxx"
 #include "net/SendMessage.hxx"
 #include "net/MsgHdr.hxx"
 #include "io/Iovec.hxx"
 #include "io/UniqueFileDescriptor.hxx"
 #include "system/Error.hxx"
-#include "util/Cancellable.hxx"
 #include "util/SpanCast.hxx"
-#include "lease.hxx"
-#include "AllocatorPtr.hxx"
 
 #include <stdexcept>
 
-#include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <sys/socket.h>
 
-struct DelegateClient final : PoolLeakDetector, Cancellable {
-	LeasePtr lease_ref;
-	const SocketDescriptor s;
-	SocketEvent event;
-
-	DelegateHandler &handler;
-
-	DelegateClient(EventLoop &event_loop, SocketDescriptor _s, Lease &lease,
-		       AllocatorPtr alloc,
-		       DelegateHandler &_handler) noexcept
-		:PoolLeakDetector(alloc),
-		 lease_ref(lease),
-		 s(_s), event(event_loop, BIND_THIS_METHOD(SocketEventCallback), s),
-		 handler(_handler)
-	{
-		event.ScheduleRead();
-	}
+DelegateClient::DelegateClient(EventLoop &event_loop, SocketDescriptor s,
+			       DelegateClientHandler &_handler) noexcept
+	:event(event_loop, BIND_THIS_METHOD(OnSocketReady), s),
+	 handler(_handler)
+{
+	/* always watch the socket, even while idle, to notice when
+	   the helper process exits */
+	event.ScheduleRead();
+}
 
-	void Destroy() noexcept {
-		this->~DelegateClient();
-	}
+DelegateClient::~DelegateClient() noexcept
+{
+	event.Cancel();
 
-	void ReleaseSocket(bool reuse) noexcept {
-		assert(s.IsDefined());
+	if (!requests.empty()) {
+		const auto error = std::make_exception_ptr(std::runtime_error("Delegate process disconnected"));
+		requests.clear_and_dispose([&error](Request *request){
+			auto *h = request->handler;
+			delete request;
+			if (h != nullptr)
+				h->OnDelegateError(error);
+		});
+	}
+}
 
-		/* the SocketEvent must be canceled before releasing its lease
-		   to avoid EBADFD from epoll_ctl() */
-		event.Cancel();
+void
+DelegateClient::Fail(std::exception_ptr error) noexcept
+{
+	event.Cancel();
 
-		lease_ref.Release(reuse);
-	}
+	requests.clear_and_dispose([&error](Request *request){
+		auto *h = request->handler;
+		delete request;
+		if (h != nullptr)
+			h->OnDelegateError(error);
+	});
 
-	void DestroyError(std::exception_ptr ep) noexcept {
-		ReleaseSocket(false);
+	handler.OnDelegateClientError(std::move(error));
+}
 
-		auto &_handler = handler;
-		Destroy();
-		_handler.OnDelegateError(ep);
-	}
+inline void
+DelegateClient::ReceiveResponse()
+{
+	const auto s = event.GetSocket();
 
-	void DestroyError(const char *msg) noexcept {
-		DestroyError(std::make_exception_ptr(std::runtime_error(msg)));
-	}
+	DelegateResponseHeader header;
+	auto iov = MakeIovecT(header);
+	int new_fd;
+	std::byte ccmsg[CMSG_SPACE(sizeof(new_fd))];
+	auto msg = MakeMsgHdr(nullptr, std::span{&iov, 1}, {ccmsg, sizeof(ccmsg)});
 
-	void HandleFd(const struct msghdr &msg, size_t length);
-	void HandleErrno(size_t length);
-	void HandleMsg(const struct msghdr &msg,
-		       DelegateResponseCommand command, size_t length);
-	void TryRead();
+	ssize_t nbytes = recvmsg(s.Get(), &msg,
+				 MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
+	if (nbytes < 0) {
+		if (errno == EAGAIN)
+			return;
 
-private:
-	void SocketEventCallback(unsigned) noexcept {
-		TryRead();
+		throw MakeErrno("recvmsg() failed");
 	}
 
-	/* virtual methods from class Cancellable */
-	void Cancel() noexcept override {
-		ReleaseSocket(false);
-		Destroy();
-	}
-};
+	if (nbytes == 0)
+		throw std::runtime_error("Delegate process closed the connection");
 
-inline void
-DelegateClient::HandleFd(const struct msghdr &msg, size_t length)
-{
-	if (length != 0) {
-		DestroyError("Invalid message length");
-		return;
+	/* take ownership of the passed file descriptor right away,
+	   so it does not leak if this response turns out to be
+	   malformed */
+	UniqueFileDescriptor fd;
+	if (const struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	    cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+	    cmsg->cmsg_type == SCM_RIGHTS) {
+		memcpy(&new_fd, CMSG_DATA(cmsg), sizeof(new_fd));
+		fd = UniqueFileDescriptor{new_fd};
 	}
 
-	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-	if (cmsg == nullptr) {
-		DestroyError("No fd passed");
-		return;
-	}
+	if ((size_t)nbytes != sizeof(header))
+		throw std::runtime_error("short recvmsg()");
 
-	if (cmsg->cmsg_type != SCM_RIGHTS) {
-		DestroyError("got control message of unknown type");
-		return;
-	}
+	if (requests.empty())
+		throw std::runtime_error("Unexpected data from delegate process");
 
-	ReleaseSocket(true);
+	std::exception_ptr error;
 
-	const void *data = CMSG_DATA(cmsg);
-	const int *fd_p = (const int *)data;
+	switch (header.command) {
+	case DelegateResponseCommand::FD:
+		if (header.length != 0)
+			throw std::runtime_error("Invalid message length");
 
-	auto &_handler = handler;
-	Destroy();
-	_handler.OnDelegateSuccess(UniqueFileDescriptor(*fd_p));
-}
+		if (!fd.IsDefined())
+			throw std::runtime_error("No fd passed");
 
-inline void
-DelegateClient::HandleErrno(size_t length)
-{
-	int e;
+		break;
 
-	if (length != sizeof(e)) {
-		DestroyError("Invalid message length");
-		return;
-	}
+	case DelegateResponseCommand::ERRNO:
+		/* i/o error */
+		{
+			int e;
+			if (header.length != sizeof(e))
+				throw std::runtime_error("Invalid message length");
 
-	ssize_t nbytes = recv(s.Get(), &e, sizeof(e), 0);
-	std::exception_ptr ep;
+			nbytes = recv(s.Get(), &e, sizeof(e), 0);
+			if (nbytes != sizeof(e))
+				throw std::runtime_error("Failed to receive errno");
 
-	if (nbytes == sizeof(e)) {
-		ReleaseSocket(true);
+			error = std::make_exception_ptr(MakeErrno(e, "Error from delegate"));
+		}
 
-		ep = std::make_exception_ptr(MakeErrno(e, "Error from delegate"));
-	} else {
-		ReleaseSocket(false);
+		break;
 
-		ep = std::make_exception_ptr(std::runtime_error("Failed to receive errno"));
+	default:
+		throw std::runtime_error("Invalid delegate response");
 	}
 
-	auto &_handler = handler;
-	Destroy();
-	_handler.OnDelegateError(ep);
-}
+	auto &request = requests.front();
+	requests.pop_front();
 
-inline void
-DelegateClient::HandleMsg(const struct msghdr &msg,
-			  DelegateResponseCommand command, size_t length)
-{
-	switch (command) {
-	case DelegateResponseCommand::FD:
-		HandleFd(msg, length);
-		return;
+	auto *h = request.handler;
+	delete &request;
 
-	case DelegateResponseCommand::ERRNO:
-		/* i/o error */
-		HandleErrno(length);
+	if (h == nullptr)
+		/* canceled */
 		return;
-	}
 
-	DestroyError("Invalid delegate response");
+	/* the handler may destroy this object; this method returns
+	   immediately, and further responses will be handled by the
+	   next event callback */
+	if (error)
+		h->OnDelegateError(std::move(error));
+	else
+		h->OnDelegateSuccess(std::move(fd));
 }
 
-inline void
-DelegateClient::TryRead()
+void
+DelegateClient::OnSocketReady(unsigned) noexcept
 {
-	DelegateResponseHeader header;
-	auto iov = MakeIovecT(header);
-	int new_fd;
-	std::byte ccmsg[CMSG_SPACE(sizeof(new_fd))];
-	auto msg = MakeMsgHdr(nullptr, std::span{&iov, 1}, {ccmsg, sizeof(ccmsg)});
-	ssize_t nbytes;
-
-	nbytes = recvmsg(s.Get(), &msg, MSG_CMSG_CLOEXEC);
-	if (nbytes < 0) {
-		DestroyError(std::make_exception_ptr(MakeErrno("recvmsg() failed")));
-		return;
-	}
-
-	if ((size_t)nbytes != sizeof(header)) {
-		DestroyError("short recvmsg()");
-		return;
+	try {
+		ReceiveResponse();
+	} catch (...) {
+		Fail(std::current_exception());
 	}
-
-	HandleMsg(msg, header.command, header.length);
 }
 
-/*
- * constructor
- *
- */
-
 static void
 SendDelegatePacket(SocketDescriptor s, DelegateRequestCommand cmd,
 		   std::span<const std::byte> payload)
@@ -236,21 +206,13 @@ SendDelegatePacket(SocketDescriptor s, DelegateRequestCommand cmd,
 }
 
 void
-delegate_open(EventLoop &event_loop, SocketDescriptor s, Lease &lease,
-	      AllocatorPtr alloc, const char *path,
-	      DelegateHandler &handler,
-	      CancellablePointer &cancel_ptr) noexcept
+DelegateClient::Open(const char *path, DelegateHandler &_handler,
+		     CancellablePointer &cancel_ptr)
 {
-	try {
-		SendDelegatePacket(s, DelegateRequestCommand::OPEN,
-				   AsBytes(path));
-	} catch (...) {
-		lease.ReleaseLease(false);
-		handler.OnDelegateError(std::current_exception());
-		return;
-	}
+	SendDelegatePacket(event.GetSocket(), DelegateRequestCommand::OPEN,
+			   AsBytes(path));
 
-	auto d = alloc.New<DelegateClient>(event_loop, s, lease, alloc,
-					   handler);
-	cancel_ptr = *d;
+	auto *request = new Request(_handler);
+	requests.push_back(*request);
+	cancel_ptr = *request;
 }
@@ -32,21 +32,98 @@
 
 #pragma once
 
-class EventLoop;
+#include "event/SocketEvent.hxx"
+#include "util/Cancellable.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <exception>
+
 class SocketDescriptor;
-class Lease;
-class AllocatorPtr;
-class CancellablePointer;
 class DelegateHandler;
 
+class DelegateClientHandler {
+public:
+	/**
+	 * The connection to the helper process has failed and must
+	 * not be used anymore.  All pending requests have already
+	 * been failed.
+	 */
+	virtual void OnDelegateClientError(std::exception_ptr error) noexcept = 0;
+};
+
 /**
- * Fork a process and delegate open() to it.  The subprocess returns
- * the file descriptor over a unix socket.
+ * A connection to a delegate helper process which opens files on our
+ * behalf and returns the file descriptors over a unix socket.
  *
- * @param fd the socket to the helper process
+ * Requests are pipelined: each request is sent right away, even if
+ * responses to earlier requests are still pending.  The helper
+ * handles them strictly in order, so each response belongs to the
+ * oldest pending request.
  */
-void
-delegate_open(EventLoop &event_loop, SocketDescriptor fd, Lease &lease,
-	      AllocatorPtr alloc, const char *path,
-	      DelegateHandler &handler,
-	      CancellablePointer &cancel_ptr) noexcept;
+class DelegateClient final {
+	class Request final : public IntrusiveListHook, public Cancellable {
+	public:
+		/**
+		 * The handler; nullptr if the request was canceled
+		 * (the response still needs to be consumed).
+		 */
+		DelegateHandler *handler;
+
+		explicit Request(DelegateHandler &_handler) noexcept
+			:handler(&_handler) {}
+
+		/* virtual methods from class Cancellable */
+		void Cancel() noexcept override {
+			handler = nullptr;
+		}
+	};
+
+	SocketEvent event;
+
+	DelegateClientHandler &handler;
+
+	IntrusiveList<Request> requests;
+
+public:
+	/**
+	 * @param s the socket to the helper process; it is owned by
+	 * the caller
+	 */
+	DelegateClient(EventLoop &event_loop, SocketDescriptor s,
+		       DelegateClientHandler &_handler) noexcept;
+
+	/**
+	 * Fails all pending requests.
+	 */
+	~DelegateClient() noexcept;
+
+	DelegateClient(const DelegateClient &) = delete;
+	DelegateClient &operator=(const DelegateClient &) = delete;
+
+	bool IsIdle() const noexcept {
+		return requests.empty();
+	}
+
+	/**
+	 * Ask the helper process to open a file.  The handler is
+	 * invoked asynchronously.
+	 *
+	 * Throws exception on error; the connection must not be
+	 * used after that.
+	 */
+	void Open(const char *path, DelegateHandler &handler,
+		  CancellablePointer &cancel_ptr);
+
+private:
+	void Fail(std::exception_ptr error) noexcept;
+
+	/**
+	 * Receive one response (if available) and dispatch it to the
+	 * oldest pending request.
+	 *
+	 * Throws exception on error.
+	 */
+	void ReceiveResponse();
+
+	void OnSocketReady(unsigned events) noexcept;
+};
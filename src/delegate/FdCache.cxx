@@ -0,0 +1,127 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FdCache.hxx"
+#include "event/Loop.hxx"
+#include "io/Reopen.hxx"
+
+#include <fcntl.h>
+
+static constexpr unsigned STATX_MASK =
+	STATX_TYPE|STATX_NLINK|STATX_SIZE|STATX_MTIME|STATX_CTIME;
+
+static std::string
+MakeKey(const char *delegate, const char *path) noexcept
+{
+	std::string key{delegate};
+
+	/* the null byte cannot occur in paths, so it's a safe
+	   separator */
+	key.push_back('\0');
+	key.append(path);
+	return key;
+}
+
+static constexpr bool
+operator==(const struct statx_timestamp &a,
+	   const struct statx_timestamp &b) noexcept
+{
+	return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+/**
+ * Does the (new) statx() result #b describe the same version of the
+ * file as #a?
+ */
+[[gnu::pure]]
+static bool
+IsSameVersion(const struct statx &a, const struct statx &b) noexcept
+{
+	return b.stx_nlink > 0 &&
+		a.stx_size == b.stx_size &&
+		a.stx_mtime == b.stx_mtime &&
+		a.stx_ctime == b.stx_ctime;
+}
+
+UniqueFileDescriptor
+DelegateFdCache::Get(const char *delegate, const char *path) noexcept
+{
+	const auto key = MakeKey(delegate, path);
+	auto *item = cache.Get(key);
+	if (item == nullptr)
+		return {};
+
+	const auto now = event_loop.SteadyNow();
+	if (now >= item->expires) {
+		cache.Remove(key);
+		return {};
+	}
+
+	if (now >= item->revalidate) {
+		struct statx st;
+		if (statx(item->fd.Get(), "", AT_EMPTY_PATH, STATX_MASK,
+			  &st) < 0 ||
+		    !IsSameVersion(item->st, st)) {
+			cache.Remove(key);
+			return {};
+		}
+
+		item->revalidate = now + FRESH;
+	}
+
+	/* not dup(), because the caller may use the file offset
+	   (e.g. a child process reading it as stdin); may be
+	   undefined if we're out of file descriptors, which is just a
+	   cache miss */
+	return ReopenReadOnly(item->fd);
+}
+
+void
+DelegateFdCache::Put(const char *delegate, const char *path,
+		     FileDescriptor fd) noexcept
+{
+	Item item;
+	if (statx(fd.Get(), "", AT_EMPTY_PATH, STATX_MASK, &item.st) < 0 ||
+	    !S_ISREG(item.st.stx_mode))
+		return;
+
+	/* this also verifies that the file can be reopened by this
+	   process; if not, caching it is pointless */
+	item.fd = ReopenReadOnly(fd);
+	if (!item.fd.IsDefined())
+		return;
+
+	const auto now = event_loop.SteadyNow();
+	item.revalidate = now + FRESH;
+	item.expires = now + MAX_AGE;
+	cache.PutOrReplace(MakeKey(delegate, path), std::move(item));
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "io/UniqueFileDescriptor.hxx"
+#include "util/Cache.hxx"
+
+#include <chrono>
+#include <string>
+
+#include <sys/stat.h>
+
+class EventLoop;
+
+/**
+ * Remembers file descriptors received from delegate helper
+ * processes, so repeated opens of the same file do not need a round
+ * trip to the helper.
+ *
+ * Entries younger than #FRESH are used as-is.  After that, each hit
+ * is revalidated with statx() on the cached file descriptor: if the
+ * file was deleted or modified, the entry is discarded.  A path
+ * which now refers to a different file (e.g. after a rename or a
+ * symlink swap) cannot be detected this way, therefore entries are
+ * discarded unconditionally after #MAX_AGE.
+ *
+ * Each hit reopens the cached file via /proc/self/fd, so every
+ * caller gets its own file offset.  Files which this process is not
+ * allowed to open by itself are therefore not cached.
+ */
+class DelegateFdCache {
+	/**
+	 * How long are cached entries used without revalidation?
+	 */
+	static constexpr std::chrono::steady_clock::duration FRESH =
+		std::chrono::seconds{1};
+
+	/**
+	 * The maximum age of a cached entry.
+	 */
+	static constexpr std::chrono::steady_clock::duration MAX_AGE =
+		std::chrono::seconds{10};
+
+	struct Item {
+		UniqueFileDescriptor fd;
+
+		/**
+		 * The statx() result at the time this item was
+		 * added; used for revalidation.
+		 */
+		struct statx st;
+
+		std::chrono::steady_clock::time_point revalidate, expires;
+	};
+
+	EventLoop &event_loop;
+
+	Cache<std::string, Item, 1024, 1021> cache;
+
+public:
+	explicit DelegateFdCache(EventLoop &_event_loop) noexcept
+		:event_loop(_event_loop) {}
+
+	/**
+	 * Look up a file.
+	 *
+	 * @param delegate identifies the delegate helper process
+	 * (program and #ChildOptions)
+	 * @return a new file descriptor with its own open file
+	 * description or an undefined object on cache miss
+	 */
+	UniqueFileDescriptor Get(const char *delegate,
+				 const char *path) noexcept;
+
+	/**
+	 * Add a file descriptor received from a delegate helper
+	 * process.  Only regular files which can be reopened are
+	 * cached.
+	 */
+	void Put(const char *delegate, const char *path,
+		 FileDescriptor fd) noexcept;
+};
@@ -32,22 +32,40 @@
 
 #include "Glue.hxx"
 #include "Client.hxx"
+#include "FdCache.hxx"
 #include "Handler.hxx"
 #include "Stock.hxx"
 #include "stock/Item.hxx"
 #include "stock/MapStock.hxx"
-#include "lease.hxx"
-#include "net/SocketDescriptor.hxx"
+#include "io/UniqueFileDescriptor.hxx"
 #include "AllocatorPtr.hxx"
 
-struct DelegateGlue final : Lease {
-	StockItem &item;
+/**
+ * Adds the file descriptor received from the helper process to the
+ * #DelegateFdCache before passing it on to the real handler.
+ */
+class DelegateCacheHandler final : public DelegateHandler {
+	DelegateFdCache &cache;
+
+	const char *const key;
+	const char *const path;
+
+	DelegateHandler &handler;
+
+public:
+	DelegateCacheHandler(DelegateFdCache &_cache,
+			     const char *_key, const char *_path,
+			     DelegateHandler &_handler) noexcept
+		:cache(_cache), key(_key), path(_path), handler(_handler) {}
 
-	explicit DelegateGlue(StockItem &_item):item(_item) {}
+	/* virtual methods from class DelegateHandler */
+	void OnDelegateSuccess(UniqueFileDescriptor fd) override {
+		cache.Put(key, path, fd);
+		handler.OnDelegateSuccess(std::move(fd));
+	}
 
-	/* virtual methods from class Lease */
-	void ReleaseLease(bool reuse) noexcept override {
-		item.Put(!reuse);
+	void OnDelegateError(std::exception_ptr ep) override {
+		handler.OnDelegateError(ep);
 	}
 };
 
@@ -59,6 +77,20 @@ delegate_stock_open(StockMap *stock, AllocatorPtr alloc,
 		    DelegateHandler &handler,
 		    CancellablePointer &cancel_ptr) noexcept
 {
+	DelegateHandler *h = &handler;
+
+	if (auto *cache = delegate_stock_get_fd_cache(*stock)) {
+		const char *key = delegate_stock_key(alloc, helper, options);
+		if (auto fd = cache->Get(key, path); fd.IsDefined()) {
+			handler.OnDelegateSuccess(std::move(fd));
+			return;
+		}
+
+		h = alloc.New<DelegateCacheHandler>(*cache, key,
+						    alloc.Dup(path),
+						    handler);
+	}
+
 	StockItem *item;
 
 	try {
@@ -68,8 +100,18 @@ delegate_stock_open(StockMap *stock, AllocatorPtr alloc,
 		return;
 	}
 
-	auto glue = alloc.New<DelegateGlue>(*item);
-	delegate_open(stock->GetEventLoop(), delegate_stock_item_get(*item), *glue,
-		      alloc, path,
-		      handler, cancel_ptr);
+	try {
+		delegate_stock_item_get(*item).Open(path, *h, cancel_ptr);
+	} catch (...) {
+		/* the connection is broken; this fails all other
+		   pending requests */
+		item->Put(true);
+		handler.OnDelegateError(std::current_exception());
+		return;
+	}
+
+	/* the item is returned to the stock right away; it can
+	   receive more (pipelined) requests while this one is still
+	   pending */
+	item->Put(false);
 }
@@ -143,7 +143,7 @@ main(int, char **) noexcept
 {
 	while (true) {
 		DelegateRequestHeader header;
-		ssize_t nbytes = recv(0, &header, sizeof(header), 0);
+		ssize_t nbytes = recv(0, &header, sizeof(header), MSG_WAITALL);
 		if (nbytes < 0) {
 			fprintf(stderr, "recv() on delegate socket failed: %s\n",
 				strerror(errno));
@@ -167,8 +167,11 @@ main(int, char **) noexcept
 		size_t length = 0;
 
 		while (length < header.length) {
+			/* read no more than this request's payload;
+			   the client may have pipelined more
+			   requests after it */
 			nbytes = recv(0, payload + length,
-				      sizeof(payload) - 1 - length, 0);
+				      header.length - length, 0);
 			if (nbytes < 0) {
 				fprintf(stderr, "recv() on delegate socket failed: %s\n",
 					strerror(errno));
@@ -31,12 +31,13 @@
  */
 
 #include "Stock.hxx"
+#include "Client.hxx"
+#include "FdCache.hxx"
 #include "stock/MapStock.hxx"
 #include "stock/Class.hxx"
 #include "stock/Item.hxx"
 #include "system/Error.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
-#include "event/SocketEvent.hxx"
 #include "spawn/Interface.hxx"
 #include "spawn/Prepared.hxx"
 #include "spawn/ChildOptions.hxx"
@@ -46,7 +47,8 @@
 #include "pool/tpool.hxx"
 #include "io/Logger.hxx"
 
-#include <unistd.h>
+#include <memory>
+
 #include <sys/socket.h>
 
 struct DelegateArgs {
@@ -71,14 +73,20 @@ struct DelegateArgs {
 	}
 };
 
-class DelegateProcess final : public StockItem {
+/**
+ * A delegate helper process.  It is never borrowed for longer than
+ * it takes to send a request: responses are received by the
+ * #DelegateClient, which allows many concurrent (pipelined) requests
+ * to share one process.
+ */
+class DelegateProcess final : public StockItem, DelegateClientHandler {
 	const LLogger logger;
 
 	std::unique_ptr<ChildProcessHandle> handle;
 
 	UniqueSocketDescriptor fd;
 
-	SocketEvent event;
+	DelegateClient client;
 
 public:
 	explicit DelegateProcess(CreateStockItem c,
@@ -88,44 +96,53 @@ public:
 		 logger(c.GetStockName()),
 		 handle(std::move(_handle)),
 		 fd(std::move(_fd)),
-		 event(c.stock.GetEventLoop(),
-		       BIND_THIS_METHOD(SocketEventCallback), fd)
+		 client(c.stock.GetEventLoop(), fd, *this)
 	{
 	}
 
-	SocketDescriptor GetSocket() const noexcept {
-		return fd;
+	DelegateClient &GetClient() noexcept {
+		return client;
 	}
 
 	/* virtual methods from class StockItem */
 	bool Borrow() noexcept override {
-		event.Cancel();
 		return true;
 	}
 
 	bool Release() noexcept override {
-		event.ScheduleRead();
 		return true;
 	}
 
 private:
-	void SocketEventCallback(unsigned events) noexcept;
+	/* virtual methods from class DelegateClientHandler */
+	void OnDelegateClientError(std::exception_ptr error) noexcept override;
 };
 
 class DelegateStock final : StockClass {
 	SpawnService &spawn_service;
 	StockMap stock;
 
+	std::unique_ptr<DelegateFdCache> fd_cache;
+
 public:
-	explicit DelegateStock(EventLoop &event_loop, SpawnService &_spawn_service)
+	explicit DelegateStock(EventLoop &event_loop, SpawnService &_spawn_service,
+			       bool enable_fd_cache)
 		:spawn_service(_spawn_service),
 		 stock(event_loop, *this, 0, 16,
-		       std::chrono::minutes(2)) {}
+		       std::chrono::minutes(2))
+	{
+		if (enable_fd_cache)
+			fd_cache = std::make_unique<DelegateFdCache>(event_loop);
+	}
 
 	StockMap &GetStock() {
 		return stock;
 	}
 
+	DelegateFdCache *GetFdCache() noexcept {
+		return fd_cache.get();
+	}
+
 private:
 	/* virtual methods from class StockClass */
 	void Create(CreateStockItem c, StockRequest request,
@@ -134,20 +151,17 @@ private:
 };
 
 /*
- * libevent callback
+ * DelegateClientHandler
  *
  */
 
-inline void
-DelegateProcess::SocketEventCallback(unsigned) noexcept
+void
+DelegateProcess::OnDelegateClientError(std::exception_ptr error) noexcept
 {
-	char buffer;
-	ssize_t nbytes = recv(fd.Get(), &buffer, sizeof(buffer), MSG_DONTWAIT);
-	if (nbytes < 0)
-		logger(2, "error on idle delegate process: ", strerror(errno));
-	else if (nbytes > 0)
-		logger(2, "unexpected data from idle delegate process");
+	logger(2, "delegate process failed: ", error);
 
+	/* the item is only borrowed while a request is being sent,
+	   and that never invokes this method */
 	InvokeIdleDisconnect();
 }
 
@@ -194,9 +208,10 @@ DelegateStock::Create(CreateStockItem c,
  */
 
 StockMap *
-delegate_stock_new(EventLoop &event_loop, SpawnService &spawn_service)
+delegate_stock_new(EventLoop &event_loop, SpawnService &spawn_service,
+		   bool fd_cache)
 {
-	auto *stock = new DelegateStock(event_loop, spawn_service);
+	auto *stock = new DelegateStock(event_loop, spawn_service, fd_cache);
 	return &stock->GetStock();
 }
 
@@ -207,6 +222,13 @@ delegate_stock_free(StockMap *_stock)
 	delete stock;
 }
 
+const char *
+delegate_stock_key(AllocatorPtr alloc, const char *helper,
+		   const ChildOptions &options)
+{
+	return DelegateArgs{helper, options}.GetStockKey(alloc);
+}
+
 StockItem *
 delegate_stock_get(StockMap *delegate_stock,
 		   const char *helper,
@@ -219,10 +241,17 @@ delegate_stock_get(StockMap *delegate_stock,
 	return delegate_stock->GetNow(key, std::move(r));
 }
 
-SocketDescriptor
+DelegateFdCache *
+delegate_stock_get_fd_cache(StockMap &_stock) noexcept
+{
+	auto &stock = (DelegateStock &)_stock.GetClass();
+	return stock.GetFdCache();
+}
+
+DelegateClient &
 delegate_stock_item_get(StockItem &item) noexcept
 {
-	auto *process = (DelegateProcess *)&item;
+	auto &process = (DelegateProcess &)item;
 
-	return process->GetSocket();
+	return process.GetClient();
 }
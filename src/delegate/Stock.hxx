@@ -36,15 +36,29 @@ struct ChildOptions;
 class StockMap;
 class EventLoop;
 class SpawnService;
-class SocketDescriptor;
 class StockItem;
+class AllocatorPtr;
+class DelegateClient;
+class DelegateFdCache;
 
+/**
+ * @param fd_cache enable the #DelegateFdCache?
+ */
 StockMap *
-delegate_stock_new(EventLoop &event_loop, SpawnService &spawn_service);
+delegate_stock_new(EventLoop &event_loop, SpawnService &spawn_service,
+		   bool fd_cache);
 
 void
 delegate_stock_free(StockMap *stock);
 
+/**
+ * Build a string which identifies the helper process for the given
+ * parameters (for use with #DelegateFdCache).
+ */
+const char *
+delegate_stock_key(AllocatorPtr alloc, const char *helper,
+		   const ChildOptions &options);
+
 /**
  * Throws exception on error.
  */
@@ -53,5 +67,11 @@ delegate_stock_get(StockMap *delegate_stock,
 		   const char *path,
 		   const ChildOptions &options);
 
-SocketDescriptor
+/**
+ * @return the file descriptor cache or nullptr if it is disabled
+ */
+DelegateFdCache *
+delegate_stock_get_fd_cache(StockMap &stock) noexcept;
+
+DelegateClient &
 delegate_stock_item_get(StockItem &item) noexcept;
@@ -31,6 +31,7 @@
  */
 
 #include "fcache.hxx"
+#include "FilterHotCache.hxx"
 #include "cache.hxx"
 #include "strmap.hxx"
 #include "http/ResponseHandler.hxx"
@@ -41,12 +42,15 @@
 #include "istream/istream_null.hxx"
 #include "istream/TeeIstream.hxx"
 #include "istream/RefIstream.hxx"
+#include "istream/istream_memory.hxx"
 #include "istream_unlock.hxx"
 #include "memory/istream_rubber.hxx"
 #include "memory/Rubber.hxx"
+#include "memory/RubberCompressor.hxx"
 #include "memory/sink_rubber.hxx"
 #include "memory/SlicePool.hxx"
 #include "stats/AllocatorStats.hxx"
+#include "stats/CacheStats.hxx"
 #include "pool/pool.hxx"
 #include "pool/Ptr.hxx"
 #include "pool/Holder.hxx"
@@ -63,6 +67,7 @@
 
 #include <boost/intrusive/list.hpp>
 
+#include <algorithm>
 #include <unordered_map>
 
 #include <stdio.h>
@@ -124,21 +129,38 @@ struct FilterCacheItem final : PoolHolder, CacheItem, LeakDetector {
 
 	const RubberAllocation body;
 
+	/**
+	 * A copy of the #CacheItem expiry, for FilterHotCache.
+	 */
+	const std::chrono::system_clock::time_point expires;
+
+	/**
+	 * The hot tier which may hold a copy of this item; the copy
+	 * is removed together with this item.
+	 */
+	FilterHotCache &hot;
+
 	FilterCacheItem(PoolPtr &&_pool,
 			std::chrono::steady_clock::time_point now,
 			std::chrono::system_clock::time_point system_now,
 			http_status_t _status, const StringMap &_headers,
 			size_t _size, RubberAllocation &&_body,
-			std::chrono::system_clock::time_point _expires) noexcept
+			std::chrono::system_clock::time_point _expires,
+			FilterHotCache &_hot) noexcept
 		:PoolHolder(std::move(_pool)),
 		 CacheItem(now, system_now, _expires, pool_netto_size(pool) + _size),
 		 status(_status), headers(pool, _headers),
-		 size(_size), body(std::move(_body)) {
+		 size(_size), body(std::move(_body)),
+		 expires(_expires), hot(_hot) {
 	}
 
 	using PoolHolder::GetPool;
 
 	/* virtual methods from class CacheItem */
+	void OnRemoved() noexcept override {
+		hot.Remove(GetKey(), FilterHotCache::Hash(GetKey()));
+	}
+
 	void Destroy() noexcept override {
 		pool_trash(pool);
 		this->~FilterCacheItem();
@@ -239,8 +261,16 @@ class FilterCache final : LeakDetector {
 	PoolPtr pool;
 	SlicePool slice_pool;
 	Rubber rubber;
+	RubberCompressor rubber_compressor;
 	Cache cache;
 
+	/**
+	 * The front tier for the most popular small objects.
+	 */
+	FilterHotCache hot;
+
+	CacheStats stats;
+
 	using PerTagHook =
 		boost::intrusive::member_hook<FilterCacheItem,
 					      FilterCacheItem::PerTagHook,
@@ -285,10 +315,20 @@ public:
 	}
 
 	AllocatorStats GetStats() const noexcept {
-		return slice_pool.GetStats() + rubber.GetStats();
+		return slice_pool.GetStats() + rubber.GetStats() +
+			AllocatorStats{hot.GetSize(), hot.GetSize()};
+	}
+
+	const CacheStats &GetCacheStats() const noexcept {
+		return stats;
+	}
+
+	const CompressStats &GetCompressStats() const noexcept {
+		return rubber_compressor.GetStats();
 	}
 
 	void Flush() noexcept {
+		hot.Clear();
 		cache.Flush();
 		Compress();
 	}
@@ -323,17 +363,23 @@ private:
 		   struct pool &caller_pool,
 		   HttpResponseHandler &handler) noexcept;
 
-	void Hit(FilterCacheItem &item,
+	void Hit(FilterCacheItem &item, const FilterCacheInfo &info,
+		 std::size_t hash,
 		 struct pool &caller_pool,
 		 HttpResponseHandler &handler) noexcept;
 
+	void HotHit(FilterHotCache::Item &item,
+		    struct pool &caller_pool,
+		    HttpResponseHandler &handler) noexcept;
+
 	void Compress() noexcept {
 		rubber.Compress();
 		slice_pool.Compress();
 	}
 
 	void OnCompressTimer() noexcept {
-		Compress();
+		slice_pool.Compress();
+		rubber_compressor.Start();
 		compress_timer.Schedule(fcache_compress_interval);
 	}
 };
@@ -407,11 +453,13 @@ FilterCache::Put(const FilterCacheInfo &info,
 						 cache.SystemNow(),
 						 status, headers, size,
 						 std::move(a),
-						 expires);
+						 expires, hot);
 
 	if (info.tag != nullptr)
 		per_tag[info.tag].push_back(*item);
 
+	/* this removes the old version (if any) and its copy in the
+	   hot tier */
 	cache.Put(p_strdup(item->GetPool(), info.key), *item);
 }
 
@@ -656,10 +704,14 @@ FilterCache::FilterCache(struct pool &_pool, size_t max_size,
 	:pool(pool_new_dummy(&_pool, "filter_cache")),
 	 slice_pool(1024, 65536, "filter_cache_meta"),
 	 rubber(max_size, "filter_cache_data"),
+	 rubber_compressor(_event_loop, rubber),
 	 /* leave 12.5% of the rubber allocator empty, to increase the
 	    chances that a hole can be found for a new allocation, to
 	    reduce the pressure that rubber_compress() creates */
 	 cache(_event_loop, 65521, max_size * 7 / 8),
+	 /* the hot tier gets 1/32 of the size, but no more than
+	    16 MB */
+	 hot(pool, std::min<size_t>(max_size / 32, 16 * 1024 * 1024)),
 	 compress_timer(_event_loop, BIND_THIS_METHOD(OnCompressTimer)),
 	 resource_loader(_resource_loader) {
 	compress_timer.Schedule(fcache_compress_interval);
@@ -699,6 +751,18 @@ filter_cache_get_stats(const FilterCache &cache) noexcept
 	return cache.GetStats();
 }
 
+const CompressStats &
+filter_cache_get_compress_stats(const FilterCache &cache) noexcept
+{
+	return cache.GetCompressStats();
+}
+
+const CacheStats &
+filter_cache_get_cache_stats(const FilterCache &cache) noexcept
+{
+	return cache.GetCacheStats();
+}
+
 void
 filter_cache_flush(FilterCache &cache) noexcept
 {
@@ -708,6 +772,8 @@ filter_cache_flush(FilterCache &cache) noexcept
 void
 FilterCache::FlushTag(const std::string &tag) noexcept
 {
+	hot.FlushTag(tag);
+
 	auto i = per_tag.find(tag);
 	if (i == per_tag.end())
 		return;
@@ -774,13 +840,48 @@ FilterCache::Serve(FilterCacheItem &item,
 }
 
 void
-FilterCache::Hit(FilterCacheItem &item,
+FilterCache::Hit(FilterCacheItem &item, const FilterCacheInfo &info,
+		 std::size_t hash,
 		 struct pool &caller_pool,
 		 HttpResponseHandler &handler) noexcept
 {
+	if (item.size <= FilterHotCache::MAX_OBJECT_SIZE) {
+		const std::span<const std::byte> body = item.body
+			? std::span{(const std::byte *)rubber.Read(item.body.GetId()), item.size}
+			: std::span<const std::byte>{};
+
+		/* convert the system_clock expiry to steady_clock */
+		const auto expires = cache.SteadyNow() +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(item.expires - cache.SystemNow());
+
+		hot.Offer(info.key, hash, info.tag, expires,
+			  item.status, item.headers, body);
+	}
+
 	Serve(item, caller_pool, handler);
 }
 
+void
+FilterCache::HotHit(FilterHotCache::Item &item,
+		    struct pool &caller_pool,
+		    HttpResponseHandler &handler) noexcept
+{
+	LogConcat(4, "FilterCache", "hot ", item.key);
+
+	/* the body is a contiguous buffer; the RefIstream keeps the
+	   item's pool alive even if the item gets evicted while the
+	   response is being sent */
+	auto response_body = item.body.empty()
+		? istream_null_new(caller_pool)
+		: istream_memory_new(caller_pool, item.body);
+	response_body = NewRefIstream(item.GetPool(),
+				      std::move(response_body));
+
+	handler.InvokeResponse(item.status,
+			       StringMap(ShallowCopy(), caller_pool, item.headers),
+			       std::move(response_body));
+}
+
 void
 FilterCache::Get(struct pool &caller_pool,
 		 const StopwatchPtr &parent_stopwatch,
@@ -795,18 +896,31 @@ FilterCache::Get(struct pool &caller_pool,
 	auto *info = filter_cache_request_evaluate(caller_pool, cache_tag, address,
 						   source_id, headers);
 	if (info != nullptr) {
+		const std::size_t hash = FilterHotCache::Hash(info->key);
+		hot.Touch(hash);
+
+		if (auto *hot_item = hot.Get(info->key, hash,
+					     cache.SteadyNow())) {
+			++stats.hot_hits;
+			body.Clear();
+			HotHit(*hot_item, caller_pool, handler);
+			return;
+		}
+
 		FilterCacheItem *item
 			= (FilterCacheItem *)cache.Get(info->key);
 
-		if (item == nullptr)
+		if (item == nullptr) {
+			++stats.misses;
 			Miss(caller_pool, parent_stopwatch,
 			     std::move(*info),
 			     address, status, std::move(headers),
 			     std::move(body), source_id,
 			     handler, cancel_ptr);
-		else {
+		} else {
+			++stats.hits;
 			body.Clear();
-			Hit(*item, caller_pool, handler);
+			Hit(*item, *info, hash, caller_pool, handler);
 		}
 	} else {
 		resource_loader.SendRequest(caller_pool, parent_stopwatch,
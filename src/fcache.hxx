@@ -45,6 +45,8 @@ struct ResourceAddress;
 class StringMap;
 class HttpResponseHandler;
 struct AllocatorStats;
+struct CompressStats;
+struct CacheStats;
 class FilterCache;
 class CancellablePointer;
 
@@ -66,6 +68,14 @@ filter_cache_fork_cow(FilterCache &cache, bool inherit) noexcept;
 AllocatorStats
 filter_cache_get_stats(const FilterCache &cache) noexcept;
 
+[[gnu::pure]]
+const CompressStats &
+filter_cache_get_compress_stats(const FilterCache &cache) noexcept;
+
+[[gnu::pure]]
+const CacheStats &
+filter_cache_get_cache_stats(const FilterCache &cache) noexcept;
+
 void
 filter_cache_flush(FilterCache &cache) noexcept;
 
@@ -47,6 +47,7 @@
 #ifdef HAVE_URING
 #include "io/uring/Handler.hxx"
 #include "io/uring/OpenStat.hxx"
+#include "io/UringOpen.hxx"
 #include "util/Cancellable.hxx"
 #include <memory>
 #endif
@@ -57,7 +58,9 @@
 
 #ifdef HAVE_URING
 
-class UringStaticFileGet final : Uring::OpenStatHandler, Cancellable {
+class UringStaticFileGet final
+	: Uring::OpenStatHandler, UringOpenHandler, Cancellable
+{
 	struct pool &pool;
 	EventLoop &event_loop;
 
@@ -68,27 +71,33 @@ class UringStaticFileGet final : Uring::OpenStatHandler, Cancellable {
 
 	std::unique_ptr<Uring::OpenStat> open_stat;
 
+	/**
+	 * Cancels opening the #base directory.
+	 */
+	CancellablePointer open_base_cancel_ptr;
+
 	HttpResponseHandler &handler;
 
 public:
 	UringStaticFileGet(EventLoop &_event_loop, Uring::Queue &uring,
 			   struct pool &_pool,
-			   UniqueFileDescriptor &&_base,
 			   const char *_path,
 			   const char *_content_type,
 			   HttpResponseHandler &_handler) noexcept
 		:pool(_pool), event_loop(_event_loop),
-		 base(std::move(_base)), // TODO: use io_uring to open it
 		 path(_path),
 		 content_type(_content_type),
 		 open_stat(new Uring::OpenStat(uring, *this)),
 		 handler(_handler) {}
 
-	void Start(CancellablePointer &cancel_ptr) noexcept {
+	void Start(const char *base_path,
+		   CancellablePointer &cancel_ptr) noexcept {
 		cancel_ptr = *this;
 
-		if (base.IsDefined())
-			open_stat->StartOpenStatReadOnlyBeneath(base, path);
+		if (base_path != nullptr)
+			UringOpen(open_stat->GetQueue(),
+				  FileDescriptor(AT_FDCWD), base_path, O_PATH,
+				  *this, open_base_cancel_ptr);
 		else
 			open_stat->StartOpenStatReadOnly(path);
 	}
@@ -100,6 +109,14 @@ private:
 
 	/* virtual methods from class Cancellable */
 	void Cancel() noexcept override {
+		if (open_base_cancel_ptr) {
+			/* the Uring::OpenStat has not been started
+			   yet */
+			open_base_cancel_ptr.Cancel();
+			Destroy();
+			return;
+		}
+
 		/* keep the Uring::OpenStat allocated until the kernel
 		   finishes the operation, or else the kernel may
 		   overwrite the memory when something else occupies
@@ -120,6 +137,18 @@ private:
 		Destroy();
 		_handler.InvokeError(std::move(e));
 	}
+
+	/* virtual methods from class UringOpenHandler */
+	void OnUringOpen(UniqueFileDescriptor fd) noexcept override {
+		open_base_cancel_ptr = nullptr;
+		base = std::move(fd);
+		open_stat->StartOpenStatReadOnlyBeneath(base, path);
+	}
+
+	void OnUringOpenError(std::exception_ptr e) noexcept override {
+		open_base_cancel_ptr = nullptr;
+		OnOpenStatError(std::move(e));
+	}
 };
 
 void
@@ -170,31 +199,30 @@ static_file_get(EventLoop &event_loop,
 {
 	assert(path != nullptr);
 
-	UniqueFileDescriptor base;
-
-	if (_base != nullptr) {
-		try {
-			base = OpenPath(_base);
-		} catch (...) {
-			handler.InvokeError(std::current_exception());
-			return;
-		}
-	}
-
 #ifdef HAVE_URING
 	if (uring != nullptr) {
 		auto *o = NewFromPool<UringStaticFileGet>(pool, event_loop,
 							  *uring, pool,
-							  std::move(base),
 							  path, content_type,
 							  handler);
-		o->Start(cancel_ptr);
+		o->Start(_base, cancel_ptr);
 		return;
 	}
 #else
 	(void)cancel_ptr;
 #endif
 
+	UniqueFileDescriptor base;
+
+	if (_base != nullptr) {
+		try {
+			base = OpenPath(_base);
+		} catch (...) {
+			handler.InvokeError(std::current_exception());
+			return;
+		}
+	}
+
 	UniqueFileDescriptor fd;
 	struct statx st;
 
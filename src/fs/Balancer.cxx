@@ -96,6 +96,12 @@ inline void
 FilteredSocketBalancer::Request::Send(AllocatorPtr alloc, SocketAddress address,
 				      CancellablePointer &cancel_ptr) noexcept
 {
+	auto &base = BR::Cast(*this);
+	if (handler.OnFilteredSocketPick(address, base.GetFailureInfo())) {
+		base.Destroy();
+		return;
+	}
+
 	stock.Get(alloc,
 		  StopwatchPtr(parent_stopwatch, "connect"),
 		  nullptr, fairness_hash,
@@ -32,13 +32,30 @@
 
 #pragma once
 
+#include "net/SocketAddress.hxx"
+
+#include <exception>
+
 class Lease;
 class FilteredSocket;
-class SocketAddress;
 class ReferencedFailureInfo;
 
 class FilteredSocketBalancerHandler {
 public:
+	/**
+	 * The balancer has picked a member (identified by its address
+	 * and its #FailureInfo) and is about to obtain a connection
+	 * to it.  The handler may instead send its request on a
+	 * connection it already has (e.g. HTTP pipelining).
+	 *
+	 * @return true if the handler has done so; the balancer will
+	 * not invoke it again
+	 */
+	virtual bool OnFilteredSocketPick(SocketAddress,
+					  ReferencedFailureInfo &) noexcept {
+		return false;
+	}
+
 	virtual void OnFilteredSocketReady(Lease &lease,
 					   FilteredSocket &socket,
 					   SocketAddress address,
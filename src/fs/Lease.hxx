@@ -133,6 +133,12 @@ public:
 		socket->ScheduleRead();
 	}
 
+	void DeferRead() noexcept {
+		assert(!IsReleased());
+
+		socket->DeferRead();
+	}
+
 	ssize_t Write(std::span<const std::byte>  src) noexcept {
 		assert(!IsReleased());
 
@@ -32,16 +32,19 @@
 
 #include "Stock.hxx"
 #include "Key.hxx"
+#include "Warmer.hxx"
 #include "Connect.hxx"
 #include "FilteredSocket.hxx"
 #include "AllocatorPtr.hxx"
 #include "pool/DisposablePointer.hxx"
 #include "stock/Stock.hxx"
 #include "stock/GetHandler.hxx"
+#include "stock/Stats.hxx"
 #include "stock/LoggerDomain.hxx"
 #include "event/CoarseTimerEvent.hxx"
 #include "net/SocketAddress.hxx"
 #include "net/AllocatedSocketAddress.hxx"
+#include "net/KeepAlive.hxx"
 #include "io/Logger.hxx"
 #include "util/Cancellable.hxx"
 #include "util/RuntimeError.hxx"
@@ -127,6 +130,11 @@ public:
 		 idle_timer(c.stock.GetEventLoop(),
 			    BIND_THIS_METHOD(OnIdleTimeout))
 	{
+		EnableIdleKeepAlive(socket->GetSocket());
+
+		/* the socket's handler may still point to the
+		   connect operation which has just finished */
+		ScheduleIdle();
 	}
 
 	~FilteredSocketStockConnection() override {
@@ -160,6 +168,18 @@ public:
 	}
 
 private:
+	/**
+	 * Watch the idle socket for hangups and schedule the idle
+	 * timeout.
+	 */
+	void ScheduleIdle() noexcept {
+		socket->Reinit(Event::Duration(-1), *this);
+		socket->UnscheduleWrite();
+
+		socket->ScheduleRead();
+		idle_timer.Schedule(std::chrono::minutes(1));
+	}
+
 	void OnIdleTimeout() noexcept {
 		InvokeIdleDisconnect();
 	}
@@ -247,6 +267,7 @@ FilteredSocketStockConnection::OnConnectFilteredSocket(std::unique_ptr<FilteredS
 
 	socket = std::move(_socket);
 	socket->Reinit(Event::Duration(-1), *this);
+	EnableIdleKeepAlive(socket->GetSocket());
 
 	InvokeCreateSuccess(*handler);
 }
@@ -306,12 +327,7 @@ FilteredSocketStockConnection::Release() noexcept
 		return false;
 	}
 
-	socket->Reinit(Event::Duration(-1), *this);
-	socket->UnscheduleWrite();
-
-	socket->ScheduleRead();
-	idle_timer.Schedule(std::chrono::minutes(1));
-
+	ScheduleIdle();
 	return true;
 }
 
@@ -320,6 +336,13 @@ FilteredSocketStockConnection::Release() noexcept
  *
  */
 
+FilteredSocketStock::FilteredSocketStock(EventLoop &event_loop,
+					 unsigned limit) noexcept
+	:stock(event_loop, *this, limit, 16,
+	       std::chrono::minutes(5)) {}
+
+FilteredSocketStock::~FilteredSocketStock() noexcept = default;
+
 void
 FilteredSocketStock::Get(AllocatorPtr alloc,
 			 StopwatchPtr stopwatch,
@@ -348,6 +371,12 @@ FilteredSocketStock::Get(AllocatorPtr alloc,
 
 	const char *key = key_buffer;
 
+	if (!warmers.empty()) {
+		if (auto i = warmers.find(std::string_view{key});
+		    i != warmers.end())
+			i->second->OnRequest(GetIdleCount(key));
+	}
+
 	auto request =
 		NewDisposablePointer<FilteredSocketStockRequest>(alloc,
 								 std::move(stopwatch),
@@ -373,6 +402,47 @@ FilteredSocketStock::Add(const char *key, SocketAddress address,
 	_stock.InjectIdle(*connection);
 }
 
+unsigned
+FilteredSocketStock::GetIdleCount(const char *key) noexcept
+{
+	StockStats stats{};
+	stock.GetStock(key, nullptr).AddStats(stats);
+	return stats.idle;
+}
+
+void
+FilteredSocketStock::Warm(SocketAddress address,
+			  ReferencedFailureInfo &failure,
+			  unsigned min_idle) noexcept
+{
+	assert(!address.IsNull());
+	assert(min_idle > 0);
+
+	char key_buffer[1024];
+	try {
+		StringBuilder b(key_buffer);
+		MakeFilteredSocketStockKey(b, nullptr,
+					   SocketAddress::Null(), address,
+					   nullptr);
+	} catch (StringBuilder::Overflow) {
+		/* shouldn't happen */
+		return;
+	}
+
+	std::string key{key_buffer};
+	if (auto i = warmers.find(key); i != warmers.end()) {
+		i->second->RaiseMinIdle(min_idle);
+		return;
+	}
+
+	auto warmer = std::make_unique<FilteredSocketStockWarmer>(*this,
+								  address,
+								  std::string{key},
+								  failure,
+								  min_idle);
+	warmers.emplace(std::move(key), std::move(warmer));
+}
+
 FilteredSocket &
 fs_stock_item_get(StockItem &item)
 {
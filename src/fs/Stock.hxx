@@ -39,6 +39,10 @@
 #include "stock/Class.hxx"
 #include "stock/MapStock.hxx"
 
+#include <map>
+#include <memory>
+#include <string>
+
 class StockItem;
 class StockGetHandler;
 class CancellablePointer;
@@ -48,6 +52,8 @@ class EventLoop;
 class SocketAddress;
 class StopwatchPtr;
 class AllocatorPtr;
+class FilteredSocketStockWarmer;
+class ReferencedFailureInfo;
 
 /**
  * A stock for TCP connections wrapped with #FilteredSocket.
@@ -55,13 +61,19 @@ class AllocatorPtr;
 class FilteredSocketStock final : StockClass {
 	StockMap stock;
 
+	/**
+	 * Addresses for which idle connections are kept ready; see
+	 * Warm().
+	 */
+	std::map<std::string, std::unique_ptr<FilteredSocketStockWarmer>,
+		 std::less<>> warmers;
+
 public:
 	/**
 	 * @param limit the maximum number of connections per host
 	 */
-	FilteredSocketStock(EventLoop &event_loop, unsigned limit) noexcept
-		:stock(event_loop, *this, limit, 16,
-		       std::chrono::minutes(5)) {}
+	FilteredSocketStock(EventLoop &event_loop, unsigned limit) noexcept;
+	~FilteredSocketStock() noexcept;
 
 	EventLoop &GetEventLoop() noexcept {
 		return stock.GetEventLoop();
@@ -105,6 +117,25 @@ public:
 	void Add(const char *key, SocketAddress address,
 		 std::unique_ptr<FilteredSocket> socket) noexcept;
 
+	/**
+	 * Keep idle connections to the given address ready, creating
+	 * them in the background (see #FilteredSocketStockWarmer).
+	 * This applies only to plain connections without bind
+	 * address and socket filter.
+	 *
+	 * @param failure the #FailureInfo of the address; no
+	 * connections are created while it is failing, and connect
+	 * failures are reported to it
+	 * @param min_idle the minimum number of idle connections
+	 */
+	void Warm(SocketAddress address, ReferencedFailureInfo &failure,
+		  unsigned min_idle) noexcept;
+
+	/**
+	 * Returns the number of idle connections with the given key.
+	 */
+	unsigned GetIdleCount(const char *key) noexcept;
+
 private:
 	/* virtual methods from class StockClass */
 	void Create(CreateStockItem c, StockRequest request,
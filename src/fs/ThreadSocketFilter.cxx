@@ -130,7 +130,10 @@ ThreadSocketFilter::SubmitDecryptedInput() noexcept
 			return true;
 
 		case BufferedResult::MORE:
-			if (unprotected_decrypted_input.IsDefinedAndFull()) {
+			/* if the handler needs more data than fits
+			   into the buffer, try a larger one */
+			if (unprotected_decrypted_input.IsDefinedAndFull() &&
+			    !unprotected_decrypted_input.Grow()) {
 				socket->InvokeError(std::make_exception_ptr(SocketBufferFullError{}));
 				return false;
 			}
@@ -217,8 +220,8 @@ ThreadSocketFilter::PreRun() noexcept
 {
 	{
 		const std::scoped_lock lock{mutex};
-		decrypted_input.AllocateIfNull(fb_pool_get());
-		encrypted_output.AllocateIfNull(fb_pool_get());
+		decrypted_input.AllocateIfNull();
+		encrypted_output.AllocateIfNull();
 	}
 
 	handler->PreRun(*this);
@@ -513,7 +516,7 @@ ThreadSocketFilter::LockWritePlainOutput(std::span<const std::byte> src) noexcep
 {
 	const std::scoped_lock lock{mutex};
 
-	plain_output.AllocateIfNull(fb_pool_get());
+	plain_output.AllocateIfNull();
 	return plain_output.MoveFrom(src);
 }
 
@@ -584,13 +587,15 @@ ThreadSocketFilter::InternalWrite() noexcept
 		return true;
 	}
 
-	/* copy to stack, unlock */
-	assert(r.size() <= FB_SIZE);
+	/* copy to stack, unlock; the buffer may be larger than
+	   the stack copy, but the remainder will be written
+	   later */
 	std::byte copy[FB_SIZE];
-	std::copy(r.begin(), r.end(), copy);
+	const auto chunk = r.first(std::min(r.size(), std::size(copy)));
+	std::copy(chunk.begin(), chunk.end(), copy);
 	lock.unlock();
 
-	ssize_t nbytes = socket->InternalWrite(std::span{copy}.first(r.size()));
+	ssize_t nbytes = socket->InternalWrite(std::span{copy}.first(chunk.size()));
 	if (nbytes > 0) {
 		lock.lock();
 		const bool add = encrypted_output.IsFull();
@@ -36,7 +36,7 @@
 #include "thread/Job.hxx"
 #include "event/DeferEvent.hxx"
 #include "event/CoarseTimerEvent.hxx"
-#include "memory/SliceFifoBuffer.hxx"
+#include "DefaultFifoBuffer.hxx"
 
 #include <memory>
 #include <mutex>
@@ -148,26 +148,29 @@ struct ThreadSocketFilterInternal : ThreadJob {
 	 * This gets fed from buffered_socket::input.  We need another
 	 * buffer because buffered_socket is not thread-safe, while this
 	 * buffer is protected by the #mutex.
+	 *
+	 * All buffers of this class start at the smallest size class
+	 * and grow only for bulk transfers.
 	 */
-	SliceFifoBuffer encrypted_input;
+	DefaultFifoBuffer encrypted_input{0};
 
 	/**
 	 * A buffer of input data that was handled by the filter.  It will
 	 * be passed to the handler.
 	 */
-	SliceFifoBuffer decrypted_input;
+	DefaultFifoBuffer decrypted_input{0};
 
 	/**
 	 * A buffer of output data that was not yet handled by the filter.
 	 * Once it was filtered, it will be written to #encrypted_output.
 	 */
-	SliceFifoBuffer plain_output;
+	DefaultFifoBuffer plain_output{0};
 
 	/**
 	 * A buffer of output data that has been filtered already, and
 	 * will be written to the socket.
 	 */
-	SliceFifoBuffer encrypted_output;
+	DefaultFifoBuffer encrypted_output{0};
 };
 
 /**
@@ -233,8 +236,12 @@ class ThreadSocketFilter final : public SocketFilter, ThreadSocketFilterInternal
 	 * Data from ThreadSocketFilterInternal::decrypted_input gets
 	 * moved here to be submitted.  This buffer is not protected by
 	 * the mutex.
+	 *
+	 * This is the buffer seen by the handler; it starts with the
+	 * default size class, because it must be able to hold a
+	 * whole header line.
 	 */
-	SliceFifoBuffer unprotected_decrypted_input;
+	DefaultFifoBuffer unprotected_decrypted_input;
 
 	/**
 	 * If this is set, an exception was caught inside the thread, and
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Warmer.hxx"
+#include "Stock.hxx"
+#include "Connect.hxx"
+#include "FilteredSocket.hxx"
+#include "net/SocketAddress.hxx"
+#include "event/Loop.hxx"
+#include "io/Logger.hxx"
+#include "util/Cancellable.hxx"
+#include "stopwatch.hxx"
+
+#include <algorithm>
+
+/**
+ * The regular interval of the warm-up timer.
+ */
+static constexpr Event::Duration WARM_INTERVAL = std::chrono::seconds(1);
+
+/**
+ * After connect failures, the interval grows up to this value.
+ */
+static constexpr Event::Duration WARM_MAX_INTERVAL = std::chrono::minutes(1);
+
+static constexpr Event::Duration WARM_CONNECT_TIMEOUT = std::chrono::seconds(10);
+
+/**
+ * Never keep more idle connections than this; it matches the
+ * "max_idle" setting of #FilteredSocketStock.
+ */
+static constexpr unsigned WARM_MAX_IDLE = 16;
+
+class FilteredSocketStockWarmer::Connect final
+	: public AutoUnlinkIntrusiveListHook, ConnectFilteredSocketHandler {
+
+	FilteredSocketStockWarmer &warmer;
+
+	CancellablePointer cancel_ptr;
+
+public:
+	std::unique_ptr<FilteredSocket> socket;
+
+	explicit Connect(FilteredSocketStockWarmer &_warmer) noexcept
+		:warmer(_warmer) {}
+
+	~Connect() noexcept {
+		if (cancel_ptr)
+			cancel_ptr.Cancel();
+	}
+
+	void Start(EventLoop &event_loop, SocketAddress address) noexcept {
+		ConnectFilteredSocket(event_loop, nullptr,
+				      false, SocketAddress::Null(),
+				      address, WARM_CONNECT_TIMEOUT,
+				      nullptr,
+				      *this, cancel_ptr);
+	}
+
+private:
+	/* virtual methods from class ConnectFilteredSocketHandler */
+	void OnConnectFilteredSocket(std::unique_ptr<FilteredSocket> _socket) noexcept override {
+		cancel_ptr = nullptr;
+		socket = std::move(_socket);
+		warmer.OnConnectSuccess(*this);
+	}
+
+	void OnConnectFilteredSocketError(std::exception_ptr e) noexcept override {
+		cancel_ptr = nullptr;
+		warmer.OnConnectError(*this, std::move(e));
+	}
+};
+
+FilteredSocketStockWarmer::FilteredSocketStockWarmer(FilteredSocketStock &_stock,
+						     SocketAddress _address,
+						     std::string &&_key,
+						     ReferencedFailureInfo &_failure,
+						     unsigned _min_idle) noexcept
+	:stock(_stock), address(_address), key(std::move(_key)),
+	 failure(_failure),
+	 min_idle(_min_idle),
+	 timer(stock.GetEventLoop(), BIND_THIS_METHOD(OnTimer)),
+	 interval(WARM_INTERVAL)
+{
+	timer.Schedule(Event::Duration::zero());
+}
+
+FilteredSocketStockWarmer::~FilteredSocketStockWarmer() noexcept
+{
+	while (!connects.empty())
+		delete &connects.front();
+}
+
+unsigned
+FilteredSocketStockWarmer::GetTarget() const noexcept
+{
+	return std::min(std::max(min_idle, demand), WARM_MAX_IDLE);
+}
+
+void
+FilteredSocketStockWarmer::OnTimer() noexcept
+{
+	if (misses >= demand)
+		demand = misses;
+	else
+		/* decay slowly, so the extra connections survive
+		   short pauses between bursts */
+		demand -= (demand - misses + 7) / 8;
+
+	misses = 0;
+
+	if (!failure->Check(stock.GetEventLoop().SteadyNow())) {
+		/* don't hammer a failing (or disabled) address; the
+		   balancer doesn't send requests there anyway */
+		timer.Schedule(interval);
+		return;
+	}
+
+	const unsigned target = GetTarget();
+	unsigned n = stock.GetIdleCount(key.c_str()) + connects.size();
+
+	for (; n < target; ++n) {
+		auto *connect = new Connect(*this);
+		connects.push_back(*connect);
+
+		/* this may invoke the handler (and delete the
+		   Connect) synchronously */
+		connect->Start(stock.GetEventLoop(), address);
+	}
+
+	timer.Schedule(interval);
+}
+
+void
+FilteredSocketStockWarmer::OnConnectSuccess(Connect &connect) noexcept
+{
+	interval = WARM_INTERVAL;
+	failure->UnsetConnect();
+
+	auto socket = std::move(connect.socket);
+	delete &connect;
+
+	stock.Add(key.c_str(), address, std::move(socket));
+}
+
+void
+FilteredSocketStockWarmer::OnConnectError(Connect &connect,
+					  std::exception_ptr e) noexcept
+{
+	delete &connect;
+
+	LogConcat(4, key.c_str(), "warm-up connect failed: ", e);
+
+	/* let the balancer know, just like a failed connect for a
+	   request */
+	failure->SetConnect(stock.GetEventLoop().SteadyNow(),
+			    std::chrono::seconds(20));
+
+	/* back off */
+	interval = std::min(interval * 2, WARM_MAX_INTERVAL);
+}
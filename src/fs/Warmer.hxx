@@ -0,0 +1,130 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "event/CoarseTimerEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/FailureRef.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <exception>
+#include <string>
+
+class FilteredSocketStock;
+
+/**
+ * Keeps idle connections to one address in a #FilteredSocketStock
+ * ready, so requests do not have to wait for a new connection.
+ *
+ * The number of idle connections to keep is the configured minimum,
+ * or more if recent requests frequently found no idle connection.
+ * A periodic timer tops up the stock with connections created in
+ * the background.  No connections are created while the address is
+ * known to be failing, and failed connects are reported to its
+ * #FailureInfo.
+ */
+class FilteredSocketStockWarmer final {
+	class Connect;
+
+	FilteredSocketStock &stock;
+
+	const AllocatedSocketAddress address;
+
+	/**
+	 * The #FilteredSocketStock key of #address.
+	 */
+	const std::string key;
+
+	const FailurePtr failure;
+
+	unsigned min_idle;
+
+	CoarseTimerEvent timer;
+
+	/**
+	 * The delay until the next timer tick.  It grows after
+	 * connect failures.
+	 */
+	Event::Duration interval;
+
+	IntrusiveList<Connect> connects;
+
+	/**
+	 * The number of requests since the last timer tick which did
+	 * not find an idle connection.
+	 */
+	unsigned misses = 0;
+
+	/**
+	 * The recent number of misses per timer tick; follows
+	 * increases immediately and decays slowly.
+	 */
+	unsigned demand = 0;
+
+public:
+	FilteredSocketStockWarmer(FilteredSocketStock &_stock,
+				  SocketAddress _address,
+				  std::string &&_key,
+				  ReferencedFailureInfo &_failure,
+				  unsigned _min_idle) noexcept;
+	~FilteredSocketStockWarmer() noexcept;
+
+	FilteredSocketStockWarmer(const FilteredSocketStockWarmer &) = delete;
+	FilteredSocketStockWarmer &operator=(const FilteredSocketStockWarmer &) = delete;
+
+	void RaiseMinIdle(unsigned _min_idle) noexcept {
+		if (_min_idle > min_idle)
+			min_idle = _min_idle;
+	}
+
+	/**
+	 * A request for this address is about to be submitted to the
+	 * stock.
+	 *
+	 * @param idle the number of idle connections
+	 */
+	void OnRequest(unsigned idle) noexcept {
+		if (idle == 0)
+			++misses;
+	}
+
+private:
+	[[gnu::pure]]
+	unsigned GetTarget() const noexcept;
+
+	void OnTimer() noexcept;
+
+	void OnConnectSuccess(Connect &connect) noexcept;
+	void OnConnectError(Connect &connect,
+			    std::exception_ptr e) noexcept;
+};
@@ -234,6 +234,14 @@ class HttpClient final : BufferedSocketHandler, IstreamSink, Cancellable, Destru
 	/* connection settings */
 	bool keep_alive;
 
+	/**
+	 * Is this a pipelined connection (see
+	 * http_client_response())?  The input buffer may contain
+	 * the following response, therefore the socket must not be
+	 * released before this response has been consumed.
+	 */
+	const bool pipelined;
+
 public:
 	HttpClient(struct pool &_pool, struct pool &_caller_pool,
 		   StopwatchPtr &&_stopwatch,
@@ -246,6 +254,15 @@ public:
 		   HttpResponseHandler &handler,
 		   CancellablePointer &cancel_ptr) noexcept;
 
+	HttpClient(struct pool &_pool, struct pool &_caller_pool,
+		   StopwatchPtr &&_stopwatch,
+		   FilteredSocket &_socket, Lease &lease,
+		   const char *_peer_name,
+		   http_method_t method,
+		   UnusedIstreamPtr pending,
+		   HttpResponseHandler &handler,
+		   CancellablePointer &cancel_ptr) noexcept;
+
 	~HttpClient() noexcept {
 		if (!socket.IsReleased())
 			ReleaseSocket(false, false);
@@ -264,6 +281,16 @@ private:
 		return socket.IsConnected();
 	}
 
+	/**
+	 * Is the rest of the response in the input buffer, so the
+	 * socket can be released already?
+	 */
+	[[gnu::pure]]
+	bool IsSocketDone() const noexcept {
+		return !pipelined && IsConnected() &&
+			response_body_reader.IsSocketDone(socket);
+	}
+
 	[[gnu::pure]]
 	bool CheckDirect() const noexcept {
 		assert(socket.GetType() == FdType::FD_NONE || IsConnected());
@@ -284,6 +311,19 @@ private:
 		socket.ScheduleWrite();
 	}
 
+	/**
+	 * The request has been sent completely.  Notify the handler,
+	 * unless it has already received the response (the server
+	 * may respond before reading the whole request body).
+	 */
+	void RequestSent() noexcept {
+		stopwatch.RecordEvent("request_end");
+
+		if (response.state == Response::State::STATUS ||
+		    response.state == Response::State::HEADERS)
+			request.handler.InvokeRequestSent();
+	}
+
 	/**
 	 * Release the socket held by this object.
 	 */
@@ -656,7 +696,7 @@ HttpClient::TryWriteBuckets()
 		assert(HasInput());
 		assert(!request.pending_body);
 
-		stopwatch.RecordEvent("request_end");
+		RequestSent();
 		CloseInput();
 		socket.ScheduleRead();
 		break;
@@ -810,7 +850,7 @@ HttpClient::ResponseFinished() noexcept
 
 	stopwatch.RecordEvent("end");
 
-	if (!socket.IsEmpty()) {
+	if (!pipelined && !socket.IsEmpty()) {
 		LogConcat(2, peer_name, "excess data after HTTP response");
 		keep_alive = false;
 	}
@@ -897,7 +937,7 @@ HttpClient::FeedBody(std::span<const std::byte> b)
 
 	socket.DisposeConsumed(nbytes);
 
-	if (IsConnected() && response_body_reader.IsSocketDone(socket))
+	if (IsSocketDone())
 		/* we don't need the socket anymore, we've got everything we
 		   need in the input buffer */
 		ReleaseSocket(true, keep_alive);
@@ -969,7 +1009,8 @@ HttpClient::FeedHeaders(std::span<const std::byte> b)
 		request.pending_body.reset();
 	}
 
-	if ((response.state == Response::State::END ||
+	if (!pipelined &&
+	    (response.state == Response::State::END ||
 	     response_body_reader.IsSocketDone(socket)) &&
 	    IsConnected())
 		/* we don't need the socket anymore, we've got everything we
@@ -1074,7 +1115,7 @@ HttpClient::OnBufferedData()
 		}
 
 	case Response::State::BODY:
-		if (IsConnected() && response_body_reader.IsSocketDone(socket))
+		if (IsSocketDone())
 			/* we don't need the socket anymore, we've got everything
 			   we need in the input buffer */
 			ReleaseSocket(true, keep_alive);
@@ -1284,7 +1325,7 @@ HttpClient::OnDirect(FdType type, FileDescriptor fd, off_t offset,
 void
 HttpClient::OnEof() noexcept
 {
-	stopwatch.RecordEvent("request_end");
+	RequestSent();
 
 	assert(HasInput());
 	ClearInput();
@@ -1362,7 +1403,8 @@ HttpClient::HttpClient(struct pool &_pool, struct pool &_caller_pool,
 	 event_loop(_socket.GetEventLoop()),
 	 socket(_socket, lease, http_client_timeout, *this),
 	 request(handler),
-	 response_body_reader(pool)
+	 response_body_reader(pool),
+	 pipelined(false)
 {
 	response.state = HttpClient::Response::State::STATUS;
 	response.no_body = http_method_is_empty(method);
@@ -1436,6 +1478,60 @@ HttpClient::HttpClient(struct pool &_pool, struct pool &_caller_pool,
 	DeferWrite();
 }
 
+inline
+HttpClient::HttpClient(struct pool &_pool, struct pool &_caller_pool,
+		       StopwatchPtr &&_stopwatch,
+		       FilteredSocket &_socket, Lease &lease,
+		       const char *_peer_name,
+		       http_method_t method,
+		       UnusedIstreamPtr pending,
+		       HttpResponseHandler &handler,
+		       CancellablePointer &cancel_ptr) noexcept
+	:PoolLeakDetector(_pool),
+	 pool(_pool), caller_pool(_caller_pool),
+	 peer_name(_peer_name),
+	 stopwatch(std::move(_stopwatch)),
+	 event_loop(_socket.GetEventLoop()),
+	 socket(_socket, lease, http_client_timeout, *this),
+	 request(handler),
+	 response_body_reader(pool),
+	 pipelined(true)
+{
+	response.state = HttpClient::Response::State::STATUS;
+	response.no_body = http_method_is_empty(method);
+
+	cancel_ptr = *this;
+
+	if (pending) {
+		SetInput(std::move(pending));
+		DeferWrite();
+	}
+
+	socket.ScheduleRead();
+
+	/* the previous client may have left (parts of) our response
+	   in the input buffer */
+	socket.DeferRead();
+}
+
+GrowingBuffer
+http_client_serialize_request(http_method_t method, const char *uri,
+			      const StringMap &headers,
+			      GrowingBuffer &&more_headers) noexcept
+{
+	GrowingBuffer buffer;
+	buffer.Write(http_method_to_string(method));
+	buffer.Write(" "sv);
+	buffer.Write(uri);
+	buffer.Write(" HTTP/1.1\r\n"sv);
+
+	buffer.AppendMoveFrom(std::move(more_headers));
+	headers_copy_most(headers, buffer);
+	buffer.Write("\r\n"sv);
+
+	return buffer;
+}
+
 void
 http_client_request(struct pool &caller_pool,
 		    StopwatchPtr stopwatch,
@@ -1469,3 +1565,24 @@ http_client_request(struct pool &caller_pool,
 				std::move(body), expect_100,
 				handler, cancel_ptr);
 }
+
+void
+http_client_response(struct pool &caller_pool,
+		     StopwatchPtr stopwatch,
+		     FilteredSocket &socket, Lease &lease,
+		     const char *peer_name,
+		     http_method_t method,
+		     UnusedIstreamPtr pending,
+		     HttpResponseHandler &handler,
+		     CancellablePointer &cancel_ptr) noexcept
+{
+	assert(http_method_is_valid(method));
+
+	NewFromPool<HttpClient>(caller_pool, caller_pool, caller_pool,
+				std::move(stopwatch),
+				socket,
+				lease,
+				peer_name,
+				method, std::move(pending),
+				handler, cancel_ptr);
+}
@@ -132,3 +132,35 @@ http_client_request(struct pool &pool,
 		    UnusedIstreamPtr body, bool expect_100,
 		    HttpResponseHandler &handler,
 		    CancellablePointer &cancel_ptr) noexcept;
+
+/**
+ * Serialize the head of a request without a request body (request
+ * line and headers), for callers which send the request themselves,
+ * e.g. #HttpPipeline.
+ */
+GrowingBuffer
+http_client_serialize_request(http_method_t method, const char *uri,
+			      const StringMap &headers,
+			      GrowingBuffer &&more_headers) noexcept;
+
+/**
+ * Receive the response to a request which has already been sent (or
+ * partially sent) on the socket by the caller.  This is used for
+ * HTTP/1.1 pipelining (see #HttpPipeline): the socket is never
+ * released before the response has been consumed completely, and
+ * data following the response remains in the socket's input buffer
+ * for the next response.
+ *
+ * @param method the HTTP request method
+ * @param pending the rest of the serialized request which the
+ * caller was unable to send (optional)
+ */
+void
+http_client_response(struct pool &pool,
+		     StopwatchPtr stopwatch,
+		     FilteredSocket &socket, Lease &lease,
+		     const char *peer_name,
+		     http_method_t method,
+		     UnusedIstreamPtr pending,
+		     HttpResponseHandler &handler,
+		     CancellablePointer &cancel_ptr) noexcept;
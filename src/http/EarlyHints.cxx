@@ -0,0 +1,134 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "EarlyHints.hxx"
+#include "util/StringCompare.hxx"
+#include "util/StringSplit.hxx"
+#include "util/StringStrip.hxx"
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * Split off the first link-value.  Commas inside the URI reference
+ * or inside quoted parameter values are not separators.
+ */
+static std::pair<std::string_view, std::string_view>
+NextLinkValue(std::string_view s) noexcept
+{
+	bool in_uri = false, in_quote = false;
+
+	for (std::size_t i = 0; i < s.size(); ++i) {
+		const char ch = s[i];
+		if (in_quote) {
+			if (ch == '\\')
+				++i;
+			else if (ch == '"')
+				in_quote = false;
+		} else if (in_uri) {
+			if (ch == '>')
+				in_uri = false;
+		} else if (ch == '<')
+			in_uri = true;
+		else if (ch == '"')
+			in_quote = true;
+		else if (ch == ',')
+			return {s.substr(0, i), s.substr(i + 1)};
+	}
+
+	return {s, {}};
+}
+
+[[gnu::pure]]
+static bool
+IsEarlyHintsRelation(std::string_view rel) noexcept
+{
+	if (rel.size() >= 2 && rel.front() == '"' && rel.back() == '"')
+		rel = rel.substr(1, rel.size() - 2);
+
+	/* the "rel" parameter may contain a space-separated list of
+	   relation types */
+	while (!rel.empty()) {
+		auto [type, rest] = Split(StripLeft(rel), ' ');
+		if (StringIsEqualIgnoreCase(type, "preload"sv) ||
+		    StringIsEqualIgnoreCase(type, "preconnect"sv))
+			return true;
+
+		rel = rest;
+	}
+
+	return false;
+}
+
+[[gnu::pure]]
+static bool
+IsEarlyHintsLinkValue(std::string_view value) noexcept
+{
+	if (value.empty() || value.front() != '<')
+		return false;
+
+	const auto end = value.find('>');
+	if (end == value.npos)
+		return false;
+
+	std::string_view params = value.substr(end + 1);
+	while (!params.empty()) {
+		auto [param, rest] = Split(params, ';');
+		params = rest;
+
+		auto [name, rel] = Split(Strip(param), '=');
+		if (StringIsEqualIgnoreCase(Strip(name), "rel"sv))
+			return IsEarlyHintsRelation(Strip(rel));
+	}
+
+	return false;
+}
+
+std::string
+FilterEarlyHintsLinks(std::string_view link)
+{
+	std::string result;
+
+	while (!link.empty()) {
+		auto [value, rest] = NextLinkValue(link);
+		link = rest;
+
+		value = Strip(value);
+		if (!IsEarlyHintsLinkValue(value))
+			continue;
+
+		if (!result.empty())
+			result.append(", "sv);
+		result.append(value);
+	}
+
+	return result;
+}
@@ -42,12 +42,15 @@
 #include "pool/LeakDetector.hxx"
 #include "event/Loop.hxx"
 #include "net/SocketAddress.hxx"
+#include "net/FailureManager.hxx"
 #include "net/FailureRef.hxx"
 #include "util/Cancellable.hxx"
 #include "AllocatorPtr.hxx"
 #include "stopwatch.hxx"
 #include "memory/GrowingBuffer.hxx"
 
+#include <optional>
+
 static constexpr Event::Duration HTTP_CONNECT_TIMEOUT =
 	std::chrono::seconds(30);
 
@@ -66,10 +69,20 @@ class HttpRequest final
 
 	FailurePtr failure;
 
+	/**
+	 * When was the last byte of the request sent to the server?
+	 * Used by the passive outlier detection.  Unset if the
+	 * request has a body, because its upload time depends on the
+	 * client.
+	 */
+	std::optional<Event::TimePoint> send_time;
+
 	const sticky_hash_t sticky_hash;
 
 	unsigned retries;
 
+	const bool has_body;
+
 	const HttpAddress &address;
 
 	PendingHttpRequest pending_request;
@@ -96,6 +109,7 @@ public:
 		 sticky_hash(_sticky_hash),
 		 /* can only retry if there is no request body */
 		 retries(_body ? 0 : 2),
+		 has_body(_body),
 		 address(_address),
 		 pending_request(_pool, _method, _address.path,
 				 std::move(_headers), std::move(_body)),
@@ -143,6 +157,7 @@ private:
 	void OnHttpResponse(http_status_t status, StringMap &&headers,
 			    UnusedIstreamPtr body) noexcept override;
 	void OnHttpError(std::exception_ptr ep) noexcept override;
+	void OnHttpRequestSent() noexcept override;
 };
 
 /*
@@ -154,8 +169,17 @@ void
 HttpRequest::OnHttpResponse(http_status_t status, StringMap &&_headers,
 			    UnusedIstreamPtr _body) noexcept
 {
+	const auto now = event_loop.SteadyNow();
 	failure->UnsetProtocol();
 
+	std::optional<Event::Duration> latency;
+	if (send_time)
+		latency = now - *send_time;
+
+	failure->AddResult(fs_balancer.GetFailureManager().GetOutlierConfig(),
+			   now, http_status_is_server_error(status),
+			   latency);
+
 	auto &_handler = handler;
 	Destroy();
 	_handler.InvokeResponse(status, std::move(_headers), std::move(_body));
@@ -181,6 +205,13 @@ HttpRequest::OnHttpError(std::exception_ptr ep) noexcept
 	}
 }
 
+void
+HttpRequest::OnHttpRequestSent() noexcept
+{
+	if (!has_body)
+		send_time = event_loop.SteadyNow();
+}
+
 /*
  * stock callback
  *
@@ -195,6 +226,7 @@ HttpRequest::OnFilteredSocketReady(Lease &lease,
 	stopwatch.RecordEvent("connect");
 
 	failure = _failure;
+	send_time.reset();
 
 	GrowingBuffer more_headers;
 	if (address.host_and_port != nullptr)
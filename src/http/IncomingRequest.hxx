@@ -103,6 +103,18 @@ public:
 				  HttpHeaders &&response_headers,
 				  UnusedIstreamPtr response_body) noexcept = 0;
 
+	/**
+	 * Send a "103 Early Hints" interim response (RFC 8297) with
+	 * the given "Link" header value.  This is only a hint: the
+	 * implementation may silently discard it, e.g. if the
+	 * protocol does not allow interim responses or if the final
+	 * response has already been submitted.  The string is
+	 * copied.
+	 */
+	virtual void SendEarlyHints(std::string_view link) noexcept {
+		(void)link;
+	}
+
 	/**
 	 * Generate a "simple" response with an optional plain-text body and
 	 * an optional "Location" redirect header.
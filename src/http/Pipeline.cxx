@@ -0,0 +1,342 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Pipeline.hxx"
+#include "Client.hxx"
+#include "Upgrade.hxx"
+#include "ResponseHandler.hxx"
+#include "fs/FilteredSocket.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "istream/sink_null.hxx"
+#include "memory/GrowingBuffer.hxx"
+#include "memory/istream_gb.hxx"
+#include "pool/Ptr.hxx"
+#include "uri/Verify.hxx"
+#include "util/Cancellable.hxx"
+#include "stopwatch.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+class HttpPipeline::Request final
+	: public IntrusiveListHook, HttpResponseHandler, Cancellable
+{
+	const PoolPtr pool;
+
+	const http_method_t method;
+
+	/**
+	 * The rest of the serialized request which could not be sent
+	 * by HttpPipeline::SendRequest().
+	 */
+	UnusedIstreamPtr pending;
+
+	/**
+	 * The caller's handler.  This is nullptr if the request was
+	 * canceled while it was queued; its response will be
+	 * discarded.
+	 */
+	HttpResponseHandler *handler;
+
+	/**
+	 * Cancels the #HttpClient which receives the response.
+	 */
+	CancellablePointer cancel_ptr;
+
+public:
+	Request(struct pool &_pool, http_method_t _method,
+		UnusedIstreamPtr &&_pending,
+		HttpResponseHandler &_handler,
+		CancellablePointer &caller_cancel_ptr) noexcept
+		:pool(_pool), method(_method),
+		 pending(std::move(_pending)),
+		 handler(&_handler)
+	{
+		caller_cancel_ptr = *this;
+	}
+
+	void Start(FilteredSocket &socket, Lease &lease,
+		   const char *peer_name) noexcept {
+		http_client_response(pool, nullptr, socket, lease,
+				     peer_name, method, std::move(pending),
+				     *this, cancel_ptr);
+	}
+
+	/**
+	 * Fail a request which has not been started.
+	 */
+	void Fail(std::exception_ptr ep) noexcept {
+		auto *_handler = handler;
+		Destroy();
+
+		if (_handler != nullptr)
+			_handler->InvokeError(std::move(ep));
+	}
+
+private:
+	void Destroy() noexcept {
+		delete this;
+	}
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		if (cancel_ptr) {
+			/* the response is being received; this makes
+			   the connection unusable, and HttpPipeline
+			   will fail all subsequent requests */
+			cancel_ptr.Cancel();
+			Destroy();
+		} else
+			/* the request has already been sent, so its
+			   response must be consumed to keep the
+			   connection in sync */
+			handler = nullptr;
+	}
+
+	/* virtual methods from class HttpResponseHandler */
+	void OnHttpResponse(http_status_t status, StringMap &&headers,
+			    UnusedIstreamPtr body) noexcept override {
+		if (handler != nullptr)
+			handler->InvokeResponse(status, std::move(headers),
+						std::move(body));
+		else if (body)
+			sink_null_new(pool, std::move(body));
+
+		Destroy();
+	}
+
+	void OnHttpError(std::exception_ptr ep) noexcept override {
+		Fail(std::move(ep));
+	}
+};
+
+HttpPipeline::HttpPipeline(HttpPipelineList &_list,
+			   FilteredSocket &_socket, Lease &_lease,
+			   const char *_peer_name,
+			   ReferencedFailureInfo &_failure,
+			   unsigned _depth) noexcept
+	:list(_list), socket(_socket), lease(_lease),
+	 peer_name(_peer_name),
+	 failure(_failure),
+	 depth(_depth)
+{
+	assert(depth > 0);
+}
+
+HttpPipeline::~HttpPipeline() noexcept
+{
+	assert(requests.empty());
+	assert(!busy);
+	assert(!lease);
+}
+
+bool
+HttpPipeline::CanPipeline(http_method_t method, const char *uri,
+			  const StringMap &headers, bool has_body) noexcept
+{
+	/* only idempotent requests may be retried after the
+	   connection has failed */
+	return (method == HTTP_METHOD_GET || method == HTTP_METHOD_HEAD) &&
+		!has_body &&
+		uri_path_verify_quick(uri) &&
+		!http_is_upgrade(headers);
+}
+
+bool
+HttpPipeline::IsAvailable(Expiry now,
+			  FailureInfo::Duration slow_start) const noexcept
+{
+	if (sealed || !socket.IsConnected() || !failure->Check(now))
+		return false;
+
+	/* a member which has just recovered gets only a fraction of
+	   the configured depth, just like the balancer gives it only
+	   a fraction of the requests */
+	const unsigned weight = failure->GetSlowStartWeight(now, slow_start);
+	const unsigned max_requests =
+		std::max(depth * weight / FailureInfo::SLOW_START_STEPS, 1U);
+
+	return n_requests < max_requests;
+}
+
+bool
+HttpPipeline::SendRequest(struct pool &pool,
+			  http_method_t method, const char *uri,
+			  const StringMap &headers,
+			  GrowingBuffer &&more_headers,
+			  HttpResponseHandler &handler,
+			  CancellablePointer &cancel_ptr) noexcept
+{
+	assert(!sealed);
+	assert(n_requests < depth);
+
+	auto buffer = http_client_serialize_request(method, uri, headers,
+						    std::move(more_headers));
+
+	bool sent_some = false;
+	while (!buffer.IsEmpty()) {
+		const ssize_t nbytes = socket.Write(buffer.Read());
+		if (nbytes <= 0)
+			break;
+
+		buffer.Consume(nbytes);
+		sent_some = true;
+	}
+
+	UnusedIstreamPtr pending;
+	if (!buffer.IsEmpty()) {
+		/* the socket buffer is full; the rest of this request
+		   will be sent by its #HttpClient, and no more
+		   requests can be appended until then */
+		sealed = true;
+
+		if (!sent_some && n_requests > 0)
+			return false;
+
+		pending = istream_gb_new(pool, std::move(buffer));
+	}
+
+	auto *request = new Request(pool, method, std::move(pending),
+				    handler, cancel_ptr);
+	requests.push_back(*request);
+	++n_requests;
+
+	if (!busy)
+		StartNext();
+
+	return true;
+}
+
+void
+HttpPipeline::StartNext() noexcept
+{
+	assert(!busy);
+	assert(!requests.empty());
+
+	auto &request = requests.front();
+	requests.pop_front();
+
+	busy = true;
+	request.Start(socket, *this, peer_name);
+}
+
+void
+HttpPipeline::Abort() noexcept
+{
+	/* unlink first so a retry doesn't find this connection
+	   again */
+	Unlink();
+	sealed = true;
+
+	lease.Release(false);
+
+	const auto error = std::make_exception_ptr(HttpClientError(HttpClientErrorCode::REFUSED,
+								   "Pipelined HTTP connection failed before the response"));
+
+	while (!requests.empty()) {
+		auto &request = requests.front();
+		requests.pop_front();
+		request.Fail(error);
+	}
+
+	n_requests = 0;
+	Destroy();
+}
+
+void
+HttpPipeline::ReleaseLease(bool reuse) noexcept
+{
+	assert(busy);
+	assert(n_requests > 0);
+
+	busy = false;
+	--n_requests;
+
+	if (!reuse)
+		Abort();
+	else if (!requests.empty())
+		StartNext();
+	else {
+		Unlink();
+		lease.Release(true);
+		Destroy();
+	}
+}
+
+inline void
+HttpPipeline::Unlink() noexcept
+{
+	list.Remove(*this);
+}
+
+HttpPipeline *
+HttpPipelineList::Find(const FailureInfo &member, Expiry now,
+		       FailureInfo::Duration slow_start) noexcept
+{
+	auto i = members.find(&member);
+	if (i == members.end())
+		return nullptr;
+
+	for (auto &pipeline : i->second)
+		if (pipeline.IsAvailable(now, slow_start))
+			return &pipeline;
+
+	return nullptr;
+}
+
+HttpPipeline &
+HttpPipelineList::Add(FilteredSocket &socket, Lease &lease,
+		      const char *peer_name,
+		      ReferencedFailureInfo &failure,
+		      unsigned depth) noexcept
+{
+	auto *pipeline = new HttpPipeline(*this, socket, lease, peer_name,
+					  failure, depth);
+	members[&failure].push_back(*pipeline);
+	return *pipeline;
+}
+
+inline void
+HttpPipelineList::Remove(HttpPipeline &pipeline) noexcept
+{
+	if (!pipeline.is_linked())
+		/* already removed, or the list has been destroyed
+		   (and cleared) before the connection was done */
+		return;
+
+	pipeline.AutoUnlinkIntrusiveListHook::unlink();
+
+	auto i = members.find(&pipeline.GetFailure());
+	assert(i != members.end());
+	if (i->second.empty())
+		members.erase(i);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "http/Method.h"
+#include "net/FailureRef.hxx"
+#include "lease.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <unordered_map>
+
+struct pool;
+class FilteredSocket;
+class StringMap;
+class GrowingBuffer;
+class HttpResponseHandler;
+class CancellablePointer;
+class HttpPipelineList;
+
+/**
+ * Sends several requests on one HTTP/1.1 connection without waiting
+ * for the responses (RFC 9112 9.3.2).  Only idempotent requests
+ * without a request body qualify, see CanPipeline().
+ *
+ * This object holds the connection's #Lease while requests are
+ * outstanding; the responses are received one after the other by a
+ * #HttpClient which gets this object as its #Lease.  If the
+ * connection fails or cannot be reused, all requests queued behind
+ * the current one fail with #HttpClientErrorCode::REFUSED, and the
+ * caller may retry them on another connection.
+ *
+ * Instances are created with HttpPipelineList::Add() and delete
+ * themselves after the last response.
+ */
+class HttpPipeline final : public AutoUnlinkIntrusiveListHook, Lease {
+	class Request;
+
+	HttpPipelineList &list;
+
+	FilteredSocket &socket;
+
+	LeasePtr lease;
+
+	const char *const peer_name;
+
+	const FailurePtr failure;
+
+	/**
+	 * The maximum number of outstanding requests (while the
+	 * member is not in its slow-start phase).
+	 */
+	const unsigned depth;
+
+	/**
+	 * Requests which have been sent, but whose response is not
+	 * yet being received.
+	 */
+	IntrusiveList<Request> requests;
+
+	/**
+	 * The number of outstanding requests, including the one whose
+	 * response is currently being received.
+	 */
+	unsigned n_requests = 0;
+
+	/**
+	 * Is a #HttpClient currently receiving a response?
+	 */
+	bool busy = false;
+
+	/**
+	 * If true, then no more requests are accepted, because the
+	 * last one could not be sent completely.
+	 */
+	bool sealed = false;
+
+public:
+	HttpPipeline(HttpPipelineList &_list,
+		     FilteredSocket &_socket, Lease &_lease,
+		     const char *_peer_name,
+		     ReferencedFailureInfo &_failure,
+		     unsigned _depth) noexcept;
+
+	~HttpPipeline() noexcept;
+
+	HttpPipeline(const HttpPipeline &) = delete;
+	HttpPipeline &operator=(const HttpPipeline &) = delete;
+
+	/**
+	 * Can the specified request be pipelined?
+	 */
+	[[gnu::pure]]
+	static bool CanPipeline(http_method_t method, const char *uri,
+				const StringMap &headers,
+				bool has_body) noexcept;
+
+	const char *GetPeerName() const noexcept {
+		return peer_name;
+	}
+
+	ReferencedFailureInfo &GetFailure() const noexcept {
+		return *failure;
+	}
+
+	/**
+	 * Does this connection accept another request?  Not if the
+	 * member has failed; during its slow-start phase, only a
+	 * fraction of the configured depth is used.
+	 *
+	 * @param slow_start see FailureManager::GetSlowStart()
+	 */
+	[[gnu::pure]]
+	bool IsAvailable(Expiry now,
+			 FailureInfo::Duration slow_start) const noexcept;
+
+	/**
+	 * Send a request on this connection.  It must have been
+	 * checked with CanPipeline() and IsAvailable() (unless this
+	 * is the first request).
+	 *
+	 * @return false if nothing could be sent because the socket
+	 * is busy; the caller shall use another connection
+	 */
+	bool SendRequest(struct pool &pool,
+			 http_method_t method, const char *uri,
+			 const StringMap &headers,
+			 GrowingBuffer &&more_headers,
+			 HttpResponseHandler &handler,
+			 CancellablePointer &cancel_ptr) noexcept;
+
+private:
+	void Destroy() noexcept {
+		delete this;
+	}
+
+	/**
+	 * Remove this object from its #HttpPipelineList so it does
+	 * not get any more requests.
+	 */
+	void Unlink() noexcept;
+
+	/**
+	 * Pass the socket to the next request's #HttpClient.
+	 */
+	void StartNext() noexcept;
+
+	/**
+	 * The connection cannot be used anymore: release it, fail all
+	 * queued requests and destroy this object.
+	 */
+	void Abort() noexcept;
+
+	/* virtual methods from class Lease */
+	void ReleaseLease(bool reuse) noexcept override;
+};
+
+/**
+ * The #HttpPipeline instances of one backend cluster, grouped by
+ * member.  The member is chosen by the balancer; this class only
+ * finds a connection to it.
+ */
+class HttpPipelineList {
+	friend class HttpPipeline;
+
+	using List = IntrusiveList<HttpPipeline>;
+
+	/**
+	 * The key is the member's #FailureInfo, which identifies it.
+	 * Each #HttpPipeline holds a reference to it, and empty lists
+	 * are removed, so no key can dangle.
+	 */
+	std::unordered_map<const FailureInfo *, List> members;
+
+public:
+	/**
+	 * Find a connection to the given member which accepts
+	 * another request.
+	 *
+	 * @param member the #FailureInfo of the member picked by the
+	 * balancer
+	 * @param slow_start see FailureManager::GetSlowStart()
+	 */
+	[[gnu::pure]]
+	HttpPipeline *Find(const FailureInfo &member, Expiry now,
+			   FailureInfo::Duration slow_start) noexcept;
+
+	/**
+	 * Create a new #HttpPipeline for a connection which has just
+	 * been obtained from the stock.
+	 */
+	HttpPipeline &Add(FilteredSocket &socket, Lease &lease,
+			  const char *peer_name,
+			  ReferencedFailureInfo &failure,
+			  unsigned depth) noexcept;
+
+private:
+	void Remove(HttpPipeline &pipeline) noexcept;
+};
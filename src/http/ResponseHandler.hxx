@@ -53,6 +53,13 @@ protected:
 
 	virtual void OnHttpError(std::exception_ptr ep) noexcept = 0;
 
+	/**
+	 * The request (including its body) has been sent completely,
+	 * and the response has not yet been received.  This is
+	 * optional; only #HttpClient implements it.
+	 */
+	virtual void OnHttpRequestSent() noexcept {}
+
 public:
 	template<typename B>
 	void InvokeResponse(http_status_t status, StringMap &&headers,
@@ -74,4 +81,8 @@ public:
 
 		OnHttpError(ep);
 	}
+
+	void InvokeRequestSent() noexcept {
+		OnHttpRequestSent();
+	}
 };
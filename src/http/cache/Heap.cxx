@@ -105,7 +105,7 @@ void
 HttpCacheHeap::Compress() noexcept
 {
 	slice_pool.Compress();
-	rubber.Compress();
+	rubber_compressor.Start();
 }
 
 void
@@ -167,6 +167,7 @@ HttpCacheHeap::HttpCacheHeap(struct pool &_pool, EventLoop &event_loop,
 	:pool(_pool),
 	 slice_pool(1024, 65536, "http_cache_meta"),
 	 rubber(max_size, "http_cache_data"),
+	 rubber_compressor(event_loop, rubber),
 	 /* leave 12.5% of the rubber allocator empty, to increase the
 	    chances that a hole can be found for a new allocation, to
 	    reduce the pressure that rubber_compress() creates */
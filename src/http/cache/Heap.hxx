@@ -35,6 +35,7 @@
 #include "Item.hxx"
 #include "memory/SlicePool.hxx"
 #include "memory/Rubber.hxx"
+#include "memory/RubberCompressor.hxx"
 #include "http/Status.h"
 #include "cache.hxx"
 
@@ -63,6 +64,8 @@ class HttpCacheHeap {
 
 	Rubber rubber;
 
+	RubberCompressor rubber_compressor;
+
 	Cache cache;
 
 	using PerTagHook =
@@ -92,6 +95,10 @@ public:
 	[[gnu::pure]]
 	AllocatorStats GetStats() const noexcept;
 
+	const CompressStats &GetCompressStats() const noexcept {
+		return rubber_compressor.GetStats();
+	}
+
 	HttpCacheDocument *Get(const char *uri,
 			       StringMap &request_headers) noexcept;
 
@@ -105,7 +112,12 @@ public:
 	void Remove(HttpCacheDocument &document) noexcept;
 	void RemoveURL(const char *url, StringMap &headers) noexcept;
 
+	/**
+	 * Start compressing the memory allocators.  The #Rubber
+	 * allocator is compressed incrementally in the background.
+	 */
 	void Compress() noexcept;
+
 	void Flush() noexcept;
 	void FlushTag(const std::string &tag) noexcept;
 
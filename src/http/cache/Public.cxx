@@ -333,6 +333,10 @@ public:
 		return heap.GetStats();
 	}
 
+	const CompressStats &GetCompressStats() const noexcept {
+		return heap.GetCompressStats();
+	}
+
 	void Flush() noexcept {
 		heap.Flush();
 	}
@@ -856,6 +860,12 @@ http_cache_get_stats(const HttpCache &cache) noexcept
 	return cache.GetStats();
 }
 
+const CompressStats &
+http_cache_get_compress_stats(const HttpCache &cache) noexcept
+{
+	return cache.GetCompressStats();
+}
+
 void
 http_cache_flush(HttpCache &cache) noexcept
 {
@@ -48,6 +48,7 @@ struct ResourceAddress;
 class StringMap;
 class HttpResponseHandler;
 struct AllocatorStats;
+struct CompressStats;
 class HttpCache;
 class CancellablePointer;
 
@@ -70,6 +71,10 @@ http_cache_fork_cow(HttpCache &cache, bool inherit) noexcept;
 AllocatorStats
 http_cache_get_stats(const HttpCache &cache) noexcept;
 
+[[gnu::pure]]
+const CompressStats &
+http_cache_get_compress_stats(const HttpCache &cache) noexcept;
+
 void
 http_cache_flush(HttpCache &cache) noexcept;
 
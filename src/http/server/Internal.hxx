@@ -41,6 +41,7 @@
 #include "net/SocketProtocolError.hxx"
 #include "net/SocketAddress.hxx"
 #include "event/CoarseTimerEvent.hxx"
+#include "event/DeferEvent.hxx"
 #include "istream/Sink.hxx"
 #include "pool/UniquePtr.hxx"
 #include "util/Cancellable.hxx"
@@ -137,6 +138,13 @@ struct HttpServerConnection final
 	 */
 	CoarseTimerEvent read_timer;
 
+	/**
+	 * Sends the "103 Early Hints" response which was queued by
+	 * SendEarlyHints().  It is deferred so socket errors are not
+	 * reported inside the request handler's stack frame.
+	 */
+	DeferEvent defer_early_hints;
+
 	enum http_server_score score = HTTP_SERVER_NEW;
 
 	/* handler */
@@ -197,6 +205,18 @@ struct HttpServerConnection final
 		/** send a "417 Expectation Failed" response? */
 		bool expect_failed;
 
+		/**
+		 * Is this a HTTP/1.0 request?  Those clients must not
+		 * receive interim (1xx) responses.
+		 */
+		bool http_1_0;
+
+		/**
+		 * A pending "103 Early Hints" response (allocated from
+		 * the request pool), to be sent by #defer_early_hints.
+		 */
+		std::string_view early_hints;
+
 		HttpServerRequest *request = nullptr;
 
 		CancellablePointer cancel_ptr;
@@ -323,6 +343,14 @@ struct HttpServerConnection final
 	 */
 	bool MaybeSend100Continue();
 
+	/**
+	 * Queue a "103 Early Hints" response.  It will be discarded
+	 * if the final response gets submitted first.
+	 */
+	void SendEarlyHints(std::string_view link) noexcept;
+
+	void OnDeferredEarlyHints() noexcept;
+
 	void SetResponseIstream(UnusedIstreamPtr r);
 
 	/**
@@ -325,6 +325,8 @@ HttpServerConnection::HttpServerConnection(struct pool &_pool,
 		    BIND_THIS_METHOD(IdleTimeoutCallback)),
 	 read_timer(socket->GetEventLoop(),
 		    BIND_THIS_METHOD(OnReadTimeout)),
+	 defer_early_hints(socket->GetEventLoop(),
+			   BIND_THIS_METHOD(OnDeferredEarlyHints)),
 	 handler(&_handler), request_handler(_request_handler),
 	 local_address(DupAddress(*pool, _local_address)),
 	 remote_address(DupAddress(*pool, _remote_address)),
@@ -375,6 +377,9 @@ HttpServerConnection::CloseRequest() noexcept
 	if (response.status != http_status_t(0))
 		Log();
 
+	defer_early_hints.Cancel();
+	request.early_hints = {};
+
 	auto *_request = std::exchange(request.request, nullptr);
 
 	if ((request.read_state == Request::BODY ||
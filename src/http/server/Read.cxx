@@ -187,6 +187,10 @@ HttpServerConnection::ParseRequestLine(const char *line,
 		return false;
 	}
 
+	request.http_1_0 = space + 9 <= eol &&
+		memcmp(space + 1, "HTTP/1.0", 8) == 0;
+	request.early_hints = {};
+
 	request.request = http_server_request_new(this, method, {line, space});
 	request.read_state = Request::HEADERS;
 
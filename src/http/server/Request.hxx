@@ -56,4 +56,5 @@ struct HttpServerRequest final : public IncomingHttpRequest {
 	void SendResponse(http_status_t status,
 			  HttpHeaders &&response_headers,
 			  UnusedIstreamPtr response_body) noexcept override;
+	void SendEarlyHints(std::string_view link) noexcept override;
 };
@@ -41,6 +41,7 @@
 #include "istream/DechunkIstream.hxx"
 #include "istream/istream_memory.hxx"
 #include "http/Date.hxx"
+#include "AllocatorPtr.hxx"
 #include "event/Loop.hxx"
 #include "util/DecimalFormat.h"
 #include "util/SpanCast.hxx"
@@ -83,6 +84,56 @@ HttpServerConnection::MaybeSend100Continue()
 	return false;
 }
 
+void
+HttpServerConnection::SendEarlyHints(std::string_view link) noexcept
+{
+	assert(request.request != nullptr);
+
+	/* large hints are probably a mistake, and they would risk a
+	   partial write, which cannot be recovered from */
+	static constexpr std::size_t max_early_hints = 1024;
+
+	if (request.http_1_0 || request.upgrade ||
+	    response.status != http_status_t(0) ||
+	    link.empty() || link.size() > max_early_hints)
+		return;
+
+	const AllocatorPtr alloc(request.request->pool);
+	request.early_hints = alloc.Concat("HTTP/1.1 103 Early Hints\r\nlink: "sv,
+					   link, "\r\n\r\n"sv);
+	defer_early_hints.Schedule();
+}
+
+void
+HttpServerConnection::OnDeferredEarlyHints() noexcept
+{
+	if (request.request == nullptr ||
+	    response.status != http_status_t(0) ||
+	    request.early_hints.empty() || !IsValid())
+		return;
+
+	const auto s = std::exchange(request.early_hints, std::string_view{});
+
+	/* like "100 Continue", this is sent before the response has
+	   started, so the socket buffer is empty and a partial write
+	   is not expected */
+	ssize_t nbytes = socket->Write(AsBytes(s));
+	if (nbytes == (ssize_t)s.size()) [[likely]] {
+		request.request->stopwatch.RecordEvent("early_hints");
+		return;
+	}
+
+	if (nbytes == WRITE_BLOCKING)
+		/* the socket buffer is full; the hints are optional,
+		   so just drop them */
+		return;
+
+	if (nbytes == WRITE_ERRNO)
+		SocketErrorErrno("write error");
+	else if (nbytes != WRITE_DESTROYED)
+		SocketError("write error");
+}
+
 static std::size_t
 format_status_line(char *p, http_status_t status)
 {
@@ -114,6 +165,10 @@ HttpServerConnection::SubmitResponse(http_status_t status,
 
 	request.request->stopwatch.RecordEvent("response_headers");
 
+	/* too late for "103 Early Hints" */
+	defer_early_hints.Cancel();
+	request.early_hints = {};
+
 	if (http_status_is_success(status)) {
 		if (score == HTTP_SERVER_FIRST)
 			score = HTTP_SERVER_SUCCESS;
@@ -213,3 +268,11 @@ HttpServerRequest::SendResponse(http_status_t status,
 	connection.SubmitResponse(status, std::move(response_headers),
 				  std::move(response_body));
 }
+
+void
+HttpServerRequest::SendEarlyHints(std::string_view link) noexcept
+{
+	assert(connection.request.request == this);
+
+	connection.SendEarlyHints(link);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "UringOpen.hxx"
+#include "io/uring/Operation.hxx"
+#include "io/uring/Queue.hxx"
+#include "system/Error.hxx"
+#include "util/Cancellable.hxx"
+
+#include <string>
+
+#include <fcntl.h>
+
+class UringOpenOperation final : Uring::Operation, Cancellable {
+	/**
+	 * The handler; nullptr after Cancel().
+	 */
+	UringOpenHandler *handler;
+
+	const std::string path;
+
+public:
+	UringOpenOperation(const char *_path,
+			   UringOpenHandler &_handler) noexcept
+		:handler(&_handler), path(_path) {}
+
+	void Start(Uring::Queue &uring, FileDescriptor directory, int flags,
+		   CancellablePointer &cancel_ptr) noexcept {
+		cancel_ptr = *this;
+
+		auto &s = uring.RequireSubmitEntry();
+		io_uring_prep_openat(&s, directory.Get(), path.c_str(),
+				     flags|O_CLOEXEC|O_NOCTTY, 0);
+		uring.Push(s, *this);
+	}
+
+private:
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		/* the kernel still owns this object; it will be
+		   deleted (and the new file descriptor will be
+		   closed) in OnUringCompletion() */
+		handler = nullptr;
+	}
+
+	/* virtual methods from class Uring::Operation */
+	void OnUringCompletion(int res) noexcept override;
+};
+
+void
+UringOpenOperation::OnUringCompletion(int res) noexcept
+{
+	UniqueFileDescriptor fd;
+	std::exception_ptr error;
+
+	if (res >= 0)
+		fd = UniqueFileDescriptor(res);
+	else if (handler != nullptr)
+		error = std::make_exception_ptr(FormatErrno(-res,
+							    "Failed to open %s",
+							    path.c_str()));
+
+	auto *const _handler = handler;
+	delete this;
+
+	if (_handler == nullptr)
+		return;
+
+	if (fd.IsDefined())
+		_handler->OnUringOpen(std::move(fd));
+	else
+		_handler->OnUringOpenError(std::move(error));
+}
+
+void
+UringOpen(Uring::Queue &uring, FileDescriptor directory,
+	  const char *path, int flags,
+	  UringOpenHandler &handler,
+	  CancellablePointer &cancel_ptr) noexcept
+{
+	auto *operation = new UringOpenOperation(path, handler);
+	operation->Start(uring, directory, flags, cancel_ptr);
+}
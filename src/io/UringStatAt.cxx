@@ -0,0 +1,117 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "UringStatAt.hxx"
+#include "io/uring/Operation.hxx"
+#include "io/uring/Queue.hxx"
+#include "util/Cancellable.hxx"
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+class UringStatAtOperation final : Uring::Operation, Cancellable {
+	/**
+	 * The handler; nullptr after Cancel().
+	 */
+	UringStatHandler *handler;
+
+	const std::string path;
+
+	/**
+	 * Written by the kernel.
+	 */
+	struct statx st;
+
+public:
+	UringStatAtOperation(std::string &&_path,
+			     UringStatHandler &_handler) noexcept
+		:handler(&_handler), path(std::move(_path)) {}
+
+	void Start(Uring::Queue &uring, int flags, unsigned mask,
+		   CancellablePointer &cancel_ptr) noexcept {
+		cancel_ptr = *this;
+
+		auto &s = uring.RequireSubmitEntry();
+		io_uring_prep_statx(&s, AT_FDCWD, path.c_str(),
+				    flags, mask, &st);
+		uring.Push(s, *this);
+	}
+
+private:
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		/* the kernel may still write to "st"; this object
+		   will be deleted in OnUringCompletion() */
+		handler = nullptr;
+	}
+
+	/* virtual methods from class Uring::Operation */
+	void OnUringCompletion(int res) noexcept override {
+		auto *const _handler = handler;
+
+		if (_handler == nullptr) {
+			delete this;
+			return;
+		}
+
+		if (res < 0) {
+			delete this;
+			_handler->OnUringStatError(-res);
+			return;
+		}
+
+		const struct statx _st = st;
+		delete this;
+		_handler->OnUringStat(_st);
+	}
+};
+
+void
+UringStatAt(Uring::Queue &uring, const char *directory,
+	    const char *pathname, int flags, unsigned mask,
+	    UringStatHandler &handler,
+	    CancellablePointer &cancel_ptr) noexcept
+{
+	std::string path;
+	if (directory != nullptr && *pathname != '/') {
+		path = directory;
+		if (path.empty() || path.back() != '/')
+			path.push_back('/');
+	}
+
+	path.append(pathname);
+
+	auto *operation = new UringStatAtOperation(std::move(path), handler);
+	operation->Start(uring, flags, mask, cancel_ptr);
+}
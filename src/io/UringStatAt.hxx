@@ -0,0 +1,62 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+struct statx;
+class CancellablePointer;
+namespace Uring { class Queue; }
+
+class UringStatHandler {
+public:
+	virtual void OnUringStat(const struct statx &st) noexcept = 0;
+
+	/**
+	 * @param error the errno value
+	 */
+	virtual void OnUringStatError(int error) noexcept = 0;
+};
+
+/**
+ * The asynchronous version of StatAt(): call statx() with io_uring.
+ * Instead of opening the directory first, the two paths are
+ * concatenated, which is equivalent, because StatAt() does not
+ * restrict path resolution either.
+ *
+ * @param directory the directory which #pathname is relative to;
+ * nullptr means the current working directory
+ */
+void
+UringStatAt(Uring::Queue &uring, const char *directory,
+	    const char *pathname, int flags, unsigned mask,
+	    UringStatHandler &handler,
+	    CancellablePointer &cancel_ptr) noexcept;
@@ -151,6 +151,9 @@ LbCluster::LbCluster(const LbClusterConfig &_config,
 
 		auto &failure = failure_manager.Make(address);
 
+		if (config.min_idle > 0)
+			fs_stock.Warm(address, failure, config.min_idle);
+
 		static_members.emplace_back(std::move(address), failure);
 	}
 
@@ -168,6 +171,13 @@ LbCluster::~LbCluster() noexcept
 #endif
 }
 
+HttpPipeline *
+LbCluster::FindHttpPipeline(const FailureInfo &member) noexcept
+{
+	return http_pipelines.Find(member, fs_balancer.GetEventLoop().SteadyNow(),
+				   failure_manager.GetSlowStart());
+}
+
 void
 LbCluster::ConnectHttp(AllocatorPtr alloc,
 		       const StopwatchPtr &parent_stopwatch,
@@ -268,6 +278,8 @@ LbCluster::ConnectStaticTcp(AllocatorPtr alloc,
 struct LbCluster::ZeroconfListWrapper {
 	const ZeroconfMemberList &active_members;
 
+	const FailureInfo::Duration slow_start;
+
 	using const_reference = const ZeroconfMember &;
 	using const_iterator = DereferenceIterator<ZeroconfMemberList::const_iterator>;
 
@@ -288,6 +300,13 @@ struct LbCluster::ZeroconfListWrapper {
 		   bool allow_fade) const noexcept {
 		return member.GetFailureInfo().Check(now, allow_fade);
 	}
+
+	[[gnu::pure]]
+	unsigned GetSlowStartWeight(const Expiry now,
+				    const_reference member) const noexcept {
+		return member.GetFailureInfo().GetSlowStartWeight(now,
+								  slow_start);
+	}
 };
 
 LbCluster::ZeroconfMemberMap::const_reference
@@ -302,7 +321,8 @@ LbCluster::PickNextGoodZeroconf(const Expiry now) noexcept
 		return *active_zeroconf_members.front();
 
 	return round_robin_balancer.Get(now,
-					ZeroconfListWrapper{active_zeroconf_members},
+					ZeroconfListWrapper{active_zeroconf_members,
+							    failure_manager.GetSlowStart()},
 					false);
 }
 
@@ -500,6 +520,11 @@ LbCluster::ZeroconfHttpConnect::Start() noexcept
 
 	failure = member->GetFailureRef();
 
+	if (handler.OnFilteredSocketPick(member->GetAddress(), *failure)) {
+		Destroy();
+		return;
+	}
+
 	cluster.fs_stock.Get(alloc,
 			     nullptr,
 			     member->GetLogName(),
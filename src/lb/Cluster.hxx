@@ -37,6 +37,7 @@
 #include "event/Chrono.hxx"
 #include "net/AllocatedSocketAddress.hxx"
 #include "net/FailureRef.hxx"
+#include "http/Pipeline.hxx"
 #include "io/Logger.hxx"
 #include "util/LeakDetector.hxx"
 
@@ -120,6 +121,12 @@ class LbCluster final
 	 */
 	std::forward_list<LbMonitorRef> static_member_monitors;
 
+	/**
+	 * HTTP connections which accept more pipelined requests (see
+	 * LbClusterConfig::http_pipeline_depth), grouped by member.
+	 */
+	HttpPipelineList http_pipelines;
+
 #ifdef HAVE_AVAHI
 	class ZeroconfMember final
 		: LeakDetector,
@@ -230,6 +237,17 @@ public:
 		return config;
 	}
 
+	HttpPipelineList &GetHttpPipelines() noexcept {
+		return http_pipelines;
+	}
+
+	/**
+	 * Find a pipelined HTTP connection to the given member (which
+	 * was picked by the balancer) which accepts another request.
+	 */
+	[[gnu::pure]]
+	HttpPipeline *FindHttpPipeline(const FailureInfo &member) noexcept;
+
 	/**
 	 * Obtain a HTTP connection to a member (Zeroconf or static).
 	 */
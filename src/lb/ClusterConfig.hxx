@@ -95,6 +95,19 @@ struct LbClusterConfig {
 
 	bool mangle_via = false;
 
+	/**
+	 * The maximum number of outstanding requests on one HTTP/1.1
+	 * connection.  Values greater than 1 enable pipelining of
+	 * GET/HEAD requests without a request body.
+	 */
+	unsigned http_pipeline_depth = 1;
+
+	/**
+	 * The number of idle HTTP connections to each static member
+	 * which are kept ready.  0 disables this.
+	 */
+	unsigned min_idle = 0;
+
 #ifdef HAVE_AVAHI
 	/**
 	 * Enable the #StickyCache for Zeroconf?  By default, consistent
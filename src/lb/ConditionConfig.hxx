@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include "RegexCache.hxx"
 #include "lib/pcre/UniqueRegex.hxx"
 #include "net/MaskedSocketAddress.hxx"
 #include "util/Compiler.h"
@@ -90,7 +91,7 @@ struct LbConditionConfig {
 
 	bool negate;
 
-	std::variant<std::string, UniqueRegex, MaskedSocketAddress> value;
+	std::variant<std::string, SharedRegex, MaskedSocketAddress> value;
 
 	LbConditionConfig(LbAttributeReference &&a, bool _negate,
 			  const char *_string) noexcept
@@ -98,7 +99,7 @@ struct LbConditionConfig {
 		 negate(_negate), value(_string) {}
 
 	LbConditionConfig(LbAttributeReference &&a, bool _negate,
-			  UniqueRegex &&_regex) noexcept
+			  SharedRegex &&_regex) noexcept
 		:attribute_reference(std::move(a)),
 		 negate(_negate), value(std::move(_regex)) {}
 
@@ -141,8 +142,8 @@ private:
 			return v == s;
 		}
 
-		bool operator()(const UniqueRegex &v) const noexcept {
-			return v.Match(s);
+		bool operator()(const SharedRegex &v) const noexcept {
+			return v->Match(s);
 		}
 
 		bool operator()(const MaskedSocketAddress &) const noexcept {
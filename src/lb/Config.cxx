@@ -44,6 +44,21 @@ LbConfig::HandleSet(std::string_view name, const char *value)
 {
 	if (name == "tcp_stock_limit") {
 		tcp_stock_limit = ParseUnsignedLong(value);
+	} else if (name == "slow_start") {
+		slow_start = std::chrono::seconds(ParseUnsignedLong(value));
+	} else if (name == "outlier_errors") {
+		outlier.consecutive_errors = ParseUnsignedLong(value);
+	} else if (name == "outlier_latency_factor") {
+		outlier.latency_factor = ParseUnsignedLong(value);
+	} else if (name == "outlier_latency_samples") {
+		outlier.latency_samples = ParsePositiveLong(value, 1000);
+	} else if (name == "outlier_min_latency") {
+		outlier.min_latency = std::chrono::milliseconds(ParseUnsignedLong(value));
+	} else if (name == "stats_file") {
+		if (*value != '/')
+			throw std::runtime_error("Absolute path expected");
+
+		stats_file = value;
 	} else
 		throw std::runtime_error("Unknown variable");
 }
@@ -39,8 +39,11 @@
 #include "PrometheusExporterConfig.hxx"
 #include "access_log/Config.hxx"
 #include "net/SocketConfig.hxx"
+#include "net/OutlierConfig.hxx"
 #include "certdb/Config.hxx"
+#include "ssl/CacheConfig.hxx"
 
+#include <chrono>
 #include <map>
 #include <list>
 #include <string>
@@ -63,6 +66,8 @@ struct LbCertDatabaseConfig : CertDatabaseConfig {
 	 */
 	std::list<std::string> ca_certs;
 
+	CertCacheConfig cache;
+
 	explicit LbCertDatabaseConfig(const char *_name) noexcept
 		:name(_name) {}
 };
@@ -90,6 +95,25 @@ struct LbConfig {
 
 	unsigned tcp_stock_limit = 256;
 
+	/**
+	 * Members which have just recovered from a failure get only
+	 * a fraction of the traffic for this duration (see
+	 * FailureManager::SetSlowStart()).
+	 */
+	std::chrono::seconds slow_start{};
+
+	/**
+	 * Settings for the passive outlier detection (see
+	 * FailureManager::SetOutlierConfig()).
+	 */
+	OutlierConfig outlier;
+
+	/**
+	 * If not empty, then statistics are published in this
+	 * shared memory file (see StatsSegmentWriter).
+	 */
+	std::string stats_file;
+
 	LbConfig() noexcept;
 	~LbConfig() noexcept;
 
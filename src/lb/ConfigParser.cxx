@@ -33,6 +33,7 @@
 #include "Config.hxx"
 #include "PrometheusExporterConfig.hxx"
 #include "Check.hxx"
+#include "RegexCache.hxx"
 #include "access_log/ConfigParser.hxx"
 #include "io/FileLineParser.hxx"
 #include "io/ConfigParser.hxx"
@@ -53,6 +54,12 @@
 class LbConfigParser final : public NestedConfigParser {
 	LbConfig &config;
 
+	/**
+	 * Conditions with the same regular expression share one
+	 * compiled instance.
+	 */
+	RegexCache regex_cache;
+
 	class Control final : public ConfigParser {
 		LbConfigParser &parent;
 		LbControlConfig config;
@@ -294,6 +301,27 @@ LbConfigParser::CertDatabase::ParseLine(FileLineParser &line)
 	if (config.ParseLine(word, line)) {
 	} else if (strcmp(word, "ca_cert") == 0) {
 		config.ca_certs.emplace_back(line.ExpectValueAndEnd());
+	} else if (strcmp(word, "ctx_cache_megabytes") == 0) {
+		config.cache.max_contexts_size = std::size_t(line.NextPositiveInteger()) * 1024 * 1024;
+		line.ExpectEnd();
+	} else if (strcmp(word, "warmup") == 0) {
+		const char *value = line.ExpectValueAndEnd();
+		if (strcmp(value, "no") == 0)
+			config.cache.warmup = CertCacheConfig::Warmup::NONE;
+		else if (strcmp(value, "top") == 0)
+			config.cache.warmup = CertCacheConfig::Warmup::TOP;
+		else if (strcmp(value, "all") == 0)
+			config.cache.warmup = CertCacheConfig::Warmup::ALL;
+		else
+			throw LineParser::Error("Unknown warmup mode");
+	} else if (strcmp(word, "warmup_count") == 0) {
+		config.cache.warmup_count = line.NextPositiveInteger();
+		line.ExpectEnd();
+	} else if (strcmp(word, "warmup_megabytes") == 0) {
+		config.cache.max_warmup_size = std::size_t(line.NextPositiveInteger()) * 1024 * 1024;
+		line.ExpectEnd();
+	} else if (strcmp(word, "usage_file") == 0) {
+		config.cache.usage_file = line.ExpectValueAndEnd();
 	} else
 		throw std::runtime_error("Unknown option");
 }
@@ -303,6 +331,10 @@ LbConfigParser::CertDatabase::Finish()
 {
 	config.Check();
 
+	if (config.cache.warmup == CertCacheConfig::Warmup::TOP &&
+	    config.cache.usage_file.empty())
+		throw LineParser::Error("'warmup \"top\"' requires 'usage_file'");
+
 	auto i = parent.config.cert_dbs.emplace(std::string(config.name),
 						std::move(config));
 	if (!i.second)
@@ -681,6 +713,20 @@ LbConfigParser::Cluster::ParseLine(FileLineParser &line)
 	} else if (strcmp(word, "mangle_via") == 0) {
 		config.mangle_via = line.NextBool();
 
+		line.ExpectEnd();
+	} else if (strcmp(word, "http_pipeline_depth") == 0) {
+		unsigned value = line.NextPositiveInteger();
+		if (value > 64)
+			throw LineParser::Error("Pipeline depth is too large");
+
+		config.http_pipeline_depth = value;
+		line.ExpectEnd();
+	} else if (strcmp(word, "min_idle") == 0) {
+		unsigned value = line.NextPositiveInteger();
+		if (value > 16)
+			throw LineParser::Error("min_idle is too large");
+
+		config.min_idle = value;
 		line.ExpectEnd();
 	} else if (strcmp(word, "fallback") == 0) {
 		if (config.fallback.IsDefined())
@@ -744,6 +790,33 @@ LbConfigParser::Cluster::Finish()
 		   sense */
 		config.sticky_mode = StickyMode::NONE;
 
+	if (config.http_pipeline_depth > 1) {
+		/* pipelined requests share connections to the
+		   member picked by the balancer, regardless of the
+		   client's session and source address */
+		if (config.protocol != LbProtocol::HTTP)
+			throw LineParser::Error("http_pipeline_depth requires protocol \"http\"");
+
+		if (config.sticky_mode != StickyMode::NONE)
+			throw LineParser::Error("http_pipeline_depth is not compatible with sticky");
+
+		if (config.transparent_source)
+			throw LineParser::Error("http_pipeline_depth is not compatible with transparent source_address");
+	}
+
+	if (config.min_idle > 0) {
+		/* connections are created in advance, without
+		   knowing the client's address */
+		if (config.protocol != LbProtocol::HTTP)
+			throw LineParser::Error("min_idle requires protocol \"http\"");
+
+		if (config.transparent_source)
+			throw LineParser::Error("min_idle is not compatible with transparent source_address");
+
+		if (config.HasZeroConf())
+			throw LineParser::Error("min_idle is not compatible with Zeroconf");
+	}
+
 	auto i = parent.config.clusters.emplace(std::string(config.name),
 						std::move(config));
 	if (!i.second)
@@ -790,7 +863,7 @@ ParseAttributeReference(const char *p)
 }
 
 static LbConditionConfig
-ParseCondition(FileLineParser &line)
+ParseCondition(FileLineParser &line, RegexCache &regex_cache)
 {
 	if (!line.SkipSymbol('$'))
 		throw LineParser::Error("Attribute name starting with '$' expected");
@@ -844,7 +917,8 @@ ParseCondition(FileLineParser &line)
 		throw LineParser::Error("Regular expression expected");
 
 	if (re)
-		return {std::move(a), negate, UniqueRegex(string, false, false)};
+		return {std::move(a), negate,
+			regex_cache.Get(string, false, false)};
 	else
 		return {std::move(a), negate, string};
 }
@@ -886,7 +960,7 @@ LbConfigParser::Branch::AddGoto(LbGotoConfig &&destination,
 		if (if_ == nullptr || strcmp(if_, "if") != 0)
 			throw LineParser::Error("'if' or end of line expected");
 
-		auto condition = ParseCondition(line);
+		auto condition = ParseCondition(line, parent.regex_cache);
 
 		line.ExpectEnd();
 
@@ -35,6 +35,7 @@
 #include "Config.hxx"
 #include "pool/tpool.hxx"
 #include "pool/pool.hxx"
+#include "pool/NameStats.hxx"
 #include "translation/InvalidateParser.hxx"
 #include "net/ToString.hxx"
 #include "net/FailureManager.hxx"
@@ -201,6 +202,7 @@ failure_status_to_string(FailureStatus status) noexcept
 		return "fade";
 
 	case FailureStatus::PROTOCOL:
+	case FailureStatus::OUTLIER:
 	case FailureStatus::CONNECT:
 	case FailureStatus::MONITOR:
 		break;
@@ -346,8 +348,10 @@ LbControl::OnControlPacket(ControlServer &control_server,
 		break;
 
 	case ControlCommand::DUMP_POOLS:
-		if (is_privileged)
+		if (is_privileged) {
 			pool_dump_tree(instance.root_pool);
+			pool_dump_name_stats();
+		}
 		break;
 
 	case ControlCommand::STATS:
@@ -364,6 +368,7 @@ LbControl::OnControlPacket(ControlServer &control_server,
 	case ControlCommand::FLUSH_NFS_CACHE:
 	case ControlCommand::FLUSH_FILTER_CACHE:
 	case ControlCommand::STOPWATCH_PIPE:
+	case ControlCommand::STOPWATCH_RING:
 	case ControlCommand::DISCARD_SESSION:
 	case ControlCommand::FLUSH_HTTP_CACHE:
 		/* not applicable */
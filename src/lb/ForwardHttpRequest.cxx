@@ -45,6 +45,7 @@
 #include "address_string.hxx"
 #include "http/IncomingRequest.hxx"
 #include "http/Client.hxx"
+#include "http/Pipeline.hxx"
 #include "fs/Handler.hxx"
 #include "http/ResponseHandler.hxx"
 #include "http/Headers.hxx"
@@ -62,6 +63,8 @@
 #include "AllocatorPtr.hxx"
 #include "stopwatch.hxx"
 
+#include <optional>
+
 static constexpr Event::Duration LB_HTTP_CONNECT_TIMEOUT =
 	std::chrono::seconds(20);
 
@@ -85,8 +88,30 @@ class LbRequest final
 
 	FailurePtr failure;
 
+	/**
+	 * When was the last byte of the request sent to the backend?
+	 * Used by the passive outlier detection.  Unset if the
+	 * latency is not meaningful: if the request has a body (which
+	 * may be uploaded slowly by the client) or if it was sent on
+	 * a pipelined connection (where it waits for the responses
+	 * before it).
+	 */
+	std::optional<Event::TimePoint> send_time;
+
+	/**
+	 * Does the request have a body?  See #send_time.
+	 */
+	bool has_body = false;
+
 	unsigned new_cookie = 0;
 
+	/**
+	 * Shall this request be sent on a pipelined connection (see
+	 * LbClusterConfig::http_pipeline_depth)?  This is cleared
+	 * after a pipelined attempt has failed.
+	 */
+	bool pipeline = false;
+
 public:
 	LbRequest(LbHttpConnection &_connection, LbCluster &_cluster,
 		  IncomingHttpRequest &_request,
@@ -135,6 +160,10 @@ private:
 
 	SocketAddress MakeBindAddress() const noexcept;
 
+	void ForwardRequestHeaders() noexcept;
+
+	void Connect() noexcept;
+
 	/* virtual methods from class Cancellable */
 	void Cancel() noexcept override {
 		cancel_ptr.Cancel();
@@ -142,6 +171,8 @@ private:
 	}
 
 	/* virtual methods from class FilteredSocketBalancerHandler */
+	bool OnFilteredSocketPick(SocketAddress address,
+				  ReferencedFailureInfo &failure) noexcept override;
 	void OnFilteredSocketReady(Lease &lease,
 				   FilteredSocket &socket,
 				   SocketAddress address, const char *name,
@@ -152,6 +183,7 @@ private:
 	void OnHttpResponse(http_status_t status, StringMap &&headers,
 			    UnusedIstreamPtr body) noexcept override;
 	void OnHttpError(std::exception_ptr ep) noexcept override;
+	void OnHttpRequestSent() noexcept override;
 };
 
 static bool
@@ -274,8 +306,17 @@ void
 LbRequest::OnHttpResponse(http_status_t status, StringMap &&_headers,
 			  UnusedIstreamPtr response_body) noexcept
 {
+	const auto now = GetEventLoop().SteadyNow();
 	failure->UnsetProtocol();
 
+	std::optional<Event::Duration> latency;
+	if (send_time)
+		latency = now - *send_time;
+
+	failure->AddResult(connection.instance.failure_manager.GetOutlierConfig(),
+			   now, http_status_is_server_error(status),
+			   latency);
+
 	SetForwardedTo();
 
 	HttpHeaders headers(std::move(_headers));
@@ -306,6 +347,16 @@ LbRequest::OnHttpResponse(http_status_t status, StringMap &&_headers,
 void
 LbRequest::OnHttpError(std::exception_ptr ep) noexcept
 {
+	if (pipeline && IsHttpClientRetryFailure(ep)) {
+		/* the pipelined connection has failed before our
+		   response was received; the request is idempotent,
+		   so try again on a connection of its own */
+		connection.logger(4, "Retrying pipelined request: ", ep);
+		pipeline = false;
+		Connect();
+		return;
+	}
+
 	if (IsHttpClientServerFailure(ep))
 		failure->SetProtocol(GetEventLoop().SteadyNow(),
 				     std::chrono::seconds(20));
@@ -324,6 +375,34 @@ LbRequest::OnHttpError(std::exception_ptr ep) noexcept
 		_connection.SendError(_request, ep);
 }
 
+void
+LbRequest::OnHttpRequestSent() noexcept
+{
+	if (!has_body)
+		send_time = GetEventLoop().SteadyNow();
+}
+
+bool
+LbRequest::OnFilteredSocketPick(SocketAddress,
+				ReferencedFailureInfo &_failure) noexcept
+{
+	if (!pipeline)
+		return false;
+
+	/* try to send the request on an existing pipelined
+	   connection to the member picked by the balancer */
+	auto *p = cluster.FindHttpPipeline(_failure);
+	if (p == nullptr)
+		return false;
+
+	failure = _failure;
+	send_time.reset();
+
+	return p->SendRequest(pool, request.method, request.uri,
+			      request.headers, {},
+			      *this, cancel_ptr);
+}
+
 void
 LbRequest::OnFilteredSocketReady(Lease &lease,
 				 FilteredSocket &socket,
@@ -331,26 +410,24 @@ LbRequest::OnFilteredSocketReady(Lease &lease,
 				 ReferencedFailureInfo &_failure) noexcept
 {
 	failure = _failure;
-
-	const char *peer_subject = connection.ssl_filter != nullptr
-		? ssl_filter_get_peer_subject(*connection.ssl_filter)
-		: nullptr;
-	const char *peer_issuer_subject = connection.ssl_filter != nullptr
-		? ssl_filter_get_peer_issuer_subject(*connection.ssl_filter)
-		: nullptr;
-
-	auto &headers = request.headers;
-	lb_forward_request_headers(pool, headers,
-				   request.local_host_and_port,
-				   request.remote_host,
-				   connection.IsEncrypted(),
-				   peer_subject, peer_issuer_subject,
-				   cluster_config.mangle_via);
+	send_time.reset();
+
+	if (pipeline && !socket.HasFilter()) {
+		/* the first request on a new pipelined connection;
+		   this always succeeds */
+		auto &p = cluster.GetHttpPipelines()
+			.Add(socket, lease, name, _failure,
+			     cluster_config.http_pipeline_depth);
+		p.SendRequest(pool, request.method, request.uri,
+			      request.headers, {},
+			      *this, cancel_ptr);
+		return;
+	}
 
 	http_client_request(pool, nullptr,
 			    socket, lease, name,
 			    request.method, request.uri,
-			    headers, {},
+			    request.headers, {},
 			    std::move(body), true,
 			    *this, cancel_ptr);
 }
@@ -415,7 +492,25 @@ LbRequest::MakeBindAddress() const noexcept
 }
 
 inline void
-LbRequest::Start() noexcept
+LbRequest::ForwardRequestHeaders() noexcept
+{
+	const char *peer_subject = connection.ssl_filter != nullptr
+		? ssl_filter_get_peer_subject(*connection.ssl_filter)
+		: nullptr;
+	const char *peer_issuer_subject = connection.ssl_filter != nullptr
+		? ssl_filter_get_peer_issuer_subject(*connection.ssl_filter)
+		: nullptr;
+
+	lb_forward_request_headers(pool, request.headers,
+				   request.local_host_and_port,
+				   request.remote_host,
+				   connection.IsEncrypted(),
+				   peer_subject, peer_issuer_subject,
+				   cluster_config.mangle_via);
+}
+
+void
+LbRequest::Connect() noexcept
 {
 	cluster.ConnectHttp(pool, nullptr,
 			    MakeFairnessHash(),
@@ -426,6 +521,22 @@ LbRequest::Start() noexcept
 			    *this, cancel_ptr);
 }
 
+inline void
+LbRequest::Start() noexcept
+{
+	/* the headers are edited only once, because the request
+	   may be sent more than once (see OnHttpError()) */
+	ForwardRequestHeaders();
+
+	has_body = body;
+
+	pipeline = cluster_config.http_pipeline_depth > 1 &&
+		HttpPipeline::CanPipeline(request.method, request.uri,
+					  request.headers, body);
+
+	Connect();
+}
+
 void
 ForwardHttpRequest(LbHttpConnection &connection,
 		   IncomingHttpRequest &request,
@@ -41,6 +41,7 @@
 #include "fs/Balancer.hxx"
 #include "cluster/BalancerMap.hxx"
 #include "memory/fb_pool.hxx"
+#include "stats/SegmentWriter.hxx"
 #include "pipe_stock.hxx"
 #include "access_log/Glue.hxx"
 #include "util/PrintException.hxx"
@@ -65,6 +66,8 @@ LbInstance::LbInstance(const LbConfig &_config)
 	 shutdown_listener(event_loop, BIND_THIS_METHOD(ShutdownCallback)),
 	 sighup_event(event_loop, SIGHUP, BIND_THIS_METHOD(ReloadEventCallback)),
 	 compress_event(event_loop, BIND_THIS_METHOD(OnCompressTimer)),
+	 stats_segment_timer(event_loop,
+			     BIND_THIS_METHOD(OnStatsSegmentTimer)),
 	 balancer(new BalancerMap()),
 	 fs_stock(new FilteredSocketStock(event_loop,
 					  config.tcp_stock_limit)),
@@ -81,6 +84,8 @@ LbInstance::LbInstance(const LbConfig &_config)
 		  },
 		  event_loop)
 {
+	failure_manager.SetSlowStart(config.slow_start);
+	failure_manager.SetOutlierConfig(config.outlier);
 }
 
 LbInstance::~LbInstance() noexcept
@@ -123,7 +128,8 @@ LbInstance::GetCertCache(const LbCertDatabaseConfig &cert_db_config)
 	auto i = cert_dbs.emplace(std::piecewise_construct,
 				  std::forward_as_tuple(cert_db_config.name),
 				  std::forward_as_tuple(event_loop,
-							cert_db_config));
+							cert_db_config,
+							cert_db_config.cache));
 	if (i.second)
 		for (const auto &j : cert_db_config.ca_certs)
 			i.first->second.LoadCaCertificate(j.c_str());
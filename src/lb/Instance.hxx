@@ -61,6 +61,7 @@ class LbTcpConnection;
 class LbControl;
 class LbListener;
 class CertCache;
+class StatsSegmentWriter;
 namespace BengProxy { struct ControlStats; }
 namespace Avahi { class Client; class Publisher; struct Service; }
 
@@ -76,6 +77,13 @@ struct LbInstance final : PInstance, Avahi::ErrorHandler {
 
 	HttpStats http_stats;
 
+	/**
+	 * Publishes statistics in a shared memory file; see
+	 * LbConfig::stats_file.
+	 */
+	std::unique_ptr<StatsSegmentWriter> stats_segment;
+	FarTimerEvent stats_segment_timer;
+
 	std::forward_list<LbControl> controls;
 
 	/* stock */
@@ -135,6 +143,14 @@ struct LbInstance final : PInstance, Avahi::ErrorHandler {
 	[[gnu::pure]]
 	BengProxy::ControlStats GetStats() const noexcept;
 
+	/**
+	 * Open the file specified by LbConfig::stats_file and start
+	 * publishing statistics in it periodically.
+	 *
+	 * Throws on error.
+	 */
+	void EnableStatsSegment();
+
 	/**
 	 * Compress memory allocators, try to return unused memory areas
 	 * to the kernel.
@@ -162,6 +178,9 @@ struct LbInstance final : PInstance, Avahi::ErrorHandler {
 private:
 	void OnCompressTimer() noexcept;
 
+	void PublishStats() noexcept;
+	void OnStatsSegmentTimer() noexcept;
+
 	/* virtual methods from class Avahi::ErrorHandler */
 	bool OnAvahiError(std::exception_ptr e) noexcept override;
 };
@@ -86,6 +86,7 @@ LbInstance::ShutdownCallback() noexcept
 	thread_pool_stop();
 
 	compress_event.Cancel();
+	stats_segment_timer.Cancel();
 
 	DeinitAllControls();
 
@@ -213,6 +214,9 @@ try {
 	prctl(PR_SET_DUMPABLE, 1, 0, 0, 0);
 #endif
 
+	if (!config.stats_file.empty())
+		instance.EnableStatsSegment();
+
 	/* can't change to new (empty) rootfs if we may need to reconnect
 	   to PostgreSQL eventually */
 	// TODO: bind-mount the PostgreSQL socket into the new rootfs
@@ -37,6 +37,12 @@
 #include "Config.hxx"
 #include "prometheus/Stats.hxx"
 #include "prometheus/HttpStats.hxx"
+#include "prometheus/PoolStats.hxx"
+#include "prometheus/ThreadQueueStats.hxx"
+#include "prometheus/CertCacheStats.hxx"
+#include "pool/NameStats.hxx"
+#include "stats/ThreadQueueStats.hxx"
+#include "thread/Pool.hxx"
 #include "beng-proxy/Control.hxx"
 #include "http/Address.hxx"
 #include "http/Headers.hxx"
@@ -53,6 +59,10 @@
 #include "memory/GrowingBuffer.hxx"
 #include "stopwatch.hxx"
 
+#ifdef ENABLE_CERTDB
+#include "ssl/Cache.hxx"
+#endif
+
 class LbPrometheusExporter::AppendRequest final
 	: public HttpResponseHandler, Cancellable
 {
@@ -148,12 +158,20 @@ WriteStats(GrowingBuffer &buffer, const LbInstance &instance) noexcept
 	const char *process = "lb";
 
 	Prometheus::Write(buffer, process, instance.GetStats());
+	Prometheus::Write(buffer, process, pool_get_name_stats());
+	Prometheus::Write(buffer, process, thread_pool_get_stats());
 
 	for (const auto &listener : instance.listeners)
 		if (const auto *stats = listener.GetHttpStats())
 			Prometheus::Write(buffer, process,
 					  listener.GetConfig().name.c_str(),
 					  *stats);
+
+#ifdef ENABLE_CERTDB
+	for (const auto &[name, cache] : instance.cert_dbs)
+		Prometheus::Write(buffer, process, name.c_str(),
+				  cache.GetStats());
+#endif
 }
 
 void
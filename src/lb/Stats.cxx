@@ -31,18 +31,22 @@
  */
 
 #include "Instance.hxx"
+#include "Listener.hxx"
+#include "Config.hxx"
 #include "fs/Stock.hxx"
 #include "stock/Stats.hxx"
 #include "memory/fb_pool.hxx"
-#include "memory/SlicePool.hxx"
 #include "stats/AllocatorStats.hxx"
+#include "stats/Segment.hxx"
+#include "stats/SegmentWriter.hxx"
+#include "thread/Pool.hxx"
 #include "beng-proxy/Control.hxx"
 #include "util/ByteOrder.hxx"
 
 BengProxy::ControlStats
 LbInstance::GetStats() const noexcept
 {
-	BengProxy::ControlStats stats;
+	BengProxy::ControlStats stats{};
 
 	StockStats tcp_stock_stats{};
 
@@ -66,9 +70,59 @@ LbInstance::GetStats() const noexcept
 	stats.filter_cache_brutto_size = 0;
 	stats.nfs_cache_size = stats.nfs_cache_brutto_size = 0;
 
-	const auto io_buffers_stats = fb_pool_get().GetStats();
+	const auto io_buffers_stats = fb_pool_get_stats();
 	stats.io_buffers_size = ToBE64(io_buffers_stats.netto_size);
 	stats.io_buffers_brutto_size = ToBE64(io_buffers_stats.brutto_size);
 
+	static_assert(std::size(stats.io_buffers_class_size) == FB_N_SIZE_CLASSES);
+	for (unsigned i = 0; i < FB_N_SIZE_CLASSES; ++i)
+		stats.io_buffers_class_size[i] =
+			ToBE64(fb_pool_get_stats(i).netto_size);
+
 	return stats;
 }
+
+static constexpr Event::Duration STATS_SEGMENT_INTERVAL = std::chrono::seconds(1);
+
+void
+LbInstance::EnableStatsSegment()
+{
+	stats_segment = std::make_unique<StatsSegmentWriter>(config.stats_file.c_str(),
+							     "lb");
+	PublishStats();
+	stats_segment_timer.Schedule(STATS_SEGMENT_INTERVAL);
+}
+
+void
+LbInstance::PublishStats() noexcept
+{
+	/* collect everything which is not a plain copy before
+	   entering the seqlock, to keep the readers' retry window
+	   small */
+
+	const auto control = GetStats();
+
+	StockStats tcp_stock_stats{};
+	fs_stock->AddStats(tcp_stock_stats);
+
+	const auto thread_queue_stats = thread_pool_get_stats();
+
+	auto &data = stats_segment->BeginUpdate();
+	data.control = control;
+	data.tcp_stock = tcp_stock_stats;
+	data.thread_queue = thread_queue_stats;
+
+	for (const auto &listener : listeners)
+		if (const auto *stats = listener.GetHttpStats())
+			data.AddHttp(listener.GetConfig().name, nullptr,
+				     *stats);
+
+	stats_segment->EndUpdate();
+}
+
+void
+LbInstance::OnStatsSegmentTimer() noexcept
+{
+	PublishStats();
+	stats_segment_timer.Schedule(STATS_SEGMENT_INTERVAL);
+}
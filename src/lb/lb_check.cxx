@@ -46,7 +46,7 @@ static void
 lb_check(EventLoop &event_loop, const LbCertDatabaseConfig &config)
 {
 #ifdef ENABLE_CERTDB
-	CertCache cache(event_loop, config);
+	CertCache cache(event_loop, config, config.cache);
 
 	for (const auto &ca_path : config.ca_certs)
 		cache.LoadCaCertificate(ca_path.c_str());
@@ -62,6 +62,12 @@ struct RubberObject {
 	 */
 	size_t size;
 
+	/**
+	 * The number of Rubber::Pin() calls on this object.  While
+	 * this is non-zero, the object must not be moved.
+	 */
+	unsigned pins;
+
 #ifndef NDEBUG
 	bool allocated;
 #endif
@@ -69,6 +75,7 @@ struct RubberObject {
 	void Init(size_t _offset, size_t _size) noexcept {
 		offset = _offset;
 		size = _size;
+		pins = 0;
 #ifndef NDEBUG
 		allocated = true;
 #endif
@@ -78,6 +85,7 @@ struct RubberObject {
 		next = previous = 0;
 		offset = 0;
 		size = _size;
+		pins = 0;
 	}
 
 	constexpr size_t GetEndOffset() const noexcept {
@@ -225,6 +233,14 @@ struct RubberTable {
 
 static constexpr size_t RUBBER_ALIGN = 0x20;
 
+/**
+ * The approximate maximum number of bytes which Add() may move to
+ * make room for a new object.  The rest is left to the periodic
+ * incremental compression, so a single allocation never stalls the
+ * event loop for long.
+ */
+static constexpr size_t ADD_COMPRESS_BUDGET = 256 * 1024;
+
 [[gnu::const]]
 static inline void *
 align_page_size_ptr(void *p) noexcept
@@ -693,6 +709,10 @@ inline bool
 Rubber::MoveLast(size_t max_object_size) noexcept
 {
 	const auto id = table->entries[0].previous;
+	if (IsPinned(id))
+		/* somebody holds a pointer to this object's data */
+		return false;
+
 	const auto t = table.get();
 	auto &o = t->entries[id];
 	if (o.size > max_object_size)
@@ -755,26 +775,45 @@ Rubber::Add(size_t size) noexcept
 			return id;
 	}
 
-	if (GetBruttoSize() / 3 >= netto_size)
-		/* auto-compress when a lot of allocations have been freed */
-		Compress();
-	else
-		while (MoveLast(size - 1)) {}
+	if (GetBruttoSize() / 3 >= netto_size) {
+		/* a lot of allocations have been freed: compress a
+		   bit, which merges holes and may shrink the tail */
+		CompressStep(ADD_COMPRESS_BUDGET);
+
+		if (netto_size + size <= GetBruttoSize()) {
+			unsigned id = AddInHole(size);
+			if (id != 0)
+				return id;
+		}
+	} else {
+		/* each moved object is smaller than the new one */
+		for (size_t moved = 0;
+		     moved < ADD_COMPRESS_BUDGET && MoveLast(size - 1);
+		     moved += size) {}
+	}
 
 	size_t offset = table->GetTailOffset();
 	if (offset + size > table.size()) {
-		/* compress, then try again */
-		Compress();
+		/* compress a bit more, then try again */
+		CompressStep(ADD_COMPRESS_BUDGET);
+
+		if (netto_size + size <= GetBruttoSize()) {
+			unsigned id = AddInHole(size);
+			if (id != 0)
+				return id;
+		}
 
 		offset = table->GetTailOffset();
 		if (offset + size > table.size())
-			/* no, sorry, there's simply not enough free memory */
+			/* no, sorry, there's not enough free memory
+			   right now */
 			return 0;
 	}
 
 	const unsigned id = table->Add(offset, size);
 	if (id > 0) {
 		netto_size += size;
+		dirty_end = std::max(dirty_end, offset + size);
 	}
 
 	assert(netto_size + GetTotalHoleSize() == GetBruttoSize());
@@ -869,6 +908,38 @@ Rubber::ReplaceWithHole(RubberObject &o,
 		AddHoleAfter(previous_id, o.offset, o.size);
 }
 
+void
+Rubber::Pin(unsigned id) noexcept
+{
+	assert(id > 0);
+
+	auto &o = table->entries[id];
+	assert(o.allocated);
+
+	++o.pins;
+	++n_pins;
+}
+
+void
+Rubber::Unpin(unsigned id) noexcept
+{
+	assert(id > 0);
+
+	auto &o = table->entries[id];
+	assert(o.allocated);
+	assert(o.pins > 0);
+	assert(n_pins > 0);
+
+	--o.pins;
+	--n_pins;
+}
+
+bool
+Rubber::IsPinned(unsigned id) const noexcept
+{
+	return n_pins > 0 && table->entries[id].pins > 0;
+}
+
 void
 Rubber::Remove(unsigned id) noexcept
 {
@@ -877,9 +948,16 @@ Rubber::Remove(unsigned id) noexcept
 	auto &o = table->entries[id];
 	assert(o.allocated);
 
+	assert(!IsPinned(id));
+
 	const unsigned previous_id = o.previous;
 	const unsigned next_id = o.next;
 
+	if (id == compress_cursor)
+		/* the incremental compression resumes at the
+		   previous object */
+		compress_cursor = previous_id;
+
 	size_t size = table->Remove(id);
 	assert(netto_size >= size);
 
@@ -922,40 +1000,103 @@ Rubber::GetStats() const noexcept
 	return stats;
 }
 
+inline size_t
+Rubber::MoveDown(RubberObject &previous, RubberObject &o) noexcept
+{
+	auto *hole = FindHoleBetween(previous, o);
+	if (hole == nullptr)
+		return 0;
+
+	assert(hole->previous_id == table->IdOf(previous));
+	assert(hole->next_id == table->IdOf(o));
+	assert(previous.GetEndOffset() + hole->size == o.offset);
+
+	/* the hole will be overwritten by MoveData() */
+	const size_t hole_size = hole->size;
+	RemoveHole(*hole);
+
+	MoveData(o, previous.GetEndOffset());
+
+	if (o.next != 0)
+		/* the hole moves behind this object (and may be merged
+		   with another hole there) */
+		AddHoleAfter(table->IdOf(o), o.GetEndOffset(), hole_size);
+
+	return o.size;
+}
+
 void
-Rubber::Compress() noexcept
+Rubber::DiscardTail() noexcept
+{
+	const size_t tail = table->GetTailOffset();
+	const size_t allocated = AlignHugePageUp(tail);
+	const size_t end = AlignHugePageUp(dirty_end);
+
+	if (allocated < end) {
+		assert(end <= table.size());
+		DiscardPages(WriteAt(allocated), end - allocated);
+	}
+
+	dirty_end = tail;
+}
+
+bool
+Rubber::CompressStep(size_t max_bytes) noexcept
 {
 	assert(GetBruttoSize() >= netto_size);
 	assert(netto_size + GetTotalHoleSize() == GetBruttoSize());
 
 	if (GetBruttoSize() == netto_size) {
+		/* there are no holes */
 #ifndef NDEBUG
 		for (const auto &i : holes)
 			assert(i.empty());
 #endif
-		return;
+
+		compress_cursor = 0;
+		DiscardTail();
+		return true;
 	}
 
-	for (auto &i : holes)
-		i.clear();
+	/* visiting an object costs something even if it doesn't need
+	   to be moved; this limits the number of iterations */
+	constexpr size_t VISIT_COST = 64;
+
+	RubberObject *previous = &table->entries[compress_cursor];
+	assert(previous->allocated);
+
+	size_t done = 0;
+	RubberObject *o;
+	while ((o = table->GetNext(previous)) != nullptr) {
+		if (done >= max_bytes) {
+			/* this slice is finished; resume later */
+			compress_cursor = table->IdOf(*previous);
+			assert(netto_size + GetTotalHoleSize() == GetBruttoSize());
+			return false;
+		}
 
-	/* relocate all items, eliminate spaces */
+		done += VISIT_COST;
 
-	RubberObject *o = table->GetHead();
-	assert(o->offset == 0);
-	size_t offset = o->size;
+		if (!IsPinned(table->IdOf(*o)))
+			done += MoveDown(*previous, *o);
 
-	while ((o = table->GetNext(o)) != nullptr) {
-		MoveData(*o, offset);
-		offset += o->size;
+		previous = o;
 	}
 
-	assert(offset == netto_size + table->GetSize());
-	assert(netto_size == GetBruttoSize());
+	assert(netto_size + GetTotalHoleSize() == GetBruttoSize());
+
+	compress_cursor = 0;
+	DiscardTail();
+	return true;
+}
+
+void
+Rubber::Compress() noexcept
+{
+	/* start a new pass from the beginning */
+	compress_cursor = 0;
+
+	while (!CompressStep(SIZE_MAX)) {}
 
-	/* tell the kernel that we won't need the data after our last
-	   allocation */
-	const size_t allocated = AlignHugePageUp(offset);
-	if (allocated < table.size())
-		DiscardPages(WriteAt(allocated), table.size() - allocated);
+	assert(n_pins > 0 || netto_size == GetBruttoSize());
 }
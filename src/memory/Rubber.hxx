@@ -100,6 +100,27 @@ class Rubber {
 	 */
 	std::array<HoleList, N_HOLE_THRESHOLDS> holes;
 
+	/**
+	 * The number of Pin() calls which have not yet been undone by
+	 * Unpin(), for all objects.  The per-object counter is
+	 * RubberObject::pins.
+	 */
+	unsigned n_pins = 0;
+
+	/**
+	 * The id of the object after which CompressStep() shall
+	 * resume.  0 means the next pass starts at the beginning of
+	 * the table.
+	 */
+	unsigned compress_cursor = 0;
+
+	/**
+	 * The highest end offset of all allocations since the last
+	 * DiscardTail() call.  Pages between the current tail and
+	 * this offset may still be populated.
+	 */
+	size_t dirty_end = 0;
+
 public:
 	/**
 	 * Throws std::bad_alloc on error.
@@ -137,12 +158,46 @@ public:
 	[[gnu::pure]]
 	AllocatorStats GetStats() const noexcept;
 
+	/**
+	 * Move all (unpinned) objects to eliminate holes, and give
+	 * unused memory back to the kernel.  This may take a long
+	 * time; CompressStep() is an incremental alternative.
+	 */
 	void Compress() noexcept;
 
+	/**
+	 * Perform one slice of incremental compression: move objects
+	 * into the holes before them until approximately #max_bytes
+	 * have been processed.  At least one object is processed,
+	 * even if it is larger than #max_bytes.  The next call
+	 * resumes where this one stopped; allocating and removing
+	 * objects between calls is allowed.
+	 *
+	 * @return true if the pass is complete, false if more calls
+	 * are needed
+	 */
+	bool CompressStep(size_t max_bytes) noexcept;
+
+	/**
+	 * Prevent the given object from being moved by Compress() and
+	 * CompressStep() until Unpin() is called.  Calls may be
+	 * nested.
+	 */
+	void Pin(unsigned id) noexcept;
+	void Unpin(unsigned id) noexcept;
+
+	[[gnu::pure]]
+	bool IsPinned(unsigned id) const noexcept;
+
 	/**
 	 * Add a new object with the specified size.  Use Write() to
 	 * actually copy data to the object.
 	 *
+	 * If there is not enough contiguous space, only a bounded
+	 * amount of compression is done (see CompressStep()); the
+	 * allocation may then fail even though a full Compress()
+	 * would have made room for it.
+	 *
 	 * @param size the size, must be positive
 	 * @return the object id, or 0 on error
 	 */
@@ -274,6 +329,21 @@ private:
 
 	void MoveData(RubberObject &o, size_t new_offset) noexcept;
 
+	/**
+	 * If there is a hole between the two (adjacent) objects, move
+	 * the second object down to eliminate it; the hole is then
+	 * moved behind the object.
+	 *
+	 * @return the number of bytes which were copied
+	 */
+	size_t MoveDown(RubberObject &previous, RubberObject &o) noexcept;
+
+	/**
+	 * Tell the kernel that we won't need the pages after the last
+	 * allocation.
+	 */
+	void DiscardTail() noexcept;
+
 	HoleList &GetHoleList(size_t size) noexcept {
 		return holes[LookupHoleThreshold(size)];
 	}
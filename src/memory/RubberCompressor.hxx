@@ -0,0 +1,85 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "stats/CompressStats.hxx"
+#include "event/DeferEvent.hxx"
+
+#include <cstddef>
+
+class Rubber;
+
+/**
+ * Compress a #Rubber allocator incrementally, one small slice per
+ * event loop iteration, to avoid blocking the event loop for a
+ * long time.
+ */
+class RubberCompressor {
+	/**
+	 * The number of bytes which may be moved in one slice.
+	 */
+	static constexpr std::size_t SLICE_BYTES = 1024 * 1024;
+
+	Rubber &rubber;
+
+	DeferEvent defer_event;
+
+	CompressStats stats;
+
+public:
+	RubberCompressor(EventLoop &event_loop, Rubber &_rubber) noexcept
+		:rubber(_rubber),
+		 defer_event(event_loop, BIND_THIS_METHOD(OnDeferred)) {}
+
+	const CompressStats &GetStats() const noexcept {
+		return stats;
+	}
+
+	bool IsRunning() const noexcept {
+		return defer_event.IsPending();
+	}
+
+	/**
+	 * Start a compression pass (unless one is already running).
+	 */
+	void Start() noexcept {
+		defer_event.ScheduleIdle();
+	}
+
+	void Cancel() noexcept {
+		defer_event.Cancel();
+	}
+
+private:
+	void OnDeferred() noexcept;
+};
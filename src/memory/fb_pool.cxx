@@ -32,48 +32,80 @@
 
 #include "fb_pool.hxx"
 #include "SlicePool.hxx"
+#include "stats/AllocatorStats.hxx"
 
 #include <assert.h>
 
-static SlicePool *fb_pool;
+/**
+ * The size of each #SliceArea; it is the same for all size classes.
+ */
+static constexpr size_t FB_AREA_SIZE = 8 * 1024 * 1024;
+
+static SlicePool *fb_pools[FB_N_SIZE_CLASSES];
 
 void
 fb_pool_init()
 {
-	assert(fb_pool == nullptr);
+	for (unsigned i = 0; i < FB_N_SIZE_CLASSES; ++i) {
+		assert(fb_pools[i] == nullptr);
 
-	fb_pool = new SlicePool(FB_SIZE, 256, "io_buffers");
+		fb_pools[i] = new SlicePool(FB_SIZE_CLASSES[i],
+					    FB_AREA_SIZE / FB_SIZE_CLASSES[i],
+					    "io_buffers");
+	}
 }
 
 void
 fb_pool_deinit(void)
 {
-	assert(fb_pool != nullptr);
+	for (auto &i : fb_pools) {
+		assert(i != nullptr);
 
-	delete fb_pool;
-	fb_pool = nullptr;
+		delete i;
+		i = nullptr;
+	}
 }
 
 void
 fb_pool_fork_cow(bool inherit)
 {
-	assert(fb_pool != nullptr);
+	for (auto *i : fb_pools) {
+		assert(i != nullptr);
 
-	fb_pool->ForkCow(inherit);
+		i->ForkCow(inherit);
+	}
 }
 
 SlicePool &
-fb_pool_get()
+fb_pool_get(unsigned size_class)
+{
+	assert(size_class < FB_N_SIZE_CLASSES);
+	assert(fb_pools[size_class] != nullptr);
+
+	return *fb_pools[size_class];
+}
+
+AllocatorStats
+fb_pool_get_stats() noexcept
 {
-	assert(fb_pool != nullptr);
+	AllocatorStats stats = AllocatorStats::Zero();
+	for (unsigned i = 0; i < FB_N_SIZE_CLASSES; ++i)
+		stats += fb_pool_get_stats(i);
+	return stats;
+}
 
-	return *fb_pool;
+AllocatorStats
+fb_pool_get_stats(unsigned size_class) noexcept
+{
+	return fb_pool_get(size_class).GetStats();
 }
 
 void
 fb_pool_compress(void)
 {
-	assert(fb_pool != nullptr);
+	for (auto *i : fb_pools) {
+		assert(i != nullptr);
 
-	fb_pool->Compress();
+		i->Compress();
+	}
 }
@@ -37,12 +37,44 @@
 
 #pragma once
 
+#include <iterator>
+
 #include <stddef.h>
 
+struct AllocatorStats;
 class SlicePool;
 
 static constexpr size_t FB_SIZE = 32768;
 
+/**
+ * The buffer size classes.  Buffers which adapt their size to the
+ * traffic (see #DefaultFifoBuffer) move between these.
+ */
+static constexpr size_t FB_SIZE_CLASSES[] = {
+	4096, 16384, FB_SIZE, 65536, 262144,
+};
+
+static constexpr unsigned FB_N_SIZE_CLASSES = std::size(FB_SIZE_CLASSES);
+
+/**
+ * The size class returned by fb_pool_get() without parameter.
+ */
+static constexpr unsigned FB_DEFAULT_SIZE_CLASS = 2;
+static_assert(FB_SIZE_CLASSES[FB_DEFAULT_SIZE_CLASS] == FB_SIZE);
+
+/**
+ * Determine the size class of a buffer with the given capacity.
+ */
+[[gnu::const]]
+constexpr unsigned
+fb_size_class(size_t capacity) noexcept
+{
+	unsigned i = 0;
+	while (i < FB_N_SIZE_CLASSES - 1 && FB_SIZE_CLASSES[i] < capacity)
+		++i;
+	return i;
+}
+
 /**
  * Global initialization.
  */
@@ -60,7 +92,25 @@ fb_pool_fork_cow(bool inherit);
 
 [[gnu::const]]
 SlicePool &
-fb_pool_get();
+fb_pool_get(unsigned size_class);
+
+[[gnu::const]]
+inline SlicePool &
+fb_pool_get()
+{
+	return fb_pool_get(FB_DEFAULT_SIZE_CLASS);
+}
+
+/**
+ * Obtain statistics of all size classes.
+ */
+[[gnu::pure]]
+AllocatorStats
+fb_pool_get_stats() noexcept;
+
+[[gnu::pure]]
+AllocatorStats
+fb_pool_get_stats(unsigned size_class) noexcept;
 
 /**
  * Give free memory back to the kernel.  The library will
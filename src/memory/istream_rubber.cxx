@@ -56,9 +56,17 @@ public:
 		      size_t start, size_t _end,
 		      bool _auto_remove) noexcept
 		:Istream(p), rubber(_rubber), id(_id), auto_remove(_auto_remove),
-		 position(start), end(_end) {}
+		 position(start), end(_end)
+	{
+		/* pointers to the object's data may be passed to
+		   our handler in buckets; don't let the incremental
+		   compression move it while we're reading */
+		rubber.Pin(id);
+	}
 
 	~RubberIstream() noexcept override {
+		rubber.Unpin(id);
+
 		if (auto_remove)
 			rubber.Remove(id);
 	}
@@ -31,6 +31,9 @@
  */
 
 #include "FailureInfo.hxx"
+#include "OutlierConfig.hxx"
+
+#include <algorithm>
 
 void
 FailureInfo::Set(Expiry now,
@@ -49,6 +52,11 @@ FailureInfo::Set(Expiry now,
 		SetProtocol(now, duration);
 		break;
 
+	case FailureStatus::OUTLIER:
+		outlier_expires.Touch(now, duration);
+		Disabled(outlier_expires);
+		break;
+
 	case FailureStatus::CONNECT:
 		SetConnect(now, duration);
 		break;
@@ -75,6 +83,10 @@ FailureInfo::Unset(FailureStatus unset_status) noexcept
 		UnsetProtocol();
 		break;
 
+	case FailureStatus::OUTLIER:
+		UnsetOutlier();
+		break;
+
 	case FailureStatus::CONNECT:
 		UnsetConnect();
 		break;
@@ -84,3 +96,110 @@ FailureInfo::Unset(FailureStatus unset_status) noexcept
 		break;
 	}
 }
+
+void
+FailureInfo::UnsetFade() noexcept
+{
+	if (!CheckFade(Expiry::Now()))
+		Enabled();
+
+	fade_expires = Expiry::AlreadyExpired();
+}
+
+void
+FailureInfo::UnsetMonitor() noexcept
+{
+	if (monitor)
+		Enabled();
+
+	monitor = false;
+}
+
+void
+FailureInfo::UnsetAll() noexcept
+{
+	if (!Check(Expiry::Now()))
+		Enabled();
+
+	fade_expires = protocol_expires = connect_expires =
+		outlier_expires = Expiry::AlreadyExpired();
+	protocol_counter = 0;
+	consecutive_server_errors = 0;
+	consecutive_slow_responses = 0;
+	outlier_ejections = 0;
+	recovering = false;
+	monitor = false;
+}
+
+void
+FailureInfo::SetOutlier(Expiry now) noexcept
+{
+	/* after a long period without ejections, start over with
+	   the base duration */
+	if (Expiry::Touched(outlier_expires,
+			    OUTLIER_MAX_DURATION).IsExpired(now))
+		outlier_ejections = 0;
+
+	const auto duration =
+		std::min(OUTLIER_BASE_DURATION * (1U << std::min(outlier_ejections, 5U)),
+			 OUTLIER_MAX_DURATION);
+	++outlier_ejections;
+
+	outlier_expires.Touch(now, duration);
+	Disabled(outlier_expires);
+
+	/* give the host a fresh start after the ejection */
+	consecutive_server_errors = 0;
+	consecutive_slow_responses = 0;
+}
+
+void
+FailureInfo::AddResult(const OutlierConfig &config, Expiry now,
+		       bool server_error,
+		       std::optional<Duration> latency) noexcept
+{
+	if (!config.IsEnabled())
+		return;
+
+	if (server_error) {
+		if (config.consecutive_errors > 0 &&
+		    ++consecutive_server_errors >= config.consecutive_errors)
+			SetOutlier(now);
+
+		/* error responses are often much faster than regular
+		   ones; keep them out of the latency statistics */
+		return;
+	}
+
+	consecutive_server_errors = 0;
+
+	if (config.latency_factor == 0 || !latency)
+		return;
+
+	if (latency_samples == 0) {
+		latency_baseline = *latency;
+		++latency_samples;
+		return;
+	}
+
+	const bool deviating = latency_samples >= OUTLIER_MIN_SAMPLES &&
+		*latency >= config.min_latency &&
+		*latency > latency_baseline * config.latency_factor;
+
+	/* the baseline follows slowly, so a host which has become
+	   slower permanently is eventually accepted again */
+	latency_baseline += (*latency - latency_baseline) / 64;
+
+	if (latency_samples < OUTLIER_MIN_SAMPLES)
+		++latency_samples;
+
+	if (!deviating) {
+		consecutive_slow_responses = 0;
+		return;
+	}
+
+	/* eject the host only if several responses in a row
+	   deviate; a single slow request is not enough */
+	if (++consecutive_slow_responses >= config.latency_samples)
+		SetOutlier(now);
+}
@@ -35,15 +35,87 @@
 #include "FailureStatus.hxx"
 #include "util/Expiry.hxx"
 
+#include <chrono>
+#include <optional>
+
+struct OutlierConfig;
+
 class FailureInfo {
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The slow-start weight of a member which is fully warmed up;
+	 * see GetSlowStartWeight().
+	 */
+	static constexpr unsigned SLOW_START_STEPS = 8;
+
+private:
+	/**
+	 * After this many protocol failures, the host is considered
+	 * failed (until #protocol_expires).
+	 */
+	static constexpr unsigned PROTOCOL_THRESHOLD = 8;
+
+	/**
+	 * The number of responses needed to establish a latency
+	 * baseline before latency ejection kicks in.
+	 */
+	static constexpr unsigned OUTLIER_MIN_SAMPLES = 32;
+
+	/**
+	 * The duration of the first ejection; it doubles with each
+	 * further ejection up to #OUTLIER_MAX_DURATION.
+	 */
+	static constexpr Duration OUTLIER_BASE_DURATION = std::chrono::seconds(10);
+	static constexpr Duration OUTLIER_MAX_DURATION = std::chrono::minutes(5);
+
 	Expiry fade_expires = Expiry::AlreadyExpired();
 
 	Expiry protocol_expires = Expiry::AlreadyExpired();
 
 	Expiry connect_expires = Expiry::AlreadyExpired();
 
+	Expiry outlier_expires = Expiry::AlreadyExpired();
+
+	/**
+	 * The time when this host has been (or will be) enabled again
+	 * after the most recent failure.  This is the starting point
+	 * of the slow-start ramp.
+	 */
+	Expiry enabled_since = Expiry::AlreadyExpired();
+
+	/**
+	 * Exponential moving average of the response latency which
+	 * serves as the baseline for the outlier detection.
+	 */
+	Duration latency_baseline{};
+
+	unsigned latency_samples = 0;
+
 	unsigned protocol_counter = 0;
 
+	unsigned consecutive_server_errors = 0;
+
+	/**
+	 * The number of consecutive responses whose latency deviated
+	 * from #latency_baseline.
+	 */
+	unsigned consecutive_slow_responses = 0;
+
+	/**
+	 * The number of recent outlier ejections; determines the
+	 * duration of the next one.
+	 */
+	unsigned outlier_ejections = 0;
+
+	/**
+	 * Has #enabled_since been set to the expiry of a failure
+	 * which has not yet been confirmed to be over by a
+	 * successful request?
+	 */
+	bool recovering = false;
+
 	bool monitor = false;
 
 public:
@@ -52,6 +124,8 @@ public:
 			return FailureStatus::MONITOR;
 		else if (!CheckConnect(now))
 			return FailureStatus::CONNECT;
+		else if (!CheckOutlier(now))
+			return FailureStatus::OUTLIER;
 		else if (!CheckProtocol(now))
 			return FailureStatus::PROTOCOL;
 		else if (!CheckFade(now))
@@ -63,6 +137,7 @@ public:
 	constexpr bool Check(Expiry now, bool allow_fade=false) const noexcept {
 		return CheckMonitor() &&
 			CheckConnect(now) &&
+			CheckOutlier(now) &&
 			CheckProtocol(now) &&
 			(allow_fade || CheckFade(now));
 	}
@@ -86,9 +161,7 @@ public:
 		fade_expires.Touch(now, duration);
 	}
 
-	void UnsetFade() noexcept {
-		fade_expires = Expiry::AlreadyExpired();
-	}
+	void UnsetFade() noexcept;
 
 	constexpr bool CheckFade(Expiry now) const noexcept {
 		return fade_expires.IsExpired(now);
@@ -96,46 +169,130 @@ public:
 
 	void SetProtocol(Expiry now, std::chrono::seconds duration) noexcept {
 		protocol_expires.Touch(now, duration);
-		++protocol_counter;
+		if (++protocol_counter >= PROTOCOL_THRESHOLD)
+			Disabled(protocol_expires);
 	}
 
 	void UnsetProtocol() noexcept {
 		protocol_expires = Expiry::AlreadyExpired();
 		protocol_counter = 0;
+		Recovered();
 	}
 
 	constexpr bool CheckProtocol(Expiry now) const noexcept {
-		return protocol_expires.IsExpired(now) || protocol_counter < 8;
+		return protocol_expires.IsExpired(now) ||
+			protocol_counter < PROTOCOL_THRESHOLD;
 	}
 
 	void SetConnect(Expiry now, std::chrono::seconds duration) noexcept {
 		connect_expires.Touch(now, duration);
+		Disabled(connect_expires);
 	}
 
 	void UnsetConnect() noexcept {
 		connect_expires = Expiry::AlreadyExpired();
+		Recovered();
 	}
 
 	constexpr bool CheckConnect(Expiry now) const noexcept {
 		return connect_expires.IsExpired(now);
 	}
 
+	/**
+	 * Eject this host for a while; the duration grows
+	 * exponentially with each ejection.
+	 */
+	void SetOutlier(Expiry now) noexcept;
+
+	void UnsetOutlier() noexcept {
+		outlier_expires = Expiry::AlreadyExpired();
+		consecutive_server_errors = 0;
+		consecutive_slow_responses = 0;
+		outlier_ejections = 0;
+	}
+
+	constexpr bool CheckOutlier(Expiry now) const noexcept {
+		return outlier_expires.IsExpired(now);
+	}
+
+	/**
+	 * Submit the result of a request to the passive outlier
+	 * detection.  The host gets ejected after too many
+	 * consecutive server errors, or if the latency of several
+	 * consecutive responses is far above its own long-term
+	 * average.
+	 *
+	 * @param server_error did the host respond with a server
+	 * error (5xx)?
+	 * @param latency the time between sending the last byte of
+	 * the request and receiving the response header; nullopt if
+	 * it is not meaningful (e.g. because the request had a body
+	 * or was queued in a pipeline)
+	 */
+	void AddResult(const OutlierConfig &config, Expiry now,
+		       bool server_error,
+		       std::optional<Duration> latency) noexcept;
+
 	void SetMonitor() noexcept {
 		monitor = true;
 	}
 
-	void UnsetMonitor() noexcept {
-		monitor = false;
-	}
+	void UnsetMonitor() noexcept;
 
 	constexpr bool CheckMonitor() const noexcept {
 		return !monitor;
 	}
 
-	void UnsetAll() noexcept {
-		fade_expires = protocol_expires = connect_expires =
-			Expiry::AlreadyExpired();
-		protocol_counter = 0;
-		monitor = false;
+	void UnsetAll() noexcept;
+
+	/**
+	 * Calculate the slow-start weight of this host: during the
+	 * given duration after it has been enabled again, the weight
+	 * ramps up linearly from 1 to #SLOW_START_STEPS.  Balancers
+	 * use it to pass only a fraction of the traffic to hosts
+	 * which have just recovered.
+	 */
+	[[gnu::pure]]
+	unsigned GetSlowStartWeight(Expiry now,
+				    Duration slow_start) const noexcept {
+		if (slow_start <= Duration::zero())
+			return SLOW_START_STEPS;
+
+		for (unsigned i = 1; i < SLOW_START_STEPS; ++i)
+			if (!Expiry::Touched(enabled_since,
+					     slow_start * i / SLOW_START_STEPS).IsExpired(now))
+				return i;
+
+		return SLOW_START_STEPS;
+	}
+
+private:
+	/**
+	 * The host has failed, and will be enabled again at the
+	 * given time.
+	 */
+	void Disabled(Expiry until) noexcept {
+		enabled_since = until;
+		recovering = true;
+	}
+
+	/**
+	 * A request to this host has succeeded.  If this ends a
+	 * failure earlier than expected, the slow-start ramp begins
+	 * now.
+	 */
+	void Recovered() noexcept {
+		if (recovering) {
+			recovering = false;
+			Enabled();
+		}
+	}
+
+	/**
+	 * The host has just been enabled by an explicit command (and
+	 * not by the expiry of a failure).
+	 */
+	void Enabled() noexcept {
+		enabled_since = Expiry::Now();
 	}
 };
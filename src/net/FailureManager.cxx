@@ -140,3 +140,20 @@ FailureManager::Check(const Expiry now, SocketAddress address,
 
 	return i->Check(now, allow_fade);
 }
+
+unsigned
+FailureManager::GetSlowStartWeight(const Expiry now,
+				   SocketAddress address) const noexcept
+{
+	assert(!address.IsNull());
+
+	if (slow_start <= slow_start.zero())
+		/* fast path: slow start is disabled */
+		return FailureInfo::SLOW_START_STEPS;
+
+	auto i = failures.find(address, Hash(), Equal());
+	if (i == failures.end())
+		return FailureInfo::SLOW_START_STEPS;
+
+	return i->GetSlowStartWeight(now, slow_start);
+}
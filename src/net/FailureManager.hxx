@@ -33,9 +33,12 @@
 #pragma once
 
 #include "FailureStatus.hxx"
+#include "OutlierConfig.hxx"
 
 #include <boost/intrusive/unordered_set.hpp>
 
+#include <chrono>
+
 class Expiry;
 class SocketAddress;
 class FailureInfo;
@@ -77,6 +80,19 @@ class FailureManager {
 
 	FailureSet failures;
 
+	/**
+	 * Hosts which have just recovered from a failure get only a
+	 * fraction of the traffic for this duration.  Zero disables
+	 * slow start.
+	 */
+	std::chrono::steady_clock::duration slow_start{};
+
+	/**
+	 * Settings for the passive outlier detection; disabled by
+	 * default.
+	 */
+	OutlierConfig outlier;
+
 public:
 	FailureManager() noexcept
 		:failures(FailureSet::bucket_traits(buckets, N_BUCKETS)) {}
@@ -100,4 +116,30 @@ public:
 	[[gnu::pure]]
 	bool Check(Expiry now, SocketAddress address,
 		   bool allow_fade=false) const noexcept;
+
+	void SetSlowStart(std::chrono::steady_clock::duration _slow_start) noexcept {
+		slow_start = _slow_start;
+	}
+
+	auto GetSlowStart() const noexcept {
+		return slow_start;
+	}
+
+	void SetOutlierConfig(const OutlierConfig &_outlier) noexcept {
+		outlier = _outlier;
+	}
+
+	/**
+	 * To be passed to FailureInfo::AddResult().
+	 */
+	const OutlierConfig &GetOutlierConfig() const noexcept {
+		return outlier;
+	}
+
+	/**
+	 * @see FailureInfo::GetSlowStartWeight()
+	 */
+	[[gnu::pure]]
+	unsigned GetSlowStartWeight(Expiry now,
+				    SocketAddress address) const noexcept;
 };
@@ -48,6 +48,12 @@ enum class FailureStatus {
 	 */
 	PROTOCOL,
 
+	/**
+	 * The host was ejected by passive outlier detection (too many
+	 * consecutive server errors or too slow responses).
+	 */
+	OUTLIER,
+
 	/**
 	 * Failed to connect to the host.
 	 */
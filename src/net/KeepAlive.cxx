@@ -0,0 +1,72 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "KeepAlive.hxx"
+#include "net/SocketDescriptor.hxx"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/**
+ * Start probing after the connection has been idle for this many
+ * seconds.  This must be well below the idle timeout of our stocks
+ * (one minute).
+ */
+static constexpr int KEEPALIVE_IDLE = 15;
+
+/**
+ * The interval between two probes.
+ */
+static constexpr int KEEPALIVE_INTERVAL = 5;
+
+/**
+ * Give up after this many unanswered probes.
+ */
+static constexpr int KEEPALIVE_COUNT = 2;
+
+static void
+SetTcpOption(SocketDescriptor s, int name, int value) noexcept
+{
+	setsockopt(s.Get(), IPPROTO_TCP, name, &value, sizeof(value));
+}
+
+void
+EnableIdleKeepAlive(SocketDescriptor s) noexcept
+{
+	if (!s.SetBoolOption(SOL_SOCKET, SO_KEEPALIVE, true))
+		return;
+
+	SetTcpOption(s, TCP_KEEPIDLE, KEEPALIVE_IDLE);
+	SetTcpOption(s, TCP_KEEPINTVL, KEEPALIVE_INTERVAL);
+	SetTcpOption(s, TCP_KEEPCNT, KEEPALIVE_COUNT);
+}
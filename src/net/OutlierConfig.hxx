@@ -0,0 +1,74 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include <chrono>
+
+/**
+ * Settings for the passive outlier detection (see
+ * FailureInfo::AddResult()).  It is disabled by default.
+ */
+struct OutlierConfig {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * Eject a host after this many consecutive server errors.  0
+	 * disables this check.
+	 */
+	unsigned consecutive_errors = 0;
+
+	/**
+	 * Eject a host if its latency is this many times higher than
+	 * its long-term average.  0 disables this check.
+	 */
+	unsigned latency_factor = 0;
+
+	/**
+	 * The number of consecutive responses whose latency must
+	 * deviate before a host is ejected.  This avoids ejecting a
+	 * host because of a single slow request.
+	 */
+	unsigned latency_samples = 5;
+
+	/**
+	 * Latencies below this value never count as deviating; this
+	 * avoids ejecting hosts which are merely slower than usual,
+	 * but still fast.
+	 */
+	Duration min_latency = std::chrono::milliseconds(100);
+
+	constexpr bool IsEnabled() const noexcept {
+		return consecutive_errors > 0 || latency_factor > 0;
+	}
+};
@@ -39,6 +39,7 @@
 #include "pool/Holder.hxx"
 #include "AllocatorPtr.hxx"
 #include "memory/Rubber.hxx"
+#include "memory/RubberCompressor.hxx"
 #include "memory/istream_rubber.hxx"
 #include "memory/sink_rubber.hxx"
 #include "istream_unlock.hxx"
@@ -120,6 +121,8 @@ class NfsCache {
 
 	Rubber rubber;
 
+	RubberCompressor rubber_compressor;
+
 	Cache cache;
 
 	FarTimerEvent compress_timer;
@@ -160,6 +163,10 @@ public:
 		return pool_children_stats(pool) + rubber.GetStats();
 	}
 
+	const CompressStats &GetCompressStats() const noexcept {
+		return rubber_compressor.GetStats();
+	}
+
 	void Put(const char *key, CacheItem &item) noexcept {
 		cache.Put(key, item);
 	}
@@ -176,7 +183,7 @@ public:
 
 private:
 	void OnCompressTimer() noexcept {
-		rubber.Compress();
+		rubber_compressor.Start();
 		compress_timer.Schedule(nfs_cache_compress_interval);
 	}
 };
@@ -393,6 +400,7 @@ NfsCache::NfsCache(struct pool &_pool, size_t max_size,
 	 stock(_stock),
 	 event_loop(_event_loop),
 	 rubber(max_size, "nfs_cache_rubber"),
+	 rubber_compressor(event_loop, rubber),
 	 cache(event_loop, 65521, max_size * 7 / 8),
 	 compress_timer(event_loop, BIND_THIS_METHOD(OnCompressTimer)) {
 	compress_timer.Schedule(nfs_cache_compress_interval);
@@ -419,6 +427,12 @@ nfs_cache_get_stats(const NfsCache &cache) noexcept
 	return cache.GetStats();
 }
 
+const CompressStats &
+nfs_cache_get_compress_stats(const NfsCache &cache) noexcept
+{
+	return cache.GetCompressStats();
+}
+
 void
 nfs_cache_fork_cow(NfsCache &cache, bool inherit) noexcept
 {
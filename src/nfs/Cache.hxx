@@ -46,6 +46,7 @@ struct NfsCacheHandle;
 class CancellablePointer;
 struct statx;
 struct AllocatorStats;
+struct CompressStats;
 
 class NfsCacheHandler {
 public:
@@ -70,6 +71,10 @@ nfs_cache_free(NfsCache *cache) noexcept;
 AllocatorStats
 nfs_cache_get_stats(const NfsCache &cache) noexcept;
 
+[[gnu::pure]]
+const CompressStats &
+nfs_cache_get_compress_stats(const NfsCache &cache) noexcept;
+
 void
 nfs_cache_fork_cow(NfsCache &cache, bool inherit) noexcept;
 
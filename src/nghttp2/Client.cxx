@@ -471,6 +471,8 @@ ClientConnection::ClientConnection(std::unique_ptr<FilteredSocket> _socket,
 
 	NgHttp2::SessionCallbacks callbacks;
 	nghttp2_session_callbacks_set_send_callback(callbacks.get(), SendCallback);
+	nghttp2_session_callbacks_set_send_data_callback(callbacks.get(),
+							 SendDataCallback);
 	nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks.get(),
 							     OnFrameRecvCallback);
 	nghttp2_session_callbacks_set_on_stream_close_callback(callbacks.get(),
@@ -549,7 +551,18 @@ ClientConnection::AbortAllRequests(std::exception_ptr e) noexcept
 ssize_t
 ClientConnection::SendCallback(std::span<const std::byte> src) noexcept
 {
-	return SendToBuffer(*socket, src);
+	return SendToBuffer(*socket, send_backlog, src);
+}
+
+int
+ClientConnection::SendDataCallback(nghttp2_frame &frame,
+				  std::span<const std::byte> framehd,
+				  std::size_t length,
+				  nghttp2_data_source &source) noexcept
+{
+	auto &ids = IstreamDataSource::FromSource(source);
+	return ids.SendDataFrame(*socket, send_backlog, framehd, length,
+				 frame.data.padlen);
 }
 
 int
@@ -616,7 +629,7 @@ ClientConnection::OnBufferedClosed() noexcept
 bool
 ClientConnection::OnBufferedWrite()
 {
-	return OnSocketWrite(session.get(), *socket);
+	return OnSocketWrite(session.get(), *socket, send_backlog);
 }
 
 void
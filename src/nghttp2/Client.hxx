@@ -33,6 +33,7 @@
 #pragma once
 
 #include "Session.hxx"
+#include "SocketUtil.hxx"
 #include "event/net/BufferedSocket.hxx"
 #include "event/DeferEvent.hxx"
 #include "http/Method.h"
@@ -63,6 +64,11 @@ class ClientConnection final : BufferedSocketHandler {
 
 	const std::unique_ptr<FilteredSocket> socket;
 
+	/**
+	 * The unsent tail of a partially written DATA frame.
+	 */
+	SendBacklog send_backlog;
+
 	ConnectionHandler &handler;
 
 	NgHttp2::Session session;
@@ -134,6 +140,21 @@ private:
 		return c.SendCallback({(const std::byte *)data, length});
 	}
 
+	int SendDataCallback(nghttp2_frame &frame,
+			     std::span<const std::byte> framehd,
+			     std::size_t length,
+			     nghttp2_data_source &source) noexcept;
+
+	static int SendDataCallback(nghttp2_session *, nghttp2_frame *frame,
+				    const uint8_t *framehd, size_t length,
+				    nghttp2_data_source *source,
+				    void *user_data) noexcept {
+		auto &c = *(ClientConnection *)user_data;
+		return c.SendDataCallback(*frame,
+					  {(const std::byte *)framehd, 9},
+					  length, *source);
+	}
+
 	int OnFrameRecvCallback(const nghttp2_frame *frame) noexcept;
 
 	static int OnFrameRecvCallback(nghttp2_session *,
@@ -31,13 +31,16 @@
  */
 
 #include "IstreamDataSource.hxx"
+#include "SocketUtil.hxx"
 
-#include <string.h>
+#include <algorithm>
+
+#include <assert.h>
 
 namespace NgHttp2 {
 
 ssize_t
-IstreamDataSource::ReadCallback(uint8_t *buf, size_t length,
+IstreamDataSource::ReadCallback(size_t length,
 				uint32_t &data_flags) noexcept
 {
 	if (error) {
@@ -70,18 +73,38 @@ IstreamDataSource::ReadCallback(uint8_t *buf, size_t length,
 		}
 	}
 
+	/* don't copy; the payload will be written directly from our
+	   buffer by SendDataFrame() */
+	data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
+
 	size_t nbytes = std::min(r.size(), length);
-	memcpy(buf, r.data(), nbytes);
-	buffer.Consume(nbytes);
-	transmitted += nbytes;
+	if (nbytes == r.size() && eof)
+		data_flags |= NGHTTP2_DATA_FLAG_EOF;
+
+	return nbytes;
+}
+
+int
+IstreamDataSource::SendDataFrame(FilteredSocket &socket, SendBacklog &backlog,
+				 std::span<const std::byte> framehd,
+				 std::size_t length, std::size_t padlen) noexcept
+{
+	auto &buffer = sink.GetBuffer();
+	auto r = buffer.Read();
+	assert(r.size() >= length);
+
+	int result = NgHttp2::SendDataFrame(socket, backlog, framehd, padlen,
+					    r.first(length));
+	if (result != 0)
+		return result;
+
+	buffer.Consume(length);
+	transmitted += length;
 
-	if (buffer.empty()) {
+	if (buffer.empty())
 		buffer.Free();
-		if (eof)
-			data_flags |= NGHTTP2_DATA_FLAG_EOF;
-	}
 
-	return nbytes;
+	return 0;
 }
 
 } // namespace NgHttp2
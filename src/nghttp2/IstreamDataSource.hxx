@@ -37,8 +37,15 @@
 
 #include <nghttp2/nghttp2.h>
 
+#include <cstddef>
+#include <span>
+
+class FilteredSocket;
+
 namespace NgHttp2 {
 
+class SendBacklog;
+
 class IstreamDataSourceHandler {
 public:
 	virtual void OnIstreamDataSourceReady() noexcept = 0;
@@ -70,13 +77,31 @@ public:
 	}
 
 	/**
-	 * Returns the number of bytes transmitted to libnghttp2 in
-	 * the read callback.
+	 * Returns the number of bytes submitted to the socket by
+	 * SendDataFrame().
 	 */
 	uint64_t GetTransmitted() const noexcept {
 		return transmitted;
 	}
 
+	/**
+	 * Implementation of the send_data_callback: write the frame
+	 * header and the first #length bytes of the buffer (which
+	 * were announced by ReadCallback() with
+	 * #NGHTTP2_DATA_FLAG_NO_COPY) directly to the socket.
+	 */
+	int SendDataFrame(FilteredSocket &socket, SendBacklog &backlog,
+			  std::span<const std::byte> framehd,
+			  std::size_t length, std::size_t padlen) noexcept;
+
+	/**
+	 * Cast the #nghttp2_data_source pointer passed to the
+	 * send_data_callback.
+	 */
+	static IstreamDataSource &FromSource(nghttp2_data_source &source) noexcept {
+		return *(IstreamDataSource *)source.ptr;
+	}
+
 private:
 	/* virtual methods from class FifoBufferSinkHandler */
 	bool OnFifoBufferSinkData() noexcept override {
@@ -100,16 +125,15 @@ private:
 	}
 
 	/* libnghttp2 callbacks */
-	ssize_t ReadCallback(uint8_t *buf, size_t length,
+	ssize_t ReadCallback(size_t length,
 			     uint32_t &data_flags) noexcept;
 
 	static ssize_t ReadCallback(nghttp2_session *, int32_t,
-				    uint8_t *buf, size_t length,
+				    uint8_t *, size_t length,
 				    uint32_t *data_flags,
 				    nghttp2_data_source *source,
 				    void *) noexcept {
-		auto &ids = *(IstreamDataSource *)source->ptr;
-		return ids.ReadCallback(buf, length, *data_flags);
+		return FromSource(*source).ReadCallback(length, *data_flags);
 	}
 };
 
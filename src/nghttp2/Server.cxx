@@ -237,6 +237,7 @@ private:
 	void SendResponse(http_status_t status,
 			  HttpHeaders &&response_headers,
 			  UnusedIstreamPtr response_body) noexcept override;
+	void SendEarlyHints(std::string_view link) noexcept override;
 };
 
 static http_method_t
@@ -447,6 +448,29 @@ ServerConnection::Request::SendResponse(http_status_t status,
 	DeferWrite();
 }
 
+void
+ServerConnection::Request::SendEarlyHints(std::string_view link) noexcept
+{
+	if (the_status != http_status_t{} || link.empty())
+		/* too late, the final response has already been
+		   submitted */
+		return;
+
+	/* a non-final HEADERS frame without END_STREAM; nghttp2
+	   copies the header values */
+	const nghttp2_nv hdrs[] = {
+		MakeNv(":status", "103"),
+		MakeNv("link", link),
+	};
+
+	if (nghttp2_submit_headers(connection.session.get(),
+				   NGHTTP2_FLAG_NONE, id, nullptr,
+				   hdrs, std::size(hdrs), nullptr) == 0) {
+		stopwatch.RecordEvent("early_hints");
+		DeferWrite();
+	}
+}
+
 ServerConnection::ServerConnection(struct pool &_pool,
 				   UniquePoolPtr<FilteredSocket> _socket,
 				   SocketAddress _remote_address,
@@ -467,6 +491,8 @@ ServerConnection::ServerConnection(struct pool &_pool,
 
 	NgHttp2::SessionCallbacks callbacks;
 	nghttp2_session_callbacks_set_send_callback(callbacks.get(), SendCallback);
+	nghttp2_session_callbacks_set_send_data_callback(callbacks.get(),
+							 SendDataCallback);
 	nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks.get(),
 							     OnFrameRecvCallback);
 	nghttp2_session_callbacks_set_on_stream_close_callback(callbacks.get(),
@@ -523,7 +549,18 @@ ServerConnection::DeferWrite() noexcept
 ssize_t
 ServerConnection::SendCallback(std::span<const std::byte> src) noexcept
 {
-	return SendToBuffer(*socket, src);
+	return SendToBuffer(*socket, send_backlog, src);
+}
+
+int
+ServerConnection::SendDataCallback(nghttp2_frame &frame,
+				  std::span<const std::byte> framehd,
+				  std::size_t length,
+				  nghttp2_data_source &source) noexcept
+{
+	auto &ids = IstreamDataSource::FromSource(source);
+	return ids.SendDataFrame(*socket, send_backlog, framehd, length,
+				 frame.data.padlen);
 }
 
 int
@@ -599,7 +636,7 @@ ServerConnection::OnBufferedClosed() noexcept
 bool
 ServerConnection::OnBufferedWrite()
 {
-	return OnSocketWrite(session.get(), *socket);
+	return OnSocketWrite(session.get(), *socket, send_backlog);
 }
 
 void
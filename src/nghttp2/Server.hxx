@@ -33,6 +33,7 @@
 #pragma once
 
 #include "Session.hxx"
+#include "SocketUtil.hxx"
 #include "pool/UniquePtr.hxx"
 #include "event/net/BufferedSocket.hxx"
 #include "net/SocketAddress.hxx"
@@ -50,6 +51,11 @@ class ServerConnection final : BufferedSocketHandler {
 
 	const UniquePoolPtr<FilteredSocket> socket;
 
+	/**
+	 * The unsent tail of a partially written DATA frame.
+	 */
+	SendBacklog send_backlog;
+
 	HttpServerConnectionHandler &handler;
 	HttpServerRequestHandler &request_handler;
 
@@ -92,6 +98,21 @@ private:
 		return c.SendCallback({(const std::byte *)data, length});
 	}
 
+	int SendDataCallback(nghttp2_frame &frame,
+			     std::span<const std::byte> framehd,
+			     std::size_t length,
+			     nghttp2_data_source &source) noexcept;
+
+	static int SendDataCallback(nghttp2_session *, nghttp2_frame *frame,
+				    const uint8_t *framehd, size_t length,
+				    nghttp2_data_source *source,
+				    void *user_data) noexcept {
+		auto &c = *(ServerConnection *)user_data;
+		return c.SendDataCallback(*frame,
+					  {(const std::byte *)framehd, 9},
+					  length, *source);
+	}
+
 	int OnFrameRecvCallback(const nghttp2_frame *frame) noexcept;
 
 	static int OnFrameRecvCallback(nghttp2_session *,
@@ -33,9 +33,15 @@
 #include "SocketUtil.hxx"
 #include "Error.hxx"
 #include "fs/FilteredSocket.hxx"
+#include "net/SocketProtocolError.hxx"
+#include "system/Error.hxx"
+#include "io/Iovec.hxx"
+#include "util/StaticVector.hxx"
 
 #include <nghttp2/nghttp2.h>
 
+#include <sys/uio.h>
+
 namespace NgHttp2 {
 
 BufferedResult
@@ -57,9 +63,48 @@ ReceiveFromSocketBuffer(nghttp2_session *session, FilteredSocket &socket)
 	return BufferedResult::MORE; // TODO?
 }
 
+bool
+SendBacklog::Flush(FilteredSocket &socket)
+{
+	if (empty())
+		return true;
+
+	const auto nbytes = socket.Write(std::span{buffer}.subspan(position,
+							    fill - position));
+	if (nbytes >= 0) {
+		position += nbytes;
+		if (empty())
+			position = fill = 0;
+
+		return true;
+	}
+
+	switch ((enum write_result)nbytes) {
+	case WRITE_SOURCE_EOF:
+	case WRITE_BLOCKING:
+		break;
+
+	case WRITE_ERRNO:
+		throw MakeErrno("Send failed");
+
+	case WRITE_DESTROYED:
+		return false;
+
+	case WRITE_BROKEN:
+		throw SocketClosedPrematurelyError{};
+	}
+
+	return true;
+}
+
 ssize_t
-SendToBuffer(FilteredSocket &socket, std::span<const std::byte> src) noexcept
+SendToBuffer(FilteredSocket &socket, const SendBacklog &backlog,
+	     std::span<const std::byte> src) noexcept
 {
+	if (!backlog.empty())
+		/* the tail of a DATA frame must go out first */
+		return NGHTTP2_ERR_WOULDBLOCK;
+
 	const auto nbytes = socket.Write(src);
 	if (nbytes < 0) {
 		if (nbytes == WRITE_BLOCKING)
@@ -71,14 +116,114 @@ SendToBuffer(FilteredSocket &socket, std::span<const std::byte> src) noexcept
 	return nbytes;
 }
 
+/**
+ * Write the given segments to the socket, stopping at the first
+ * short write.
+ *
+ * @return the number of bytes written or a negative #write_result
+ * if nothing was written
+ */
+static ssize_t
+WriteSegments(FilteredSocket &socket,
+	      std::span<const std::span<const std::byte>> segments) noexcept
+{
+	if (!socket.HasFilter()) {
+		/* no filter: submit everything with one system
+		   call */
+		StaticVector<struct iovec, 4> v;
+		for (const auto &i : segments)
+			if (!i.empty())
+				v.push_back(MakeIovec(i));
+
+		return socket.WriteV(v);
+	}
+
+	/* the filter (e.g. TLS) needs to copy the data anyway, and
+	   it does not implement WriteV() */
+	std::size_t total = 0;
+	for (const auto &i : segments) {
+		if (i.empty())
+			continue;
+
+		const auto nbytes = socket.Write(i);
+		if (nbytes < 0)
+			return total > 0 ? ssize_t(total) : nbytes;
+
+		total += nbytes;
+		if (std::size_t(nbytes) < i.size())
+			break;
+	}
+
+	return total;
+}
+
+int
+SendDataFrame(FilteredSocket &socket, SendBacklog &backlog,
+	      std::span<const std::byte> framehd, std::size_t padlen,
+	      std::span<const std::byte> payload) noexcept
+{
+	if (!backlog.empty())
+		return NGHTTP2_ERR_WOULDBLOCK;
+
+	static constexpr std::byte zero_padding[256]{};
+
+	std::byte pad_length_field[1];
+	std::span<const std::byte> pad_length{}, padding{};
+	if (padlen > 0) {
+		pad_length_field[0] = static_cast<std::byte>(padlen - 1);
+		pad_length = pad_length_field;
+		padding = std::span{zero_padding}.first(padlen - 1);
+	}
+
+	const std::span<const std::byte> segments[] = {
+		framehd, pad_length, payload, padding,
+	};
+
+	const auto nbytes = WriteSegments(socket, segments);
+	if (nbytes < 0)
+		return nbytes == WRITE_BLOCKING
+			? NGHTTP2_ERR_WOULDBLOCK
+			: NGHTTP2_ERR_CALLBACK_FAILURE;
+
+	if (nbytes == 0)
+		return NGHTTP2_ERR_WOULDBLOCK;
+
+	/* copy whatever the socket didn't accept to the backlog */
+	std::size_t skip = nbytes;
+	for (const auto &i : segments) {
+		if (skip >= i.size()) {
+			skip -= i.size();
+			continue;
+		}
+
+		if (!backlog.Append(i.subspan(skip)))
+			return NGHTTP2_ERR_CALLBACK_FAILURE;
+
+		skip = 0;
+	}
+
+	if (!backlog.empty())
+		socket.ScheduleWrite();
+
+	return 0;
+}
+
 bool
-OnSocketWrite(nghttp2_session *session, FilteredSocket &socket)
+OnSocketWrite(nghttp2_session *session, FilteredSocket &socket,
+	      SendBacklog &backlog)
 {
+	if (!backlog.Flush(socket))
+		return false;
+
+	if (!backlog.empty())
+		/* wait until the socket becomes writable again */
+		return true;
+
 	const auto rv = nghttp2_session_send(session);
 	if (rv != 0)
 		throw MakeError(rv, "nghttp2_session_send() failed");
 
-	if (!nghttp2_session_want_write(session))
+	if (!nghttp2_session_want_write(session) && backlog.empty())
 		socket.UnscheduleWrite();
 
 	return true;
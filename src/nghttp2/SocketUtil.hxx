@@ -34,18 +34,97 @@
 
 #include "event/net/BufferedSocket.hxx"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+
 struct nghttp2_session;
 class FilteredSocket;
 
 namespace NgHttp2 {
 
+/**
+ * The unsent tail of a DATA frame which was submitted by
+ * SendDataFrame() but could only partially be written to the
+ * socket.  libnghttp2 considers the frame sent as soon as the
+ * send_data_callback returns, so this tail must be flushed before
+ * any other frame.
+ */
+class SendBacklog {
+	/**
+	 * The size of the largest DATA frame libnghttp2 submits: the
+	 * frame header, the pad length byte, the default maximum
+	 * payload (we don't install a
+	 * data_source_read_length_callback) and the padding.
+	 */
+	static constexpr std::size_t MAX_SIZE = 9 + 1 + 16384 + 255;
+
+	/**
+	 * Preallocated, so Append() cannot fail with
+	 * std::bad_alloc.
+	 */
+	std::array<std::byte, MAX_SIZE> buffer;
+
+	std::size_t position = 0, fill = 0;
+
+public:
+	bool empty() const noexcept {
+		return position == fill;
+	}
+
+	/**
+	 * @return false if the data does not fit (which means the
+	 * frame is larger than expected)
+	 */
+	[[nodiscard]]
+	bool Append(std::span<const std::byte> src) noexcept {
+		if (src.size() > buffer.size() - fill)
+			return false;
+
+		std::copy(src.begin(), src.end(), buffer.begin() + fill);
+		fill += src.size();
+		return true;
+	}
+
+	/**
+	 * Attempt to write the backlog to the socket.
+	 *
+	 * Throws on error.
+	 *
+	 * @return false if the socket has been destroyed
+	 */
+	bool Flush(FilteredSocket &socket);
+};
+
 BufferedResult
 ReceiveFromSocketBuffer(nghttp2_session *session, FilteredSocket &socket);
 
 ssize_t
-SendToBuffer(FilteredSocket &socket, std::span<const std::byte> src) noexcept;
+SendToBuffer(FilteredSocket &socket, const SendBacklog &backlog,
+	     std::span<const std::byte> src) noexcept;
+
+/**
+ * Write a DATA frame without copying the payload into a libnghttp2
+ * buffer; this implements the send_data_callback for
+ * #NGHTTP2_DATA_FLAG_NO_COPY.  The frame header, the padding and
+ * the payload are submitted with one writev() call (or sequentially
+ * if the socket has a filter).  If the socket accepts only a part
+ * of it, the rest is copied to the #SendBacklog.
+ *
+ * @param padlen the "padlen" field of the #nghttp2_data frame
+ * (including the pad length byte)
+ * @return 0 if the frame was accepted (completely or partially),
+ * #NGHTTP2_ERR_WOULDBLOCK if nothing was written or
+ * #NGHTTP2_ERR_CALLBACK_FAILURE on error
+ */
+int
+SendDataFrame(FilteredSocket &socket, SendBacklog &backlog,
+	      std::span<const std::byte> framehd, std::size_t padlen,
+	      std::span<const std::byte> payload) noexcept;
 
 bool
-OnSocketWrite(nghttp2_session *session, FilteredSocket &socket);
+OnSocketWrite(nghttp2_session *session, FilteredSocket &socket,
+	      SendBacklog &backlog);
 
 } // namespace NgHttp2
@@ -39,6 +39,7 @@
 #include "ssl/Filter.hxx"
 #include "event/CoarseTimerEvent.hxx"
 #include "net/SocketAddress.hxx"
+#include "net/KeepAlive.hxx"
 #include "io/Logger.hxx"
 #include "util/Cancellable.hxx"
 #include "util/djbhash.h"
@@ -274,6 +275,10 @@ Stock::Item::OnConnectFilteredSocket(std::unique_ptr<FilteredSocket> socket) noe
 		return;
 	}
 
+	/* the connection is shared and may sit idle for a while;
+	   detect dead peers before a request is sent */
+	EnableIdleKeepAlive(socket->GetSocket());
+
 	NgHttp2::ConnectionHandler &handler = *this;
 	connection = std::make_unique<ClientConnection>(std::move(socket),
 							handler);
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * Allocation statistics for all linear pools with a certain name.
+ */
+struct PoolNameStats {
+	/**
+	 * The pool name.  This string is owned by the pool library
+	 * and remains valid forever.
+	 */
+	std::string_view name;
+
+	/**
+	 * The number of pools which have been destroyed (or
+	 * cleared).
+	 */
+	uint64_t n_pools;
+
+	/**
+	 * The number of pools which needed more than one area.
+	 */
+	uint64_t n_spilled;
+
+	/**
+	 * The largest number of bytes ever allocated from one pool
+	 * (including overhead).
+	 */
+	std::size_t high_water;
+
+	/**
+	 * The area size chosen for new pools; 0 if there are not yet
+	 * enough samples and the size passed to pool_new_linear() is
+	 * used.
+	 */
+	std::size_t area_size;
+};
+
+std::vector<PoolNameStats>
+pool_get_name_stats() noexcept;
+
+/**
+ * Log the statistics of all pool names (for #DUMP_POOLS).
+ */
+void
+pool_dump_name_stats() noexcept;
@@ -33,6 +33,7 @@
 #include "pool.hxx"
 #include "Ptr.hxx"
 #include "LeakDetector.hxx"
+#include "NameStats.hxx"
 #include "memory/SlicePool.hxx"
 #include "stats/AllocatorStats.hxx"
 #include "io/Logger.hxx"
@@ -48,8 +49,13 @@
 #include <valgrind/memcheck.h>
 #endif
 
+#include <array>
+#include <bit>
 #include <forward_list>
+#include <map>
+#include <string>
 #include <typeinfo>
+#include <unordered_map>
 
 #include <assert.h>
 #include <stdlib.h>
@@ -76,6 +82,173 @@ static constexpr size_t ALIGN_MASK = ALIGN_SIZE - 1;
 static constexpr unsigned RECYCLER_MAX_POOLS = 256;
 static constexpr unsigned RECYCLER_MAX_LINEAR_AREAS = 256;
 
+/**
+ * Linear pool area sizes are rounded up to a power of two between
+ * these two (in bytes, as binary logarithm); this keeps the number
+ * of distinct sizes small, so the recycler can reuse areas between
+ * pools.
+ */
+static constexpr unsigned MIN_AREA_SHIFT = 6, MAX_AREA_SHIFT = 20;
+static constexpr unsigned N_AREA_CLASSES = MAX_AREA_SHIFT - MIN_AREA_SHIFT + 1;
+
+/**
+ * After this many samples, the area size of a pool name is
+ * recalculated and the histogram decays.
+ */
+static constexpr unsigned AREA_SIZE_UPDATE_INTERVAL = 64;
+
+/**
+ * The histogram is multiplied with this factor after each update, so
+ * old samples lose their influence.
+ */
+static constexpr double AREA_SIZE_DECAY = 0.5;
+
+/**
+ * New pools get an area size which is large enough for this fraction
+ * of all (recent) pools with the same name; the others have to
+ * allocate additional areas.
+ */
+static constexpr double AREA_SIZE_PERCENTILE = 0.9;
+
+static constexpr unsigned
+area_size_class(size_t size) noexcept
+{
+	const unsigned shift = size > 1
+		? std::bit_width(size - 1)
+		: 0;
+	if (shift <= MIN_AREA_SHIFT)
+		return 0;
+	if (shift >= MAX_AREA_SHIFT)
+		return N_AREA_CLASSES - 1;
+	return shift - MIN_AREA_SHIFT;
+}
+
+static constexpr size_t
+area_class_size(unsigned c) noexcept
+{
+	return size_t(1) << (MIN_AREA_SHIFT + c);
+}
+
+/**
+ * Round the given area size up to the next size class.  Sizes above
+ * the largest class are not modified.
+ */
+static constexpr size_t
+round_area_size(size_t size) noexcept
+{
+	const size_t rounded = area_class_size(area_size_class(size));
+	return rounded >= size ? rounded : size;
+}
+
+static_assert(round_area_size(1) == 64);
+static_assert(round_area_size(64) == 64);
+static_assert(round_area_size(65) == 128);
+static_assert(round_area_size(8192) == 8192);
+static_assert(round_area_size(3000) == 4096);
+static_assert(round_area_size(2 * 1024 * 1024) == 2 * 1024 * 1024);
+
+/**
+ * Allocation statistics for all linear pools with a certain name;
+ * used to choose the area size for new pools.
+ */
+struct PoolNameData {
+	/**
+	 * A decaying histogram of the number of bytes allocated by
+	 * each pool, one counter per size class.
+	 */
+	std::array<double, N_AREA_CLASSES> histogram{};
+
+	uint64_t n_pools = 0, n_spilled = 0;
+
+	size_t high_water = 0;
+
+	/**
+	 * The area size for new pools; 0 if there are not yet enough
+	 * samples (use the caller's value).
+	 */
+	size_t area_size = 0;
+
+	unsigned n_new_samples = 0;
+
+	void AddSample(size_t used, bool spilled) noexcept {
+		++n_pools;
+		if (spilled)
+			++n_spilled;
+		if (used > high_water)
+			high_water = used;
+
+		histogram[area_size_class(used)] += 1;
+
+		if (++n_new_samples >= AREA_SIZE_UPDATE_INTERVAL)
+			Update();
+	}
+
+private:
+	void Update() noexcept {
+		n_new_samples = 0;
+
+		double total = 0;
+		for (const double i : histogram)
+			total += i;
+
+		const double threshold = total * AREA_SIZE_PERCENTILE;
+		double sum = 0;
+		for (unsigned c = 0; c < N_AREA_CLASSES; ++c) {
+			sum += histogram[c];
+			if (sum >= threshold) {
+				area_size = area_class_size(c);
+				break;
+			}
+		}
+
+		for (double &i : histogram)
+			i *= AREA_SIZE_DECAY;
+	}
+};
+
+/**
+ * Pool names are usually string literals, but they are compared by
+ * value, because the same name may be used at different call sites.
+ * Items are never removed.
+ */
+static std::map<std::string, PoolNameData, std::less<>> pool_names;
+
+/**
+ * Maps name pointers to #pool_names items, so pool_new_linear() does
+ * not need to compare strings (and construct a std::string key).
+ * This relies on names being string literals (or at least being
+ * immutable and valid forever).  Items are never removed.
+ */
+static std::unordered_map<const char *, PoolNameData *> pool_name_pointers;
+
+/**
+ * Look up (or create) the #PoolNameData for the given name.
+ *
+ * @return the object or nullptr if out of memory
+ */
+static PoolNameData *
+LookupPoolName(const char *name) noexcept
+{
+	if (auto i = pool_name_pointers.find(name);
+	    i != pool_name_pointers.end()) [[likely]]
+		return i->second;
+
+	/* first pool_new_linear() call from this call site (or rather
+	   with this string literal) */
+
+	try {
+		auto i = pool_names.find(std::string_view{name});
+		if (i == pool_names.end())
+			i = pool_names.emplace(name, PoolNameData{}).first;
+
+		pool_name_pointers.emplace(name, &i->second);
+		return &i->second;
+	} catch (...) {
+		/* out of memory: this pool doesn't get statistics */
+		return nullptr;
+	}
+}
+
 #ifndef NDEBUG
 struct allocation_info {
 	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> SiblingsHook;
@@ -205,10 +378,17 @@ struct pool final
 	SlicePool *slice_pool;
 
 	/**
-	 * The area size passed to pool_new_linear().
+	 * The area size passed to pool_new_linear() or the one
+	 * chosen from #name_data.
 	 */
 	size_t area_size;
 
+	/**
+	 * Allocation statistics for this pool's name; nullptr if
+	 * this is not a (heap allocated) linear pool.
+	 */
+	PoolNameData *name_data = nullptr;
+
 	/**
 	 * The number of bytes allocated from this pool, not counting
 	 * overhead.
@@ -236,7 +416,11 @@ static struct {
 	Recycler<struct pool, RECYCLER_MAX_POOLS> pools;
 
 	unsigned num_linear_areas;
-	struct linear_pool_area *linear_areas;
+
+	/**
+	 * Recycled areas, one list per size class.
+	 */
+	std::array<struct linear_pool_area *, N_AREA_CLASSES> linear_areas;
 } recycler;
 
 static void * gcc_malloc
@@ -270,10 +454,12 @@ pool_recycler_clear(void) noexcept
 {
 	recycler.pools.Clear();
 
-	while (recycler.linear_areas != nullptr) {
-		struct linear_pool_area *linear = recycler.linear_areas;
-		recycler.linear_areas = linear->prev;
-		free(linear);
+	for (auto &list : recycler.linear_areas) {
+		while (list != nullptr) {
+			struct linear_pool_area *linear = list;
+			list = linear->prev;
+			free(linear);
+		}
 	}
 
 	recycler.num_linear_areas = 0;
@@ -290,13 +476,15 @@ pool_recycler_put_linear(struct linear_pool_area *area) noexcept
 	assert(area->size > 0);
 	assert(area->slice_area == nullptr);
 
-	if (recycler.num_linear_areas >= RECYCLER_MAX_LINEAR_AREAS)
+	const unsigned c = area_size_class(area->size);
+	if (area_class_size(c) != area->size ||
+	    recycler.num_linear_areas >= RECYCLER_MAX_LINEAR_AREAS)
 		return false;
 
 	PoisonInaccessible(area->data, area->used);
 
-	area->prev = recycler.linear_areas;
-	recycler.linear_areas = area;
+	area->prev = recycler.linear_areas[c];
+	recycler.linear_areas[c] = area;
 	++recycler.num_linear_areas;
 	return true;
 }
@@ -306,19 +494,18 @@ pool_recycler_get_linear(size_t size) noexcept
 {
 	assert(size > 0);
 
-	struct linear_pool_area **linear_p, *linear;
-	for (linear_p = &recycler.linear_areas, linear = *linear_p;
-	     linear != nullptr;
-	     linear_p = &linear->prev, linear = *linear_p) {
-		if (linear->size == size) {
-			assert(recycler.num_linear_areas > 0);
-			--recycler.num_linear_areas;
-			*linear_p = linear->prev;
-			return linear;
-		}
+	const unsigned c = area_size_class(size);
+	if (area_class_size(c) != size)
+		return nullptr;
+
+	struct linear_pool_area *linear = recycler.linear_areas[c];
+	if (linear != nullptr) {
+		assert(recycler.num_linear_areas > 0);
+		--recycler.num_linear_areas;
+		recycler.linear_areas[c] = linear->prev;
 	}
 
-	return nullptr;
+	return linear;
 }
 
 static void
@@ -478,9 +665,14 @@ pool_new_linear(struct pool *parent, const char *name,
 	return pool_new_libc(parent, name);
 #else
 
+	auto *name_data = LookupPoolName(name);
+
 	struct pool *pool = pool_new(parent, name);
 	pool->type = POOL_LINEAR;
-	pool->area_size = initial_size;
+	pool->area_size = name_data != nullptr && name_data->area_size > 0
+		? name_data->area_size
+		: round_area_size(initial_size);
+	pool->name_data = name_data;
 	pool->slice_pool = nullptr;
 	pool->current_area.linear = nullptr;
 
@@ -517,6 +709,7 @@ pool_new_slice(struct pool *parent, const char *name,
 	struct pool *pool = pool_new(parent, name);
 	pool->type = POOL_LINEAR;
 	pool->area_size = slice_pool->GetSliceSize() - LINEAR_POOL_AREA_HEADER;
+	pool->name_data = nullptr;
 	pool->slice_pool = slice_pool;
 	pool->current_area.linear = nullptr;
 
@@ -829,6 +1022,34 @@ pool_dump_tree(const struct pool &pool) noexcept
 	pool_dump_node(0, pool);
 }
 
+std::vector<PoolNameStats>
+pool_get_name_stats() noexcept
+{
+	std::vector<PoolNameStats> result;
+	result.reserve(pool_names.size());
+
+	for (const auto &[name, data] : pool_names)
+		result.push_back({
+			name,
+			data.n_pools,
+			data.n_spilled,
+			data.high_water,
+			data.area_size,
+		});
+
+	return result;
+}
+
+void
+pool_dump_name_stats() noexcept
+{
+	for (const auto &[name, data] : pool_names)
+		LogConcat(2, "pool", "name '", name, "' pools=", data.n_pools,
+			  " spilled=", data.n_spilled,
+			  " high_water=", data.high_water,
+			  " area_size=", data.area_size);
+}
+
 #ifndef NDEBUG
 
 void
@@ -909,6 +1130,19 @@ pool_clear(struct pool &pool) noexcept
 		break;
 
 	case POOL_LINEAR:
+		if (pool.name_data != nullptr &&
+		    pool.current_area.linear != nullptr) {
+			size_t used = 0;
+			unsigned n_areas = 0;
+			for (const auto *area = pool.current_area.linear;
+			     area != nullptr; area = area->prev) {
+				used += area->used;
+				++n_areas;
+			}
+
+			pool.name_data->AddSample(used, n_areas > 1);
+		}
+
 		while (pool.current_area.linear != nullptr) {
 			struct linear_pool_area *area = pool.current_area.linear;
 			pool.current_area.linear = area->prev;
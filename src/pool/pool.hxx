@@ -65,6 +65,14 @@ pool_new_dummy(struct pool *parent, const char *name) noexcept;
 PoolPtr
 pool_new_libc(struct pool *parent, const char *name) noexcept;
 
+/**
+ * Create a new pool which allocates from larger memory areas.
+ *
+ * @param initial_size the size of each area; it is only used until
+ * enough statistics about pools with the same name have been
+ * collected, and then the area size is chosen based on how much
+ * memory those pools really needed
+ */
 PoolPtr
 pool_new_linear(struct pool *parent, const char *name,
 		size_t initial_size) noexcept;
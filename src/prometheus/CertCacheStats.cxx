@@ -0,0 +1,90 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CertCacheStats.hxx"
+#include "stats/CertCacheStats.hxx"
+#include "memory/GrowingBuffer.hxx"
+
+#include <inttypes.h>
+
+namespace Prometheus {
+
+void
+Write(GrowingBuffer &buffer, const char *process, const char *certdb,
+      const CertCacheStats &stats) noexcept
+{
+	buffer.Write(R"(
+# HELP beng_proxy_certdb_certificates Number of certificates in the cache
+# TYPE beng_proxy_certdb_certificates gauge
+
+# HELP beng_proxy_certdb_context_bytes Estimated memory used by prebuilt SSL_CTX instances
+# TYPE beng_proxy_certdb_context_bytes gauge
+
+# HELP beng_proxy_certdb_warmup_queued Number of certificates waiting to be loaded by the warm-up
+# TYPE beng_proxy_certdb_warmup_queued gauge
+
+# HELP beng_proxy_certdb_warmup_loaded Number of certificates loaded by the warm-up
+# TYPE beng_proxy_certdb_warmup_loaded counter
+
+# HELP beng_proxy_certdb_warmup_not_found Number of warm-up queries which did not find a certificate
+# TYPE beng_proxy_certdb_warmup_not_found counter
+
+# HELP beng_proxy_certdb_warmup_errors Number of failed warm-up queries
+# TYPE beng_proxy_certdb_warmup_errors counter
+
+# HELP beng_proxy_certdb_warmup_skipped Number of certificates not loaded because the warm-up memory limit was reached
+# TYPE beng_proxy_certdb_warmup_skipped counter
+
+# HELP beng_proxy_certdb_warmup_bytes Estimated memory used by cached certificates loaded by the warm-up
+# TYPE beng_proxy_certdb_warmup_bytes gauge
+
+)");
+
+	buffer.Format("beng_proxy_certdb_certificates{process=\"%s\",certdb=\"%s\"} %zu\n"
+		      "beng_proxy_certdb_context_bytes{process=\"%s\",certdb=\"%s\"} %zu\n"
+		      "beng_proxy_certdb_warmup_queued{process=\"%s\",certdb=\"%s\"} %zu\n"
+		      "beng_proxy_certdb_warmup_loaded{process=\"%s\",certdb=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_certdb_warmup_not_found{process=\"%s\",certdb=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_certdb_warmup_errors{process=\"%s\",certdb=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_certdb_warmup_skipped{process=\"%s\",certdb=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_certdb_warmup_bytes{process=\"%s\",certdb=\"%s\"} %zu\n",
+		      process, certdb, stats.n_certificates,
+		      process, certdb, stats.contexts_size,
+		      process, certdb, stats.warmup_queued,
+		      process, certdb, stats.warmup_loaded,
+		      process, certdb, stats.warmup_not_found,
+		      process, certdb, stats.warmup_errors,
+		      process, certdb, stats.warmup_skipped,
+		      process, certdb, stats.warmup_size);
+}
+
+} // namespace Prometheus
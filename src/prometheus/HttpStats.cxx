@@ -85,16 +85,22 @@ Write(GrowingBuffer &buffer, const char *process, const char *listener,
 
 void
 Write(GrowingBuffer &buffer, const char *process, const char *listener,
-      const TaggedHttpStats &tagged_stats) noexcept
+      const char *tag, const HttpStats &stats) noexcept
 {
-	for (const auto &[tag, stats] : tagged_stats.per_tag) {
-		char labels[256];
-		snprintf(labels, sizeof(labels),
-			 "process=\"%s\",listener=\"%s\",tag=\"%s\",",
-			 process, listener, tag.c_str());
+	char labels[256];
+	snprintf(labels, sizeof(labels),
+		 "process=\"%s\",listener=\"%s\",tag=\"%s\",",
+		 process, listener, tag);
+
+	Write(buffer, labels, stats);
+}
 
-		Write(buffer, labels, stats);
-	}
+void
+Write(GrowingBuffer &buffer, const char *process, const char *listener,
+      const TaggedHttpStats &tagged_stats) noexcept
+{
+	for (const auto &[tag, stats] : tagged_stats.per_tag)
+		Write(buffer, process, listener, tag.c_str(), stats);
 }
 
 } // namespace Prometheus
@@ -42,6 +42,10 @@ void
 Write(GrowingBuffer &buffer, const char *process, const char *listener,
       const HttpStats &stats) noexcept;
 
+void
+Write(GrowingBuffer &buffer, const char *process, const char *listener,
+      const char *tag, const HttpStats &stats) noexcept;
+
 void
 Write(GrowingBuffer &buffer, const char *process, const char *listener,
       const TaggedHttpStats &stats) noexcept;
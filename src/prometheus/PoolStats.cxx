@@ -0,0 +1,75 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PoolStats.hxx"
+#include "pool/NameStats.hxx"
+#include "memory/GrowingBuffer.hxx"
+
+#include <inttypes.h>
+
+namespace Prometheus {
+
+void
+Write(GrowingBuffer &buffer, const char *process,
+      std::span<const PoolNameStats> stats) noexcept
+{
+	buffer.Write(R"(
+# HELP beng_proxy_pools Number of linear pools which have been destroyed
+# TYPE beng_proxy_pools counter
+
+# HELP beng_proxy_pools_spilled Number of linear pools which needed more than one memory area
+# TYPE beng_proxy_pools_spilled counter
+
+# HELP beng_proxy_pool_high_water Largest number of bytes allocated from one linear pool
+# TYPE beng_proxy_pool_high_water gauge
+
+# HELP beng_proxy_pool_area_size Memory area size for new linear pools
+# TYPE beng_proxy_pool_area_size gauge
+
+)");
+
+	for (const auto &i : stats) {
+		const int name_length = i.name.size();
+		const char *name = i.name.data();
+
+		buffer.Format("beng_proxy_pools{process=\"%s\",name=\"%.*s\"} %" PRIu64 "\n"
+			      "beng_proxy_pools_spilled{process=\"%s\",name=\"%.*s\"} %" PRIu64 "\n"
+			      "beng_proxy_pool_high_water{process=\"%s\",name=\"%.*s\"} %zu\n"
+			      "beng_proxy_pool_area_size{process=\"%s\",name=\"%.*s\"} %zu\n",
+			      process, name_length, name, i.n_pools,
+			      process, name_length, name, i.n_spilled,
+			      process, name_length, name, i.high_water,
+			      process, name_length, name, i.area_size);
+	}
+}
+
+} // namespace Prometheus
@@ -32,6 +32,7 @@
 
 #include "Stats.hxx"
 #include "beng-proxy/Control.hxx"
+#include "stats/LatencyHistogram.hxx"
 #include "util/ByteOrder.hxx"
 #include "memory/GrowingBuffer.hxx"
 
@@ -60,6 +61,30 @@ Write(GrowingBuffer &buffer, const char *process,
 # HELP beng_proxy_buffer_size Size of buffers in bytes
 # TYPE beng_proxy_buffer_size gauge
 
+# HELP beng_proxy_io_buffer_class_size Netto size of I/O buffers in bytes per size class
+# TYPE beng_proxy_io_buffer_class_size gauge
+
+# HELP beng_proxy_compress_slices Number of incremental memory compression slices
+# TYPE beng_proxy_compress_slices counter
+
+# HELP beng_proxy_compress_duration Total duration of memory compression
+# TYPE beng_proxy_compress_duration counter
+
+# HELP beng_proxy_compress_max_pause Longest event loop pause caused by memory compression
+# TYPE beng_proxy_compress_max_pause gauge
+
+# HELP beng_proxy_cache_lookups Number of cache lookups
+# TYPE beng_proxy_cache_lookups counter
+
+# HELP beng_proxy_regex_cache_lookups Number of compiled regular expression cache lookups
+# TYPE beng_proxy_regex_cache_lookups counter
+
+# HELP beng_proxy_regex_compile_duration Total duration of regular expression compilation
+# TYPE beng_proxy_regex_compile_duration counter
+
+# HELP beng_proxy_regex_compile_saved Estimated regular expression compile duration saved by the cache
+# TYPE beng_proxy_regex_compile_saved counter
+
 )"
 	       "beng_proxy_connections{process=\"%s\",direction=\"in\"} %" PRIu32 "\n"
 	       "beng_proxy_connections{process=\"%s\",direction=\"out\"} %" PRIu32 "\n"
@@ -74,7 +99,22 @@ Write(GrowingBuffer &buffer, const char *process,
 	       "beng_proxy_cache_size{process=\"%s\",type=\"nfs\",metric=\"netto\"} %" PRIu64 "\n"
 	       "beng_proxy_cache_size{process=\"%s\",type=\"nfs\",metric=\"brutto\"} %" PRIu64 "\n"
 	       "beng_proxy_buffer_size{process=\"%s\",type=\"io\",metric=\"netto\"} %" PRIu64 "\n"
-	       "beng_proxy_buffer_size{process=\"%s\",type=\"io\",metric=\"brutto\"} %" PRIu64 "\n",
+	       "beng_proxy_buffer_size{process=\"%s\",type=\"io\",metric=\"brutto\"} %" PRIu64 "\n"
+	       "beng_proxy_io_buffer_class_size{process=\"%s\",class=\"4k\"} %" PRIu64 "\n"
+	       "beng_proxy_io_buffer_class_size{process=\"%s\",class=\"16k\"} %" PRIu64 "\n"
+	       "beng_proxy_io_buffer_class_size{process=\"%s\",class=\"32k\"} %" PRIu64 "\n"
+	       "beng_proxy_io_buffer_class_size{process=\"%s\",class=\"64k\"} %" PRIu64 "\n"
+	       "beng_proxy_io_buffer_class_size{process=\"%s\",class=\"256k\"} %" PRIu64 "\n"
+	       "beng_proxy_compress_slices{process=\"%s\"} %" PRIu64 "\n"
+	       "beng_proxy_compress_duration{process=\"%s\"} %e\n"
+	       "beng_proxy_compress_max_pause{process=\"%s\"} %e\n"
+	       "beng_proxy_cache_lookups{process=\"%s\",type=\"filter\",tier=\"hot\",result=\"hit\"} %" PRIu64 "\n"
+	       "beng_proxy_cache_lookups{process=\"%s\",type=\"filter\",tier=\"main\",result=\"hit\"} %" PRIu64 "\n"
+	       "beng_proxy_cache_lookups{process=\"%s\",type=\"filter\",tier=\"main\",result=\"miss\"} %" PRIu64 "\n"
+	       "beng_proxy_regex_cache_lookups{process=\"%s\",result=\"hit\"} %" PRIu64 "\n"
+	       "beng_proxy_regex_cache_lookups{process=\"%s\",result=\"miss\"} %" PRIu64 "\n"
+	       "beng_proxy_regex_compile_duration{process=\"%s\"} %e\n"
+	       "beng_proxy_regex_compile_saved{process=\"%s\"} %e\n",
 	       process, FromBE32(stats.incoming_connections),
 	       process, FromBE32(stats.outgoing_connections),
 	       process, FromBE32(stats.children),
@@ -88,7 +128,55 @@ Write(GrowingBuffer &buffer, const char *process,
 	       process, FromBE64(stats.nfs_cache_size),
 	       process, FromBE64(stats.nfs_cache_brutto_size),
 	       process, FromBE64(stats.io_buffers_size),
-	       process, FromBE64(stats.io_buffers_brutto_size));
+	       process, FromBE64(stats.io_buffers_brutto_size),
+	       process, FromBE64(stats.io_buffers_class_size[0]),
+	       process, FromBE64(stats.io_buffers_class_size[1]),
+	       process, FromBE64(stats.io_buffers_class_size[2]),
+	       process, FromBE64(stats.io_buffers_class_size[3]),
+	       process, FromBE64(stats.io_buffers_class_size[4]),
+	       process, FromBE64(stats.compress_slices),
+	       process, FromBE64(stats.compress_time) / 1e6,
+	       process, FromBE64(stats.compress_max_pause) / 1e6,
+	       process, FromBE64(stats.filter_cache_hot_hits),
+	       process, FromBE64(stats.filter_cache_hits),
+	       process, FromBE64(stats.filter_cache_misses),
+	       process, FromBE64(stats.regex_cache_hits),
+	       process, FromBE64(stats.regex_cache_misses),
+	       process, FromBE64(stats.regex_compile_time) / 1e6,
+	       process, FromBE64(stats.regex_compile_time_saved) / 1e6);
+
+	buffer.Write(R"(
+# HELP beng_proxy_cgi_spawn_latency Time from launching a CGI program until its response header was received
+# TYPE beng_proxy_cgi_spawn_latency histogram
+
+)");
+
+	static constexpr const char *cgi_launchers[] = {"direct", "zygote"};
+	for (unsigned l = 0; l < 2; ++l) {
+		uint64_t count = 0;
+
+		for (unsigned i = 0; i < LatencyHistogram::N_BUCKETS; ++i) {
+			/* Prometheus buckets are cumulative */
+			count += FromBE64(stats.cgi_spawn_latency[l][i]);
+
+			if (i < LatencyHistogram::BOUNDS.size())
+				buffer.Format("beng_proxy_cgi_spawn_latency_bucket{process=\"%s\",launcher=\"%s\",le=\"%g\"} %" PRIu64 "\n",
+					      process, cgi_launchers[l],
+					      LatencyHistogram::BOUNDS[i].count() / 1e3,
+					      count);
+			else
+				buffer.Format("beng_proxy_cgi_spawn_latency_bucket{process=\"%s\",launcher=\"%s\",le=\"+Inf\"} %" PRIu64 "\n",
+					      process, cgi_launchers[l],
+					      count);
+		}
+
+		buffer.Format("beng_proxy_cgi_spawn_latency_sum{process=\"%s\",launcher=\"%s\"} %e\n"
+			      "beng_proxy_cgi_spawn_latency_count{process=\"%s\",launcher=\"%s\"} %" PRIu64 "\n",
+			      process, cgi_launchers[l],
+			      FromBE64(stats.cgi_spawn_latency_sum[l]) / 1e6,
+			      process, cgi_launchers[l],
+			      count);
+	}
 }
 
 } // namespace Prometheus
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ThreadQueueStats.hxx"
+#include "stats/ThreadQueueStats.hxx"
+#include "memory/GrowingBuffer.hxx"
+
+#include <inttypes.h>
+
+namespace Prometheus {
+
+void
+Write(GrowingBuffer &buffer, const char *process,
+      const ThreadQueueStats &stats) noexcept
+{
+	using FloatSeconds = std::chrono::duration<double>;
+
+	buffer.Write(R"(
+# HELP beng_proxy_thread_queue_waiting Number of jobs waiting for a worker thread
+# TYPE beng_proxy_thread_queue_waiting gauge
+
+# HELP beng_proxy_thread_queue_jobs Number of jobs handed to worker threads
+# TYPE beng_proxy_thread_queue_jobs counter
+
+# HELP beng_proxy_thread_queue_batches Number of job batches run by worker threads without sleeping
+# TYPE beng_proxy_thread_queue_batches counter
+
+# HELP beng_proxy_thread_queue_wakeups Number of main thread wakeups to handle finished jobs
+# TYPE beng_proxy_thread_queue_wakeups counter
+
+# HELP beng_proxy_thread_queue_completions Number of finished jobs handled by the main thread
+# TYPE beng_proxy_thread_queue_completions counter
+
+# HELP beng_proxy_thread_queue_wait Total time jobs were waiting for a worker thread
+# TYPE beng_proxy_thread_queue_wait counter
+
+)");
+
+	buffer.Format("beng_proxy_thread_queue_waiting{process=\"%s\"} %zu\n"
+		      "beng_proxy_thread_queue_jobs{process=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_thread_queue_batches{process=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_thread_queue_wakeups{process=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_thread_queue_completions{process=\"%s\"} %" PRIu64 "\n"
+		      "beng_proxy_thread_queue_wait{process=\"%s\"} %e\n",
+		      process, stats.n_waiting,
+		      process, stats.n_jobs,
+		      process, stats.n_batches,
+		      process, stats.n_wakeups,
+		      process, stats.n_completions,
+		      process, FloatSeconds(stats.wait_time).count());
+}
+
+} // namespace Prometheus
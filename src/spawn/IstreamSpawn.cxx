@@ -442,25 +442,22 @@ SpawnIstream::SpawnIstream(EventLoop &event_loop,
 }
 
 UnusedIstreamPtr
-SpawnChildProcess(EventLoop &event_loop, struct pool *pool, const char *name,
+SpawnChildProcess(EventLoop &event_loop, struct pool *pool,
 		  UnusedIstreamPtr input,
-		  PreparedChildProcess &&prepared,
-		  SpawnService &spawn_service)
+		  ChildProcessLauncher &launcher)
 {
+	UniqueFileDescriptor stdin_fd;
 	if (input) {
 		int fd = input.AsFd();
 		if (fd >= 0)
-			prepared.SetStdin(fd);
+			stdin_fd = UniqueFileDescriptor{fd};
 	}
 
 	UniqueFileDescriptor stdin_pipe;
 	if (input) {
-		UniqueFileDescriptor stdin_r;
-		if (!UniqueFileDescriptor::CreatePipe(stdin_r, stdin_pipe))
+		if (!UniqueFileDescriptor::CreatePipe(stdin_fd, stdin_pipe))
 			throw MakeErrno("pipe() failed");
 
-		prepared.SetStdin(std::move(stdin_r));
-
 		stdin_pipe.SetNonBlocking();
 	}
 
@@ -468,11 +465,9 @@ SpawnChildProcess(EventLoop &event_loop, struct pool *pool, const char *name,
 	if (!UniqueFileDescriptor::CreatePipe(stdout_pipe, stdout_w))
 		throw MakeErrno("pipe() failed");
 
-	prepared.SetStdout(std::move(stdout_w));
-
 	stdout_pipe.SetNonBlocking();
 
-	auto handle = spawn_service.SpawnChildProcess(name, std::move(prepared));
+	auto handle = launcher.Launch(std::move(stdin_fd), std::move(stdout_w));
 	auto f = NewFromPool<SpawnIstream>(*pool, event_loop,
 					   *pool,
 					   std::move(input), std::move(stdin_pipe),
@@ -483,3 +478,39 @@ SpawnChildProcess(EventLoop &event_loop, struct pool *pool, const char *name,
 
 	return UnusedIstreamPtr(f);
 }
+
+namespace {
+
+class SpawnServiceLauncher final : public ChildProcessLauncher {
+	SpawnService &spawn_service;
+	const char *const name;
+	PreparedChildProcess &prepared;
+
+public:
+	SpawnServiceLauncher(SpawnService &_spawn_service, const char *_name,
+			     PreparedChildProcess &_prepared) noexcept
+		:spawn_service(_spawn_service), name(_name),
+		 prepared(_prepared) {}
+
+	std::unique_ptr<ChildProcessHandle> Launch(UniqueFileDescriptor stdin_fd,
+						   UniqueFileDescriptor stdout_fd) override {
+		if (stdin_fd.IsDefined())
+			prepared.SetStdin(std::move(stdin_fd));
+		prepared.SetStdout(std::move(stdout_fd));
+
+		return spawn_service.SpawnChildProcess(name, std::move(prepared));
+	}
+};
+
+} // anonymous namespace
+
+UnusedIstreamPtr
+SpawnChildProcess(EventLoop &event_loop, struct pool *pool, const char *name,
+		  UnusedIstreamPtr input,
+		  PreparedChildProcess &&prepared,
+		  SpawnService &spawn_service)
+{
+	SpawnServiceLauncher launcher(spawn_service, name, prepared);
+	return SpawnChildProcess(event_loop, pool, std::move(input),
+				 launcher);
+}
@@ -32,6 +32,8 @@
 
 #pragma once
 
+#include <memory>
+
 #include <sys/types.h>
 
 struct pool;
@@ -39,6 +41,24 @@ struct PreparedChildProcess;
 class SpawnService;
 class EventLoop;
 class UnusedIstreamPtr;
+class UniqueFileDescriptor;
+class ChildProcessHandle;
+
+/**
+ * Launches a child process with the given standard input and
+ * output.  This allows SpawnChildProcess() to be used with
+ * something other than a #SpawnService.
+ */
+class ChildProcessLauncher {
+public:
+	/**
+	 * Throws exception on error.
+	 *
+	 * @param stdin_fd the standard input; may be undefined
+	 */
+	virtual std::unique_ptr<ChildProcessHandle> Launch(UniqueFileDescriptor stdin_fd,
+							   UniqueFileDescriptor stdout_fd) = 0;
+};
 
 /**
  * Wrapper for the fork() system call.  Forks a sub process, returns
@@ -60,3 +80,12 @@ SpawnChildProcess(EventLoop &event_loop, struct pool *pool, const char *name,
 		  UnusedIstreamPtr input,
 		  PreparedChildProcess &&prepared,
 		  SpawnService &spawn_service);
+
+/**
+ * Like the other overload, but let a #ChildProcessLauncher launch
+ * the process.
+ */
+UnusedIstreamPtr
+SpawnChildProcess(EventLoop &event_loop, struct pool *pool,
+		  UnusedIstreamPtr input,
+		  ChildProcessLauncher &launcher);
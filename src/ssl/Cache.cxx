@@ -31,7 +31,9 @@
  */
 
 #include "Cache.hxx"
+#include "CertCtx.hxx"
 #include "CompletionHandler.hxx"
+#include "lib/openssl/Ctx.hxx"
 #include "lib/openssl/Name.hxx"
 #include "lib/openssl/AltName.hxx"
 #include "lib/openssl/Error.hxx"
@@ -46,8 +48,28 @@
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+#include <algorithm>
+#include <limits>
 #include <set>
 
+/**
+ * The number of items loaded by the warm-up which are published in
+ * one #CertCache::Snapshot update.
+ */
+static constexpr std::size_t WARMUP_BATCH = 64;
+
+/**
+ * How often does the main thread check whether retired data can be
+ * freed?  Read-side critical sections are short, so the grace period
+ * is usually over by the first check.
+ */
+static constexpr auto RECLAIM_INTERVAL = std::chrono::milliseconds(10);
+
+/**
+ * How often are the handshake counters in #CertUsage halved?
+ */
+static constexpr auto USAGE_DECAY_INTERVAL = std::chrono::hours(24);
+
 struct CertCache::Request final : AutoUnlinkIntrusiveListHook, Cancellable {
 	SSL &ssl;
 
@@ -164,12 +186,15 @@ CertCache::Query::Run()
 		   OnCompletion() */
 		co_return;
 
-	cert_key = cache.Add(std::move(cert_key),
-			     _special);
+	const auto item = cache.Add(std::move(cert_key), _special);
+
+	/* this item was loaded because a client wants it; count
+	   this as its first use */
+	item->n_used.fetch_add(1, std::memory_order_relaxed);
 
-	requests.clear_and_dispose([this, &cert_key](Request *request){
+	requests.clear_and_dispose([this, &item](Request *request){
 		try {
-			cache.Apply(request->ssl, cert_key);
+			cache.Apply(request->ssl, *item);
 			cache.state_idx.Set(request->ssl, State::COMPLETE);
 		} catch (...) {
 			cache.logger(1, std::current_exception());
@@ -215,30 +240,318 @@ CertCache::Query::OnCompletion(std::exception_ptr error) noexcept
 	_cache.StartQuery();
 }
 
+CertCache::Item::~Item() noexcept
+{
+	if (SSL_CTX *ctx = ssl_ctx.load(std::memory_order_relaxed)) {
+		contexts_size.fetch_sub(GetContextSize(),
+					std::memory_order_relaxed);
+		SSL_CTX_free(ctx);
+	}
+}
+
+std::size_t
+CertCache::Item::GetContextSize() const noexcept
+{
+	return EstimateCertSslCtxSize(*cert, *key, chain);
+}
+
+std::size_t
+CertCache::Item::GetSize() const noexcept
+{
+	return EstimateCertKeySize(*cert, *key);
+}
+
+inline void
+CertCache::Item::Touch(std::chrono::steady_clock::time_point now) noexcept
+{
+	if (now - last_used.load(std::memory_order_relaxed) >= std::chrono::seconds(1)) {
+		last_used.store(now, std::memory_order_relaxed);
+		n_used.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const auto new_expires = now + std::chrono::hours(24);
+	if (new_expires - expires.load(std::memory_order_relaxed) >= std::chrono::minutes(1))
+		expires.store(new_expires, std::memory_order_relaxed);
+}
+
+inline bool
+CertCache::Item::InstallContext(SSL_CTX &ctx) noexcept
+{
+	SSL_CTX *expected = nullptr;
+	if (!ssl_ctx.compare_exchange_strong(expected, &ctx))
+		return false;
+
+	SSL_CTX_up_ref(&ctx);
+	contexts_size.fetch_add(GetContextSize(), std::memory_order_relaxed);
+	return true;
+}
+
+void
+CertCache::Snapshot::Insert(const ItemPtr &item) noexcept
+{
+	for (const std::string_view name : item->names) {
+		names.emplace(name, item);
+
+		if (name.starts_with('*'))
+			wildcards.emplace(name.substr(1), item);
+	}
+}
+
+template<typename M, typename I>
+static void
+EraseItem(M &map, std::string_view name, const I &item) noexcept
+{
+	for (auto [i, end] = map.equal_range(name); i != end;) {
+		if (i->second.get() == &item)
+			i = map.erase(i);
+		else
+			++i;
+	}
+}
+
+void
+CertCache::Snapshot::Remove(std::string_view name, const Item &item) noexcept
+{
+	EraseItem(names, name, item);
+
+	if (name.starts_with('*'))
+		EraseItem(wildcards, name.substr(1), item);
+}
+
+void
+CertCache::Snapshot::Remove(const Item &item) noexcept
+{
+	for (const std::string_view name : item.names)
+		Remove(name, item);
+}
+
+const CertCache::ItemPtr *
+CertCache::Snapshot::FindExact(std::string_view host,
+			       std::string_view special) const noexcept
+{
+	for (auto [i, end] = names.equal_range(host); i != end; ++i)
+		if (i->second->special == special)
+			return &i->second;
+
+	return nullptr;
+}
+
+const CertCache::ItemPtr *
+CertCache::Snapshot::Find(const char *host,
+			  std::string_view special) const noexcept
+{
+	if (const auto *item = FindExact(host, special))
+		return item;
+
+	if (*host == '*' || *host == '.') {
+		/* unusual host name; use the generic (slow) wildcard
+		   code */
+		const auto wildcard = MakeCommonNameWildcard(host);
+		return wildcard.empty()
+			? nullptr
+			: FindExact(wildcard, special);
+	}
+
+	/* "foo.example.com" matches the wildcard "*.example.com"
+	   which is stored as ".example.com" in the "wildcards"
+	   map */
+	const char *dot = strchr(host, '.');
+	if (dot == nullptr)
+		return nullptr;
+
+	for (auto [i, end] = wildcards.equal_range(dot); i != end; ++i)
+		if (i->second->special == special)
+			return &i->second;
+
+	return nullptr;
+}
+
 CertCache::CertCache(EventLoop &event_loop,
-		     const CertDatabaseConfig &_config) noexcept
-	:logger("CertCache"), config(_config),
+		     const CertDatabaseConfig &_config,
+		     const CertCacheConfig &_cache_config) noexcept
+	:logger("CertCache"), config(_config), cache_config(_cache_config),
 	 query_added_notify(event_loop, BIND_THIS_METHOD(StartQuery)),
+	 evict_notify(event_loop, BIND_THIS_METHOD(EvictContexts)),
 	 db(event_loop, config.connect.c_str(), config.schema.c_str(),
 	    *this),
-	 name_cache(event_loop, _config, *this)
+	 name_cache(event_loop, _config, *this),
+	 snapshot(new Snapshot()),
+	 reclaim_timer(event_loop, BIND_THIS_METHOD(Reclaim)),
+	 publish_event(event_loop, BIND_THIS_METHOD(PublishPending))
 {
 }
 
-CertCache::~CertCache() noexcept = default;
+CertCache::~CertCache() noexcept
+{
+	/* all worker threads are gone; no need to wait for grace
+	   periods */
+	for (auto &i : retired)
+		for (SSL_CTX *ctx : i.contexts)
+			SSL_CTX_free(ctx);
+
+	delete snapshot.load();
+}
+
+void
+CertCache::Publish(std::unique_ptr<Snapshot> &&new_snapshot) noexcept
+{
+	std::unique_ptr<const Snapshot> old{snapshot.exchange(new_snapshot.release())};
+
+	/* worker threads may still use the old snapshot */
+	Retire(std::move(old), {});
+}
+
+void
+CertCache::Retire(std::unique_ptr<const Snapshot> &&old_snapshot,
+		  std::vector<SSL_CTX *> &&old_contexts) noexcept
+{
+	Retired r{
+		rcu.StartGracePeriod(),
+		std::move(old_snapshot),
+		std::move(old_contexts),
+	};
+
+	try {
+		retired.push_back(std::move(r));
+	} catch (...) {
+		/* out of memory: fall back to waiting */
+		rcu.Synchronize();
+		for (SSL_CTX *ctx : r.contexts)
+			SSL_CTX_free(ctx);
+		return;
+	}
+
+	if (!reclaim_timer.IsPending())
+		reclaim_timer.Schedule(RECLAIM_INTERVAL);
+}
+
+void
+CertCache::Reclaim() noexcept
+{
+	while (!retired.empty() &&
+	       rcu.PollGracePeriod(retired.front().grace_period)) {
+		for (SSL_CTX *ctx : retired.front().contexts)
+			SSL_CTX_free(ctx);
+
+		retired.pop_front();
+	}
+
+	if (!retired.empty())
+		reclaim_timer.Schedule(RECLAIM_INTERVAL);
+}
 
 void
 CertCache::Expire() noexcept
 {
 	const auto now = GetEventLoop().SteadyNow();
 
-	const std::scoped_lock lock{mutex};
-	for (auto i = map.begin(), end = map.end(); i != end;) {
-		if (now >= i->second.expires) {
-			logger(5, "flushed certificate '", i->first, "'");
-			i = map.erase(i);
-		} else
-			++i;
+	/* the main thread is the only writer, so it may access the
+	   current snapshot without RcuReadLock */
+	const auto &current = *snapshot.load();
+
+	std::unique_ptr<Snapshot> new_snapshot;
+
+	for (const auto &[name, item] : current.names) {
+		if (now < item->expires.load(std::memory_order_relaxed) ||
+		    name != item->names.front())
+			continue;
+
+		logger(5, "flushed certificate '", name, "'");
+
+		if (!new_snapshot)
+			new_snapshot = std::make_unique<Snapshot>(current);
+
+		CollectUsage(*item);
+		ForgetWarmup(*item);
+		new_snapshot->Remove(*item);
+	}
+
+	if (new_snapshot)
+		Publish(std::move(new_snapshot));
+
+	if (!cache_config.usage_file.empty()) {
+		CollectUsage();
+
+		if (now >= next_usage_decay) {
+			usage.Decay();
+			next_usage_decay = now + USAGE_DECAY_INTERVAL;
+		}
+
+		SaveUsage();
+	}
+}
+
+CertCacheStats
+CertCache::GetStats() const noexcept
+{
+	CertCacheStats result = stats;
+
+	for (const auto &[name, item] : snapshot.load()->names)
+		if (name == item->names.front())
+			++result.n_certificates;
+
+	result.contexts_size = contexts_size.load(std::memory_order_relaxed);
+	result.warmup_queued = warmup_queue.size();
+	return result;
+}
+
+inline void
+CertCache::ForgetWarmup(const Item &item) noexcept
+{
+	if (!item.warmup)
+		return;
+
+	const std::size_t size = item.GetSize();
+	assert(stats.warmup_size >= size);
+	stats.warmup_size -= size;
+}
+
+void
+CertCache::CollectUsage(Item &item) noexcept
+{
+	if (cache_config.usage_file.empty())
+		return;
+
+	if (const unsigned n = item.n_used.exchange(0, std::memory_order_relaxed))
+		usage.Add(CertUsage::MakeKey(item.names.front(), item.special), n);
+}
+
+void
+CertCache::CollectUsage() noexcept
+{
+	for (const auto &[name, item] : snapshot.load()->names)
+		if (name == item->names.front())
+			CollectUsage(*item);
+}
+
+void
+CertCache::LoadUsage() noexcept
+{
+	if (cache_config.usage_file.empty())
+		return;
+
+	try {
+		usage.Load(cache_config.usage_file.c_str());
+		logger(4, "loaded ", usage.size(), " certificate usage records");
+	} catch (...) {
+		logger(1, "Failed to load certificate usage: ",
+		       std::current_exception());
+	}
+
+	next_usage_decay = GetEventLoop().SteadyNow() + USAGE_DECAY_INTERVAL;
+}
+
+void
+CertCache::SaveUsage() noexcept
+{
+	if (cache_config.usage_file.empty())
+		return;
+
+	try {
+		usage.Save(cache_config.usage_file.c_str());
+	} catch (...) {
+		logger(1, "Failed to save certificate usage: ",
+		       std::current_exception());
 	}
 }
 
@@ -261,6 +574,21 @@ CertCache::LoadCaCertificate(const char *path)
 void
 CertCache::Connect() noexcept
 {
+	LoadUsage();
+
+	if (cache_config.warmup != CertCacheConfig::Warmup::NONE) {
+		/* the most frequently used certificates first; with
+		   Warmup::ALL, the rest will be queued by
+		   OnCertNameLoaded() while the CertNameCache is being
+		   filled */
+		const std::size_t n = cache_config.warmup == CertCacheConfig::Warmup::TOP
+			? cache_config.warmup_count
+			: std::numeric_limits<std::size_t>::max();
+
+		for (auto &key : usage.GetTop(n))
+			QueueWarmup(std::move(key), false);
+	}
+
 	db.Connect();
 	name_cache.Connect();
 }
@@ -276,12 +604,21 @@ CertCache::Disconnect() noexcept
 		current_query = queries.end();
 	}
 
+	warmup_task = {};
+	warmup_queue.clear();
+	warmup_keys.clear();
+	PublishPending();
+
 	db.Disconnect();
 	query_added_notify.Disable();
+	evict_notify.Disable();
+
+	CollectUsage();
+	SaveUsage();
 }
 
-inline UniqueCertKey
-CertCache::Add(UniqueCertKey &&ck, const char *special)
+CertCache::ItemPtr
+CertCache::MakeItem(UniqueCertKey &&ck, const char *special)
 {
 	assert(ck);
 
@@ -291,53 +628,45 @@ CertCache::Add(UniqueCertKey &&ck, const char *special)
 	if (name == nullptr)
 		throw std::runtime_error("Certificate without common name");
 
-	const std::scoped_lock lock{mutex};
-	auto i = map.emplace(std::piecewise_construct,
-			     std::forward_as_tuple(name.c_str()),
-			     std::forward_as_tuple(std::move(ck),
-						   GetEventLoop().SteadyNow()));
+	const auto *chain = FindChain(*ck.cert);
+
+	auto item = std::make_shared<Item>(std::move(ck), chain,
+					   GetEventLoop().SteadyNow(),
+					   contexts_size);
 
 	if (special != nullptr)
-		i->second.special = special;
+		item->special = special;
+
+	/* the common name first, followed by all other altNames */
+	item->names.emplace_back(name.c_str());
 
-	/* create shadow items for all altNames */
 	std::set<std::string> alt_names;
-	for (auto &a : GetSubjectAltNames(*i->second.cert))
+	for (auto &a : GetSubjectAltNames(*item->cert))
 		alt_names.emplace(std::move(a));
 
-	alt_names.erase(i->first);
+	alt_names.erase(item->names.front());
 
 	for (auto &a : alt_names)
-		map.emplace(std::move(a), i->second);
+		item->names.emplace_back(std::move(a));
 
-	return UpRef(i->second);
+	return item;
 }
 
-inline std::optional<UniqueCertKey>
-CertCache::GetNoWildCardCached(const char *host, const char *_special) noexcept
+inline CertCache::ItemPtr
+CertCache::Add(UniqueCertKey &&ck, const char *special)
 {
-	const std::scoped_lock lock{mutex};
+	auto item = MakeItem(std::move(ck), special);
 
-	const std::string_view special{
-		_special != nullptr
-		? std::string_view{_special}
-		: std::string_view{}
-	};
-
-	for (auto [i, end] = map.equal_range(host); i != end; ++i) {
-		if (i->second.special == special) {
-			i->second.expires = GetEventLoop().SteadyNow() + std::chrono::hours(24);
-			return UpRef(i->second);
-		}
-	}
+	pending_items.emplace_back(item);
+	publish_event.Schedule();
 
-	return std::nullopt;
+	return item;
 }
 
 void
 CertCache::StartQuery() noexcept
 {
-	if (current_query != queries.end())
+	if (current_query != queries.end() || warmup_task)
 		/* already busy */
 		return;
 
@@ -345,21 +674,158 @@ CertCache::StartQuery() noexcept
 		/* database is (re)connecting */
 		return;
 
-	/* pick an arbitrary request and start the database query */
-	const std::scoped_lock lock{mutex};
-	while (!queries.empty()) {
-		auto i = queries.begin();
-		if (!i->second.IsCancelled()) {
-			/* found a candidate - start it */
-			current_query = i;
-			current_query->second.Start();
-			break;
+	{
+		/* pick an arbitrary request and start the database
+		   query */
+		const std::scoped_lock lock{mutex};
+		while (!queries.empty()) {
+			auto i = queries.begin();
+			if (!i->second.IsCancelled()) {
+				/* found a candidate - start it */
+				current_query = i;
+				current_query->second.Start();
+				return;
+			}
+
+			/* this query was scheduled, but meanwhile all
+			   requests were cancelled, so don't bother */
+			queries.erase(i);
+		}
+	}
+
+	/* no client is waiting for us; continue the warm-up */
+	StartWarmup();
+}
+
+bool
+CertCache::IsCached(std::string_view name,
+		    std::string_view special) const noexcept
+{
+	if (snapshot.load()->FindExact(name, special) != nullptr)
+		return true;
+
+	for (const auto &item : pending_items)
+		if (item->special == special &&
+		    std::find(item->names.begin(), item->names.end(),
+			      name) != item->names.end())
+			return true;
+
+	return false;
+}
+
+void
+CertCache::QueueWarmup(std::string &&key, bool refresh) noexcept
+{
+	if (!warmup_keys.emplace(key).second) {
+		/* already queued; a refresh request must not be
+		   dropped by CertCacheConfig::max_warmup_size */
+		if (refresh)
+			for (auto &i : warmup_queue)
+				if (i.key == key)
+					i.refresh = true;
+		return;
+	}
+
+	warmup_queue.push_back({std::move(key), refresh});
+
+	if (!warmup_running) {
+		warmup_running = true;
+		logger(4, "starting certificate warm-up");
+	}
+
+	StartQuery();
+}
+
+void
+CertCache::StartWarmup() noexcept
+{
+	assert(current_query == queries.end());
+	assert(!warmup_task);
+
+	while (!warmup_queue.empty()) {
+		auto request = std::move(warmup_queue.front());
+		warmup_queue.pop_front();
+		warmup_keys.erase(request.key);
+
+		const auto [name, special] = CertUsage::SplitKey(request.key);
+		if (IsCached(name, special))
+			continue;
+
+		if (!request.refresh &&
+		    stats.warmup_size >= cache_config.max_warmup_size) {
+			++stats.warmup_skipped;
+			continue;
 		}
 
-		/* this query was scheduled, but meanwhile all
-		   requests were cancelled, so don't bother */
-		queries.erase(i);
+		warmup_task = RunWarmup(std::move(request.key));
+		warmup_task.Start(BIND_THIS_METHOD(OnWarmupCompletion));
+		return;
+	}
+
+	PublishPending();
+
+	if (warmup_running) {
+		warmup_running = false;
+		logger(4, "certificate warm-up finished: ",
+		       stats.warmup_loaded, " loaded, ",
+		       stats.warmup_not_found, " not found, ",
+		       stats.warmup_errors, " errors, ",
+		       stats.warmup_skipped, " skipped");
+	}
+}
+
+void
+CertCache::PublishPending() noexcept
+{
+	if (pending_items.empty())
+		return;
+
+	auto new_snapshot = std::make_unique<Snapshot>(*snapshot.load());
+	for (const auto &item : pending_items)
+		new_snapshot->Insert(item);
+	Publish(std::move(new_snapshot));
+
+	pending_items.clear();
+}
+
+Co::InvokeTask
+CertCache::RunWarmup(std::string key)
+{
+	const auto name_special = CertUsage::SplitKey(key);
+	const std::string name{name_special.first};
+	const std::string special{name_special.second};
+	const char *_special = special.empty() ? nullptr : special.c_str();
+
+	auto cert_key = co_await CoGetServerCertificateKey(db, config,
+							   name.c_str(),
+							   _special);
+	if (!cert_key) {
+		++stats.warmup_not_found;
+		co_return;
 	}
+
+	auto item = MakeItem(std::move(cert_key), _special);
+	item->warmup = true;
+	stats.warmup_size += item->GetSize();
+	++stats.warmup_loaded;
+
+	pending_items.emplace_back(std::move(item));
+	if (pending_items.size() >= WARMUP_BATCH)
+		PublishPending();
+}
+
+void
+CertCache::OnWarmupCompletion(std::exception_ptr error) noexcept
+{
+	if (error) {
+		++stats.warmup_errors;
+		logger(2, "certificate warm-up failed: ", error);
+	}
+
+	warmup_task = {};
+
+	/* continue with the next query or the next warm-up item */
+	StartQuery();
 }
 
 void
@@ -401,37 +867,103 @@ CertCache::ScheduleQuery(SSL &ssl, const char *host,
 		query_added_notify.Signal();
 }
 
-inline void
-CertCache::Apply(SSL &ssl, X509 &cert, EVP_PKEY &key)
+inline const std::forward_list<UniqueX509> *
+CertCache::FindChain(X509 &cert) const noexcept
 {
-	ERR_clear_error();
-
-	if (SSL_use_PrivateKey(&ssl, &key) != 1)
-		throw SslError("SSL_use_PrivateKey() failed");
-
-	if (SSL_use_certificate(&ssl, &cert) != 1)
-		throw SslError("SSL_use_certificate() failed");
-
 	if (X509_NAME *issuer = X509_get_issuer_name(&cert);
 	    issuer != nullptr) {
 		auto i = ca_certs.find(CalcSHA1(*issuer));
 		if (i != ca_certs.end())
-			for (const auto &ca_cert : i->second)
-				SSL_add1_chain_cert(&ssl, ca_cert.get());
+			return &i->second;
 	}
+
+	return nullptr;
 }
 
-inline void
-CertCache::Apply(SSL &ssl, const UniqueCertKey &cert_key)
+void
+CertCache::EvictContexts() noexcept
 {
-	Apply(ssl, *cert_key.cert, *cert_key.key);
+	if (contexts_size.load(std::memory_order_relaxed) <= cache_config.max_contexts_size)
+		return;
+
+	const auto &current = *snapshot.load();
+
+	/* collect all items with a context (each only once, via its
+	   common name) */
+	std::vector<Item *> items;
+	for (const auto &[name, item] : current.names)
+		if (name == item->names.front() &&
+		    item->ssl_ctx.load(std::memory_order_relaxed) != nullptr)
+			items.push_back(item.get());
+
+	std::sort(items.begin(), items.end(), [](const Item *a, const Item *b){
+		return a->last_used.load(std::memory_order_relaxed) <
+			b->last_used.load(std::memory_order_relaxed);
+	});
+
+	/* never evict the most recently used context, even if it
+	   alone exceeds the limit */
+	if (!items.empty())
+		items.pop_back();
+
+	std::size_t size = contexts_size.load(std::memory_order_relaxed);
+	std::vector<SSL_CTX *> evicted;
+
+	for (Item *item : items) {
+		if (size <= cache_config.max_contexts_size)
+			break;
+
+		if (SSL_CTX *ctx = item->ssl_ctx.exchange(nullptr)) {
+			const std::size_t item_size = item->GetContextSize();
+			evicted.push_back(ctx);
+			size -= std::min(size, item_size);
+
+			/* account for it right away, or else the next
+			   EvictContexts() call would evict even
+			   more */
+			contexts_size.fetch_sub(item_size,
+						std::memory_order_relaxed);
+		}
+	}
+
+	if (evicted.empty())
+		return;
+
+	logger(5, "evicted ", evicted.size(), " SSL_CTX instances");
+
+	/* worker threads may have obtained one of these pointers just
+	   before we removed it; free them after the grace period */
+	Retire(nullptr, std::move(evicted));
+}
+
+void
+CertCache::Apply(SSL &ssl, Item &item)
+{
+	{
+		const RcuReadLock lock{rcu};
+		if (SSL_CTX *ctx = item.ssl_ctx.load(std::memory_order_acquire)) {
+			SwitchSslCtx(ssl, *ctx);
+			return;
+		}
+	}
+
+	/* not yet built (or evicted meanwhile); this is the
+	   expensive part, therefore it is done outside of the read
+	   lock */
+	const auto ssl_ctx = MakeCertSslCtx(*item.cert, *item.key, item.chain);
+
+	if (item.InstallContext(*ssl_ctx) &&
+	    contexts_size.load(std::memory_order_relaxed) > cache_config.max_contexts_size)
+		evict_notify.Signal();
+
+	SwitchSslCtx(ssl, *ssl_ctx);
 }
 
 inline LookupCertResult
-CertCache::ApplyAndSetState(SSL &ssl, const UniqueCertKey &cert_key) noexcept
+CertCache::ApplyAndSetState(SSL &ssl, Item &item) noexcept
 {
 	try {
-		Apply(ssl, cert_key);
+		Apply(ssl, item);
 		state_idx.Set(ssl, State::COMPLETE);
 		return LookupCertResult::COMPLETE;
 	} catch (...) {
@@ -467,15 +999,47 @@ CertCache::Apply(SSL &ssl, const char *host,
 		return LookupCertResult::ERROR;
 	}
 
-	if (auto item = GetNoWildCardCached(host, special))
-		return ApplyAndSetState(ssl, *item);
+	const std::string_view _special{
+		special != nullptr
+		? std::string_view{special}
+		: std::string_view{}
+	};
 
-	const auto wildcard = MakeCommonNameWildcard(host);
-	if (!wildcard.empty()) {
-		if (auto item = GetNoWildCardCached(wildcard.c_str(), special))
-			return ApplyAndSetState(ssl, *item);
+	ItemPtr item;
+
+	{
+		const RcuReadLock lock{rcu};
+
+		if (const auto *i = snapshot.load()->Find(host, _special)) {
+			auto &_item = **i;
+			_item.Touch(GetEventLoop().SteadyNow());
+
+			if (SSL_CTX *ctx = _item.ssl_ctx.load(std::memory_order_acquire)) {
+				/* fast path: switch to the prebuilt
+				   SSL_CTX while still inside the read
+				   lock */
+				try {
+					SwitchSslCtx(ssl, *ctx);
+					state_idx.Set(ssl, State::COMPLETE);
+					return LookupCertResult::COMPLETE;
+				} catch (...) {
+					logger(1, std::current_exception());
+					state_idx.Set(ssl, State::ERROR);
+					return LookupCertResult::ERROR;
+				}
+			}
+
+			/* the SSL_CTX needs to be built; keep a
+			   reference to the item after leaving the read
+			   lock */
+			item = *i;
+		}
 	}
 
+	if (item)
+		return ApplyAndSetState(ssl, *item);
+
+	const auto wildcard = MakeCommonNameWildcard(host);
 	if (name_cache.Lookup(host) ||
 	    (!wildcard.empty() && name_cache.Lookup(wildcard.c_str()))) {
 		state_idx.Set(ssl, State::IN_PROGRESS);
@@ -490,41 +1054,76 @@ CertCache::Apply(SSL &ssl, const char *host,
 bool
 CertCache::Flush(const std::string &name) noexcept
 {
-	auto r = map.equal_range(name);
+	const auto &current = *snapshot.load();
+
+	auto r = current.names.equal_range(name);
 	if (r.first == r.second)
 		return false;
 
-	std::set<std::string> alt_names;
-
-	for (auto i = r.first; i != r.second;) {
-		const auto &item = i->second;
+	auto new_snapshot = std::make_unique<Snapshot>(current);
 
-		/* if this is a primary item (not a shadow item for an
-		   altName), collect all altNames to be flushed
-		   later */
-		if (name == GetCommonName(*item.cert).c_str())
-			for (auto &a : GetSubjectAltNames(*item.cert))
-				alt_names.emplace(std::move(a));
+	for (auto i = r.first; i != r.second; ++i) {
+		const auto &item = *i->second;
 
-		i = map.erase(i);
+		/* if this is the primary name (not an altName),
+		   flush the whole item with all altNames */
+		if (name == item.names.front()) {
+			CollectUsage(*i->second);
+			ForgetWarmup(item);
+			new_snapshot->Remove(item);
+		}
+		else
+			new_snapshot->Remove(name, item);
 	}
 
-	/* now flush all altNames */
-	for (const auto &i : alt_names)
-		Flush(i);
-
+	Publish(std::move(new_snapshot));
 	return true;
 }
 
 void
 CertCache::OnCertModified(const std::string &name, bool deleted) noexcept
 {
-	const std::scoped_lock lock{mutex};
+	/* don't let a pending warm-up item survive the flush */
+	for (const auto &item : pending_items) {
+		if (std::find(item->names.begin(), item->names.end(),
+			      name) != item->names.end()) {
+			PublishPending();
+			break;
+		}
+	}
+
+	/* remember which certificates were cached, to load the new
+	   version in the background */
+	std::vector<std::string> refresh;
+	if (cache_config.warmup != CertCacheConfig::Warmup::NONE && !deleted)
+		for (auto [i, end] = snapshot.load()->names.equal_range(name);
+		     i != end; ++i)
+			if (name == i->second->names.front())
+				refresh.emplace_back(CertUsage::MakeKey(name,
+									i->second->special));
 
 	if (Flush(name))
 		logger.Format(5, "flushed %s certificate '%s'",
 			      deleted ? "deleted" : "modified",
 			      name.c_str());
+
+	for (auto &key : refresh)
+		QueueWarmup(std::move(key), true);
+
+	if (cache_config.warmup == CertCacheConfig::Warmup::ALL &&
+	    !deleted && refresh.empty())
+		/* a new certificate (or one we haven't loaded yet) */
+		QueueWarmup(std::string{name}, false);
+}
+
+void
+CertCache::OnCertNameLoaded(const std::string &name) noexcept
+{
+	/* the initial fill of the name cache; these certificates
+	   have not been modified, so there is nothing to flush */
+	if (cache_config.warmup == CertCacheConfig::Warmup::ALL &&
+	    !IsCached(name, {}))
+		QueueWarmup(std::string{name}, false);
 }
 
 void
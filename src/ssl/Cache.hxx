@@ -33,25 +33,37 @@
 #pragma once
 
 #include "NameCache.hxx"
+#include "CacheConfig.hxx"
+#include "CertUsage.hxx"
 #include "LookupCertResult.hxx"
 #include "lib/openssl/Hash.hxx"
 #include "lib/openssl/UniqueX509.hxx"
 #include "lib/openssl/UniqueCertKey.hxx"
 #include "lib/openssl/IntegralExDataIndex.hxx"
 #include "certdb/Config.hxx"
+#include "stats/CertCacheStats.hxx"
 #include "pg/AsyncConnection.hxx"
+#include "co/InvokeTask.hxx"
+#include "event/DeferEvent.hxx"
+#include "event/FineTimerEvent.hxx"
 #include "thread/Notify.hxx"
+#include "thread/Rcu.hxx"
 #include "io/Logger.hxx"
 #include "util/Cancellable.hxx"
 #include "util/IntrusiveList.hxx"
 
+#include <atomic>
+#include <deque>
 #include <unordered_map>
+#include <unordered_set>
 #include <map>
+#include <memory>
 #include <forward_list>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <mutex>
 #include <chrono>
-#include <optional>
 
 #include <string.h>
 
@@ -61,12 +73,23 @@ class CertDatabase;
  * A frontend for #CertDatabase which caches results as SSL_CTX
  * instance.  It is thread-safe, designed to be called synchronously
  * by worker threads (via #SslFilter).
+ *
+ * Lookups never lock: the cache contents are an immutable
+ * #Snapshot which is replaced (copy-on-write) by the main thread and
+ * reclaimed using RCU.  The main thread never waits for worker
+ * threads; old versions are freed by a timer after their grace
+ * period.
+ *
+ * Optionally, certificates are loaded in the background before a
+ * client asks for them ("warm-up"); see CertCacheConfig::warmup.
  */
 class CertCache final : Pg::AsyncConnectionHandler, CertNameCacheHandler {
 	const LLogger logger;
 
 	const CertDatabaseConfig config;
 
+	const CertCacheConfig cache_config;
+
 	enum class State {
 		NONE = 0,
 		IN_PROGRESS,
@@ -85,6 +108,13 @@ class CertCache final : Pg::AsyncConnectionHandler, CertNameCacheHandler {
 	 */
 	Notify query_added_notify;
 
+	/**
+	 * Signalled by worker threads when #contexts_size exceeds
+	 * #max_contexts_size; triggers EvictContexts() in the main
+	 * thread.
+	 */
+	Notify evict_notify;
+
 	Pg::AsyncConnection db;
 
 	CertNameCache name_cache;
@@ -97,36 +127,262 @@ class CertCache final : Pg::AsyncConnectionHandler, CertNameCacheHandler {
 		}
 	};
 
+	/**
+	 * This map is only modified during startup (by
+	 * LoadCaCertificate()), therefore it can be read without
+	 * locking.
+	 */
 	std::map<SHA1Digest, std::forward_list<UniqueX509>, SHA1Compare> ca_certs;
 
 	/**
-	 * Protects #map, #queries.
+	 * Protects #queries.
 	 */
 	std::mutex mutex;
 
+	/**
+	 * A certificate/key pair loaded from the database.  It is
+	 * shared by all #Snapshot entries for its common name and
+	 * altNames.  Apart from the atomic fields, it is immutable
+	 * after it has been published.
+	 */
 	struct Item : UniqueCertKey {
+		/**
+		 * The chain from #ca_certs; nullptr if there is none.
+		 */
+		const std::forward_list<UniqueX509> *const chain;
+
 		std::string special;
 
-		std::chrono::steady_clock::time_point expires;
+		/**
+		 * The common name followed by all other altNames.
+		 */
+		std::vector<std::string> names;
+
+		std::atomic<std::chrono::steady_clock::time_point> expires;
+
+		/**
+		 * When was this item last used for a handshake?  Used
+		 * to find the least recently used #ssl_ctx.
+		 */
+		std::atomic<std::chrono::steady_clock::time_point> last_used;
+
+		/**
+		 * The number of times #last_used was updated since
+		 * the last CollectUsage() call, i.e. roughly the
+		 * number of seconds in which this item was used.
+		 */
+		std::atomic_uint n_used{0};
+
+		/**
+		 * Was this item loaded by the warm-up?  If yes, its
+		 * size is accounted in CertCacheStats::warmup_size
+		 * until it is removed from the cache.
+		 */
+		bool warmup = false;
+
+		/**
+		 * A #SSL_CTX prebuilt with this certificate/key pair
+		 * and its chain (owning reference), or nullptr if it
+		 * was not yet built or was evicted.  Worker threads
+		 * may install one at any time; only the main thread
+		 * evicts it (and frees it after an RCU grace
+		 * period).
+		 */
+		std::atomic<SSL_CTX *> ssl_ctx{nullptr};
+
+		/**
+		 * The #CertCache::contexts_size counter which accounts
+		 * for #ssl_ctx.
+		 */
+		std::atomic_size_t &contexts_size;
 
 		Item(UniqueCertKey &&_ck,
-		     std::chrono::steady_clock::time_point now) noexcept
-			:UniqueCertKey(std::move(_ck)),
+		     const std::forward_list<UniqueX509> *_chain,
+		     std::chrono::steady_clock::time_point now,
+		     std::atomic_size_t &_contexts_size) noexcept
+			:UniqueCertKey(std::move(_ck)), chain(_chain),
 			 /* the initial expiration is 6 hours; it will be raised
 			    to 24 hours if the certificate is used again */
-			 expires(now + std::chrono::hours(6)) {}
+			 expires(now + std::chrono::hours(6)),
+			 last_used(now),
+			 contexts_size(_contexts_size) {}
 
-		Item(const Item &src) noexcept
-			:UniqueCertKey(UpRef(src)),
-			 special(src.special),
-			 expires(src.expires) {}
+		~Item() noexcept;
+
+		Item(const Item &) = delete;
+		Item &operator=(const Item &) = delete;
+
+		[[gnu::pure]]
+		std::size_t GetContextSize() const noexcept;
+
+		/**
+		 * Estimate the memory occupied by the certificate and
+		 * the key.
+		 */
+		[[gnu::pure]]
+		std::size_t GetSize() const noexcept;
+
+		/**
+		 * Mark this item as "used".  Only writes to the atomic
+		 * fields if they would change significantly, to avoid
+		 * bouncing cache lines between worker threads.
+		 */
+		void Touch(std::chrono::steady_clock::time_point now) noexcept;
+
+		/**
+		 * Install a newly built #SSL_CTX unless another
+		 * thread was faster.
+		 *
+		 * @return true if it was installed (and #contexts_size
+		 * was increased)
+		 */
+		bool InstallContext(SSL_CTX &ctx) noexcept;
 	};
 
+	using ItemPtr = std::shared_ptr<Item>;
+
 	/**
-	 * Map host names to SSL_CTX instances.  The key may be a
-	 * wildcard.
+	 * An immutable version of the cache contents.  The keys point
+	 * into Item::names.
 	 */
-	std::unordered_multimap<std::string, Item> map;
+	struct Snapshot {
+		/**
+		 * Map host names (including wildcards like
+		 * "*.example.com") to items.
+		 */
+		std::unordered_multimap<std::string_view, ItemPtr> names;
+
+		/**
+		 * Precomputed wildcard resolution: maps the part of a
+		 * wildcard name after the asterisk (e.g.
+		 * ".example.com") to items.
+		 */
+		std::unordered_multimap<std::string_view, ItemPtr> wildcards;
+
+		void Insert(const ItemPtr &item) noexcept;
+
+		/**
+		 * Remove the item with all of its names.
+		 */
+		void Remove(const Item &item) noexcept;
+
+		/**
+		 * Remove one name of an item.
+		 */
+		void Remove(std::string_view name, const Item &item) noexcept;
+
+		[[gnu::pure]]
+		const ItemPtr *FindExact(std::string_view host,
+					 std::string_view special) const noexcept;
+
+		[[gnu::pure]]
+		const ItemPtr *Find(const char *host,
+				    std::string_view special) const noexcept;
+	};
+
+	RcuDomain rcu;
+
+	/**
+	 * The current contents.  Worker threads may only dereference
+	 * it inside a #RcuReadLock; it is replaced only by the main
+	 * thread (see Publish()).
+	 */
+	std::atomic<const Snapshot *> snapshot;
+
+	/**
+	 * Data which was unpublished by the main thread, but may
+	 * still be used by worker threads.
+	 */
+	struct Retired {
+		/**
+		 * The cookie returned by RcuDomain::StartGracePeriod().
+		 */
+		uint64_t grace_period;
+
+		std::unique_ptr<const Snapshot> snapshot;
+
+		/**
+		 * Evicted Item::ssl_ctx instances (owning
+		 * references).
+		 */
+		std::vector<SSL_CTX *> contexts;
+	};
+
+	/**
+	 * Retired data, ordered by Retired::grace_period.
+	 */
+	std::deque<Retired> retired;
+
+	/**
+	 * Frees #retired items after their grace period.
+	 */
+	FineTimerEvent reclaim_timer;
+
+	/**
+	 * Publishes #pending_items.
+	 */
+	DeferEvent publish_event;
+
+	/**
+	 * The (estimated) memory used by all Item::ssl_ctx instances.
+	 */
+	std::atomic_size_t contexts_size{0};
+
+	/**
+	 * Handshake statistics; only used if
+	 * CertCacheConfig::usage_file is set.
+	 */
+	CertUsage usage;
+
+	/**
+	 * When shall CertUsage::Decay() be called next?
+	 */
+	std::chrono::steady_clock::time_point next_usage_decay;
+
+	struct WarmupRequest {
+		/**
+		 * A key built by CertUsage::MakeKey().
+		 */
+		std::string key;
+
+		/**
+		 * Reload a certificate which was flushed from the
+		 * cache because it was modified.  This is not
+		 * subject to CertCacheConfig::max_warmup_size
+		 * because it only replaces a cached certificate.
+		 */
+		bool refresh;
+	};
+
+	/**
+	 * Certificates to be loaded by the warm-up.  They are loaded
+	 * one at a time, only while no client is waiting for a
+	 * database query (see StartQuery()).
+	 */
+	std::deque<WarmupRequest> warmup_queue;
+
+	/**
+	 * The keys of all #warmup_queue items, to avoid queueing a
+	 * certificate more than once.
+	 */
+	std::unordered_set<std::string> warmup_keys;
+
+	/**
+	 * Items which have been loaded (by a client query or by the
+	 * warm-up), but have not yet been published.  They are added
+	 * in batches to avoid copying the #Snapshot for each one.
+	 */
+	std::vector<ItemPtr> pending_items;
+
+	Co::InvokeTask warmup_task;
+
+	/**
+	 * Is a warm-up in progress?  Used to log a message when it
+	 * is finished.
+	 */
+	bool warmup_running = false;
+
+	CertCacheStats stats;
 
 	struct Request;
 	class Query;
@@ -144,7 +400,8 @@ class CertCache final : Pg::AsyncConnectionHandler, CertNameCacheHandler {
 
 public:
 	CertCache(EventLoop &event_loop,
-		  const CertDatabaseConfig &_config) noexcept;
+		  const CertDatabaseConfig &_config,
+		  const CertCacheConfig &_cache_config) noexcept;
 
 	~CertCache() noexcept;
 
@@ -157,8 +414,16 @@ public:
 	void Connect() noexcept;
 	void Disconnect() noexcept;
 
+	/**
+	 * Remove expired items, and update the handshake statistics
+	 * (CertCacheConfig::usage_file).  Should be called
+	 * periodically by the main thread.
+	 */
 	void Expire() noexcept;
 
+	[[gnu::pure]]
+	CertCacheStats GetStats() const noexcept;
+
 	/**
 	 * Look up a certificate by host name, and set it in the given
 	 * #SSL.
@@ -174,32 +439,109 @@ public:
 
 private:
 	/**
-	 * Add the given certificate/key pair to the cache.
+	 * Replace the current #Snapshot and free the old one after
+	 * all readers have left it.  Must be called from the main
+	 * thread.
+	 */
+	void Publish(std::unique_ptr<Snapshot> &&new_snapshot) noexcept;
+
+	/**
+	 * Free the given data after the current RCU grace period.
+	 */
+	void Retire(std::unique_ptr<const Snapshot> &&old_snapshot,
+		    std::vector<SSL_CTX *> &&old_contexts) noexcept;
+
+	/**
+	 * Free all #retired items whose grace period is over.
+	 */
+	void Reclaim() noexcept;
+
+	/**
+	 * Create a new #Item from the given certificate/key pair
+	 * without adding it to the cache.
+	 */
+	ItemPtr MakeItem(UniqueCertKey &&ck, const char *special);
+
+	/**
+	 * Add the given certificate/key pair to the cache.  It is
+	 * published at the end of the current event loop iteration,
+	 * together with other pending items.
 	 *
-	 * This method locks the mutex when necessary.
+	 * Must be called from the main thread.
 	 */
-	UniqueCertKey Add(UniqueCertKey &&ck,
-			  const char *special);
+	ItemPtr Add(UniqueCertKey &&ck, const char *special);
 
+	/**
+	 * Is a certificate with this exact name in the cache (or in
+	 * #pending_items)?
+	 */
 	[[gnu::pure]]
-	std::optional<UniqueCertKey> GetNoWildCardCached(const char *host,
-							 const char *special) noexcept;
+	bool IsCached(std::string_view name,
+		      std::string_view special) const noexcept;
+
+	/**
+	 * An item was removed from the cache; if it was loaded by
+	 * the warm-up, subtract it from CertCacheStats::warmup_size.
+	 */
+	void ForgetWarmup(const Item &item) noexcept;
+
+	/**
+	 * Move the item's handshake counter to #usage.
+	 */
+	void CollectUsage(Item &item) noexcept;
+	void CollectUsage() noexcept;
+
+	void LoadUsage() noexcept;
+	void SaveUsage() noexcept;
+
+	/**
+	 * Add a certificate to #warmup_queue unless it is already
+	 * queued.
+	 */
+	void QueueWarmup(std::string &&key, bool refresh) noexcept;
+
+	/**
+	 * Start loading the next certificate from #warmup_queue.
+	 * Must only be called while no other query runs.
+	 */
+	void StartWarmup() noexcept;
+
+	/**
+	 * Add all #pending_items to the cache.
+	 */
+	void PublishPending() noexcept;
+
+	Co::InvokeTask RunWarmup(std::string key);
+	void OnWarmupCompletion(std::exception_ptr error) noexcept;
 
 	void StartQuery() noexcept;
 
 	void ScheduleQuery(SSL &ssl, const char *host,
 			   const char *special) noexcept;
 
-	void Apply(SSL &ssl, X509 &cert, EVP_PKEY &key);
-	void Apply(SSL &ssl, const UniqueCertKey &cert_key);
+	[[gnu::pure]]
+	const std::forward_list<UniqueX509> *FindChain(X509 &cert) const noexcept;
+
+	/**
+	 * Evict the least recently used Item::ssl_ctx instances until
+	 * #contexts_size is within #max_contexts_size.  Must be called
+	 * from the main thread.
+	 */
+	void EvictContexts() noexcept;
+
+	/**
+	 * Switch the #SSL to the item's #SSL_CTX; build it first if
+	 * necessary.  The caller must hold a reference to the item,
+	 * but must not be inside a #RcuReadLock.
+	 */
+	void Apply(SSL &ssl, Item &item);
 
-	LookupCertResult ApplyAndSetState(SSL &ssl,
-					  const UniqueCertKey &cert_key) noexcept;
+	LookupCertResult ApplyAndSetState(SSL &ssl, Item &item) noexcept;
 
 	/**
 	 * Flush items with the given name.
 	 *
-	 * Caller must lock the mutex.
+	 * Must be called from the main thread.
 	 *
 	 * @return true if at least one item was found and deleted
 	 */
@@ -214,4 +556,5 @@ private:
 	/* virtual methods from class CertNameCacheHandler */
 	void OnCertModified(const std::string &name,
 			    bool deleted) noexcept override;
+	void OnCertNameLoaded(const std::string &name) noexcept override;
 };
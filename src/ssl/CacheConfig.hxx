@@ -0,0 +1,88 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Tuning parameters for #CertCache.
+ */
+struct CertCacheConfig {
+	/**
+	 * The (estimated) memory bound for prebuilt per-certificate
+	 * SSL_CTX instances.
+	 */
+	std::size_t max_contexts_size = 128 * 1024 * 1024;
+
+	enum class Warmup : uint8_t {
+		/**
+		 * Load certificates only when a client asks for them.
+		 */
+		NONE,
+
+		/**
+		 * Load the #warmup_count most frequently used
+		 * certificates (according to #usage_file) in the
+		 * background.
+		 */
+		TOP,
+
+		/**
+		 * Load all certificates in the background, the most
+		 * frequently used ones first.
+		 */
+		ALL,
+	} warmup = Warmup::NONE;
+
+	/**
+	 * The number of certificates loaded by #Warmup::TOP.
+	 */
+	unsigned warmup_count = 1000;
+
+	/**
+	 * The (estimated) memory bound for certificates loaded by the
+	 * warm-up.  Only certificates which are still in the cache
+	 * are counted; expired and flushed ones make room for new
+	 * ones.
+	 */
+	std::size_t max_warmup_size = 64 * 1024 * 1024;
+
+	/**
+	 * A file where handshake statistics are stored, to be able
+	 * to find the most frequently used certificates after a
+	 * restart.  Empty if disabled.
+	 */
+	std::string usage_file;
+};
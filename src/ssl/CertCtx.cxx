@@ -0,0 +1,116 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CertCtx.hxx"
+#include "Basic.hxx"
+#include "lib/openssl/Ctx.hxx"
+#include "lib/openssl/Error.hxx"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+/**
+ * The estimated size of an #SSL_CTX without the certificates and
+ * keys (the #SSL_CTX itself, its #CERT structure, the default
+ * cipher/sigalg lists and the #X509_STORE).
+ */
+static constexpr std::size_t SSL_CTX_OVERHEAD = 16 * 1024;
+
+SslCtx
+MakeCertSslCtx(X509 &cert, EVP_PKEY &key,
+	       const std::forward_list<UniqueX509> *chain)
+{
+	auto ssl_ctx = CreateBasicSslCtx(true);
+
+	ERR_clear_error();
+
+	if (SSL_CTX_use_PrivateKey(ssl_ctx.get(), &key) != 1)
+		throw SslError("SSL_CTX_use_PrivateKey() failed");
+
+	if (SSL_CTX_use_certificate(ssl_ctx.get(), &cert) != 1)
+		throw SslError("SSL_CTX_use_certificate() failed");
+
+	if (chain != nullptr)
+		for (const auto &i : *chain)
+			if (SSL_CTX_add1_chain_cert(ssl_ctx.get(), i.get()) != 1)
+				throw SslError("SSL_CTX_add1_chain_cert() failed");
+
+	return ssl_ctx;
+}
+
+std::size_t
+EstimateCertKeySize(X509 &cert, EVP_PKEY &key) noexcept
+{
+	/* the parsed structures are a few times larger than their
+	   DER encoding */
+	return 4 * (i2d_X509(&cert, nullptr) + i2d_PrivateKey(&key, nullptr));
+}
+
+std::size_t
+EstimateCertSslCtxSize(X509 &cert, EVP_PKEY &key,
+		       const std::forward_list<UniqueX509> *chain) noexcept
+{
+	std::size_t size = SSL_CTX_OVERHEAD + EstimateCertKeySize(cert, key);
+
+	if (chain != nullptr)
+		for (const auto &i : *chain)
+			size += 4 * i2d_X509(i.get(), nullptr);
+
+	return size;
+}
+
+void
+SwitchSslCtx(SSL &ssl, SSL_CTX &ctx)
+{
+	SSL_CTX &old_ctx = *SSL_get_SSL_CTX(&ssl);
+	if (&old_ctx == &ctx)
+		return;
+
+	ERR_clear_error();
+
+	if (SSL_set_SSL_CTX(&ssl, &ctx) == nullptr)
+		throw SslError("SSL_set_SSL_CTX() failed");
+
+	/* the verify mode was copied to the SSL object by SSL_new(),
+	   but the trust store and the list of acceptable client CAs
+	   are looked up in the (new) SSL_CTX; copy them from the
+	   listener's SSL_CTX */
+	if (SSL_get_verify_mode(&ssl) != SSL_VERIFY_NONE) {
+		if (SSL_set1_verify_cert_store(&ssl,
+					       SSL_CTX_get_cert_store(&old_ctx)) != 1)
+			throw SslError("SSL_set1_verify_cert_store() failed");
+
+		if (auto *list = SSL_CTX_get_client_CA_list(&old_ctx);
+		    list != nullptr)
+			SSL_set_client_CA_list(&ssl, SSL_dup_CA_list(list));
+	}
+}
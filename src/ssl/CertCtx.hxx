@@ -0,0 +1,87 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Prebuilt per-certificate SSL_CTX instances.
+ */
+
+#pragma once
+
+#include "lib/openssl/UniqueX509.hxx"
+
+#include <openssl/ossl_typ.h>
+
+#include <cstddef>
+#include <forward_list>
+
+class SslCtx;
+
+/**
+ * Create a new server #SSL_CTX with the given certificate, key and
+ * (optional) chain preinstalled.  The key/certificate consistency
+ * check and the chain setup are done only once here; later, each
+ * handshake only needs to switch to this context with
+ * SwitchSslCtx().
+ *
+ * Throws on error.
+ */
+SslCtx
+MakeCertSslCtx(X509 &cert, EVP_PKEY &key,
+	       const std::forward_list<UniqueX509> *chain);
+
+/**
+ * Estimate how much memory an #SSL_CTX created by MakeCertSslCtx()
+ * occupies.  This is only a rough guess (OpenSSL doesn't tell), but
+ * good enough to put a bound on a cache of such contexts.
+ */
+[[gnu::pure]]
+std::size_t
+EstimateCertSslCtxSize(X509 &cert, EVP_PKEY &key,
+		       const std::forward_list<UniqueX509> *chain) noexcept;
+
+/**
+ * Estimate how much memory the parsed certificate and key occupy.
+ */
+[[gnu::pure]]
+std::size_t
+EstimateCertKeySize(X509 &cert, EVP_PKEY &key) noexcept;
+
+/**
+ * Switch the given #SSL (in the middle of a server handshake, i.e.
+ * from the certificate callback) to a context created by
+ * MakeCertSslCtx().  Client certificate verification settings of
+ * the listener's #SSL_CTX are carried over.
+ *
+ * Throws on error.
+ */
+void
+SwitchSslCtx(SSL &ssl, SSL_CTX &ctx);
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CertUsage.hxx"
+#include "io/BufferedOutputStream.hxx"
+#include "io/BufferedReader.hxx"
+#include "io/FdOutputStream.hxx"
+#include "io/FdReader.hxx"
+#include "io/FileWriter.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <charconv>
+
+#include <errno.h>
+#include <inttypes.h>
+
+std::string
+CertUsage::MakeKey(std::string_view name, std::string_view special) noexcept
+{
+	std::string key{name};
+	if (!special.empty()) {
+		key.push_back(' ');
+		key.append(special);
+	}
+
+	return key;
+}
+
+std::pair<std::string_view, std::string_view>
+CertUsage::SplitKey(std::string_view key) noexcept
+{
+	const auto space = key.find(' ');
+	if (space == key.npos)
+		return {key, {}};
+
+	return {key.substr(0, space), key.substr(space + 1)};
+}
+
+void
+CertUsage::Add(std::string_view key, uint_least64_t n) noexcept
+{
+	if (auto i = map.find(key); i != map.end())
+		i->second += n;
+	else
+		map.emplace(key, n);
+}
+
+void
+CertUsage::Decay() noexcept
+{
+	for (auto i = map.begin(); i != map.end();) {
+		i->second /= 2;
+		if (i->second == 0)
+			i = map.erase(i);
+		else
+			++i;
+	}
+}
+
+std::vector<std::string>
+CertUsage::GetTop(std::size_t n) const noexcept
+{
+	std::vector<const Map::value_type *> items;
+	items.reserve(map.size());
+	for (const auto &i : map)
+		items.push_back(&i);
+
+	n = std::min(n, items.size());
+
+	std::partial_sort(items.begin(), std::next(items.begin(), n),
+			  items.end(),
+			  [](const Map::value_type *a, const Map::value_type *b){
+				  return a->second > b->second;
+			  });
+
+	std::vector<std::string> result;
+	result.reserve(n);
+	for (std::size_t i = 0; i < n; ++i)
+		result.push_back(items[i]->first);
+
+	return result;
+}
+
+void
+CertUsage::ParseLine(std::string_view line) noexcept
+{
+	uint_least64_t n;
+	const auto [end, ec] = std::from_chars(line.data(),
+					       line.data() + line.size(), n);
+	if (ec != std::errc{} || n == 0)
+		return;
+
+	line.remove_prefix(end - line.data());
+	if (!line.starts_with(' '))
+		return;
+
+	line.remove_prefix(1);
+
+	const auto [name, special] = SplitKey(line);
+	if (name.empty() || special.find(' ') != special.npos)
+		return;
+
+	Add(line, n);
+}
+
+void
+CertUsage::Load(const char *path)
+{
+	UniqueFileDescriptor fd;
+	if (!fd.OpenReadOnly(path)) {
+		if (errno == ENOENT)
+			return;
+
+		throw FormatErrno("Failed to open %s", path);
+	}
+
+	FdReader fr(fd);
+	BufferedReader br(fr);
+
+	while (const char *line = br.ReadLine())
+		ParseLine(line);
+}
+
+void
+CertUsage::Save(const char *path) const
+{
+	FileWriter fw(path);
+	FdOutputStream fos(fw.GetFileDescriptor());
+
+	{
+		BufferedOutputStream bos(fos);
+		for (const auto &[key, n] : map)
+			bos.Format("%" PRIuLEAST64 " %s\n", n, key.c_str());
+		bos.Flush();
+	}
+
+	fw.Commit();
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Counts how often each certificate was used for handshakes, to be
+ * able to find the most frequently used ones after a restart (see
+ * CertCacheConfig::Warmup::TOP).
+ *
+ * Keys are built by MakeKey().  This class is not thread-safe.
+ */
+class CertUsage {
+	using Map = std::map<std::string, uint_least64_t, std::less<>>;
+	Map map;
+
+public:
+	/**
+	 * Build a key from the certificate's common name and its
+	 * "special" value.
+	 */
+	static std::string MakeKey(std::string_view name,
+				   std::string_view special) noexcept;
+
+	/**
+	 * Split a key built by MakeKey().
+	 *
+	 * @return the name and the "special" value (empty if there is
+	 * none)
+	 */
+	[[gnu::pure]]
+	static std::pair<std::string_view, std::string_view> SplitKey(std::string_view key) noexcept;
+
+	bool empty() const noexcept {
+		return map.empty();
+	}
+
+	std::size_t size() const noexcept {
+		return map.size();
+	}
+
+	void Add(std::string_view key, uint_least64_t n) noexcept;
+
+	/**
+	 * Halve all counters and remove those which have dropped to
+	 * zero.  Call this periodically to let old usage fade away.
+	 */
+	void Decay() noexcept;
+
+	/**
+	 * Return up to the given number of keys, most frequently
+	 * used first.
+	 */
+	std::vector<std::string> GetTop(std::size_t n) const noexcept;
+
+	/**
+	 * Parse one line of a file written by Save() and add it.
+	 * Malformed lines are ignored.
+	 */
+	void ParseLine(std::string_view line) noexcept;
+
+	/**
+	 * Load a file written by Save() and add its contents.  A
+	 * missing file is not an error.
+	 *
+	 * Throws on error.
+	 */
+	void Load(const char *path);
+
+	/**
+	 * Atomically replace the given file with the current
+	 * counters.
+	 *
+	 * Throws on error.
+	 */
+	void Save(const char *path) const;
+};
@@ -209,31 +209,45 @@ CertNameCache::OnResult(Pg::Result &&result)
 		modified = row.GetValue(2);
 		const bool deleted = complete && *row.GetValue(3) == 't';
 
-		handler.OnCertModified(name, deleted);
-		if (!alt_name.empty())
-			handler.OnCertModified(alt_name, deleted);
-
-		const std::scoped_lock lock{mutex};
-
-		if (deleted) {
+		if (complete) {
+			handler.OnCertModified(name, deleted);
 			if (!alt_name.empty())
-				RemoveAltName(name, std::move(alt_name));
+				handler.OnCertModified(alt_name, deleted);
+		}
 
-			auto i = names.find(std::move(name));
-			if (i != names.end()) {
-				names.erase(i);
-				++n_deleted;
+		bool loaded = false;
+
+		{
+			const std::scoped_lock lock{mutex};
+
+			if (deleted) {
+				if (!alt_name.empty())
+					RemoveAltName(name, std::move(alt_name));
+
+				auto i = names.find(name);
+				if (i != names.end()) {
+					names.erase(i);
+					++n_deleted;
+				}
+			} else {
+				if (!alt_name.empty())
+					AddAltName(name, std::move(alt_name));
+
+				auto i = names.emplace(name);
+				if (i.second)
+					++n_added;
+				else
+					++n_updated;
+
+				/* there is one row per alt_name;
+				   announce each common_name only
+				   once */
+				loaded = !complete && i.second;
 			}
-		} else {
-			if (!alt_name.empty())
-				AddAltName(name, std::move(alt_name));
-
-			auto i = names.emplace(std::move(name));
-			if (i.second)
-				++n_added;
-			else
-				++n_updated;
 		}
+
+		if (loaded)
+			handler.OnCertNameLoaded(name);
 	}
 
 	if (modified != nullptr)
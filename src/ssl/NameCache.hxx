@@ -46,8 +46,20 @@ struct CertDatabaseConfig;
 
 class CertNameCacheHandler {
 public:
+	/**
+	 * A certificate was modified or deleted after the name cache
+	 * had become complete.  This is not called during the initial
+	 * fill.
+	 */
 	virtual void OnCertModified(const std::string &name,
 				    bool deleted) noexcept = 0;
+
+	/**
+	 * A common_name was found while the name cache is being
+	 * filled for the first time.  Called once per common_name
+	 * (not for alt_names).
+	 */
+	virtual void OnCertNameLoaded([[maybe_unused]] const std::string &name) noexcept {}
 };
 
 /**
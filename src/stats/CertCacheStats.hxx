@@ -0,0 +1,85 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Statistics of a #CertCache.
+ */
+struct CertCacheStats {
+	/**
+	 * The number of certificates currently in the cache.
+	 */
+	std::size_t n_certificates = 0;
+
+	/**
+	 * The (estimated) memory used by prebuilt SSL_CTX instances.
+	 */
+	std::size_t contexts_size = 0;
+
+	/**
+	 * The number of certificates waiting to be loaded by the
+	 * warm-up.
+	 */
+	std::size_t warmup_queued = 0;
+
+	/**
+	 * The number of certificates loaded by the warm-up.
+	 */
+	uint64_t warmup_loaded = 0;
+
+	/**
+	 * The number of warm-up queries which did not find a
+	 * certificate.
+	 */
+	uint64_t warmup_not_found = 0;
+
+	/**
+	 * The number of failed warm-up queries.
+	 */
+	uint64_t warmup_errors = 0;
+
+	/**
+	 * The number of certificates not loaded by the warm-up
+	 * because its memory bound was reached.
+	 */
+	uint64_t warmup_skipped = 0;
+
+	/**
+	 * The (estimated) memory used by certificates loaded by the
+	 * warm-up which are still in the cache.
+	 */
+	std::size_t warmup_size = 0;
+};
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Statistics about the (incremental) compression of a memory
+ * allocator.
+ */
+struct CompressStats {
+	/**
+	 * The number of slices, i.e. event loop callbacks which
+	 * performed compression work.
+	 */
+	uint64_t n_slices = 0;
+
+	/**
+	 * The total time spent compressing.
+	 */
+	std::chrono::steady_clock::duration total_duration{};
+
+	/**
+	 * The longest duration of a single slice, i.e. the longest
+	 * event loop pause caused by compression.
+	 */
+	std::chrono::steady_clock::duration max_duration{};
+
+	void AddSlice(std::chrono::steady_clock::duration duration) noexcept {
+		++n_slices;
+		total_duration += duration;
+		if (duration > max_duration)
+			max_duration = duration;
+	}
+
+	CompressStats &operator+=(const CompressStats &other) noexcept {
+		n_slices += other.n_slices;
+		total_duration += other.total_duration;
+		if (other.max_duration > max_duration)
+			max_duration = other.max_duration;
+		return *this;
+	}
+};
@@ -0,0 +1,349 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A Prometheus exporter which reads the statistics segments written
+ * by beng-proxy and beng-lb (see "set stats_file") and serves them
+ * via HTTP.  It does not communicate with these processes at all, so
+ * it keeps responding while they are overloaded.
+ *
+ * The listener socket is passed on stdin (systemd socket activation
+ * with "StandardInput=socket").
+ */
+
+#include "stats/Segment.hxx"
+#include "prometheus/Stats.hxx"
+#include "prometheus/HttpStats.hxx"
+#include "prometheus/StockStats.hxx"
+#include "prometheus/ThreadQueueStats.hxx"
+#include "memory/GrowingBuffer.hxx"
+#include "memory/fb_pool.hxx"
+#include "io/Open.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/PrintException.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+#include <inttypes.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * How often shall we try to obtain a consistent copy while the
+ * writer is busy?
+ */
+static constexpr unsigned MAX_READ_ATTEMPTS = 1000;
+
+/**
+ * The maximum duration of one connection (receiving the request and
+ * sending the response).  Connections are handled one after another,
+ * so this limits how long a stalled client can block all others.
+ */
+static constexpr std::chrono::steady_clock::duration CONNECTION_TIMEOUT =
+	std::chrono::seconds{10};
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+static void
+ReadSegment(const char *path, StatsSegment::Data &dest)
+{
+	const auto fd = OpenReadOnly(path);
+
+	struct stat st;
+	if (fstat(fd.Get(), &st) < 0)
+		throw MakeErrno("Failed to stat");
+
+	const std::size_t size = st.st_size;
+	if (size < sizeof(StatsSegment::Header))
+		throw std::runtime_error("File is too small");
+
+	const void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+			     fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map");
+
+	const auto &header = *(const StatsSegment::Header *)p;
+	const bool valid = header.IsValid(size);
+
+	bool success = false;
+	if (valid) {
+		for (unsigned i = 0; i < MAX_READ_ATTEMPTS; ++i) {
+			if (StatsSegment::Read(header, dest)) {
+				success = true;
+				break;
+			}
+
+			/* the writer is busy; let it finish */
+			sched_yield();
+		}
+	}
+
+	munmap(const_cast<void *>(p), size);
+
+	if (!valid)
+		throw std::runtime_error("Not a valid statistics segment");
+
+	if (!success)
+		throw std::runtime_error("Statistics segment is busy");
+
+	/* don't trust the strings in the shared file */
+	dest.process[sizeof(dest.process) - 1] = 0;
+	dest.n_http = std::min<uint32_t>(dest.n_http,
+					 StatsSegment::MAX_HTTP);
+	for (uint32_t i = 0; i < dest.n_http; ++i) {
+		auto &h = dest.http[i];
+		h.listener[sizeof(h.listener) - 1] = 0;
+		h.tag[sizeof(h.tag) - 1] = 0;
+	}
+}
+
+static void
+WriteSegment(GrowingBuffer &buffer,
+	     const StatsSegment::Data &data) noexcept
+{
+	const char *process = data.process;
+
+	Prometheus::Write(buffer, process, data.control);
+	Prometheus::Write(buffer, process, data.tcp_stock);
+	Prometheus::Write(buffer, process, data.thread_queue);
+
+	for (uint32_t i = 0; i < data.n_http; ++i) {
+		const auto &h = data.http[i];
+		if (h.tagged)
+			Prometheus::Write(buffer, process, h.listener, h.tag,
+					  h.stats);
+		else
+			Prometheus::Write(buffer, process, h.listener,
+					  h.stats);
+	}
+
+	buffer.Format(R"(
+# HELP beng_proxy_stats_update_time Time of the last statistics update in seconds since the epoch
+# TYPE beng_proxy_stats_update_time gauge
+
+# HELP beng_proxy_stats_http_dropped Number of HTTP statistics entries which did not fit into the segment
+# TYPE beng_proxy_stats_http_dropped gauge
+
+)"
+		      "beng_proxy_stats_update_time{process=\"%s\"} %" PRId64 "\n"
+		      "beng_proxy_stats_http_dropped{process=\"%s\"} %" PRIu32 "\n",
+		      process, data.update_time,
+		      process, data.n_http_dropped);
+}
+
+/**
+ * Wait until the socket is ready for the given poll() events.
+ *
+ * @return false if the deadline has expired or on error
+ */
+static bool
+WaitSocket(int fd, short events, Deadline deadline) noexcept
+{
+	while (true) {
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			return false;
+
+		const auto timeout =
+			std::chrono::ceil<std::chrono::milliseconds>(deadline - now);
+
+		struct pollfd pfd{fd, events, 0};
+		int result = poll(&pfd, 1, timeout.count());
+		if (result > 0)
+			return true;
+
+		if (result < 0 && errno != EINTR)
+			return false;
+	}
+}
+
+/**
+ * Receive data from the socket, waiting no longer than the given
+ * deadline.
+ *
+ * @return the number of bytes received, 0 on end-of-file, -1 on
+ * error or timeout
+ */
+static ssize_t
+Receive(int fd, std::span<char> dest, Deadline deadline) noexcept
+{
+	while (true) {
+		ssize_t nbytes = recv(fd, dest.data(), dest.size(),
+				      MSG_DONTWAIT);
+		if (nbytes >= 0)
+			return nbytes;
+
+		if (errno == EAGAIN) {
+			if (!WaitSocket(fd, POLLIN, deadline))
+				return -1;
+		} else if (errno != EINTR)
+			return -1;
+	}
+}
+
+static bool
+SendAll(int fd, std::span<const std::byte> src, Deadline deadline) noexcept
+{
+	while (!src.empty()) {
+		ssize_t nbytes = send(fd, src.data(), src.size(),
+				      MSG_NOSIGNAL|MSG_DONTWAIT);
+		if (nbytes > 0) {
+			src = src.subspan(nbytes);
+		} else if (nbytes < 0 && errno == EAGAIN) {
+			if (!WaitSocket(fd, POLLOUT, deadline))
+				return false;
+		} else if (nbytes == 0 || errno != EINTR)
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+SendAll(int fd, std::string_view src, Deadline deadline) noexcept
+{
+	return SendAll(fd, std::as_bytes(std::span{src}), deadline);
+}
+
+static void
+HandleConnection(int fd, std::span<const char *const> paths)
+{
+	/* a per-connection deadline (and not just a per-call
+	   timeout) so a client which trickles its request or drains
+	   the response slowly can't block all others */
+	const Deadline deadline =
+		std::chrono::steady_clock::now() + CONNECTION_TIMEOUT;
+
+	/* receive the request header; the URI and all header fields
+	   are ignored */
+
+	char request[4096];
+	std::size_t fill = 0;
+	while (std::string_view{request, fill}.find("\r\n\r\n") == std::string_view::npos) {
+		if (fill == sizeof(request))
+			return;
+
+		ssize_t nbytes = Receive(fd, std::span{request}.subspan(fill),
+					 deadline);
+		if (nbytes <= 0)
+			return;
+
+		fill += nbytes;
+	}
+
+	const std::string_view r{request, fill};
+	const bool head = r.starts_with("HEAD ");
+	if (!head && !r.starts_with("GET ")) {
+		SendAll(fd, "HTTP/1.1 405 Method Not Allowed\r\n"
+			"allow: GET, HEAD\r\n"
+			"content-length: 0\r\n"
+			"connection: close\r\n"
+			"\r\n", deadline);
+		return;
+	}
+
+	/* this is large; don't put it on the stack */
+	static StatsSegment::Data data;
+
+	GrowingBuffer buffer;
+	for (const char *path : paths) {
+		try {
+			ReadSegment(path, data);
+			WriteSegment(buffer, data);
+		} catch (const std::exception &e) {
+			fprintf(stderr, "Failed to read %s: %s\n",
+				path, e.what());
+		}
+	}
+
+	char response_header[256];
+	const int length = snprintf(response_header, sizeof(response_header),
+				    "HTTP/1.1 200 OK\r\n"
+				    "content-type: text/plain;version=0.0.4\r\n"
+				    "content-length: %zu\r\n"
+				    "connection: close\r\n"
+				    "\r\n",
+				    std::size_t(buffer.GetSize()));
+	if (!SendAll(fd, {response_header, std::size_t(length)}, deadline) ||
+	    head)
+		return;
+
+	while (true) {
+		const auto src = buffer.Read();
+		if (src.empty() || !SendAll(fd, src, deadline))
+			break;
+
+		buffer.Consume(src.size());
+	}
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: cm4all-beng-proxy-stats-exporter PATH ...\n");
+		return EXIT_FAILURE;
+	}
+
+	const std::span<const char *const> paths{argv + 1, std::size_t(argc - 1)};
+
+	const ScopeFbPoolInit fb_pool_init;
+
+	while (true) {
+		int fd = accept4(STDIN_FILENO, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			throw MakeErrno("accept() failed");
+		}
+
+		HandleConnection(fd, paths);
+		close(fd);
+	}
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * A histogram of durations with fixed bucket bounds from 1 ms to
+ * 5 s, suitable for Prometheus.
+ */
+struct LatencyHistogram {
+	using Duration = std::chrono::steady_clock::duration;
+
+	/**
+	 * The upper bounds of all buckets except for the last one,
+	 * which is unbounded.
+	 */
+	static constexpr std::array<std::chrono::milliseconds, 12> BOUNDS{
+		std::chrono::milliseconds{1},
+		std::chrono::milliseconds{2},
+		std::chrono::milliseconds{5},
+		std::chrono::milliseconds{10},
+		std::chrono::milliseconds{20},
+		std::chrono::milliseconds{50},
+		std::chrono::milliseconds{100},
+		std::chrono::milliseconds{200},
+		std::chrono::milliseconds{500},
+		std::chrono::milliseconds{1000},
+		std::chrono::milliseconds{2000},
+		std::chrono::milliseconds{5000},
+	};
+
+	static constexpr std::size_t N_BUCKETS = BOUNDS.size() + 1;
+
+	/**
+	 * The number of samples in each bucket (not cumulative).
+	 */
+	std::array<uint64_t, N_BUCKETS> buckets{};
+
+	/**
+	 * The sum of all samples.
+	 */
+	Duration sum{};
+
+	void Add(Duration d) noexcept {
+		std::size_t i = 0;
+		while (i < BOUNDS.size() && d > BOUNDS[i])
+			++i;
+
+		++buckets[i];
+		sum += d;
+	}
+};
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The binary format of the statistics segment.  beng-proxy and
+ * beng-lb periodically copy their statistics into a shared memory
+ * file, and a reader (cm4all-beng-proxy-stats-exporter) can obtain a
+ * consistent snapshot from it without involving the busy event loop.
+ */
+
+#pragma once
+
+#include "HttpStats.hxx"
+#include "ThreadQueueStats.hxx"
+#include "stock/Stats.hxx"
+#include "beng-proxy/Control.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace StatsSegment {
+
+static constexpr uint32_t MAGIC = 0x62707374; // "bpst"
+static constexpr uint32_t VERSION = 1;
+
+static constexpr std::size_t MAX_HTTP = 256;
+static constexpr std::size_t MAX_NAME = 64;
+
+struct Http {
+	/**
+	 * The listener name (null-terminated, possibly truncated).
+	 */
+	char listener[MAX_NAME];
+
+	/**
+	 * The listener tag (null-terminated, possibly truncated).
+	 */
+	char tag[MAX_NAME];
+
+	/**
+	 * Does this entry have a tag (which may be empty)?  If not,
+	 * the "tag" label is omitted.
+	 */
+	bool tagged;
+
+	HttpStats stats;
+};
+
+/**
+ * The statistics of one process.  Readers copy it with a plain
+ * assignment, therefore everything in here must be trivially
+ * copyable.
+ */
+struct Data {
+	/**
+	 * The value of the "process" label (null-terminated),
+	 * e.g. "lb" or "bp".
+	 */
+	char process[16];
+
+	/**
+	 * The time of the last update (CLOCK_REALTIME) [seconds].
+	 */
+	int64_t update_time;
+
+	BengProxy::ControlStats control;
+
+	StockStats tcp_stock;
+
+	ThreadQueueStats thread_queue;
+
+	uint32_t n_http;
+
+	/**
+	 * The number of #Http entries which did not fit into #http.
+	 */
+	uint32_t n_http_dropped;
+
+	Http http[MAX_HTTP];
+
+	void AddHttp(std::string_view listener, const char *tag,
+		     const HttpStats &stats) noexcept {
+		if (n_http >= MAX_HTTP) {
+			++n_http_dropped;
+			return;
+		}
+
+		auto &h = http[n_http++];
+		CopyName(h.listener, listener);
+		h.tagged = tag != nullptr;
+		CopyName(h.tag, tag != nullptr ? tag : std::string_view{});
+		h.stats = stats;
+	}
+
+private:
+	static void CopyName(char (&dest)[MAX_NAME],
+			     std::string_view src) noexcept {
+		src = src.substr(0, MAX_NAME - 1);
+		*std::copy(src.begin(), src.end(), dest) = 0;
+	}
+};
+
+static_assert(std::is_trivially_copyable_v<Data>);
+
+struct Header {
+	uint32_t magic, version;
+
+	uint32_t data_size;
+
+	/**
+	 * This is a seqlock with only one writer: the value is odd
+	 * while #data is being modified.
+	 */
+	uint32_t sequence;
+
+	Data data;
+
+	bool IsValid(std::size_t size) const noexcept {
+		return magic == MAGIC && version == VERSION &&
+			data_size == sizeof(Data) &&
+			size >= sizeof(Header);
+	}
+
+	uint32_t LoadSequence(std::memory_order order) const noexcept {
+		return std::atomic_ref{const_cast<uint32_t &>(sequence)}
+			.load(order);
+	}
+};
+
+/**
+ * Copy the data from the (concurrently written) segment.
+ *
+ * @return true if the data was copied successfully, false if it is
+ * being written right now
+ */
+inline bool
+Read(const Header &header, Data &dest) noexcept
+{
+	const uint32_t before = header.LoadSequence(std::memory_order_acquire);
+	if (before & 1)
+		return false;
+
+	dest = header.data;
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return header.LoadSequence(std::memory_order_relaxed) == before;
+}
+
+} // namespace StatsSegment
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SegmentWriter.hxx"
+#include "Segment.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+StatsSegmentWriter::StatsSegmentWriter(const char *path, const char *process)
+{
+	UniqueFileDescriptor fd;
+	if (!fd.Open(path, O_CREAT|O_RDWR|O_NOFOLLOW|O_CLOEXEC, 0644))
+		throw FormatErrno("Failed to create %s", path);
+
+	static constexpr std::size_t size = sizeof(StatsSegment::Header);
+	if (ftruncate(fd.Get(), size) < 0)
+		throw FormatErrno("Failed to resize %s", path);
+
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		       fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path);
+
+	header = static_cast<StatsSegment::Header *>(p);
+
+	/* the file may still contain data from a previous run which
+	   a reader may be copying right now; make the sequence odd
+	   so it retries */
+	const uint32_t sequence =
+		header->LoadSequence(std::memory_order_relaxed) | 1;
+	std::atomic_ref{header->sequence}.store(sequence,
+						std::memory_order_relaxed);
+	std::atomic_ref{header->magic}.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	header->version = StatsSegment::VERSION;
+	header->data_size = sizeof(StatsSegment::Data);
+	new(&header->data) StatsSegment::Data{};
+
+	const std::string_view process_sv{process};
+	*std::copy_n(process_sv.begin(),
+		     std::min(process_sv.size(),
+			      sizeof(header->data.process) - 1),
+		     header->data.process) = 0;
+
+	std::atomic_ref{header->sequence}.store(sequence + 1,
+						std::memory_order_release);
+
+	/* the magic is written last to mark the header as valid */
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = StatsSegment::MAGIC;
+}
+
+StatsSegmentWriter::~StatsSegmentWriter() noexcept
+{
+	munmap(header, sizeof(*header));
+}
+
+StatsSegment::Data &
+StatsSegmentWriter::BeginUpdate() noexcept
+{
+	/* this is a seqlock with only one writer: make the sequence
+	   odd, modify the data, then make it even again */
+
+	std::atomic_ref{header->sequence}.store(header->sequence + 1,
+						std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	auto &data = header->data;
+	data.update_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	data.n_http = data.n_http_dropped = 0;
+	return data;
+}
+
+void
+StatsSegmentWriter::EndUpdate() noexcept
+{
+	std::atomic_ref{header->sequence}.store(header->sequence + 1,
+						std::memory_order_release);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+namespace StatsSegment { struct Header; struct Data; }
+
+/**
+ * Publishes the statistics of this process in a shared memory file
+ * (see Segment.hxx).
+ */
+class StatsSegmentWriter {
+	StatsSegment::Header *header;
+
+public:
+	/**
+	 * Create the file (or reuse an existing one) and map it into
+	 * memory.
+	 *
+	 * Throws on error.
+	 *
+	 * @param process the value of the "process" label
+	 */
+	StatsSegmentWriter(const char *path, const char *process);
+
+	~StatsSegmentWriter() noexcept;
+
+	StatsSegmentWriter(const StatsSegmentWriter &) = delete;
+	StatsSegmentWriter &operator=(const StatsSegmentWriter &) = delete;
+
+	/**
+	 * Begin an update; until EndUpdate() is called, readers will
+	 * retry.  The caller shall fill in all attributes of the
+	 * returned object; all #StatsSegment::Http entries have been
+	 * removed already.
+	 */
+	StatsSegment::Data &BeginUpdate() noexcept;
+
+	void EndUpdate() noexcept;
+};
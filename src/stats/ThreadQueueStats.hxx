@@ -0,0 +1,76 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Statistics of a #ThreadQueue.
+ */
+struct ThreadQueueStats {
+	/**
+	 * The number of jobs currently waiting for a worker thread.
+	 */
+	std::size_t n_waiting = 0;
+
+	/**
+	 * The number of jobs which were handed to worker threads.
+	 */
+	uint64_t n_jobs = 0;
+
+	/**
+	 * The number of batches in which #n_jobs were run, i.e. how
+	 * often a worker thread started running jobs after having
+	 * been idle.  #n_jobs divided by this is the average batch
+	 * size.
+	 */
+	uint64_t n_batches = 0;
+
+	/**
+	 * The number of times the main thread was woken up to
+	 * handle finished jobs.
+	 */
+	uint64_t n_wakeups = 0;
+
+	/**
+	 * The number of finished jobs handled by the main thread.
+	 */
+	uint64_t n_completions = 0;
+
+	/**
+	 * The total time jobs were waiting for a worker thread.
+	 */
+	std::chrono::steady_clock::duration wait_time{};
+};
@@ -31,212 +31,308 @@
  */
 
 #include "stopwatch.hxx"
+#include "StopwatchRing.hxx"
 #include "io/UniqueFileDescriptor.hxx"
-#include "util/LeakDetector.hxx"
-#include "util/StringBuilder.hxx"
-
-#include <boost/container/static_vector.hpp>
+#include "system/Error.hxx"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <list>
-#include <string>
+#include <new>
+#include <stdexcept>
 
 #include <assert.h>
-#include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#if 0
-#include <sys/resource.h>
-#endif
+/**
+ * The shared memory ring buffer all finished spans are written to.
+ * This is nullptr if the stopwatch is disabled.
+ */
+static StopwatchRing::Header *stopwatch_ring;
+static size_t stopwatch_ring_size;
 
-static UniqueFileDescriptor stopwatch_fd;
+/**
+ * Only one of this many root spans is recorded.
+ */
+static unsigned stopwatch_sample_rate = 1;
+static unsigned stopwatch_sample_counter;
 
-struct StopwatchEvent {
-	std::string name;
+static uint64_t stopwatch_trace_counter;
+static uint32_t stopwatch_span_counter;
 
-	std::chrono::steady_clock::time_point time =
-		std::chrono::steady_clock::now();
+class Stopwatch final {
+	friend class StopwatchPtr;
 
-	template<typename N>
-	explicit StopwatchEvent(N &&_name) noexcept
-		:name(std::forward<N>(_name)) {}
-};
+	/**
+	 * Link for the free list.
+	 */
+	Stopwatch *next_free;
 
-class Stopwatch final : LeakDetector
-{
-	const std::string name;
+	unsigned ref;
+
+	uint64_t trace_id;
+	uint32_t span_id, parent_id;
+
+	std::chrono::steady_clock::time_point time;
 
-	const std::chrono::steady_clock::time_point time =
-		std::chrono::steady_clock::now();
+	unsigned n_events;
 
-	std::list<std::shared_ptr<Stopwatch>> children;
+	char name[StopwatchRing::MAX_NAME];
 
-	boost::container::static_vector<StopwatchEvent, 16> events;
+	StopwatchRing::Event events[StopwatchRing::MAX_EVENTS];
 
-#if 0
 	/**
-	 * Our own resource usage, measured when the stopwatch was
-	 * started.
+	 * Recycled #Stopwatch objects; this avoids a heap allocation
+	 * for each span.
 	 */
-	struct rusage self;
-#endif
+	static Stopwatch *free_list;
+	static unsigned n_free;
+	static constexpr unsigned MAX_FREE = 1024;
 
-	const bool dump;
+	Stopwatch() noexcept = default;
+	~Stopwatch() noexcept = default;
 
 public:
-	template<typename N>
-	Stopwatch(N &&_name, bool _dump) noexcept
-		:name(std::forward<N>(_name)),
-		 dump(_dump)
-	{
-#if 0
-		getrusage(RUSAGE_SELF, &self);
-#endif
-	}
+	static Stopwatch *New(uint64_t _trace_id, uint32_t _parent_id,
+			      const char *_name, const char *suffix) noexcept;
 
-	~Stopwatch() noexcept {
-		if (dump)
-			Dump(time, 0);
+	void Ref() noexcept {
+		++ref;
 	}
 
-	template<typename C>
-	void AddChild(C &&child) noexcept {
-		children.emplace_back(std::forward<C>(child));
+	void Unref() noexcept {
+		assert(ref > 0);
+
+		if (--ref == 0) {
+			Commit();
+			Free();
+		}
 	}
 
 	void RecordEvent(const char *name) noexcept;
 
-	void Dump(std::chrono::steady_clock::time_point root_time,
-		  size_t indent) noexcept;
-};
+private:
+	void Free() noexcept;
 
-void
-stopwatch_enable(UniqueFileDescriptor fd) noexcept
-{
-	assert(fd.IsDefined());
+	/**
+	 * Write this span to the ring buffer.
+	 */
+	void Commit() const noexcept;
+};
 
-	stopwatch_fd = std::move(fd);
-}
+Stopwatch *Stopwatch::free_list;
+unsigned Stopwatch::n_free;
 
-bool
-stopwatch_is_enabled() noexcept
+static void
+CopyTruncated(char *dest, size_t dest_size,
+	      const char *src, size_t src_length) noexcept
 {
-	return stopwatch_fd.IsDefined();
+	src_length = std::min(src_length, dest_size - 1);
+	memcpy(dest, src, src_length);
+	dest[src_length] = 0;
 }
 
-static std::string
-MakeStopwatchName(std::string name, const char *suffix) noexcept
+inline Stopwatch *
+Stopwatch::New(uint64_t _trace_id, uint32_t _parent_id,
+	       const char *_name, const char *suffix) noexcept
 {
-	if (suffix != nullptr)
-		name += suffix;
-
-	constexpr size_t MAX_NAME = 96;
-	if (name.length() > MAX_NAME)
-		name.resize(MAX_NAME);
-
-	return name;
+	Stopwatch *s;
+	if (free_list != nullptr) {
+		s = free_list;
+		free_list = s->next_free;
+		--n_free;
+	} else
+		s = new Stopwatch();
+
+	s->ref = 1;
+	s->trace_id = _trace_id;
+	s->parent_id = _parent_id;
+	s->span_id = ++stopwatch_span_counter;
+	s->time = std::chrono::steady_clock::now();
+	s->n_events = 0;
+
+	const size_t name_length = strlen(_name);
+	CopyTruncated(s->name, sizeof(s->name), _name, name_length);
+	if (suffix != nullptr && name_length < sizeof(s->name) - 1)
+		CopyTruncated(s->name + name_length,
+			      sizeof(s->name) - name_length,
+			      suffix, strlen(suffix));
+
+	return s;
 }
 
-static std::shared_ptr<Stopwatch>
-stopwatch_new(const char *name, const char *suffix) noexcept
+inline void
+Stopwatch::Free() noexcept
 {
-	if (!stopwatch_is_enabled())
-		return nullptr;
+	if (n_free >= MAX_FREE) {
+		delete this;
+		return;
+	}
 
-	return std::make_shared<Stopwatch>(MakeStopwatchName(name, suffix), true);
+	next_free = free_list;
+	free_list = this;
+	++n_free;
 }
 
-StopwatchPtr::StopwatchPtr(const char *name, const char *suffix) noexcept
-	:stopwatch(stopwatch_new(name, suffix)) {}
-
-StopwatchPtr::StopwatchPtr(Stopwatch *parent, const char *name,
-			   const char *suffix) noexcept
+template<typename D>
+static constexpr uint32_t
+ToMicroseconds(D d) noexcept
 {
-	if (parent != nullptr) {
-		stopwatch = std::make_shared<Stopwatch>(MakeStopwatchName(name, suffix),
-							false);
-		parent->AddChild(stopwatch);
-	}
+	return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
 }
 
-StopwatchPtr::~StopwatchPtr() noexcept = default;
-
 inline void
 Stopwatch::RecordEvent(const char *event_name) noexcept
 {
-	if (events.size() >= events.capacity())
+	if (n_events >= std::size(events))
 		/* array is full, do not record any more events */
 		return;
 
-	events.emplace_back(event_name);
+	auto &e = events[n_events++];
+	e.time = ToMicroseconds(std::chrono::steady_clock::now() - time);
+	CopyTruncated(e.name, sizeof(e.name), event_name, strlen(event_name));
 }
 
 void
-StopwatchPtr::RecordEvent(const char *name) const noexcept
+Stopwatch::Commit() const noexcept
 {
-	if (stopwatch != nullptr)
-		stopwatch->RecordEvent(name);
+	auto *const header = stopwatch_ring;
+	if (header == nullptr)
+		return;
+
+	/* this is a seqlock with only one writer: invalidate the
+	   record, write it, then publish it with the new sequence
+	   number */
+
+	const uint64_t position = header->head;
+	auto &record = header->GetRecord(position);
+	std::atomic_ref{record.sequence}.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	record.trace_id = trace_id;
+	record.span_id = span_id;
+	record.parent_id = parent_id;
+	record.start = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+	record.duration = ToMicroseconds(std::chrono::steady_clock::now() - time);
+	record.n_events = n_events;
+	memcpy(record.name, name, sizeof(name));
+	std::copy_n(events, n_events, record.events);
+
+	std::atomic_ref{record.sequence}.store(position + 1,
+					       std::memory_order_release);
+	std::atomic_ref{header->head}.store(position + 1,
+					    std::memory_order_release);
 }
 
-static constexpr long
-ToLongMs(std::chrono::steady_clock::duration d) noexcept
+void
+stopwatch_enable(UniqueFileDescriptor fd, unsigned sample_rate)
 {
-	return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
-}
+	assert(fd.IsDefined());
+
+	if (sample_rate == 0)
+		throw std::invalid_argument("Invalid stopwatch sample rate");
+
+	struct stat st;
+	if (fstat(fd.Get(), &st) < 0)
+		throw MakeErrno("Failed to stat stopwatch file");
+
+	const size_t size = st.st_size;
+	const size_t capacity = StopwatchRing::Header::CapacityForSize(size);
+	if (!S_ISREG(st.st_mode) || capacity == 0)
+		throw std::invalid_argument("Stopwatch file is too small");
+
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		       fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map stopwatch file");
 
-#if 0
+	if (stopwatch_ring != nullptr)
+		munmap(stopwatch_ring, stopwatch_ring_size);
+
+	auto *header = new(p) StopwatchRing::Header{};
+	header->capacity = std::min<size_t>(capacity, UINT32_MAX);
+	header->record_size = sizeof(StopwatchRing::Record);
+	header->head = 0;
+	header->version = StopwatchRing::VERSION;
+
+	/* the magic is written last to mark the header as valid */
+	std::atomic_thread_fence(std::memory_order_release);
+	header->magic = StopwatchRing::MAGIC;
+
+	stopwatch_ring = header;
+	stopwatch_ring_size = size;
+	stopwatch_sample_rate = sample_rate;
+
+	/* each process has its own segment (see stopwatch_enable()),
+	   but trace ids shall still be unique when a reader merges
+	   the segments of several processes */
+	stopwatch_trace_counter = uint64_t(getpid()) << 32;
+}
 
-static long
-timeval_diff_ms(const struct timeval *a, const struct timeval *b) noexcept
+bool
+stopwatch_is_enabled() noexcept
 {
-	return (a->tv_sec - b->tv_sec) * 1000 +
-		(a->tv_usec - b->tv_usec) / 1000;
+	return stopwatch_ring != nullptr;
 }
 
-#endif
+static Stopwatch *
+stopwatch_new_root(const char *name, const char *suffix) noexcept
+{
+	if (!stopwatch_is_enabled())
+		return nullptr;
 
-inline void
-Stopwatch::Dump(std::chrono::steady_clock::time_point root_time,
-		size_t indent) noexcept
-try {
-	if (!stopwatch_fd.IsDefined())
-		return;
+	if (++stopwatch_sample_counter < stopwatch_sample_rate)
+		/* this request is not sampled */
+		return nullptr;
 
-	char message[1024];
-	StringBuilder b(message);
+	stopwatch_sample_counter = 0;
 
-	b.CheckAppend(indent);
-	std::fill_n(b.GetTail(), indent, ' ');
-	b.Extend(indent);
+	return Stopwatch::New(++stopwatch_trace_counter, 0, name, suffix);
+}
 
-	b.Append(name.c_str());
+StopwatchPtr::StopwatchPtr(const char *name, const char *suffix) noexcept
+	:stopwatch(stopwatch_new_root(name, suffix)) {}
 
-	b.Format(" init=%ldms",
-		 ToLongMs(time - root_time));
+StopwatchPtr::StopwatchPtr(Stopwatch *parent, const char *name,
+			   const char *suffix) noexcept
+{
+	if (parent != nullptr)
+		stopwatch = Stopwatch::New(parent->trace_id, parent->span_id,
+					   name, suffix);
+}
 
-	for (const auto &i : events)
-		b.Format(" %s=%ldms",
-			 i.name.c_str(),
-			 ToLongMs(i.time - time));
+StopwatchPtr::StopwatchPtr(const StopwatchPtr &src) noexcept
+	:stopwatch(src.stopwatch)
+{
+	if (stopwatch != nullptr)
+		stopwatch->Ref();
+}
 
-#if 0
-	struct rusage new_self;
-	getrusage(RUSAGE_SELF, &new_self);
-	b.Format(" (beng-proxy=%ld+%ldms)",
-		 timeval_diff_ms(&new_self.ru_utime, &self.ru_utime),
-		 timeval_diff_ms(&new_self.ru_stime, &self.ru_stime));
-#endif
+StopwatchPtr::~StopwatchPtr() noexcept
+{
+	if (stopwatch != nullptr)
+		stopwatch->Unref();
+}
 
-	b.Append('\n');
+StopwatchPtr &
+StopwatchPtr::operator=(const StopwatchPtr &src) noexcept
+{
+	if (src.stopwatch != nullptr)
+		src.stopwatch->Ref();
 
-	if (stopwatch_fd.Write(message, strlen(message)) < 0) {
-		stopwatch_fd.Close();
-		return;
-	}
+	if (stopwatch != nullptr)
+		stopwatch->Unref();
 
-	indent += 2;
+	stopwatch = src.stopwatch;
+	return *this;
+}
 
-	for (const auto &child : children)
-		child->Dump(root_time, indent);
-} catch (StringBuilder::Overflow) {
+void
+StopwatchPtr::RecordEvent(const char *name) const noexcept
+{
+	if (stopwatch != nullptr)
+		stopwatch->RecordEvent(name);
 }
@@ -39,17 +39,27 @@ class UniqueFileDescriptor;
 
 #ifdef ENABLE_STOPWATCH
 
-#include <memory>
+#include <cstddef>
 
+/**
+ * A (reference-counted) pointer to a #Stopwatch span.  When the last
+ * reference goes away, the span is written to the stopwatch ring
+ * buffer.  If the stopwatch is disabled or the request was not
+ * sampled, this is a nullptr and all operations are no-ops.
+ */
 class StopwatchPtr {
 protected:
-	std::shared_ptr<Stopwatch> stopwatch;
+	Stopwatch *stopwatch = nullptr;
 
 public:
 	StopwatchPtr() = default;
 	StopwatchPtr(std::nullptr_t) noexcept {}
 
 protected:
+	/**
+	 * Create a new root span, but only if this request is
+	 * sampled.
+	 */
 	StopwatchPtr(const char *name,
 		     const char *suffix=nullptr) noexcept;
 
@@ -59,10 +69,23 @@ public:
 
 	StopwatchPtr(const StopwatchPtr &parent, const char *name,
 		     const char *suffix=nullptr) noexcept
-		:StopwatchPtr(parent.stopwatch.get(), name, suffix) {}
+		:StopwatchPtr(parent.stopwatch, name, suffix) {}
+
+	StopwatchPtr(const StopwatchPtr &src) noexcept;
+
+	StopwatchPtr(StopwatchPtr &&src) noexcept
+		:stopwatch(std::exchange(src.stopwatch, nullptr)) {}
 
 	~StopwatchPtr() noexcept;
 
+	StopwatchPtr &operator=(const StopwatchPtr &src) noexcept;
+
+	StopwatchPtr &operator=(StopwatchPtr &&src) noexcept {
+		using std::swap;
+		swap(stopwatch, src.stopwatch);
+		return *this;
+	}
+
 	operator bool() const noexcept {
 		return stopwatch != nullptr;
 	}
@@ -81,8 +104,22 @@ public:
 	RootStopwatchPtr &operator=(RootStopwatchPtr &&) noexcept = default;
 };
 
+/**
+ * Enable the stopwatch: finished spans will be written into the
+ * given file (which is mapped into memory) in the
+ * #StopwatchRing format.
+ *
+ * The ring buffer is a seqlock with exactly one writer: the file
+ * must not be shared with another process (or another call to this
+ * function), because the header is reinitialized and the head is
+ * updated without atomic read-modify-write.
+ *
+ * Throws on error.
+ *
+ * @param sample_rate record only one of this many requests
+ */
 void
-stopwatch_enable(UniqueFileDescriptor fd) noexcept;
+stopwatch_enable(UniqueFileDescriptor fd, unsigned sample_rate);
 
 [[gnu::pure]]
 bool
@@ -110,7 +147,7 @@ public:
 using RootStopwatchPtr = StopwatchPtr;
 
 static inline void
-stopwatch_enable(UniqueFileDescriptor &&) noexcept
+stopwatch_enable(UniqueFileDescriptor &&, unsigned)
 {
 }
 
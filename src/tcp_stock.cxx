@@ -43,6 +43,7 @@
 #include "net/SocketAddress.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "net/ToString.hxx"
+#include "net/KeepAlive.hxx"
 #include "util/Cancellable.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/Exception.hxx"
@@ -179,6 +180,8 @@ TcpStockConnection::OnSocketConnectSuccess(UniqueSocketDescriptor new_fd) noexce
 {
 	cancel_ptr = nullptr;
 
+	EnableIdleKeepAlive(new_fd);
+
 	fd = new_fd.Release();
 	event.Open(fd);
 
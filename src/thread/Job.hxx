@@ -34,6 +34,7 @@
 
 #include "util/IntrusiveList.hxx"
 
+#include <chrono>
 #include <cstdint>
 
 /**
@@ -73,6 +74,12 @@ public:
 	 */
 	bool again = false;
 
+	/**
+	 * When was this job added to the queue (#State::WAITING)?
+	 * Used for #ThreadQueueStats::wait_time.
+	 */
+	std::chrono::steady_clock::time_point queued_time;
+
 	/**
 	 * Is this job currently idle, i.e. not being worked on by a
 	 * worker thread?  This method may be called only from the main
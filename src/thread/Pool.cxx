@@ -114,6 +114,15 @@ thread_pool_set_volatile() noexcept
 		global_thread_queue->SetVolatile();
 }
 
+ThreadQueueStats
+thread_pool_get_stats() noexcept
+{
+	if (global_thread_queue == nullptr)
+		return {};
+
+	return global_thread_queue->GetStats();
+}
+
 void
 thread_pool_stop() noexcept
 {
@@ -33,6 +33,7 @@
 #pragma once
 
 class EventLoop;
+struct ThreadQueueStats;
 
 /**
  * A queue that manages work for worker threads.
@@ -55,6 +56,13 @@ thread_pool_get_queue(EventLoop &event_loop) noexcept;
 void
 thread_pool_set_volatile() noexcept;
 
+/**
+ * Obtain statistics of the global #ThreadQueue (all zero if it has
+ * not been created yet).
+ */
+ThreadQueueStats
+thread_pool_get_stats() noexcept;
+
 void
 thread_pool_stop() noexcept;
 
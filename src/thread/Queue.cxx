@@ -49,19 +49,23 @@ ThreadQueue::~ThreadQueue() noexcept
 void
 ThreadQueue::WakeupCallback() noexcept
 {
+	const auto now = std::chrono::steady_clock::now();
+
 	std::unique_lock lock{mutex};
 
-	done.clear_and_dispose([this, &lock](auto *_job){
+	++stats.n_wakeups;
+
+	/* handle all jobs which have finished since the last
+	   wakeup */
+	done.clear_and_dispose([this, now, &lock](auto *_job){
 		auto &job = *_job;
 		assert(job.state == ThreadJob::State::DONE);
 
 		if (job.again) {
 			/* schedule this job again */
-			job.state = ThreadJob::State::WAITING;
-			job.again = false;
-			waiting.push_back(job);
-			cond.notify_one();
+			AddWaiting(job, now);
 		} else {
+			++stats.n_completions;
 			job.state = ThreadJob::State::INITIAL;
 			lock.unlock();
 			job.Done();
@@ -83,16 +87,27 @@ ThreadQueue::Stop() noexcept
 	CheckDisableNotify();
 }
 
+inline void
+ThreadQueue::AddWaiting(ThreadJob &job,
+			std::chrono::steady_clock::time_point now) noexcept
+{
+	job.state = ThreadJob::State::WAITING;
+	job.again = false;
+	job.queued_time = now;
+	waiting.push_back(job);
+	++stats.n_waiting;
+
+	if (n_idle_workers > 0)
+		cond.notify_one();
+}
+
 inline void
 ThreadQueue::_Add(ThreadJob &job) noexcept
 {
 	assert(alive);
 
 	if (job.state == ThreadJob::State::INITIAL) {
-		job.state = ThreadJob::State::WAITING;
-		job.again = false;
-		waiting.push_back(job);
-		cond.notify_one();
+		AddWaiting(job, std::chrono::steady_clock::now());
 	} else if (job.state != ThreadJob::State::WAITING) {
 		job.again = true;
 	}
@@ -109,47 +124,79 @@ ThreadQueue::Add(ThreadJob &job) noexcept
 	notify.Enable();
 }
 
-ThreadJob *
-ThreadQueue::Wait() noexcept
+inline ThreadJob *
+ThreadQueue::_Wait(std::unique_lock<std::mutex> &lock, bool continued) noexcept
 {
-	std::unique_lock lock{mutex};
-
 	while (true) {
 		if (!alive)
 			return nullptr;
 
-		auto i = waiting.begin();
-		if (i != waiting.end()) {
-			auto &job = *i;
+		if (!waiting.empty()) {
+			auto &job = waiting.front();
 			assert(job.state == ThreadJob::State::WAITING);
 
 			job.state = ThreadJob::State::BUSY;
 			job.unlink();
 			busy.push_back(job);
+			--stats.n_waiting;
+			stats.wait_time += std::chrono::steady_clock::now() - job.queued_time;
+
+			++stats.n_jobs;
+			if (!continued)
+				++stats.n_batches;
+
 			return &job;
 		}
 
 		/* queue is empty, wait for a new job to be added */
+		continued = false;
+		++n_idle_workers;
 		cond.wait(lock);
+		--n_idle_workers;
 	}
 }
 
-void
-ThreadQueue::Done(ThreadJob &job) noexcept
+ThreadJob *
+ThreadQueue::Wait() noexcept
+{
+	std::unique_lock lock{mutex};
+	return _Wait(lock, false);
+}
+
+inline void
+ThreadQueue::_Done(ThreadJob &job) noexcept
 {
 	assert(job.state == ThreadJob::State::BUSY);
 
+	job.state = ThreadJob::State::DONE;
+	job.unlink();
+	done.push_back(job);
+}
+
+void
+ThreadQueue::Done(ThreadJob &job) noexcept
+{
 	{
 		const std::scoped_lock lock{mutex};
-
-		job.state = ThreadJob::State::DONE;
-		job.unlink();
-		done.push_back(job);
+		_Done(job);
 	}
 
 	notify.Signal();
 }
 
+ThreadJob *
+ThreadQueue::DoneAndWait(ThreadJob &job) noexcept
+{
+	std::unique_lock lock{mutex};
+	_Done(job);
+
+	/* don't delay the completion until the next job is
+	   finished; Notify::Signal() coalesces redundant wakeups */
+	notify.Signal();
+
+	return _Wait(lock, true);
+}
+
 bool
 ThreadQueue::Cancel(ThreadJob &job) noexcept
 {
@@ -164,6 +211,7 @@ ThreadQueue::Cancel(ThreadJob &job) noexcept
 		/* cancel it */
 		job.unlink();
 		job.state = ThreadJob::State::INITIAL;
+		--stats.n_waiting;
 		CheckDisableNotify();
 		return true;
 
@@ -180,3 +228,10 @@ ThreadQueue::Cancel(ThreadJob &job) noexcept
 	assert(false);
 	gcc_unreachable();
 }
+
+ThreadQueueStats
+ThreadQueue::GetStats() noexcept
+{
+	const std::scoped_lock lock{mutex};
+	return stats;
+}
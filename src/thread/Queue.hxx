@@ -37,6 +37,7 @@
 #pragma once
 
 #include "Notify.hxx"
+#include "stats/ThreadQueueStats.hxx"
 #include "util/IntrusiveList.hxx"
 
 #include <mutex>
@@ -61,6 +62,14 @@ class ThreadQueue {
 
 	JobList waiting, busy, done;
 
+	/**
+	 * The number of worker threads waiting for a job.  The
+	 * condition variable is only notified if this is non-zero.
+	 */
+	unsigned n_idle_workers = 0;
+
+	ThreadQueueStats stats;
+
 	Notify notify;
 
 public:
@@ -91,15 +100,27 @@ public:
 	/**
 	 * Dequeue an existing job or wait for a new job, and reserve it.
 	 *
-	 * @return NULL if thread_queue_stop() has been called
+	 * @return nullptr if Stop() has been called
 	 */
 	ThreadJob *Wait() noexcept;
 
 	/**
-	 * Mark the specified job (returned by thread_queue_wait()) as "done".
+	 * Mark the specified job (returned by Wait()) as "done".
 	 */
 	void Done(ThreadJob &job) noexcept;
 
+	/**
+	 * Combination of Done() and Wait() with only one mutex
+	 * round trip.  This allows a worker thread to drain a burst
+	 * of small jobs (e.g. TLS handshakes) without sleeping,
+	 * while each finished job is still handed to the main thread
+	 * immediately and all other jobs remain available to other
+	 * worker threads.
+	 *
+	 * @return the next job or nullptr if Stop() has been called
+	 */
+	ThreadJob *DoneAndWait(ThreadJob &job) noexcept;
+
 	/**
 	 * Cancel a job that has been queued.
 	 *
@@ -108,6 +129,8 @@ public:
 	 */
 	bool Cancel(ThreadJob &job) noexcept;
 
+	ThreadQueueStats GetStats() noexcept;
+
 private:
 	bool IsEmpty() const noexcept {
 		return waiting.empty() && busy.empty() && done.empty();
@@ -123,7 +146,19 @@ private:
 		CheckDisableNotify();
 	}
 
+	void AddWaiting(ThreadJob &job,
+			std::chrono::steady_clock::time_point now) noexcept;
 	void _Add(ThreadJob &job) noexcept;
 
+	void _Done(ThreadJob &job) noexcept;
+
+	/**
+	 * @param continued true if the calling worker thread has just
+	 * finished a job without sleeping (for
+	 * ThreadQueueStats::n_batches)
+	 */
+	ThreadJob *_Wait(std::unique_lock<std::mutex> &lock,
+			 bool continued) noexcept;
+
 	void WakeupCallback() noexcept;
 };
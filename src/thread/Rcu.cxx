@@ -0,0 +1,89 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Rcu.hxx"
+
+#include <thread>
+
+unsigned
+RcuDomain::GetSlotIndex() noexcept
+{
+	static std::atomic_uint next_slot{0};
+
+	/* assign slots round-robin, so threads share slots only if
+	   there are more than N_SLOTS */
+	thread_local const unsigned slot =
+		next_slot.fetch_add(1, std::memory_order_relaxed) % N_SLOTS;
+
+	return slot;
+}
+
+inline bool
+RcuDomain::HasReaders(unsigned parity) const noexcept
+{
+	for (const auto &slot : slots)
+		if (slot.readers[parity].load(std::memory_order_acquire) != 0)
+			return true;
+
+	return false;
+}
+
+bool
+RcuDomain::PollGracePeriod(uint64_t cookie) noexcept
+{
+	/* two steps are needed: a reader may have sampled the
+	   generation before the first flip, but incremented its
+	   counter only after we have checked that parity; it is
+	   caught by the second step */
+	while (completed_steps < cookie) {
+		if (!step_running) {
+			step_parity = generation.fetch_add(1) & 1;
+			step_running = true;
+		}
+
+		if (HasReaders(step_parity))
+			return false;
+
+		step_running = false;
+		++completed_steps;
+	}
+
+	return true;
+}
+
+void
+RcuDomain::Synchronize() noexcept
+{
+	const auto cookie = StartGracePeriod();
+	while (!PollGracePeriod(cookie))
+		std::this_thread::yield();
+}
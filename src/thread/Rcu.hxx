@@ -0,0 +1,161 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * A minimal read-copy-update implementation for read-mostly data
+ * structures which are accessed by worker threads and modified only
+ * by the main thread.
+ *
+ * Readers enter a read-side critical section with #RcuReadLock; this
+ * never blocks, it only increments a counter which is shared with
+ * few other threads.  A writer publishes a new version of the data
+ * (e.g. by swapping an atomic pointer) and then calls Synchronize(),
+ * which waits until all readers which may still see the old version
+ * have left their critical section; after that, the old version can
+ * be freed.
+ *
+ * A writer which must not block (e.g. because it runs in an event
+ * loop) obtains a cookie from StartGracePeriod() instead, and
+ * frees the old version as soon as PollGracePeriod() returns true.
+ *
+ * Read-side critical sections must be short and must not block.
+ */
+class RcuDomain {
+	friend class RcuReadLock;
+
+	static constexpr unsigned N_SLOTS = 64;
+
+	/**
+	 * Each reader thread is assigned one of these slots.  There
+	 * are two counters, one for each generation parity.
+	 */
+	struct alignas(64) Slot {
+		std::array<std::atomic_uint, 2> readers{};
+	};
+
+	std::array<Slot, N_SLOTS> slots;
+
+	std::atomic_uint generation{0};
+
+	/**
+	 * The number of completed grace period steps (each one is a
+	 * generation flip followed by waiting for the readers of the
+	 * old parity).  Only used by the writer.
+	 */
+	uint64_t completed_steps = 0;
+
+	/**
+	 * The parity whose readers are being waited for by the
+	 * current step; only valid if #step_running is set.
+	 */
+	unsigned step_parity;
+
+	bool step_running = false;
+
+public:
+	RcuDomain() noexcept = default;
+
+	RcuDomain(const RcuDomain &) = delete;
+	RcuDomain &operator=(const RcuDomain &) = delete;
+
+	/**
+	 * Wait until all read-side critical sections which were
+	 * entered before this call have been left.  Must not be
+	 * called by more than one thread at a time, and never from
+	 * within a read-side critical section.
+	 */
+	void Synchronize() noexcept;
+
+	/**
+	 * Begin a grace period for data which has just been
+	 * unpublished.  Does not block.  Same restrictions as
+	 * Synchronize().
+	 *
+	 * @return a cookie to be passed to PollGracePeriod()
+	 */
+	[[gnu::pure]]
+	uint64_t StartGracePeriod() const noexcept {
+		/* a step which is already running has flipped the
+		   generation before the caller unpublished its data,
+		   so it doesn't count */
+		return completed_steps + step_running + 2;
+	}
+
+	/**
+	 * Advance the grace period without blocking.
+	 *
+	 * @param cookie a value returned by StartGracePeriod()
+	 * @return true if all read-side critical sections which
+	 * were entered before the StartGracePeriod() call have been
+	 * left
+	 */
+	bool PollGracePeriod(uint64_t cookie) noexcept;
+
+private:
+	static unsigned GetSlotIndex() noexcept;
+
+	[[gnu::pure]]
+	bool HasReaders(unsigned parity) const noexcept;
+};
+
+/**
+ * A read-side critical section of a #RcuDomain.  Data published
+ * through this domain which was obtained while this object exists
+ * remains valid until it is destructed.
+ */
+class RcuReadLock {
+	std::atomic_uint &counter;
+
+public:
+	explicit RcuReadLock(RcuDomain &domain) noexcept
+		:counter(domain.slots[RcuDomain::GetSlotIndex()]
+			 .readers[domain.generation.load() & 1])
+	{
+		/* sequentially consistent: the caller's load of the
+		   published pointer must not be reordered before
+		   this increment */
+		counter.fetch_add(1);
+	}
+
+	~RcuReadLock() noexcept {
+		counter.fetch_sub(1, std::memory_order_release);
+	}
+
+	RcuReadLock(const RcuReadLock &) = delete;
+	RcuReadLock &operator=(const RcuReadLock &) = delete;
+};
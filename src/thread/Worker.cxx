@@ -39,10 +39,10 @@
 inline void
 ThreadWorker::Run() noexcept
 {
-	ThreadJob *job;
-	while ((job = queue.Wait()) != nullptr) {
+	ThreadJob *job = queue.Wait();
+	while (job != nullptr) {
 		job->Run();
-		queue.Done(*job);
+		job = queue.DoneAndWait(*job);
 	}
 }
 
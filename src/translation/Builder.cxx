@@ -32,6 +32,8 @@
 
 #include "Builder.hxx"
 #include "Stock.hxx"
+#include "MuxStock.hxx"
+#include "Replicated.hxx"
 #include "Cache.hxx"
 #include "net/SocketAddress.hxx"
 #include "stats/AllocatorStats.hxx"
@@ -61,30 +63,54 @@ SocketAddressCompare::operator()(SocketAddress a,
 	return a.GetSize() < b.GetSize();
 }
 
-TranslationStockBuilder::TranslationStockBuilder(unsigned _limit) noexcept
-	:limit(_limit)
+TranslationStockBuilder::TranslationStockBuilder(FailureManager &_failure_manager,
+						 unsigned _limit,
+						 unsigned _multiplex) noexcept
+	:failure_manager(_failure_manager),
+	 limit(_limit), multiplex(_multiplex)
 {
 }
 
 TranslationStockBuilder::~TranslationStockBuilder() noexcept = default;
 
+std::shared_ptr<TranslationService>
+TranslationStockBuilder::MakeStock(SocketAddress address,
+				   EventLoop &event_loop) noexcept
+{
+	if (multiplex > 0)
+		return std::make_shared<TranslationMuxStock>(event_loop,
+							     address,
+							     multiplex);
+	else
+		return std::make_shared<TranslationStock>(event_loop,
+							  address, limit);
+}
+
 std::shared_ptr<TranslationService>
 TranslationStockBuilder::Get(SocketAddress address,
 			     EventLoop &event_loop) noexcept
 {
 	auto e = m.emplace(address, nullptr);
-	if (e.second)
-		e.first->second = std::make_shared<TranslationStock>
-			(event_loop, address, limit);
+	if (e.second) {
+		if (auto r = replicas.find(address); r != replicas.end()) {
+			auto service = std::make_shared<ReplicatedTranslationService>(event_loop,
+										      failure_manager);
+			for (const auto &i : r->second)
+				service->AddReplica(i, MakeStock(i, event_loop));
+			e.first->second = std::move(service);
+		} else
+			e.first->second = MakeStock(address, event_loop);
+	}
 
 	return e.first->second;
 }
 
 TranslationCacheBuilder::TranslationCacheBuilder(TranslationStockBuilder &_builder,
 						 struct pool &_pool,
+						 RegexCache &_regex_cache,
 						 unsigned _max_size) noexcept
 	:builder(_builder),
-	 pool(_pool), max_size(_max_size)
+	 pool(_pool), regex_cache(_regex_cache), max_size(_max_size)
 {
 }
 
@@ -134,7 +160,7 @@ TranslationCacheBuilder::Get(SocketAddress address,
 			(pool, event_loop,
 			 // TODO: refactor to std::shared_ptr?
 			 *builder.Get(address, event_loop),
-			 max_size, false);
+			 regex_cache, max_size, false);
 
 	return e.first->second;
 }
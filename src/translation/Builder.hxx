@@ -42,9 +42,13 @@
 #include <map>
 #include <memory>
 #include <span>
+#include <iterator>
+#include <vector>
 
 struct AllocatorStats;
 class EventLoop;
+class FailureManager;
+class RegexCache;
 class SocketAddress;
 class TranslationStock;
 class TranslationCache;
@@ -63,17 +67,55 @@ public:
 };
 
 class TranslationStockBuilder final : public TranslationServiceBuilder {
+	FailureManager &failure_manager;
+
 	const unsigned limit;
 
-	std::map<SocketAddress, std::shared_ptr<TranslationStock>,
+	/**
+	 * If non-zero, then the translation servers support the
+	 * multiplexed protocol, and this is the maximum number of
+	 * connections to each of them (see #TranslationMuxStock).
+	 */
+	const unsigned multiplex;
+
+	std::map<SocketAddress, std::shared_ptr<TranslationService>,
 		 SocketAddressCompare> m;
 
+	/**
+	 * Sets of equivalent translation servers, indexed by the
+	 * first address (see AddReplicas()).
+	 */
+	std::map<SocketAddress, std::vector<SocketAddress>,
+		 SocketAddressCompare> replicas;
+
 public:
-	explicit TranslationStockBuilder(unsigned _limit) noexcept;
+	TranslationStockBuilder(FailureManager &_failure_manager,
+				unsigned _limit,
+				unsigned _multiplex=0) noexcept;
 	~TranslationStockBuilder() noexcept;
 
+	/**
+	 * Declare that the given translation servers are equivalent
+	 * replicas.  Get() with the first address will return a
+	 * #ReplicatedTranslationService which balances requests
+	 * over all of them.  The addresses must remain valid for the
+	 * lifetime of this object.
+	 *
+	 * @param addresses a container of at least two socket
+	 * addresses
+	 */
+	template<typename C>
+	void AddReplicas(const C &addresses) noexcept {
+		auto &v = replicas[*std::begin(addresses)];
+		v.assign(std::begin(addresses), std::end(addresses));
+	}
+
 	std::shared_ptr<TranslationService> Get(SocketAddress address,
 						EventLoop &event_loop) noexcept override;
+
+private:
+	std::shared_ptr<TranslationService> MakeStock(SocketAddress address,
+						      EventLoop &event_loop) noexcept;
 };
 
 class TranslationCacheBuilder final : public TranslationServiceBuilder {
@@ -81,6 +123,8 @@ class TranslationCacheBuilder final : public TranslationServiceBuilder {
 
 	struct pool &pool;
 
+	RegexCache &regex_cache;
+
 	const unsigned max_size;
 
 	std::map<SocketAddress, std::shared_ptr<TranslationCache>,
@@ -89,6 +133,7 @@ class TranslationCacheBuilder final : public TranslationServiceBuilder {
 public:
 	TranslationCacheBuilder(TranslationStockBuilder &_builder,
 				struct pool &_pool,
+				RegexCache &_regex_cache,
 				unsigned _max_size) noexcept;
 	~TranslationCacheBuilder() noexcept;
 
@@ -49,6 +49,7 @@
 #include "pool/PSocketAddress.hxx"
 #include "memory/SlicePool.hxx"
 #include "stats/AllocatorStats.hxx"
+#include "RegexCache.hxx"
 #include "lib/pcre/UniqueRegex.hxx"
 #include "io/Logger.hxx"
 #include "util/djbhash.h"
@@ -122,7 +123,7 @@ struct TranslateCacheItem final : PoolHolder, CacheItem {
 
 	TranslateResponse response;
 
-	UniqueRegex regex, inverse_regex;
+	SharedRegex regex, inverse_regex;
 
 	TranslateCacheItem(PoolPtr &&_pool,
 			   std::chrono::steady_clock::time_point now,
@@ -361,6 +362,8 @@ struct tcache {
 
 	TranslationService &next;
 
+	RegexCache &regex_cache;
+
 	/**
 	 * This flag may be set to false when initializing the translation
 	 * cache.  All responses will be regarded "non cacheable".  It
@@ -369,8 +372,8 @@ struct tcache {
 	bool active;
 
 	tcache(struct pool &_pool, EventLoop &event_loop,
-	       TranslationService &_next, unsigned max_size,
-	       bool handshake_cacheable);
+	       TranslationService &_next, RegexCache &_regex_cache,
+	       unsigned max_size, bool handshake_cacheable);
 	tcache(struct tcache &) = delete;
 
 	~tcache() = default;
@@ -1023,20 +1026,20 @@ tcache_item_match(const CacheItem *_item, void *ctx)
 
 	const TempPoolLease tpool;
 
-	if (item.response.base != nullptr && item.inverse_regex.IsDefined()) {
+	if (item.response.base != nullptr && item.inverse_regex) {
 		auto input = tcache_regex_input(AllocatorPtr{tpool},
 						request.uri, request.host,
 						request.user, item.response, true);
-		if (input == nullptr || item.inverse_regex.Match(input))
+		if (input == nullptr || item.inverse_regex->Match(input))
 			/* the URI matches the inverse regular expression */
 			return false;
 	}
 
-	if (item.response.base != nullptr && item.regex.IsDefined()) {
+	if (item.response.base != nullptr && item.regex) {
 		auto input = tcache_regex_input(AllocatorPtr{tpool},
 						request.uri, request.host,
 						request.user, item.response);
-		if (input == nullptr || !item.regex.Match(input))
+		if (input == nullptr || !item.regex->Match(input))
 			return false;
 	}
 
@@ -1300,7 +1303,9 @@ tcache_store(TranslateCacheRequest &tcr, const TranslateResponse &response)
 
 	if (response.regex != nullptr) {
 		try {
-			item->regex = response.CompileRegex();
+			item->regex = tcr.tcache->regex_cache.Get(response.regex,
+								  true,
+								  response.IsExpandable());
 		} catch (...) {
 			item->Destroy();
 			throw;
@@ -1311,7 +1316,8 @@ tcache_store(TranslateCacheRequest &tcr, const TranslateResponse &response)
 
 	if (response.inverse_regex != nullptr) {
 		try {
-			item->inverse_regex = response.CompileInverseRegex();
+			item->inverse_regex = tcr.tcache->regex_cache.Get(response.inverse_regex,
+									  true, false);
 		} catch (...) {
 			item->Destroy();
 			throw;
@@ -1375,8 +1381,9 @@ try {
 
 	if (request.uri != nullptr && response.IsExpandable()) {
 		const char *uri = UriWithoutQueryString(alloc, request.uri);
-		tcache_expand_response(alloc, response,
-				       response.CompileRegex(),
+		const auto regex = tcache->regex_cache.Get(response.regex,
+							   true, true);
+		tcache_expand_response(alloc, response, *regex,
 				       uri, request.host,
 				       request.user);
 	} else if (response.easy_base) {
@@ -1425,7 +1432,7 @@ tcache_hit(AllocatorPtr alloc,
 
 	if (uri != nullptr && response->IsExpandable()) {
 		try {
-			tcache_expand_response(alloc, *response, item.regex,
+			tcache_expand_response(alloc, *response, *item.regex,
 					       uri, host, user);
 		} catch (...) {
 			handler.OnTranslateError(std::current_exception());
@@ -1536,23 +1543,25 @@ TranslateCacheItem::Destroy() noexcept
 
 inline
 tcache::tcache(struct pool &_pool, EventLoop &event_loop,
-	       TranslationService &_next, unsigned max_size,
-	       bool handshake_cacheable)
+	       TranslationService &_next, RegexCache &_regex_cache,
+	       unsigned max_size, bool handshake_cacheable)
 	:pool(pool_new_dummy(&_pool, "translate_cache")),
 	 slice_pool(4096, 32768, "translate_cache"),
 	 per_host(PerHostSet::bucket_traits(per_host_buckets, N_BUCKETS)),
 	 per_site(PerSiteSet::bucket_traits(per_site_buckets, N_BUCKETS)),
 	 cache(event_loop, 65521, max_size),
-	 next(_next), active(handshake_cacheable)
+	 next(_next), regex_cache(_regex_cache),
+	 active(handshake_cacheable)
 {
 	assert(max_size > 0);
 }
 
 TranslationCache::TranslationCache(struct pool &pool, EventLoop &event_loop,
 				   TranslationService &next,
+				   RegexCache &regex_cache,
 				   unsigned max_size,
 				   bool handshake_cacheable)
-	:cache(new tcache(pool, event_loop, next, max_size,
+	:cache(new tcache(pool, event_loop, next, regex_cache, max_size,
 			  handshake_cacheable))
 {
 }
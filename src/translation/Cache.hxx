@@ -39,6 +39,7 @@
 
 enum class TranslationCommand : uint16_t;
 class EventLoop;
+class RegexCache;
 struct AllocatorStats;
 
 struct tcache;
@@ -51,11 +52,14 @@ class TranslationCache final : public TranslationService {
 
 public:
 	/**
+	 * @param regex_cache compiled regular expressions are
+	 * obtained from here; it must outlive this object
 	 * @param handshake_cacheable if false, then all requests are
 	 * deemed uncacheable until the first response is received
 	 */
 	TranslationCache(struct pool &pool, EventLoop &event_loop,
 			 TranslationService &next,
+			 RegexCache &regex_cache,
 			 unsigned max_size, bool handshake_cacheable=true);
 
 	~TranslationCache() noexcept;
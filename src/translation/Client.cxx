@@ -51,8 +51,6 @@
 #include <assert.h>
 #include <string.h>
 
-static const uint8_t PROTOCOL_VERSION = 3;
-
 class TranslateClient final : BufferedSocketHandler, Cancellable {
 	static constexpr Event::Duration read_timeout = std::chrono::minutes{1};
 	static constexpr Event::Duration write_timeout = std::chrono::seconds{10};
@@ -274,7 +272,7 @@ try {
 	       (request.content_type_lookup.data() != nullptr &&
 		request.suffix != nullptr));
 
-	GrowingBuffer gb = MarshalTranslateRequest(PROTOCOL_VERSION,
+	GrowingBuffer gb = MarshalTranslateRequest(TRANSLATION_PROTOCOL_VERSION,
 						   request);
 
 	alloc.New<TranslateClient>(alloc, event_loop,
@@ -32,6 +32,7 @@
 
 #include "Layout.hxx"
 #include "AllocatorPtr.hxx"
+#include "RegexCache.hxx"
 #include "lib/pcre/UniqueRegex.hxx"
 #include "util/Compiler.h"
 #include "util/StringCompare.hxx"
@@ -43,7 +44,8 @@ TranslationLayoutItem::TranslationLayoutItem(AllocatorPtr alloc,
 }
 
 bool
-TranslationLayoutItem::Match(const char *uri) const noexcept
+TranslationLayoutItem::Match(const char *uri,
+			     RegexCache &regex_cache) const noexcept
 {
 	switch (type) {
 	case Type::BASE:
@@ -51,7 +53,7 @@ TranslationLayoutItem::Match(const char *uri) const noexcept
 
 	case Type::REGEX:
 		try {
-			return UniqueRegex{value, true, false}.Match(uri);
+			return regex_cache.Get(value, true, false)->Match(uri);
 		} catch (...) {
 			// TODO: what to do?  We should reject this
 			// translation response
@@ -33,6 +33,7 @@
 #pragma once
 
 class AllocatorPtr;
+class RegexCache;
 
 /**
  * An item in a URI layout.
@@ -54,6 +55,9 @@ struct TranslationLayoutItem {
 
 	TranslationLayoutItem(AllocatorPtr alloc, const TranslationLayoutItem &src) noexcept;
 
-	[[gnu::pure]]
-	bool Match(const char *uri) const noexcept;
+	/**
+	 * @param regex_cache a cache for compiled #Type::REGEX
+	 * values
+	 */
+	bool Match(const char *uri, RegexCache &regex_cache) const noexcept;
 };
@@ -43,6 +43,11 @@ enum class TranslationCommand : uint16_t;
 struct TranslateRequest;
 class SocketAddress;
 
+/**
+ * The protocol version sent by this client in the BEGIN packet.
+ */
+static constexpr uint8_t TRANSLATION_PROTOCOL_VERSION = 3;
+
 class TranslationMarshaller {
 	GrowingBuffer buffer;
 
@@ -0,0 +1,634 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MuxStock.hxx"
+#include "MuxProtocol.hxx"
+#include "Marshal.hxx"
+#include "translation/Parser.hxx"
+#include "translation/Request.hxx"
+#include "translation/Response.hxx"
+#include "translation/Handler.hxx"
+#include "event/CoarseTimerEvent.hxx"
+#include "event/Loop.hxx"
+#include "event/net/BufferedSocket.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/ToString.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "net/TimeoutError.hxx"
+#include "memory/GrowingBuffer.hxx"
+#include "pool/LeakDetector.hxx"
+#include "system/Error.hxx"
+#include "util/Cancellable.hxx"
+#include "util/Exception.hxx"
+#include "stopwatch.hxx"
+#include "AllocatorPtr.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+class TranslationMuxStock::Request final
+	: public IntrusiveListHook, Cancellable, PoolLeakDetector
+{
+	Connection &connection;
+
+	StopwatchPtr stopwatch;
+
+	TranslateHandler &handler;
+
+	TranslateParser parser;
+
+public:
+	const uint32_t id;
+
+	/**
+	 * When was this request submitted?  Used for the
+	 * per-request timeout.
+	 */
+	const Event::TimePoint send_time;
+
+	Request(Connection &_connection, uint32_t _id,
+		Event::TimePoint _send_time,
+		AllocatorPtr alloc, const TranslateRequest &request,
+		StopwatchPtr &&_stopwatch,
+		TranslateHandler &_handler,
+		CancellablePointer &cancel_ptr) noexcept
+		:PoolLeakDetector(alloc),
+		 connection(_connection),
+		 stopwatch(std::move(_stopwatch)),
+		 handler(_handler),
+		 parser(alloc, request, *alloc.New<TranslateResponse>()),
+		 id(_id), send_time(_send_time)
+	{
+		cancel_ptr = *this;
+	}
+
+	/**
+	 * Feed response frame data into the parser.  Throws on
+	 * error.
+	 *
+	 * @return the number of bytes consumed; 0 if more data is
+	 * needed
+	 */
+	std::size_t Feed(std::span<const std::byte> src) {
+		return parser.Feed(src);
+	}
+
+	/**
+	 * Process the packet which has just been fed.  Throws on
+	 * error.
+	 *
+	 * @return true if the response is complete
+	 */
+	bool Process() {
+		return parser.Process() == TranslateParser::Result::DONE;
+	}
+
+	/**
+	 * Deliver the completed response to the handler and destroy
+	 * this object.  The caller must have removed it from the
+	 * #Connection.
+	 */
+	void Finish() noexcept {
+		stopwatch.RecordEvent("response");
+
+		auto &_handler = handler;
+		auto &response = parser.GetResponse();
+		Destroy();
+		_handler.OnTranslateResponse(response);
+	}
+
+	/**
+	 * Like Finish(), but deliver an error.
+	 */
+	void Fail(std::exception_ptr ep) noexcept {
+		stopwatch.RecordEvent("error");
+
+		auto &_handler = handler;
+		Destroy();
+		_handler.OnTranslateError(std::move(ep));
+	}
+
+private:
+	void Destroy() noexcept {
+		this->~Request();
+	}
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override;
+};
+
+class TranslationMuxStock::Connection final
+	: public IntrusiveListHook, BufferedSocketHandler
+{
+	static constexpr Event::Duration read_timeout = std::chrono::minutes{1};
+	static constexpr Event::Duration write_timeout = std::chrono::seconds{10};
+	static constexpr Event::Duration idle_timeout = std::chrono::minutes{1};
+
+	TranslationMuxStock &stock;
+
+	UniqueSocketDescriptor fd;
+
+	BufferedSocket socket;
+
+	/**
+	 * The read timeout of the oldest pending request; the idle
+	 * timeout if there is none.
+	 */
+	CoarseTimerEvent timeout_timer;
+
+	/**
+	 * Marshalled request frames which have not yet been sent.
+	 */
+	GrowingBuffer output;
+
+	/**
+	 * Requests waiting for their response, oldest first.
+	 */
+	IntrusiveList<Request> requests;
+
+	std::size_t n_requests = 0;
+
+	/**
+	 * The request whose response frame is being received.  This
+	 * is nullptr if the request has been canceled; the rest of
+	 * the frame is then discarded.
+	 */
+	Request *current = nullptr;
+
+	/**
+	 * The number of bytes remaining in the response frame which
+	 * is being received; 0 if the next frame header is expected.
+	 */
+	std::size_t frame_remaining = 0;
+
+	uint32_t last_id = 0;
+
+	/**
+	 * When was data last received from the translation server?
+	 */
+	Event::TimePoint last_received;
+
+public:
+	Connection(TranslationMuxStock &_stock,
+		   UniqueSocketDescriptor &&_fd) noexcept
+		:stock(_stock), fd(std::move(_fd)),
+		 socket(stock.GetEventLoop()),
+		 timeout_timer(stock.GetEventLoop(),
+			       BIND_THIS_METHOD(OnTimeout)),
+		 last_received(stock.GetEventLoop().SteadyNow())
+	{
+		socket.Init(fd, FdType::FD_SOCKET, write_timeout, *this);
+		socket.ScheduleRead();
+		timeout_timer.Schedule(idle_timeout);
+	}
+
+	/**
+	 * Close the connection, fail all pending requests and delete
+	 * this object.  To be called by
+	 * TranslationMuxStock::RemoveConnection() only.
+	 */
+	void Destroy(std::exception_ptr error) noexcept;
+
+	std::size_t GetRequestCount() const noexcept {
+		return n_requests;
+	}
+
+	/**
+	 * Throws if the request cannot be marshalled.
+	 */
+	void SendRequest(AllocatorPtr alloc,
+			 const TranslateRequest &request,
+			 StopwatchPtr &&stopwatch,
+			 TranslateHandler &handler,
+			 CancellablePointer &cancel_ptr);
+
+	void CancelRequest(Request &request) noexcept;
+
+private:
+	EventLoop &GetEventLoop() const noexcept {
+		return stock.GetEventLoop();
+	}
+
+	/**
+	 * Arm the timer for the oldest pending request, or for the
+	 * idle timeout.
+	 */
+	void ScheduleTimeout() noexcept {
+		if (requests.empty()) {
+			timeout_timer.Schedule(idle_timeout);
+			return;
+		}
+
+		const auto deadline = requests.front().send_time + read_timeout;
+		const auto now = GetEventLoop().SteadyNow();
+		timeout_timer.Schedule(deadline > now
+				       ? deadline - now
+				       : Event::Duration::zero());
+	}
+
+	void RemoveRequest(Request &request) noexcept {
+		const bool was_oldest = &request == &requests.front();
+
+		requests.erase(requests.iterator_to(request));
+		--n_requests;
+
+		if (was_oldest)
+			ScheduleTimeout();
+	}
+
+	[[gnu::pure]]
+	Request *FindRequest(uint32_t id) noexcept {
+		/* responses usually arrive roughly in the order of
+		   their requests, so this linear search is short */
+		for (auto &i : requests)
+			if (i.id == id)
+				return &i;
+
+		return nullptr;
+	}
+
+	void Fail(std::exception_ptr ep) noexcept {
+		stock.RemoveConnection(*this, std::move(ep));
+	}
+
+	bool TryWrite() noexcept;
+
+	BufferedResult Feed(std::span<const std::byte> src) noexcept;
+
+	void OnTimeout() noexcept;
+
+	/* virtual methods from class BufferedSocketHandler */
+	BufferedResult OnBufferedData() override {
+		last_received = GetEventLoop().SteadyNow();
+
+		auto r = socket.ReadBuffer();
+		assert(!r.empty());
+		return Feed(r);
+	}
+
+	bool OnBufferedClosed() noexcept override {
+		if (n_requests == 0)
+			stock.RemoveConnection(*this, {});
+		else
+			Fail(std::make_exception_ptr(std::runtime_error("Translation server closed the connection")));
+		return false;
+	}
+
+	bool OnBufferedWrite() override {
+		return TryWrite();
+	}
+
+	void OnBufferedError(std::exception_ptr ep) noexcept override {
+		Fail(NestException(ep,
+				   std::runtime_error("Translation server connection failed")));
+	}
+};
+
+void
+TranslationMuxStock::Request::Cancel() noexcept
+{
+	stopwatch.RecordEvent("cancel");
+	connection.CancelRequest(*this);
+	Destroy();
+}
+
+void
+TranslationMuxStock::Connection::Destroy(std::exception_ptr error) noexcept
+{
+	timeout_timer.Cancel();
+	socket.Abandon();
+	socket.Destroy();
+	fd.Close();
+
+	current = nullptr;
+
+	while (!requests.empty()) {
+		assert(error);
+
+		auto &request = requests.front();
+		requests.pop_front();
+		--n_requests;
+		request.Fail(error);
+	}
+
+	delete this;
+}
+
+void
+TranslationMuxStock::Connection::SendRequest(AllocatorPtr alloc,
+					     const TranslateRequest &request,
+					     StopwatchPtr &&stopwatch,
+					     TranslateHandler &handler,
+					     CancellablePointer &cancel_ptr)
+{
+	GrowingBuffer payload =
+		MarshalTranslateRequest(TRANSLATION_PROTOCOL_VERSION,
+					request);
+
+	const uint32_t id = ++last_id;
+
+	output.WriteT(TranslationMuxHeader{id, uint32_t(payload.GetSize())});
+	output.AppendMoveFrom(std::move(payload));
+
+	auto *r = alloc.New<Request>(*this, id,
+				     GetEventLoop().SteadyNow(),
+				     alloc, request,
+				     std::move(stopwatch),
+				     handler, cancel_ptr);
+	requests.push_back(*r);
+	if (n_requests++ == 0)
+		ScheduleTimeout();
+
+	socket.DeferWrite();
+}
+
+void
+TranslationMuxStock::Connection::CancelRequest(Request &request) noexcept
+{
+	if (current == &request)
+		/* discard the rest of this response frame */
+		current = nullptr;
+
+	RemoveRequest(request);
+}
+
+void
+TranslationMuxStock::Connection::OnTimeout() noexcept
+{
+	if (requests.empty()) {
+		/* idle for too long */
+		stock.RemoveConnection(*this, {});
+		return;
+	}
+
+	const auto now = GetEventLoop().SteadyNow();
+	const auto &oldest = requests.front();
+	if (now < oldest.send_time + read_timeout) {
+		/* the oldest request has finished meanwhile */
+		ScheduleTimeout();
+		return;
+	}
+
+	const auto error =
+		NestException(std::make_exception_ptr(TimeoutError{}),
+			      std::runtime_error("Translation server timed out"));
+
+	if (last_received <= oldest.send_time) {
+		/* nothing has been received since this request was
+		   sent: the server (or the connection) is stuck, and
+		   all other requests would time out as well */
+		Fail(error);
+		return;
+	}
+
+	/* the server is alive, but the response to this request (and
+	   maybe others) got lost; fail only the expired requests */
+	while (!requests.empty()) {
+		auto &request = requests.front();
+		if (now < request.send_time + read_timeout)
+			break;
+
+		if (current == &request)
+			/* discard the rest of this response frame */
+			current = nullptr;
+
+		RemoveRequest(request);
+		request.Fail(error);
+	}
+}
+
+/*
+ * send requests
+ *
+ */
+
+bool
+TranslationMuxStock::Connection::TryWrite() noexcept
+{
+	while (true) {
+		auto src = output.Read();
+		if (src.empty()) {
+			socket.UnscheduleWrite();
+			return true;
+		}
+
+		ssize_t nbytes = socket.Write(src.data(), src.size());
+		if (gcc_unlikely(nbytes < 0)) {
+			if (gcc_likely(nbytes == WRITE_BLOCKING))
+				return true;
+
+			Fail(std::make_exception_ptr(MakeErrno("write error to translation server")));
+			return false;
+		}
+
+		output.Consume(nbytes);
+
+		if (std::size_t(nbytes) < src.size()) {
+			socket.ScheduleWrite();
+			return true;
+		}
+	}
+}
+
+/*
+ * receive responses
+ *
+ */
+
+inline BufferedResult
+TranslationMuxStock::Connection::Feed(std::span<const std::byte> src) noexcept
+try {
+	while (!src.empty()) {
+		if (frame_remaining == 0) {
+			TranslationMuxHeader header;
+			if (src.size() < sizeof(header))
+				return BufferedResult::MORE;
+
+			memcpy(&header, src.data(), sizeof(header));
+			src = src.subspan(sizeof(header));
+			socket.DisposeConsumed(sizeof(header));
+
+			if (header.length == 0 ||
+			    header.length > TRANSLATION_MUX_MAX_FRAME)
+				throw std::runtime_error("Malformed frame from translation server");
+
+			frame_remaining = header.length;
+
+			/* this is nullptr if the request was canceled */
+			current = FindRequest(header.id);
+			continue;
+		}
+
+		const auto chunk = src.first(std::min(src.size(),
+						      frame_remaining));
+
+		std::size_t nbytes = chunk.size();
+		if (current != nullptr) {
+			nbytes = current->Feed(chunk);
+			if (nbytes == 0) {
+				if (chunk.size() == frame_remaining)
+					throw std::runtime_error("Truncated packet from translation server");
+
+				/* need more data */
+				return BufferedResult::MORE;
+			}
+		}
+
+		src = src.subspan(nbytes);
+		socket.DisposeConsumed(nbytes);
+		frame_remaining -= nbytes;
+
+		if (current == nullptr)
+			continue;
+
+		if (current->Process()) {
+			if (frame_remaining > 0)
+				throw std::runtime_error("Excess data in frame from translation server");
+
+			auto &request = *current;
+			current = nullptr;
+			RemoveRequest(request);
+			request.Finish();
+		} else if (frame_remaining == 0)
+			throw std::runtime_error("Truncated response from translation server");
+	}
+
+	return BufferedResult::OK;
+} catch (...) {
+	Fail(std::current_exception());
+	return BufferedResult::CLOSED;
+}
+
+/*
+ * TranslationMuxStock
+ *
+ */
+
+/**
+ * Create a non-blocking socket and connect it.  The translation
+ * server usually listens on a local socket, where connect() does
+ * not block; for TCP, the connection may still be in progress, and
+ * the #BufferedSocket waits for it to become writable.
+ */
+static UniqueSocketDescriptor
+CreateConnectStreamSocket(const SocketAddress address)
+{
+	UniqueSocketDescriptor fd;
+	if (!fd.CreateNonBlock(address.GetFamily(), SOCK_STREAM, 0))
+		throw MakeErrno("Failed to create socket");
+
+	if (!fd.Connect(address) && errno != EINPROGRESS) {
+		const int e = errno;
+		char buffer[256];
+		ToString(buffer, sizeof(buffer), address);
+		throw FormatErrno(e, "Failed to connect to %s", buffer);
+	}
+
+	return fd;
+}
+
+TranslationMuxStock::TranslationMuxStock(EventLoop &_event_loop,
+					 SocketAddress _address,
+					 unsigned _max_connections) noexcept
+	:event_loop(_event_loop), address(_address),
+	 max_connections(_max_connections)
+{
+	assert(max_connections > 0);
+}
+
+TranslationMuxStock::~TranslationMuxStock() noexcept
+{
+	while (!connections.empty())
+		RemoveConnection(connections.front(),
+				 std::make_exception_ptr(std::runtime_error("Translation service shut down")));
+}
+
+TranslationMuxStock::Connection &
+TranslationMuxStock::GetConnection()
+{
+	Connection *best = nullptr;
+	for (auto &i : connections)
+		if (best == nullptr ||
+		    i.GetRequestCount() < best->GetRequestCount())
+			best = &i;
+
+	if (best != nullptr &&
+	    (best->GetRequestCount() < SPREAD_THRESHOLD ||
+	     n_connections >= max_connections))
+		return *best;
+
+	try {
+		auto fd = CreateConnectStreamSocket(address);
+
+		auto *connection = new Connection(*this, std::move(fd));
+		connections.push_back(*connection);
+		++n_connections;
+		return *connection;
+	} catch (...) {
+		if (best == nullptr)
+			throw;
+
+		/* use the busy connection instead */
+		return *best;
+	}
+}
+
+void
+TranslationMuxStock::RemoveConnection(Connection &connection,
+				      std::exception_ptr error) noexcept
+{
+	connections.erase(connections.iterator_to(connection));
+	--n_connections;
+
+	connection.Destroy(std::move(error));
+}
+
+void
+TranslationMuxStock::SendRequest(AllocatorPtr alloc,
+				 const TranslateRequest &request,
+				 const StopwatchPtr &parent_stopwatch,
+				 TranslateHandler &handler,
+				 CancellablePointer &cancel_ptr) noexcept
+try {
+	StopwatchPtr stopwatch(parent_stopwatch, "translate",
+			       request.GetDiagnosticName());
+
+	GetConnection().SendRequest(alloc, request, std::move(stopwatch),
+				    handler, cancel_ptr);
+} catch (...) {
+	handler.OnTranslateError(std::current_exception());
+}
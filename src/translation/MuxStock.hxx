@@ -0,0 +1,109 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Service.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "util/IntrusiveList.hxx"
+
+#include <cstddef>
+#include <exception>
+
+class EventLoop;
+
+/**
+ * A #TranslationService which sends many requests over a few
+ * long-lived connections to a translation server which supports the
+ * multiplexed protocol (see MuxProtocol.hxx).  Unlike
+ * #TranslationStock, a connection is not leased exclusively to one
+ * request, and responses may arrive in any order.
+ */
+class TranslationMuxStock final : public TranslationService {
+	class Connection;
+	class Request;
+
+	/**
+	 * Open another connection (up to #max_connections) if all
+	 * existing ones have at least this many pending requests.
+	 */
+	static constexpr std::size_t SPREAD_THRESHOLD = 16;
+
+	EventLoop &event_loop;
+
+	const AllocatedSocketAddress address;
+
+	const unsigned max_connections;
+
+	IntrusiveList<Connection> connections;
+
+	unsigned n_connections = 0;
+
+public:
+	TranslationMuxStock(EventLoop &_event_loop, SocketAddress _address,
+			    unsigned _max_connections) noexcept;
+
+	/**
+	 * Closes all connections; pending requests fail.
+	 */
+	~TranslationMuxStock() noexcept;
+
+	TranslationMuxStock(const TranslationMuxStock &) = delete;
+	TranslationMuxStock &operator=(const TranslationMuxStock &) = delete;
+
+	auto &GetEventLoop() const noexcept {
+		return event_loop;
+	}
+
+	/* virtual methods from class TranslationService */
+	void SendRequest(AllocatorPtr alloc,
+			 const TranslateRequest &request,
+			 const StopwatchPtr &parent_stopwatch,
+			 TranslateHandler &handler,
+			 CancellablePointer &cancel_ptr) noexcept override;
+
+private:
+	/**
+	 * Choose the connection with the fewest pending requests,
+	 * and open a new one if all are busy.  Throws if no
+	 * connection exists and connecting fails.
+	 */
+	Connection &GetConnection();
+
+	/**
+	 * Called by #Connection when it has failed or has been idle
+	 * for too long.  Deletes the #Connection; pending requests
+	 * fail with the given error.
+	 */
+	void RemoveConnection(Connection &connection,
+			      std::exception_ptr error) noexcept;
+};
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Replicated.hxx"
+#include "translation/Handler.hxx"
+#include "translation/Request.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "event/Loop.hxx"
+#include "net/FailureManager.hxx"
+#include "net/SocketAddress.hxx"
+#include "pool/LeakDetector.hxx"
+#include "util/Cancellable.hxx"
+#include "AllocatorPtr.hxx"
+#include "stopwatch.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+class ReplicatedTranslationService::Request final
+	: PoolLeakDetector, Cancellable
+{
+	/**
+	 * One request to one replica.
+	 */
+	struct Attempt final : TranslateHandler {
+		Request &request;
+
+		/**
+		 * The replica handling this attempt; nullptr if
+		 * this attempt is not running.
+		 */
+		Replica *replica = nullptr;
+
+		Event::TimePoint start_time;
+
+		CancellablePointer cancel_ptr;
+
+		explicit Attempt(Request &_request) noexcept
+			:request(_request) {}
+
+		bool IsRunning() const noexcept {
+			return replica != nullptr;
+		}
+
+		void Start(Replica &_replica) noexcept {
+			assert(!IsRunning());
+
+			replica = &_replica;
+			++replica->pending;
+			start_time = request.service.event_loop.SteadyNow();
+
+			/* this may finish (and destroy the
+			   #Request) synchronously */
+			replica->service->SendRequest(request.alloc,
+						      request.request,
+						      request.stopwatch,
+						      *this, cancel_ptr);
+		}
+
+		/**
+		 * Mark this attempt as finished.
+		 *
+		 * @return the replica which handled it and the
+		 * time it took
+		 */
+		std::pair<Replica &, Event::Duration> Finish() noexcept {
+			assert(IsRunning());
+
+			auto &r = *replica;
+			replica = nullptr;
+			--r.pending;
+
+			return {r, request.service.event_loop.SteadyNow() - start_time};
+		}
+
+		/**
+		 * Cancel this attempt because another one has
+		 * won.
+		 */
+		void Abandon() noexcept {
+			cancel_ptr.Cancel();
+
+			/* the replica took at least this long; this
+			   makes sure a replica which never wins
+			   does not keep its old (low) latency
+			   average */
+			auto [r, duration] = Finish();
+			r.AddLatency(duration);
+		}
+
+		/* virtual methods from TranslateHandler */
+		void OnTranslateResponse(TranslateResponse &response) noexcept override {
+			request.OnAttemptResponse(*this, response);
+		}
+
+		void OnTranslateError(std::exception_ptr error) noexcept override {
+			request.OnAttemptError(*this, std::move(error));
+		}
+	};
+
+	ReplicatedTranslationService &service;
+
+	const AllocatorPtr alloc;
+
+	/**
+	 * A copy of the caller's request.  The hedged attempt may be
+	 * started after SendRequest() has returned, so this must not
+	 * refer to an object the caller may have allocated on its
+	 * stack.
+	 */
+	const TranslateRequest request;
+
+	/**
+	 * Our own span; the caller's #StopwatchPtr is usually a
+	 * temporary.
+	 */
+	const StopwatchPtr stopwatch;
+
+	TranslateHandler &handler;
+
+	FineTimerEvent hedge_timer;
+
+	Attempt primary{*this}, hedge{*this};
+
+	/**
+	 * Has the second attempt been started (either as a hedged
+	 * request or because the primary one has failed)?
+	 */
+	bool hedged = false;
+
+public:
+	Request(ReplicatedTranslationService &_service,
+		AllocatorPtr _alloc, const TranslateRequest &_request,
+		const StopwatchPtr &_parent_stopwatch,
+		TranslateHandler &_handler,
+		CancellablePointer &caller_cancel_ptr) noexcept
+		:PoolLeakDetector(_alloc),
+		 service(_service),
+		 alloc(_alloc),
+		 request(_request),
+		 stopwatch(_parent_stopwatch, "replicated_translate"),
+		 handler(_handler),
+		 hedge_timer(service.event_loop, BIND_THIS_METHOD(OnHedgeTimer))
+	{
+		caller_cancel_ptr = *this;
+	}
+
+	void Start(Replica &replica) noexcept {
+		hedge_timer.Schedule(service.hedge_delay);
+		primary.Start(replica);
+	}
+
+private:
+	void Destroy() noexcept {
+		this->~Request();
+	}
+
+	Attempt &GetOther(const Attempt &attempt) noexcept {
+		return &attempt == &primary ? hedge : primary;
+	}
+
+	void OnHedgeTimer() noexcept {
+		assert(!hedged);
+		assert(primary.IsRunning());
+
+		hedged = true;
+		stopwatch.RecordEvent("hedge");
+
+		if (auto *replica = service.Pick(primary.replica))
+			hedge.Start(*replica);
+	}
+
+	void OnAttemptResponse(Attempt &attempt,
+			       TranslateResponse &response) noexcept;
+	void OnAttemptError(Attempt &attempt,
+			    std::exception_ptr error) noexcept;
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		if (primary.IsRunning())
+			primary.Abandon();
+		if (hedge.IsRunning())
+			hedge.Abandon();
+
+		Destroy();
+	}
+};
+
+void
+ReplicatedTranslationService::Request::OnAttemptResponse(Attempt &attempt,
+							 TranslateResponse &response) noexcept
+{
+	auto [replica, latency] = attempt.Finish();
+	service.OnSuccess(replica, latency);
+
+	if (auto &other = GetOther(attempt); other.IsRunning())
+		other.Abandon();
+
+	auto &_handler = handler;
+	Destroy();
+	_handler.OnTranslateResponse(response);
+}
+
+void
+ReplicatedTranslationService::Request::OnAttemptError(Attempt &attempt,
+						      std::exception_ptr error) noexcept
+{
+	auto &replica = attempt.Finish().first;
+	service.OnFailure(replica);
+
+	if (GetOther(attempt).IsRunning())
+		/* wait for the other one */
+		return;
+
+	if (!hedged) {
+		/* fail over to another replica right away */
+		hedged = true;
+		hedge_timer.Cancel();
+
+		if (auto *next = service.Pick(&replica)) {
+			hedge.Start(*next);
+			return;
+		}
+	}
+
+	auto &_handler = handler;
+	Destroy();
+	_handler.OnTranslateError(std::move(error));
+}
+
+inline double
+ReplicatedTranslationService::Replica::GetScore() const noexcept
+{
+	/* add a millisecond so replicas without samples are not
+	   all equally "free" regardless of their load */
+	return (latency + 0.001) * (pending + 1);
+}
+
+inline void
+ReplicatedTranslationService::Replica::AddLatency(Event::Duration d) noexcept
+{
+	const double s = std::chrono::duration<double>(d).count();
+	if (latency > 0)
+		latency += (s - latency) * LATENCY_ALPHA;
+	else
+		latency = s;
+}
+
+ReplicatedTranslationService::ReplicatedTranslationService(EventLoop &_event_loop,
+							   FailureManager &_failure_manager) noexcept
+	:event_loop(_event_loop), failure_manager(_failure_manager)
+{
+}
+
+ReplicatedTranslationService::~ReplicatedTranslationService() noexcept = default;
+
+void
+ReplicatedTranslationService::AddReplica(SocketAddress address,
+					 std::shared_ptr<TranslationService> service) noexcept
+{
+	replicas.emplace_back(std::move(service),
+			      failure_manager.Make(address));
+}
+
+ReplicatedTranslationService::Replica *
+ReplicatedTranslationService::Pick(const Replica *except) noexcept
+{
+	const Expiry now = event_loop.SteadyNow();
+
+	Replica *best = nullptr;
+	bool best_ok = false;
+
+	for (auto &i : replicas) {
+		if (&i == except)
+			continue;
+
+		const bool ok = i.failure->Check(now);
+		if (best == nullptr || (ok && !best_ok) ||
+		    (ok == best_ok && i.GetScore() < best->GetScore())) {
+			best = &i;
+			best_ok = ok;
+		}
+	}
+
+	return best;
+}
+
+void
+ReplicatedTranslationService::OnSuccess(Replica &replica,
+					Event::Duration latency) noexcept
+{
+	replica.AddLatency(latency);
+	replica.failure->UnsetConnect();
+
+	samples[next_sample] = latency;
+	next_sample = (next_sample + 1) % samples.size();
+	if (n_samples < samples.size())
+		++n_samples;
+
+	if (++new_samples >= 16 && n_samples >= 32)
+		UpdateHedgeDelay();
+}
+
+void
+ReplicatedTranslationService::OnFailure(Replica &replica) noexcept
+{
+	replica.failure->SetConnect(event_loop.SteadyNow(), FAILURE_DURATION);
+}
+
+void
+ReplicatedTranslationService::UpdateHedgeDelay() noexcept
+{
+	new_samples = 0;
+
+	auto copy = samples;
+	const auto end = std::next(copy.begin(), n_samples);
+	const auto nth = std::next(copy.begin(),
+				   std::size_t(n_samples * HEDGE_PERCENTILE));
+	std::nth_element(copy.begin(), nth, end);
+
+	hedge_delay = std::clamp(*nth, MIN_HEDGE_DELAY, MAX_HEDGE_DELAY);
+}
+
+void
+ReplicatedTranslationService::SendRequest(AllocatorPtr alloc,
+					  const TranslateRequest &request,
+					  const StopwatchPtr &parent_stopwatch,
+					  TranslateHandler &handler,
+					  CancellablePointer &cancel_ptr) noexcept
+{
+	assert(!replicas.empty());
+
+	auto *replica = Pick();
+	assert(replica != nullptr);
+
+	auto *r = alloc.New<Request>(*this, alloc, request, parent_stopwatch,
+				     handler, cancel_ptr);
+	r->Start(*replica);
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Service.hxx"
+#include "event/Chrono.hxx"
+#include "net/FailureRef.hxx"
+
+#include <array>
+#include <list>
+#include <memory>
+
+class EventLoop;
+class FailureManager;
+class SocketAddress;
+
+/**
+ * Wrapper for multiple equivalent #TranslationService instances
+ * (replicas of the same translation server).  Each request is sent
+ * to the replica with the lowest expected latency; if it does not
+ * respond within a delay derived from recent latencies, a "hedged"
+ * duplicate request is sent to another replica, and whichever
+ * response arrives first is used.
+ */
+class ReplicatedTranslationService final : public TranslationService {
+	class Request;
+
+	struct Replica {
+		std::shared_ptr<TranslationService> service;
+
+		FailureRef failure;
+
+		/**
+		 * Exponentially weighted moving average of the
+		 * response latency [seconds]; 0 if unknown.
+		 */
+		double latency = 0;
+
+		/**
+		 * The number of requests currently being handled by
+		 * this replica.
+		 */
+		unsigned pending = 0;
+
+		Replica(std::shared_ptr<TranslationService> &&_service,
+			ReferencedFailureInfo &_failure) noexcept
+			:service(std::move(_service)), failure(_failure) {}
+
+		/**
+		 * Lower is better.
+		 */
+		[[gnu::pure]]
+		double GetScore() const noexcept;
+
+		void AddLatency(Event::Duration d) noexcept;
+	};
+
+	/**
+	 * Weight of a new sample in #Replica::latency.
+	 */
+	static constexpr double LATENCY_ALPHA = 0.2;
+
+	/**
+	 * The percentile of recent latencies after which a hedged
+	 * request is sent.
+	 */
+	static constexpr double HEDGE_PERCENTILE = 0.95;
+
+	static constexpr Event::Duration MIN_HEDGE_DELAY =
+		std::chrono::milliseconds{5};
+	static constexpr Event::Duration MAX_HEDGE_DELAY =
+		std::chrono::seconds{2};
+
+	/**
+	 * The hedge delay used until enough samples have been
+	 * collected.
+	 */
+	static constexpr Event::Duration DEFAULT_HEDGE_DELAY =
+		std::chrono::milliseconds{100};
+
+	/**
+	 * How long a replica is avoided after it has failed.
+	 */
+	static constexpr std::chrono::seconds FAILURE_DURATION{20};
+
+	EventLoop &event_loop;
+
+	FailureManager &failure_manager;
+
+	std::list<Replica> replicas;
+
+	/**
+	 * A ring buffer of recent response latencies of all replicas.
+	 */
+	std::array<Event::Duration, 128> samples;
+	std::size_t n_samples = 0, next_sample = 0;
+
+	/**
+	 * The number of samples added since #hedge_delay was
+	 * calculated.
+	 */
+	std::size_t new_samples = 0;
+
+	Event::Duration hedge_delay = DEFAULT_HEDGE_DELAY;
+
+public:
+	ReplicatedTranslationService(EventLoop &_event_loop,
+				     FailureManager &_failure_manager) noexcept;
+	~ReplicatedTranslationService() noexcept;
+
+	ReplicatedTranslationService(const ReplicatedTranslationService &) = delete;
+	ReplicatedTranslationService &operator=(const ReplicatedTranslationService &) = delete;
+
+	/**
+	 * @param address the address of this replica; used to look
+	 * up its #FailureInfo
+	 */
+	void AddReplica(SocketAddress address,
+			std::shared_ptr<TranslationService> service) noexcept;
+
+	Event::Duration GetHedgeDelay() const noexcept {
+		return hedge_delay;
+	}
+
+	/* virtual methods from class TranslationService */
+	void SendRequest(AllocatorPtr alloc,
+			 const TranslateRequest &request,
+			 const StopwatchPtr &parent_stopwatch,
+			 TranslateHandler &handler,
+			 CancellablePointer &cancel_ptr) noexcept override;
+
+private:
+	/**
+	 * Choose the best replica which is not @a except.  Replicas
+	 * which have failed recently are only chosen if there is no
+	 * other.
+	 *
+	 * @return nullptr if there is no replica other than @a except
+	 */
+	Replica *Pick(const Replica *except=nullptr) noexcept;
+
+	void OnSuccess(Replica &replica, Event::Duration latency) noexcept;
+	void OnFailure(Replica &replica) noexcept;
+
+	void UpdateHedgeDelay() noexcept;
+};
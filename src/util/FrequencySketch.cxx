@@ -0,0 +1,108 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FrequencySketch.hxx"
+
+#include <algorithm>
+#include <bit>
+
+static constexpr uint64_t seeds[] = {
+	0xc3a5c85c97cb3127ULL,
+	0xb492b66fbe98f273ULL,
+	0x9ae16a3b2f90404fULL,
+	0xcbf29ce484222325ULL,
+};
+
+/**
+ * Calculate the position (word index and counter shift) of one of
+ * the four counters of a key.
+ */
+static constexpr std::pair<std::size_t, unsigned>
+CounterPosition(std::size_t hash, unsigned i, std::size_t mask) noexcept
+{
+	uint64_t h = (uint64_t(hash) + seeds[i]) * seeds[i];
+	h ^= h >> 32;
+	return {std::size_t(h) & mask, unsigned(h >> 60) * 4};
+}
+
+FrequencySketch::FrequencySketch(std::size_t capacity) noexcept
+	:table(new uint64_t[std::bit_ceil(std::max<std::size_t>(capacity, 16))]()),
+	 mask(std::bit_ceil(std::max<std::size_t>(capacity, 16)) - 1),
+	 sample_size(10 * (mask + 1))
+{
+}
+
+void
+FrequencySketch::Increment(std::size_t hash) noexcept
+{
+	bool incremented = false;
+
+	for (unsigned i = 0; i < 4; ++i) {
+		const auto [index, shift] = CounterPosition(hash, i, mask);
+		if (((table[index] >> shift) & 0xf) < MAX_FREQUENCY) {
+			table[index] += uint64_t(1) << shift;
+			incremented = true;
+		}
+	}
+
+	if (incremented && ++additions >= sample_size)
+		Reset();
+}
+
+unsigned
+FrequencySketch::Estimate(std::size_t hash) const noexcept
+{
+	unsigned result = MAX_FREQUENCY;
+
+	for (unsigned i = 0; i < 4; ++i) {
+		const auto [index, shift] = CounterPosition(hash, i, mask);
+		result = std::min(result, unsigned((table[index] >> shift) & 0xf));
+	}
+
+	return result;
+}
+
+void
+FrequencySketch::Clear() noexcept
+{
+	std::fill_n(table.get(), mask + 1, 0);
+	additions = 0;
+}
+
+void
+FrequencySketch::Reset() noexcept
+{
+	for (std::size_t i = 0; i <= mask; ++i)
+		table[i] = (table[i] >> 1) & 0x7777777777777777ULL;
+
+	additions /= 2;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * A compact approximation of the access frequency of many keys, used
+ * for TinyLFU admission decisions: a count-min sketch with four 4-bit
+ * counters per key.  After a number of increments, all counters are
+ * halved, so old popularity fades away.
+ *
+ * The caller passes a hash of the key; the sketch never sees the
+ * key itself.
+ */
+class FrequencySketch {
+	/**
+	 * Each word holds 16 counters of 4 bits.
+	 */
+	std::unique_ptr<uint64_t[]> table;
+
+	const std::size_t mask;
+
+	/**
+	 * After this many increments, all counters are halved.
+	 */
+	const std::size_t sample_size;
+
+	std::size_t additions = 0;
+
+public:
+	static constexpr unsigned MAX_FREQUENCY = 15;
+
+	/**
+	 * @param capacity the approximate number of distinct keys
+	 * which shall be tracked
+	 */
+	explicit FrequencySketch(std::size_t capacity) noexcept;
+
+	FrequencySketch(const FrequencySketch &) = delete;
+	FrequencySketch &operator=(const FrequencySketch &) = delete;
+
+	void Increment(std::size_t hash) noexcept;
+
+	/**
+	 * Returns the estimated frequency (0 to #MAX_FREQUENCY).
+	 */
+	[[gnu::pure]]
+	unsigned Estimate(std::size_t hash) const noexcept;
+
+	void Clear() noexcept;
+
+private:
+	/**
+	 * Halve all counters.
+	 */
+	void Reset() noexcept;
+};
@@ -34,6 +34,7 @@
 #include "Map.hxx"
 #include "Output.hxx"
 #include "Input.hxx"
+#include "Shm.hxx"
 #include "Lease.hxx"
 #include "was/async/Control.hxx"
 #include "was/async/Error.hxx"
@@ -72,6 +73,11 @@ class WasClient final
 
 	WasLease &lease;
 
+	/**
+	 * The shared memory segment of this WAS connection (optional).
+	 */
+	WasShm *const shm;
+
 	Was::Control control;
 
 	HttpResponseHandler &handler;
@@ -87,9 +93,28 @@ class WasClient final
 	FineTimerEvent submit_response_timer;
 
 	struct Request {
+		/**
+		 * Is the request body transported over the
+		 * #WasShm ring?  This is only possible after the
+		 * application has attached it.
+		 */
+		const bool shm;
+
 		WasOutput *body;
 
-		explicit Request(WasOutput *_body):body(_body) {}
+		Request(struct pool &pool, EventLoop &event_loop,
+			FileDescriptor fd, WasShm *_shm,
+			UnusedIstreamPtr &&_body,
+			WasOutputHandler &_handler) noexcept
+			:shm(_body && _shm != nullptr && _shm->IsAttached()),
+			 body(!_body
+			      ? nullptr
+			      : shm
+			      ? was_output_new(pool, event_loop,
+					       _shm->GetRequestRing(),
+					       std::move(_body), _handler)
+			      : was_output_new(pool, event_loop, fd,
+					       std::move(_body), _handler)) {}
 
 		void ClearBody() {
 			if (body != nullptr)
@@ -160,6 +185,7 @@ public:
 		  StopwatchPtr &&_stopwatch,
 		  SocketDescriptor control_fd,
 		  FileDescriptor input_fd, FileDescriptor output_fd,
+		  WasShm *_shm,
 		  WasLease &_lease,
 		  http_method_t method, UnusedIstreamPtr body,
 		  HttpResponseHandler &_handler,
@@ -613,6 +639,25 @@ WasClient::OnWasControlPacket(enum was_command cmd,
 			return false;
 		}
 
+		if (!payload.empty()) {
+			if (shm == nullptr || payload.size() != 1 ||
+			    payload.front() != WAS_SHM_DATA) {
+				stopwatch.RecordEvent("control_error");
+				AbortResponseHeaders(std::make_exception_ptr(WasProtocolError("malformed DATA packet")));
+				return false;
+			}
+
+			/* the response body will be transported over
+			   the shared memory ring; the WasInput has not
+			   been enabled yet, so it can simply be
+			   replaced */
+			was_input_free_unused(response.body);
+			response.body = was_input_new(caller_pool,
+						      control.GetEventLoop(),
+						      shm->GetResponseRing(),
+						      *this);
+		}
+
 		response.pending = true;
 		break;
 
@@ -852,6 +897,7 @@ WasClient::WasClient(struct pool &_pool, struct pool &_caller_pool,
 		     StopwatchPtr &&_stopwatch,
 		     SocketDescriptor control_fd,
 		     FileDescriptor input_fd, FileDescriptor output_fd,
+		     WasShm *_shm,
 		     WasLease &_lease,
 		     http_method_t method, UnusedIstreamPtr body,
 		     HttpResponseHandler &_handler,
@@ -860,14 +906,12 @@ WasClient::WasClient(struct pool &_pool, struct pool &_caller_pool,
 	 alloc(_pool), caller_pool(_caller_pool),
 	 stopwatch(std::move(_stopwatch)),
 	 lease(_lease),
+	 shm(_shm),
 	 control(event_loop, control_fd, *this),
 	 handler(_handler),
 	 submit_response_timer(event_loop,
 			       BIND_THIS_METHOD(OnSubmitResponseTimer)),
-	 request(body
-		 ? was_output_new(_pool, event_loop, output_fd,
-				  std::move(body), *this)
-		 : nullptr),
+	 request(_pool, event_loop, output_fd, shm, std::move(body), *this),
 	 response(http_method_is_empty(method)
 		  ? nullptr
 		  : was_input_new(_pool, event_loop, input_fd, *this))
@@ -882,6 +926,7 @@ SendRequest(Was::Control &control,
 	    const char *script_name, const char *path_info,
 	    const char *query_string,
 	    const StringMap &headers, WasOutput *request_body,
+	    bool request_shm,
 	    std::span<const char *const> params)
 {
 	const uint32_t method32 = (uint32_t)method;
@@ -900,9 +945,12 @@ SendRequest(Was::Control &control,
 		control.SendArray(WAS_COMMAND_PARAMETER, params) &&
 		(remote_host == nullptr ||
 		 control.SendString(WAS_COMMAND_REMOTE_HOST, remote_host)) &&
-		control.SendEmpty(request_body != nullptr
-				  ? WAS_COMMAND_DATA
-				  : WAS_COMMAND_NO_DATA) &&
+		(request_body == nullptr
+		 ? control.SendEmpty(WAS_COMMAND_NO_DATA)
+		 : request_shm
+		 ? control.Send(WAS_COMMAND_DATA,
+				&WAS_SHM_DATA, sizeof(WAS_SHM_DATA))
+		 : control.SendEmpty(WAS_COMMAND_DATA)) &&
 		(request_body == nullptr || was_output_check_length(*request_body));
 }
 
@@ -917,7 +965,8 @@ WasClient::SendRequest(const char *remote_host,
 	::SendRequest(control,
 		      remote_host,
 		      method, uri, script_name, path_info,
-		      query_string, headers, request.body,
+		      query_string, headers,
+		      request.body, request.shm,
 		      params);
 }
 
@@ -926,6 +975,7 @@ was_client_request(struct pool &caller_pool, EventLoop &event_loop,
 		   StopwatchPtr stopwatch,
 		   SocketDescriptor control_fd,
 		   FileDescriptor input_fd, FileDescriptor output_fd,
+		   WasShm *shm,
 		   WasLease &lease,
 		   const char *remote_host,
 		   http_method_t method, const char *uri,
@@ -942,7 +992,7 @@ was_client_request(struct pool &caller_pool, EventLoop &event_loop,
 	auto client = NewFromPool<WasClient>(caller_pool, caller_pool, caller_pool,
 					     event_loop, std::move(stopwatch),
 					     control_fd, input_fd, output_fd,
-					     lease, method, std::move(body),
+					     shm, lease, method, std::move(body),
 					     handler, cancel_ptr);
 	client->SendRequest(remote_host,
 			    method, uri, script_name, path_info,
@@ -43,6 +43,7 @@ class SocketDescriptor;
 class EventLoop;
 class UnusedIstreamPtr;
 class WasLease;
+class WasShm;
 class StringMap;
 class HttpResponseHandler;
 class CancellablePointer;
@@ -58,6 +59,8 @@ class CancellablePointer;
  * @param control_fd a control socket to the WAS server
  * @param input_fd a data pipe for the response body
  * @param output_fd a data pipe for the request body
+ * @param shm an optional shared memory segment which may be used
+ * instead of the pipes
  * @param lease the lease for both sockets
  * @param method the HTTP request method
  * @param uri the request URI path
@@ -75,6 +78,7 @@ was_client_request(struct pool &pool, EventLoop &event_loop,
 		   StopwatchPtr stopwatch,
 		   SocketDescriptor control_fd,
 		   FileDescriptor input_fd, FileDescriptor output_fd,
+		   WasShm *shm,
 		   WasLease &lease,
 		   const char *remote_host,
 		   http_method_t method, const char *uri,
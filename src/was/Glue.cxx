@@ -156,6 +156,7 @@ WasRequest::OnStockItemReady(StockItem &item) noexcept
 			   std::move(stopwatch),
 			   process.control,
 			   process.input, process.output,
+			   connection->GetShm(),
 			   *this,
 			   remote_host,
 			   pending_request.method, pending_request.uri,
@@ -85,6 +85,13 @@ WasIdleConnection::DiscardControl(size_t size)
 inline void
 WasIdleConnection::DiscardInput(uint64_t remaining)
 {
+	if (shm.IsDefined())
+		/* if the response body was transported over the
+		   ring, all of it is already there (the application
+		   copies everything before sending PREMATURE); if it
+		   was transported over the pipe, the ring is empty */
+		remaining -= shm.GetResponseRing().Discard(remaining);
+
 	while (remaining > 0) {
 		uint8_t buffer[16384];
 		size_t size = std::min(remaining, uint64_t(sizeof(buffer)));
@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include "Shm.hxx"
 #include "was/async/Socket.hxx"
 #include "event/SocketEvent.hxx"
 
@@ -55,6 +56,12 @@ public:
 class WasIdleConnection {
 	WasSocket socket;
 
+	/**
+	 * The optional shared memory segment which may replace the
+	 * pipes.
+	 */
+	WasShm shm;
+
 	SocketEvent event;
 
 	WasIdleConnectionHandler &handler;
@@ -83,10 +90,23 @@ public:
 		event.Open(socket.control);
 	}
 
+	void Open(WasSocket &&_socket, WasShm &&_shm) noexcept {
+		Open(std::move(_socket));
+		shm = std::move(_shm);
+	}
+
 	const auto &GetSocket() const noexcept {
 		return socket;
 	}
 
+	/**
+	 * @return the shared memory segment or nullptr if this
+	 * connection does not have one
+	 */
+	WasShm *GetShm() noexcept {
+		return shm.IsDefined() ? &shm : nullptr;
+	}
+
 	void Stop(uint64_t _received) noexcept {
 		assert(!stopping);
 
@@ -133,7 +153,8 @@ private:
 	void DiscardControl(size_t size);
 
 	/**
-	 * Discard the given amount of data from the input pipe.
+	 * Discard the given amount of data from the input pipe (or
+	 * from the shared memory ring).
 	 *
 	 * Throws on error.
 	 */
@@ -31,6 +31,7 @@
  */
 
 #include "Input.hxx"
+#include "Shm.hxx"
 #include "was/async/Error.hxx"
 #include "event/PipeEvent.hxx"
 #include "event/DeferEvent.hxx"
@@ -58,6 +59,13 @@ class WasInput final : Istream {
 
 	WasInputHandler &handler;
 
+	/**
+	 * If set, then the body is transported over this shared
+	 * memory ring instead of the pipe, and #event watches the
+	 * ring's "data" eventfd.
+	 */
+	WasShmRing *const ring;
+
 	SliceFifoBuffer buffer;
 
 	uint64_t received = 0, length;
@@ -74,7 +82,16 @@ public:
 		:Istream(p),
 		 event(event_loop, BIND_THIS_METHOD(EventCallback), fd),
 		 defer_read(event_loop, BIND_THIS_METHOD(OnDeferredRead)),
-		 handler(_handler) {
+		 handler(_handler), ring(nullptr) {
+	}
+
+	WasInput(struct pool &p, EventLoop &event_loop, WasShmRing &_ring,
+		 WasInputHandler &_handler) noexcept
+		:Istream(p),
+		 event(event_loop, BIND_THIS_METHOD(EventCallback),
+		       _ring.GetDataEvent()),
+		 defer_read(event_loop, BIND_THIS_METHOD(OnDeferredRead)),
+		 handler(_handler), ring(&_ring) {
 	}
 
 	void Free(std::exception_ptr ep) noexcept;
@@ -142,7 +159,13 @@ private:
 		assert(HasPipe());
 		assert(!buffer.IsDefined() || !buffer.IsFull());
 
-		event.ScheduleRead();
+		if (ring != nullptr && !ring->PrepareRead())
+			/* the producer won't signal the eventfd
+			   because the ring is not empty; just read
+			   again in the next iteration */
+			defer_read.Schedule();
+		else
+			event.ScheduleRead();
 	}
 
 	void CancelRead() noexcept {
@@ -218,6 +241,16 @@ private:
 	 */
 	void ReadToBuffer();
 
+	/**
+	 * Copy data from the shared memory ring.
+	 *
+	 * Throws #WasProtocolError if the ring is corrupt.
+	 *
+	 * @return the number of bytes copied; 0 if the ring is empty
+	 * (and the "data" eventfd has been scheduled)
+	 */
+	std::size_t ReadRingToBuffer(std::size_t max_length);
+
 	bool TryBuffered() noexcept;
 	bool TryDirect() noexcept;
 
@@ -236,7 +269,9 @@ private:
 	/* virtual methods from class Istream */
 
 	void _SetDirect(FdTypeMask mask) noexcept override {
-		direct = (mask & ISTREAM_TO_PIPE) != 0;
+		/* there is no file descriptor to splice() from if the
+		   body is transported over the shared memory ring */
+		direct = ring == nullptr && (mask & ISTREAM_TO_PIPE) != 0;
 	}
 
 	off_t _GetAvailable(bool partial) noexcept override {
@@ -287,6 +322,16 @@ WasInput::ReadToBuffer()
 
 	buffer.AllocateIfNull(fb_pool_get());
 
+	if (ring != nullptr) {
+		received += ReadRingToBuffer(max_length);
+
+		if (buffer.IsFull())
+			CancelRead();
+		else
+			buffer.FreeIfEmpty();
+		return;
+	}
+
 	ssize_t nbytes = ::ReadToBuffer(GetPipe(), buffer, max_length);
 	assert(nbytes != -2);
 
@@ -311,6 +356,24 @@ WasInput::ReadToBuffer()
 		CancelRead();
 }
 
+std::size_t
+WasInput::ReadRingToBuffer(std::size_t max_length)
+{
+	auto w = buffer.Write();
+	if (w.size() > max_length)
+		w = w.first(max_length);
+
+	const std::size_t nbytes = ring->ReadTo(w);
+	if (nbytes == 0) {
+		if (!w.empty())
+			ScheduleRead();
+		return 0;
+	}
+
+	buffer.Append(nbytes);
+	return nbytes;
+}
+
 inline bool
 WasInput::TryBuffered() noexcept
 {
@@ -392,6 +455,9 @@ WasInput::EventCallback(unsigned) noexcept
 {
 	assert(HasPipe());
 
+	if (ring != nullptr)
+		WasShmRing::DrainEvent(GetPipe());
+
 	TryRead();
 }
 
@@ -418,6 +484,14 @@ was_input_new(struct pool &pool, EventLoop &event_loop, FileDescriptor fd,
 				     handler);
 }
 
+WasInput *
+was_input_new(struct pool &pool, EventLoop &event_loop, WasShmRing &ring,
+	      WasInputHandler &handler) noexcept
+{
+	return NewFromPool<WasInput>(pool, pool, event_loop, ring,
+				     handler);
+}
+
 inline void
 WasInput::Free(std::exception_ptr ep) noexcept
 {
@@ -507,6 +581,14 @@ WasInput::PrematureThrow(uint64_t _length)
 
 	uint64_t remaining = _length - received;
 
+	if (ring != nullptr) {
+		/* the peer has copied all of it into the ring before
+		   sending PREMATURE */
+		if (ring->Discard(remaining) != remaining)
+			throw WasProtocolError("announced premature length is too large");
+		return;
+	}
+
 	while (remaining > 0) {
 		uint8_t discard_buffer[4096];
 		std::size_t size = std::min(remaining, uint64_t(sizeof(discard_buffer)));
@@ -41,6 +41,7 @@ class FileDescriptor;
 class EventLoop;
 class UnusedIstreamPtr;
 class WasInput;
+class WasShmRing;
 
 class WasInputHandler {
 public:
@@ -93,6 +94,14 @@ WasInput *
 was_input_new(struct pool &pool, EventLoop &event_loop, FileDescriptor fd,
 	      WasInputHandler &handler) noexcept;
 
+/**
+ * Like was_input_new(), but receive the body from a shared memory
+ * ring instead of a pipe.
+ */
+WasInput *
+was_input_new(struct pool &pool, EventLoop &event_loop, WasShmRing &ring,
+	      WasInputHandler &handler) noexcept;
+
 /**
  * @param error the error reported to the istream handler
  */
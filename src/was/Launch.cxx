@@ -68,7 +68,8 @@ was_launch(SpawnService &spawn_service,
 	   const char *executable_path,
 	   std::span<const char *const> args,
 	   const ChildOptions &options,
-	   UniqueFileDescriptor stderr_fd)
+	   UniqueFileDescriptor stderr_fd,
+	   bool shm)
 {
 	auto s = WasSocket::CreatePair();
 
@@ -76,6 +77,14 @@ was_launch(SpawnService &spawn_service,
 	process.input.SetNonBlocking();
 	process.output.SetNonBlocking();
 
+	if (shm) {
+		/* the offer must be the first packet on the control
+		   socket, so send it before the child gets a chance
+		   to run */
+		process.shm = WasShm::Create();
+		process.shm.Offer(process.control);
+	}
+
 	process.handle = WasLaunch(spawn_service, name, executable_path, args,
 				   options, std::move(stderr_fd),
 				   std::move(s.second));
@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include "Shm.hxx"
 #include "was/async/Socket.hxx"
 #include "spawn/ProcessHandle.hxx"
 
@@ -45,6 +46,12 @@ struct ChildOptions;
 struct WasProcess : WasSocket {
 	std::unique_ptr<ChildProcessHandle> handle;
 
+	/**
+	 * The shared memory segment offered to the child process
+	 * (optional).
+	 */
+	WasShm shm;
+
 	WasProcess() = default;
 
 	explicit WasProcess(WasSocket &&_socket) noexcept
@@ -55,6 +62,9 @@ struct WasProcess : WasSocket {
  * Launch WAS child processes.
  *
  * Throws std::runtime_error on error.
+ *
+ * @param shm offer a shared memory segment (#WasShm) to the child
+ * process, which it may use instead of the data pipes
  */
 WasProcess
 was_launch(SpawnService &spawn_service,
@@ -62,4 +72,5 @@ was_launch(SpawnService &spawn_service,
 	   const char *executable_path,
 	   std::span<const char *const> args,
 	   const ChildOptions &options,
-	   UniqueFileDescriptor stderr_fd);
+	   UniqueFileDescriptor stderr_fd,
+	   bool shm);
@@ -31,6 +31,7 @@
  */
 
 #include "Output.hxx"
+#include "Shm.hxx"
 #include "was/async/Error.hxx"
 #include "event/PipeEvent.hxx"
 #include "event/DeferEvent.hxx"
@@ -64,6 +65,13 @@ class WasOutput final : PoolLeakDetector, IstreamSink, DestructAnchor {
 
 	WasOutputHandler &handler;
 
+	/**
+	 * If set, then the body is transported over this shared
+	 * memory ring instead of the pipe, and #event watches the
+	 * ring's "space" eventfd.
+	 */
+	WasShmRing *const ring;
+
 	uint64_t sent = 0;
 
 	uint64_t total_length;
@@ -81,13 +89,27 @@ public:
 		 event(event_loop, BIND_THIS_METHOD(WriteEventCallback), fd),
 		 defer_write(event_loop, BIND_THIS_METHOD(OnDeferredWrite)),
 		 timeout_event(event_loop, BIND_THIS_METHOD(OnTimeout)),
-		 handler(_handler)
+		 handler(_handler), ring(nullptr)
 	{
 		input.SetDirect(ISTREAM_TO_PIPE);
 
 		defer_write.Schedule();
 	}
 
+	WasOutput(struct pool &pool, EventLoop &event_loop, WasShmRing &_ring,
+		  UnusedIstreamPtr _input,
+		  WasOutputHandler &_handler) noexcept
+		:PoolLeakDetector(pool),
+		 IstreamSink(std::move(_input)),
+		 event(event_loop, BIND_THIS_METHOD(WriteEventCallback),
+		       _ring.GetSpaceEvent()),
+		 defer_write(event_loop, BIND_THIS_METHOD(OnDeferredWrite)),
+		 timeout_event(event_loop, BIND_THIS_METHOD(OnTimeout)),
+		 handler(_handler), ring(&_ring)
+	{
+		defer_write.Schedule();
+	}
+
 	uint64_t Close() noexcept {
 		const auto _sent = sent;
 		Destroy();
@@ -138,10 +160,37 @@ private:
 	}
 
 	void ScheduleWrite() noexcept {
-		event.ScheduleWrite();
+		if (ring == nullptr)
+			event.ScheduleWrite();
+		else if (ring->PrepareWrite())
+			/* the ring is full; the consumer will signal
+			   the eventfd after it has freed some
+			   space */
+			event.ScheduleRead();
+		else
+			defer_write.Schedule();
+
 		timeout_event.Schedule(was_output_timeout);
 	}
 
+	void CancelWrite() noexcept {
+		if (ring == nullptr)
+			event.CancelWrite();
+		else
+			event.CancelRead();
+	}
+
+	/**
+	 * Write to the pipe or to the shared memory ring.
+	 *
+	 * Throws #WasProtocolError if the shared memory ring is
+	 * corrupt.
+	 *
+	 * @return the number of bytes written or -1 with errno set
+	 * (EAGAIN if the ring is full)
+	 */
+	ssize_t WriteV(std::span<const struct iovec> v);
+
 	void WriteEventCallback(unsigned events) noexcept;
 	void OnDeferredWrite() noexcept;
 
@@ -187,6 +236,9 @@ WasOutput::WriteEventCallback(unsigned) noexcept
 
 	timeout_event.Cancel();
 
+	if (ring != nullptr)
+		WasShmRing::DrainEvent(GetPipe());
+
 	if (!CheckLength())
 		return;
 
@@ -198,7 +250,7 @@ WasOutput::WriteEventCallback(unsigned) noexcept
 	if (!destructed && !got_data)
 		/* the Istream is not ready for reading, so cancel our
 		   write event */
-		event.CancelWrite();
+		CancelWrite();
 }
 
 inline void
@@ -213,6 +265,29 @@ WasOutput::OnDeferredWrite() noexcept
 	input.Read();
 }
 
+ssize_t
+WasOutput::WriteV(std::span<const struct iovec> v)
+{
+	if (ring == nullptr)
+		return writev(GetPipe().Get(), v.data(), v.size());
+
+	std::size_t total = 0;
+	for (const auto &i : v) {
+		const std::span<const std::byte> src{(const std::byte *)i.iov_base, i.iov_len};
+		const std::size_t nbytes = ring->Write(src);
+		total += nbytes;
+		if (nbytes < src.size())
+			break;
+	}
+
+	if (total == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return total;
+}
+
 /*
  * istream handler for the request
  *
@@ -273,7 +348,15 @@ WasOutput::OnIstreamReady() noexcept
 
 	/* write this struct iovec array */
 
-	ssize_t nbytes = writev(GetPipe().Get(), v.data(), v.size());
+	ssize_t nbytes;
+
+	try {
+		nbytes = WriteV({v.data(), v.size()});
+	} catch (...) {
+		DestroyError(std::current_exception());
+		return false;
+	}
+
 	if (nbytes < 0) {
 		int e = errno;
 		if (e == EAGAIN) {
@@ -309,7 +392,16 @@ WasOutput::OnData(const std::span<const std::byte> src) noexcept
 
 	got_data = true;
 
-	ssize_t nbytes = GetPipe().Write(src.data(), src.size());
+	const struct iovec v = MakeIovec(src);
+	ssize_t nbytes;
+
+	try {
+		nbytes = WriteV({&v, 1});
+	} catch (...) {
+		DestroyError(std::current_exception());
+		return 0;
+	}
+
 	if (gcc_likely(nbytes > 0)) {
 		sent += nbytes;
 
@@ -339,6 +431,7 @@ WasOutput::OnDirect(gcc_unused FdType type, FileDescriptor source_fd,
 		    std::size_t max_length) noexcept
 {
 	assert(HasPipe());
+	assert(ring == nullptr);
 	assert(!IsEof());
 
 	ssize_t nbytes = SpliceToPipe(source_fd,
@@ -416,6 +509,15 @@ was_output_new(struct pool &pool, EventLoop &event_loop,
 				      std::move(input), handler);
 }
 
+WasOutput *
+was_output_new(struct pool &pool, EventLoop &event_loop,
+	       WasShmRing &ring, UnusedIstreamPtr input,
+	       WasOutputHandler &handler) noexcept
+{
+	return NewFromPool<WasOutput>(pool, pool, event_loop, ring,
+				      std::move(input), handler);
+}
+
 uint64_t
 was_output_free(WasOutput *output) noexcept
 {
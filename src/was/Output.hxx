@@ -41,6 +41,7 @@ class EventLoop;
 class FileDescriptor;
 class UnusedIstreamPtr;
 class WasOutput;
+class WasShmRing;
 
 class WasOutputHandler {
 public:
@@ -76,6 +77,15 @@ was_output_new(struct pool &pool, EventLoop &event_loop,
 	       FileDescriptor fd, UnusedIstreamPtr input,
 	       WasOutputHandler &handler) noexcept;
 
+/**
+ * Like was_output_new(), but send the body to a shared memory ring
+ * instead of a pipe.
+ */
+WasOutput *
+was_output_new(struct pool &pool, EventLoop &event_loop,
+	       WasShmRing &ring, UnusedIstreamPtr input,
+	       WasOutputHandler &handler) noexcept;
+
 /**
  * @return the total number of bytes written to the pipe
  */
@@ -60,6 +60,10 @@ public:
 		return connection.GetSocket();
 	}
 
+	WasShm *GetShm() noexcept {
+		return connection.GetShm();
+	}
+
 	/**
 	 * Set the "stopping" flag.  Call this after sending
 	 * #WAS_COMMAND_STOP, before calling hstock_put().  This will
@@ -75,6 +79,10 @@ protected:
 		connection.Open(std::move(_socket));
 	}
 
+	void Open(WasSocket &&_socket, WasShm &&_shm) noexcept {
+		connection.Open(std::move(_socket), std::move(_shm));
+	}
+
 private:
 	/* virtual methods from class StockItem */
 	bool Borrow() noexcept override;
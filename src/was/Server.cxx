@@ -47,10 +47,11 @@
 #include <unistd.h>
 
 WasServer::WasServer(struct pool &_pool, EventLoop &event_loop,
-		     WasSocket &&_socket,
+		     WasSocket &&_socket, WasShm &&_shm,
 		     WasServerHandler &_handler) noexcept
 	:pool(_pool),
 	 socket(std::move(_socket)),
+	 shm(std::move(_shm)),
 	 control(event_loop, socket.control, *this),
 	 handler(_handler)
 {
@@ -358,6 +359,21 @@ WasServer::OnWasControlPacket(enum was_command cmd,
 			return false;
 		}
 
+		if (!payload.empty()) {
+			if (!shm.IsDefined() || payload.size() != 1 ||
+			    payload.front() != WAS_SHM_DATA) {
+				AbortProtocolError("malformed DATA packet");
+				return false;
+			}
+
+			request.body = was_input_new(*request.pool,
+						     control.GetEventLoop(),
+						     shm.GetRequestRing(),
+						     *this);
+			request.state = Request::State::PENDING;
+			break;
+		}
+
 		request.body = was_input_new(*request.pool, control.GetEventLoop(),
 					     socket.input, *this);
 		request.state = Request::State::PENDING;
@@ -470,7 +486,16 @@ WasServer::SendResponse(http_status_t status,
 
 	Was::SendMap(control, WAS_COMMAND_HEADER, headers);
 
-	if (body) {
+	if (body && shm.IsDefined()) {
+		response.body = was_output_new(*request.pool,
+					       control.GetEventLoop(),
+					       shm.GetResponseRing(),
+					       std::move(body), *this);
+		if (!control.Send(WAS_COMMAND_DATA,
+				  &WAS_SHM_DATA, sizeof(WAS_SHM_DATA)) ||
+		    !was_output_check_length(*response.body))
+			return;
+	} else if (body) {
 		response.body = was_output_new(*request.pool,
 					       control.GetEventLoop(),
 					       socket.output, std::move(body),
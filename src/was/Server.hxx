@@ -34,6 +34,7 @@
 
 #include "Output.hxx"
 #include "Input.hxx"
+#include "Shm.hxx"
 #include "was/async/Control.hxx"
 #include "was/async/Socket.hxx"
 #include "pool/Ptr.hxx"
@@ -58,6 +59,13 @@ class WasServer final : Was::ControlHandler, WasOutputHandler, WasInputHandler {
 
 	WasSocket socket;
 
+	/**
+	 * The shared memory segment offered by the WAS client
+	 * (optional).  If defined, response bodies are always sent
+	 * through it.
+	 */
+	WasShm shm;
+
 	Was::Control control;
 
 	WasServerHandler &handler;
@@ -123,6 +131,16 @@ public:
 	 */
 	WasServer(struct pool &_pool, EventLoop &event_loop,
 		  WasSocket &&_socket,
+		  WasServerHandler &_handler) noexcept
+		:WasServer(_pool, event_loop, std::move(_socket), {},
+			   _handler) {}
+
+	/**
+	 * @param _shm a shared memory segment obtained with
+	 * WasShm::Accept() (may be undefined)
+	 */
+	WasServer(struct pool &_pool, EventLoop &event_loop,
+		  WasSocket &&_socket, WasShm &&_shm,
 		  WasServerHandler &_handler) noexcept;
 
 	void Free() noexcept {
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Shm.hxx"
+#include "was/async/Error.hxx"
+#include "system/Error.hxx"
+#include "system/LinuxFD.hxx"
+#include "net/SocketDescriptor.hxx"
+#include "io/Iovec.hxx"
+
+#include <was/protocol.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <new>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+static void
+SignalEvent(FileDescriptor fd) noexcept
+{
+	static constexpr uint64_t value = 1;
+	(void)fd.Write(&value, sizeof(value));
+}
+
+inline uint64_t
+WasShmRing::LoadHead()
+{
+	const uint64_t value = header->head.load(std::memory_order_acquire);
+	if (value < head || value > tail)
+		throw WasProtocolError("corrupt WAS shared memory ring");
+
+	head = value;
+	return value;
+}
+
+inline uint64_t
+WasShmRing::LoadTail()
+{
+	const uint64_t value = header->tail.load(std::memory_order_acquire);
+	if (value < tail || value - head > capacity)
+		throw WasProtocolError("corrupt WAS shared memory ring");
+
+	tail = value;
+	return value;
+}
+
+std::size_t
+WasShmRing::Write(std::span<const std::byte> src)
+{
+	/* our own counter is taken from the local copy, because the
+	   peer may have overwritten the shared one */
+	const uint64_t _head = LoadHead();
+	const std::size_t nbytes = std::min(src.size(),
+					    capacity - std::size_t(tail - _head));
+	if (nbytes == 0)
+		return 0;
+
+	const std::size_t offset = tail & (capacity - 1);
+	const std::size_t first = std::min(nbytes, capacity - offset);
+	std::copy_n(src.data(), first, data + offset);
+	std::copy_n(src.data() + first, nbytes - first, data);
+
+	tail += nbytes;
+
+	/* this store and the "reader_waiting" load below pair with
+	   the store/load in PrepareRead(); sequential consistency
+	   guarantees that at least one side sees the other's
+	   update, so no wakeup can get lost */
+	header->tail.store(tail, std::memory_order_seq_cst);
+
+	if (header->reader_waiting.load(std::memory_order_seq_cst) &&
+	    header->reader_waiting.exchange(0))
+		SignalEvent(data_event);
+
+	return nbytes;
+}
+
+bool
+WasShmRing::PrepareWrite() noexcept
+{
+	header->writer_waiting.store(1, std::memory_order_seq_cst);
+
+	const uint64_t _head = header->head.load(std::memory_order_seq_cst);
+	if (_head != head || tail - head < capacity) {
+		/* the consumer has freed some space meanwhile */
+		header->writer_waiting.store(0, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+inline void
+WasShmRing::Consume(std::size_t nbytes) noexcept
+{
+	head += nbytes;
+	header->head.store(head, std::memory_order_seq_cst);
+
+	if (header->writer_waiting.load(std::memory_order_seq_cst) &&
+	    header->writer_waiting.exchange(0))
+		SignalEvent(space_event);
+}
+
+std::size_t
+WasShmRing::ReadTo(std::span<std::byte> dest)
+{
+	const uint64_t _tail = LoadTail();
+	const std::size_t nbytes = std::min(dest.size(),
+					    std::size_t(_tail - head));
+	if (nbytes == 0)
+		return 0;
+
+	const std::size_t offset = head & (capacity - 1);
+	const std::size_t first = std::min(nbytes, capacity - offset);
+	std::copy_n(data + offset, first, dest.data());
+	std::copy_n(data, nbytes - first, dest.data() + first);
+
+	Consume(nbytes);
+	return nbytes;
+}
+
+std::size_t
+WasShmRing::Discard(uint64_t max_length)
+{
+	const uint64_t _tail = LoadTail();
+	const std::size_t nbytes = std::min(max_length, _tail - head);
+	if (nbytes > 0)
+		Consume(nbytes);
+	return nbytes;
+}
+
+bool
+WasShmRing::PrepareRead() noexcept
+{
+	header->reader_waiting.store(1, std::memory_order_seq_cst);
+
+	const uint64_t _tail = header->tail.load(std::memory_order_seq_cst);
+	if (_tail != head) {
+		/* the producer has written more data meanwhile */
+		header->reader_waiting.store(0, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+void
+WasShmRing::DrainEvent(FileDescriptor fd) noexcept
+{
+	uint64_t value;
+	(void)fd.Read(&value, sizeof(value));
+}
+
+struct WasShm::Shared {
+	static constexpr uint32_t MAGIC = 0x57415331; // "WAS1"
+
+	uint32_t magic;
+
+	/**
+	 * The capacity of each ring.
+	 */
+	uint32_t capacity;
+
+	/**
+	 * Set by the application after it has received and mapped the
+	 * segment.
+	 */
+	std::atomic<uint32_t> attached;
+
+	WasShmRing::Header request, response;
+};
+
+/**
+ * The size of the #WasShm::Shared area at the beginning of the
+ * segment; the ring data follows it.
+ */
+static constexpr std::size_t WAS_SHM_HEADER_SIZE = 4096;
+
+static constexpr std::size_t WAS_SHM_N_FDS = 5;
+
+/**
+ * The #WAS_COMMAND_NOP packet which carries the #WasShm file
+ * descriptors.
+ */
+struct WasShmOfferPacket {
+	struct was_header header;
+	uint32_t magic;
+};
+
+WasShm::WasShm(WasShm &&src) noexcept
+	:shared(std::exchange(src.shared, nullptr)),
+	 mapping_size(src.mapping_size),
+	 memfd(std::move(src.memfd)),
+	 request_data(std::move(src.request_data)),
+	 request_space(std::move(src.request_space)),
+	 response_data(std::move(src.response_data)),
+	 response_space(std::move(src.response_space)),
+	 request(src.request), response(src.response)
+{
+}
+
+WasShm::~WasShm() noexcept
+{
+	if (shared != nullptr)
+		munmap(shared, mapping_size);
+}
+
+WasShm &
+WasShm::operator=(WasShm &&src) noexcept
+{
+	using std::swap;
+	swap(shared, src.shared);
+	swap(mapping_size, src.mapping_size);
+	swap(memfd, src.memfd);
+	swap(request_data, src.request_data);
+	swap(request_space, src.request_space);
+	swap(response_data, src.response_data);
+	swap(response_space, src.response_space);
+	swap(request, src.request);
+	swap(response, src.response);
+	return *this;
+}
+
+void
+WasShm::Map(FileDescriptor fd, std::size_t capacity)
+{
+	const std::size_t size = WAS_SHM_HEADER_SIZE + 2 * capacity;
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		       fd.Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map WAS shared memory");
+
+	shared = (Shared *)p;
+	mapping_size = size;
+
+	auto *data = (std::byte *)p + WAS_SHM_HEADER_SIZE;
+	request = {shared->request, data, capacity,
+		request_data, request_space};
+	response = {shared->response, data + capacity, capacity,
+		response_data, response_space};
+}
+
+WasShm
+WasShm::Create(std::size_t capacity)
+{
+	static_assert(sizeof(Shared) <= WAS_SHM_HEADER_SIZE);
+	assert(capacity >= 4096);
+	assert((capacity & (capacity - 1)) == 0);
+
+	UniqueFileDescriptor fd(memfd_create("was_shm", MFD_CLOEXEC));
+	if (!fd.IsDefined())
+		throw MakeErrno("Failed to create WAS shared memory");
+
+	if (ftruncate(fd.Get(), WAS_SHM_HEADER_SIZE + 2 * capacity) < 0)
+		throw MakeErrno("Failed to resize WAS shared memory");
+
+	WasShm shm;
+	shm.request_data = CreateEventFD();
+	shm.request_space = CreateEventFD();
+	shm.response_data = CreateEventFD();
+	shm.response_space = CreateEventFD();
+	shm.Map(fd, capacity);
+
+	auto *shared = new(shm.shared) Shared{};
+	shared->capacity = capacity;
+	shared->magic = Shared::MAGIC;
+
+	shm.memfd = std::move(fd);
+	return shm;
+}
+
+void
+WasShm::Offer(SocketDescriptor control)
+{
+	assert(IsDefined());
+	assert(memfd.IsDefined());
+
+	WasShmOfferPacket packet{};
+	packet.header.length = sizeof(packet.magic);
+	packet.header.command = WAS_COMMAND_NOP;
+	packet.magic = Shared::MAGIC;
+
+	const std::array<int, WAS_SHM_N_FDS> fds{
+		memfd.Get(),
+		request_data.Get(), request_space.Get(),
+		response_data.Get(), response_space.Get(),
+	};
+
+	alignas(struct cmsghdr) std::byte cmsg_buffer[CMSG_SPACE(sizeof(fds))];
+
+	auto iov = MakeIovecT(packet);
+
+	struct msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buffer;
+	msg.msg_controllen = sizeof(cmsg_buffer);
+
+	auto *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(fds));
+
+	ssize_t nbytes = sendmsg(control.Get(), &msg,
+				 MSG_DONTWAIT|MSG_NOSIGNAL);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to send WAS shared memory");
+
+	if (std::size_t(nbytes) != sizeof(packet))
+		throw std::runtime_error("Short send on WAS control socket");
+
+	/* the application has its own copy now */
+	memfd.Close();
+}
+
+WasShm
+WasShm::Accept(SocketDescriptor control)
+{
+	WasShmOfferPacket packet;
+
+	/* peek first, because if the client has not offered a
+	   segment, the packet belongs to Was::Control */
+	ssize_t nbytes = recv(control.Get(), &packet, sizeof(packet),
+			      MSG_PEEK|MSG_DONTWAIT);
+	if (nbytes < 0) {
+		if (errno == EAGAIN)
+			return {};
+
+		throw MakeErrno("Failed to receive from WAS control socket");
+	}
+
+	if (std::size_t(nbytes) < sizeof(packet) ||
+	    packet.header.command != WAS_COMMAND_NOP ||
+	    packet.header.length != sizeof(packet.magic) ||
+	    packet.magic != Shared::MAGIC)
+		return {};
+
+	alignas(struct cmsghdr) std::byte cmsg_buffer[CMSG_SPACE(sizeof(int) * WAS_SHM_N_FDS)];
+
+	auto iov = MakeIovecT(packet);
+
+	struct msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg_buffer;
+	msg.msg_controllen = sizeof(cmsg_buffer);
+
+	nbytes = recvmsg(control.Get(), &msg, MSG_DONTWAIT|MSG_CMSG_CLOEXEC);
+	if (nbytes < 0)
+		throw MakeErrno("Failed to receive from WAS control socket");
+
+	std::array<UniqueFileDescriptor, WAS_SHM_N_FDS> fds;
+	std::size_t n_fds = 0;
+
+	for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		const std::size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		const int *p = (const int *)(const void *)CMSG_DATA(cmsg);
+		for (std::size_t i = 0; i < n; ++i) {
+			UniqueFileDescriptor fd(p[i]);
+			if (n_fds < fds.size())
+				fds[n_fds++] = std::move(fd);
+		}
+	}
+
+	if (std::size_t(nbytes) != sizeof(packet) || n_fds != fds.size() ||
+	    (msg.msg_flags & MSG_CTRUNC) != 0)
+		throw std::runtime_error("Malformed WAS shared memory offer");
+
+	struct stat st;
+	if (fstat(fds[0].Get(), &st) < 0)
+		throw MakeErrno("Failed to stat WAS shared memory");
+
+	if (std::size_t(st.st_size) <= WAS_SHM_HEADER_SIZE)
+		throw std::runtime_error("WAS shared memory is too small");
+
+	const std::size_t capacity = (st.st_size - WAS_SHM_HEADER_SIZE) / 2;
+	if (capacity < 4096 || (capacity & (capacity - 1)) != 0)
+		throw std::runtime_error("Bad WAS shared memory size");
+
+	WasShm shm;
+	shm.request_data = std::move(fds[1]);
+	shm.request_space = std::move(fds[2]);
+	shm.response_data = std::move(fds[3]);
+	shm.response_space = std::move(fds[4]);
+	shm.Map(fds[0], capacity);
+
+	if (shm.shared->magic != Shared::MAGIC ||
+	    shm.shared->capacity != capacity)
+		throw std::runtime_error("Bad WAS shared memory header");
+
+	shm.shared->attached.store(1, std::memory_order_release);
+	return shm;
+}
+
+bool
+WasShm::IsAttached() const noexcept
+{
+	return shared->attached.load(std::memory_order_acquire) != 0;
+}
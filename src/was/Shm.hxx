@@ -0,0 +1,336 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+#include <stdint.h>
+
+class SocketDescriptor;
+
+/**
+ * A single-producer/single-consumer byte ring buffer in a shared
+ * memory segment.  It replaces a WAS data pipe: the producer copies
+ * into the ring and the consumer reads from it without any system
+ * call.  An eventfd is only written when the peer has announced that
+ * it is about to sleep (futex-style "waiting" flag), so a busy
+ * connection transfers bodies without any kernel involvement.
+ */
+class WasShmRing {
+public:
+	/**
+	 * The part of the ring which lives in shared memory.
+	 */
+	struct Header {
+		/**
+		 * The total number of bytes consumed; only modified
+		 * by the consumer.
+		 */
+		alignas(64) std::atomic<uint64_t> head;
+
+		/**
+		 * The total number of bytes produced; only modified
+		 * by the producer.
+		 */
+		alignas(64) std::atomic<uint64_t> tail;
+
+		/**
+		 * Set by the consumer before it waits for
+		 * #data_event.
+		 */
+		alignas(64) std::atomic<uint32_t> reader_waiting;
+
+		/**
+		 * Set by the producer before it waits for
+		 * #space_event.
+		 */
+		std::atomic<uint32_t> writer_waiting;
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+private:
+	Header *header = nullptr;
+	std::byte *data = nullptr;
+
+	/**
+	 * The size of #data; a power of two.
+	 */
+	std::size_t capacity = 0;
+
+	/**
+	 * Local copies of Header::head and Header::tail: the value
+	 * this side has written to its own counter, and the value it
+	 * has last seen in the peer's counter.  The peer may corrupt
+	 * the shared header, so each value loaded from it is checked
+	 * against these before it is used.
+	 */
+	uint64_t head = 0, tail = 0;
+
+	/**
+	 * An eventfd signalled by the producer when new data is
+	 * available.
+	 */
+	FileDescriptor data_event;
+
+	/**
+	 * An eventfd signalled by the consumer when space has been
+	 * freed.
+	 */
+	FileDescriptor space_event;
+
+public:
+	WasShmRing() = default;
+
+	WasShmRing(Header &_header, std::byte *_data, std::size_t _capacity,
+		   FileDescriptor _data_event,
+		   FileDescriptor _space_event) noexcept
+		:header(&_header), data(_data), capacity(_capacity),
+		 data_event(_data_event), space_event(_space_event) {}
+
+	FileDescriptor GetDataEvent() const noexcept {
+		return data_event;
+	}
+
+	FileDescriptor GetSpaceEvent() const noexcept {
+		return space_event;
+	}
+
+	/**
+	 * Return the number of bytes available to the consumer.
+	 *
+	 * Throws #WasProtocolError if the peer has corrupted the
+	 * ring.
+	 */
+	std::size_t GetAvailable() {
+		return LoadTail() - head;
+	}
+
+	/* producer methods */
+
+	/**
+	 * Copy as much of the given data into the ring as fits, and
+	 * wake up the consumer if it is waiting.
+	 *
+	 * Throws #WasProtocolError if the peer has corrupted the
+	 * ring.
+	 *
+	 * @return the number of bytes copied (0 if the ring is full)
+	 */
+	std::size_t Write(std::span<const std::byte> src);
+
+	/**
+	 * Announce that the producer is going to wait for
+	 * #space_event.
+	 *
+	 * @return true if the ring is still full and the caller shall
+	 * wait, false if space has become available meanwhile (or if
+	 * the header was modified in a way which the next Write()
+	 * call will report)
+	 */
+	bool PrepareWrite() noexcept;
+
+	/* consumer methods */
+
+	/**
+	 * Copy data from the ring into the given buffer and wake up
+	 * the producer if it is waiting.
+	 *
+	 * Throws #WasProtocolError if the peer has corrupted the
+	 * ring.
+	 *
+	 * @return the number of bytes copied (0 if the ring is empty)
+	 */
+	std::size_t ReadTo(std::span<std::byte> dest);
+
+	/**
+	 * Discard up to the given number of bytes.
+	 *
+	 * Throws #WasProtocolError if the peer has corrupted the
+	 * ring.
+	 *
+	 * @return the number of bytes discarded
+	 */
+	std::size_t Discard(uint64_t max_length);
+
+	/**
+	 * Announce that the consumer is going to wait for
+	 * #data_event.
+	 *
+	 * @return true if the ring is still empty and the caller
+	 * shall wait, false if data has arrived meanwhile (or if the
+	 * header was modified in a way which the next ReadTo() call
+	 * will report)
+	 */
+	bool PrepareRead() noexcept;
+
+	/**
+	 * Reset the counter of an eventfd after it has been reported
+	 * readable.
+	 */
+	static void DrainEvent(FileDescriptor fd) noexcept;
+
+private:
+	/**
+	 * Load the consumer's counter (on the producer side).  It
+	 * must not go backwards and must not pass the producer's
+	 * counter.
+	 *
+	 * Throws #WasProtocolError on error.
+	 */
+	uint64_t LoadHead();
+
+	/**
+	 * Load the producer's counter (on the consumer side).  It
+	 * must not go backwards and must not be more than #capacity
+	 * ahead of the consumer's counter.
+	 *
+	 * Throws #WasProtocolError on error.
+	 */
+	uint64_t LoadTail();
+
+	void Consume(std::size_t nbytes) noexcept;
+};
+
+/**
+ * A shared memory segment containing one #WasShmRing for the request
+ * body and one for the response body of a WAS connection, plus the
+ * eventfds used for wakeups.
+ *
+ * The WAS client creates it when launching the child process and
+ * offers it with a #WAS_COMMAND_NOP packet which carries the file
+ * descriptors (SCM_RIGHTS); applications which don't know about it
+ * ignore the packet and the descriptors are discarded by the kernel.
+ * Applications which accept the offer set the "attached" flag, and
+ * each side then announces a ring-transported body with a one-byte
+ * #WAS_COMMAND_DATA payload (see #WAS_SHM_DATA).
+ */
+class WasShm {
+	struct Shared;
+
+	Shared *shared = nullptr;
+	std::size_t mapping_size;
+
+	/**
+	 * The memfd; only kept until Offer() has been called.
+	 */
+	UniqueFileDescriptor memfd;
+
+	UniqueFileDescriptor request_data, request_space;
+	UniqueFileDescriptor response_data, response_space;
+
+	WasShmRing request, response;
+
+public:
+	static constexpr std::size_t DEFAULT_CAPACITY = 256 * 1024;
+
+	WasShm() noexcept = default;
+	WasShm(WasShm &&src) noexcept;
+	~WasShm() noexcept;
+
+	WasShm &operator=(WasShm &&src) noexcept;
+
+	/**
+	 * Create a new segment (on the client side).
+	 *
+	 * Throws on error.
+	 *
+	 * @param capacity the size of each ring; must be a power of
+	 * two
+	 */
+	static WasShm Create(std::size_t capacity=DEFAULT_CAPACITY);
+
+	/**
+	 * Check whether the WAS client has offered a segment on the
+	 * given control socket, and if yes, receive and attach it (on
+	 * the application side).  This must be called before the
+	 * first packet is read from the control socket.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the segment or an undefined object if none was
+	 * offered
+	 */
+	static WasShm Accept(SocketDescriptor control);
+
+	bool IsDefined() const noexcept {
+		return shared != nullptr;
+	}
+
+	/**
+	 * Send the segment to the application.  This must be called
+	 * before any other packet is sent.
+	 *
+	 * Throws on error.
+	 */
+	void Offer(SocketDescriptor control);
+
+	/**
+	 * Has the application attached the segment?  Until it has,
+	 * request bodies must be sent over the pipe.
+	 */
+	[[gnu::pure]]
+	bool IsAttached() const noexcept;
+
+	/**
+	 * The ring transporting the request body (client to
+	 * application).
+	 */
+	WasShmRing &GetRequestRing() noexcept {
+		return request;
+	}
+
+	/**
+	 * The ring transporting the response body (application to
+	 * client).
+	 */
+	WasShmRing &GetResponseRing() noexcept {
+		return response;
+	}
+
+private:
+	/**
+	 * Throws on error.
+	 */
+	void Map(FileDescriptor fd, std::size_t capacity);
+};
+
+/**
+ * The #WAS_COMMAND_DATA payload announcing that the body is
+ * transported over the #WasShm ring instead of the pipe.
+ */
+static constexpr std::byte WAS_SHM_DATA{'S'};
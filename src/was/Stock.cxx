@@ -83,7 +83,7 @@ public:
 	 * Throws on error.
 	 */
 	void Launch(const CgiChildParams &params, SocketDescriptor log_socket,
-		    const ChildErrorLogOptions &log_options) {
+		    const ChildErrorLogOptions &log_options, bool shm) {
 		auto process =
 			was_launch(spawn_service,
 				   GetStockName(),
@@ -92,13 +92,14 @@ public:
 				   params.options,
 				   log.EnableClient(GetEventLoop(),
 						    log_socket, log_options,
-						    params.options.stderr_pond));
+						    params.options.stderr_pond),
+				   shm);
 
 		handle = std::move(process.handle);
 		handle->SetExitListener(*this);
 
 		WasSocket &socket = process;
-		Open(std::move(socket));
+		Open(std::move(socket), std::move(process.shm));
 	}
 
 	void SetSite(const char *_site) noexcept override {
@@ -143,7 +144,7 @@ WasStock::Create(CreateStockItem c, StockRequest _request,
 	auto *child = new WasChild(c, spawn_service, params.options.tag);
 
 	try {
-		child->Launch(params, log_socket, log_options);
+		child->Launch(params, log_socket, log_options, shm);
 	} catch (...) {
 		delete child;
 		throw;
@@ -53,6 +53,11 @@ class WasStock final : StockClass {
 	const SocketDescriptor log_socket;
 	const ChildErrorLogOptions log_options;
 
+	/**
+	 * Offer a shared memory segment to each new child process?
+	 */
+	const bool shm;
+
 	class WasStockMap final : public StockMap {
 	public:
 		using StockMap::StockMap;
@@ -68,9 +73,11 @@ public:
 	explicit WasStock(EventLoop &event_loop, SpawnService &_spawn_service,
 			  const SocketDescriptor _log_socket,
 			  const ChildErrorLogOptions &_log_options,
-			  unsigned limit, unsigned max_idle) noexcept
+			  unsigned limit, unsigned max_idle,
+			  bool _shm) noexcept
 		:spawn_service(_spawn_service),
 		 log_socket(_log_socket), log_options(_log_options),
+		 shm(_shm),
 		 stock(event_loop, *this, limit, max_idle,
 		       std::chrono::minutes(10)) {}
 
@@ -30,28 +30,75 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ * A simple HTTP/2 server for testing and benchmarking.  If a file
+ * path is given on the command line, each request is answered with
+ * the contents of that file; for comparing the throughput with
+ * HTTP/1.1, the same is served on port 8001 (e.g. "h2load -n 10000
+ * http://localhost:8000/" vs. "h2load --h1 -n 10000
+ * http://localhost:8001/").
+ */
+
 #include "nghttp2/Server.hxx"
 #include "http/Headers.hxx"
 #include "http/IncomingRequest.hxx"
 #include "http/server/Handler.hxx"
+#include "http/server/Public.hxx"
 #include "fs/FilteredSocket.hxx"
 #include "event/Loop.hxx"
 #include "event/net/TemplateServerSocket.hxx"
+#include "istream/OpenFileIstream.hxx"
+#include "istream/UnusedPtr.hxx"
 #include "net/UniqueSocketDescriptor.hxx"
 #include "util/PrintException.hxx"
 #include "pool/RootPool.hxx"
 #include "memory/fb_pool.hxx"
 
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The file to be served; nullptr means "Hello, world" or mirror.
+ */
+static const char *file_path;
+
+static void
+HandleRequest(EventLoop &event_loop, IncomingHttpRequest &request) noexcept
+{
+	if (file_path != nullptr) {
+		UnusedIstreamPtr body;
+
+		try {
+			body = OpenFileIstream(event_loop, request.pool,
+					       file_path);
+		} catch (...) {
+			PrintException(std::current_exception());
+			request.SendMessage(HTTP_STATUS_INTERNAL_SERVER_ERROR,
+					    "Failed to open file\n");
+			return;
+		}
+
+		request.SendResponse(HTTP_STATUS_OK, {}, std::move(body));
+	} else if (request.body)
+		request.SendResponse(HTTP_STATUS_OK, {},
+				     std::move(request.body));
+	else
+		request.SendMessage(HTTP_STATUS_OK, "Hello, world!\n");
+}
+
 class Connection final
 	: public AutoUnlinkIntrusiveListHook,
 	  HttpServerConnectionHandler, HttpServerRequestHandler
 {
+	EventLoop &event_loop;
+
 	NgHttp2::ServerConnection http;
 
 public:
-	Connection(struct pool &pool, EventLoop &event_loop,
+	Connection(struct pool &pool, EventLoop &_event_loop,
 		   UniqueSocketDescriptor fd, SocketAddress address)
-		:http(pool,
+		:event_loop(_event_loop),
+		 http(pool,
 		      UniquePoolPtr<FilteredSocket>::Make(pool, event_loop,
 							  std::move(fd), FD_TCP),
 		      address,
@@ -64,19 +111,62 @@ public:
 		(void)cancel_ptr;
 		// TODO
 
-		if (request.body)
-			request.SendResponse(HTTP_STATUS_OK, {},
-					     std::move(request.body));
-		else
-			request.SendMessage(HTTP_STATUS_OK, "Hello, world!\n");
+		HandleRequest(event_loop, request);
+	}
+
+	void HttpConnectionError(std::exception_ptr e) noexcept override {
+		PrintException(e);
+		delete this;
+	}
+
+	void HttpConnectionClosed() noexcept override {
+		delete this;
+	}
+};
+
+/**
+ * The HTTP/1.1 counterpart of #Connection.
+ */
+class Http1Connection final
+	: public AutoUnlinkIntrusiveListHook,
+	  HttpServerConnectionHandler, HttpServerRequestHandler
+{
+	EventLoop &event_loop;
+
+	HttpServerConnection *connection;
+
+public:
+	Http1Connection(struct pool &pool, EventLoop &_event_loop,
+			UniqueSocketDescriptor fd, SocketAddress address)
+		:event_loop(_event_loop),
+		 connection(http_server_connection_new(pool,
+						       UniquePoolPtr<FilteredSocket>::Make(pool, event_loop,
+											   std::move(fd), FD_TCP),
+						       nullptr,
+						       address,
+						       true,
+						       *this, *this)) {}
+
+	~Http1Connection() noexcept {
+		if (connection != nullptr)
+			http_server_connection_close(connection);
+	}
+
+	/* virtual methods from class HttpServerConnectionHandler */
+	void HandleHttpRequest(IncomingHttpRequest &request,
+			       const StopwatchPtr &,
+			       CancellablePointer &) noexcept override {
+		HandleRequest(event_loop, request);
 	}
 
 	void HttpConnectionError(std::exception_ptr e) noexcept override {
+		connection = nullptr;
 		PrintException(e);
 		delete this;
 	}
 
 	void HttpConnectionClosed() noexcept override {
+		connection = nullptr;
 		delete this;
 	}
 };
@@ -84,9 +174,20 @@ public:
 typedef TemplateServerSocket<Connection, struct pool &,
 			     EventLoop &> Listener;
 
+typedef TemplateServerSocket<Http1Connection, struct pool &,
+			     EventLoop &> Http1Listener;
+
 int
-main(int, char **) noexcept
+main(int argc, char **argv) noexcept
 try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [FILE]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (argc == 2)
+		file_path = argv[1];
+
 	const ScopeFbPoolInit fb_pool_init;
 	RootPool pool;
 	EventLoop event_loop;
@@ -94,6 +195,9 @@ try {
 	Listener listener(event_loop, pool.get(), event_loop);
 	listener.ListenTCP(8000);
 
+	Http1Listener http1_listener(event_loop, pool.get(), event_loop);
+	http1_listener.ListenTCP(8001);
+
 	event_loop.Dispatch();
 } catch (...) {
 	PrintException(std::current_exception());
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DefaultFifoBuffer.hxx"
+#include "memory/fb_pool.hxx"
+#include "stats/AllocatorStats.hxx"
+#include "util/Sanitizer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+static void
+Fill(DefaultFifoBuffer &buffer, std::size_t n, std::byte value)
+{
+	auto w = buffer.Write();
+	ASSERT_GE(w.size(), n);
+	std::fill_n(w.begin(), n, value);
+	buffer.Append(n);
+}
+
+TEST(DefaultFifoBuffer, Grow)
+{
+	const ScopeFbPoolInit fb_pool_init;
+
+	DefaultFifoBuffer buffer;
+	buffer.AllocateIfNull();
+	ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[1]);
+
+	/* less than half full: no growth */
+	Fill(buffer, 1000, std::byte{'a'});
+	buffer.AllocateIfNull();
+	ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[1]);
+
+	/* half full: grow to the next size class, data preserved */
+	Fill(buffer, FB_SIZE_CLASSES[1] / 2, std::byte{'b'});
+	buffer.AllocateIfNull();
+	ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[2]);
+	ASSERT_EQ(buffer.GetAvailable(), 1000 + FB_SIZE_CLASSES[1] / 2);
+
+	auto r = buffer.Read();
+	ASSERT_EQ(r.front(), std::byte{'a'});
+	ASSERT_EQ(r[999], std::byte{'a'});
+	ASSERT_EQ(r[1000], std::byte{'b'});
+	ASSERT_EQ(r.back(), std::byte{'b'});
+
+	if (!HaveAddressSanitizer()) {
+		/* the old buffer has been freed */
+		ASSERT_EQ(fb_pool_get_stats(1).netto_size, 0u);
+		ASSERT_EQ(fb_pool_get_stats(2).netto_size, FB_SIZE_CLASSES[2]);
+	}
+
+	/* grow up to the largest size class */
+	while (buffer.Grow()) {}
+	ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[FB_N_SIZE_CLASSES - 1]);
+	ASSERT_EQ(buffer.GetAvailable(), 1000 + FB_SIZE_CLASSES[1] / 2);
+
+	buffer.Free();
+}
+
+TEST(DefaultFifoBuffer, Shrink)
+{
+	const ScopeFbPoolInit fb_pool_init;
+
+	DefaultFifoBuffer buffer{0};
+	buffer.Allocate();
+	ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[0]);
+
+	while (buffer.Grow()) {}
+
+	/* not empty: not freed */
+	Fill(buffer, 1, std::byte{'x'});
+	buffer.FreeIfEmpty();
+	ASSERT_TRUE(buffer.IsDefined());
+
+	buffer.Consume(1);
+	buffer.FreeIfEmpty();
+	ASSERT_TRUE(buffer.IsNull());
+	if (!HaveAddressSanitizer()) {
+		ASSERT_EQ(fb_pool_get_stats().netto_size, 0u);
+	}
+
+	/* each idle period steps down one size class */
+	for (unsigned i = FB_N_SIZE_CLASSES - 1; i-- > 0;) {
+		buffer.AllocateIfNull();
+		ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[i]);
+		buffer.FreeIfEmpty();
+	}
+
+	/* never below the minimum */
+	buffer.AllocateIfNull();
+	ASSERT_EQ(buffer.GetCapacity(), FB_SIZE_CLASSES[0]);
+	buffer.FreeIfEmpty();
+}
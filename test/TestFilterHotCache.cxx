@@ -0,0 +1,213 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FilterHotCache.hxx"
+#include "TestPool.hxx"
+#include "util/FrequencySketch.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using std::string_view_literals::operator""sv;
+
+TEST(FrequencySketch, Basic)
+{
+	FrequencySketch sketch(256);
+
+	EXPECT_EQ(sketch.Estimate(42), 0U);
+
+	for (unsigned i = 0; i < 5; ++i)
+		sketch.Increment(42);
+
+	EXPECT_GE(sketch.Estimate(42), 5U);
+
+	/* saturation */
+	for (unsigned i = 0; i < 100; ++i)
+		sketch.Increment(43);
+
+	EXPECT_EQ(sketch.Estimate(43), FrequencySketch::MAX_FREQUENCY);
+
+	sketch.Clear();
+	EXPECT_EQ(sketch.Estimate(42), 0U);
+	EXPECT_EQ(sketch.Estimate(43), 0U);
+}
+
+TEST(FrequencySketch, Aging)
+{
+	FrequencySketch sketch(16);
+
+	for (unsigned i = 0; i < 8; ++i)
+		sketch.Increment(1);
+
+	const unsigned before = sketch.Estimate(1);
+
+	/* many increments of other keys trigger the periodic
+	   halving */
+	for (std::size_t i = 0; i < 1000; ++i)
+		sketch.Increment(1000 + i);
+
+	EXPECT_LT(sketch.Estimate(1), before);
+}
+
+static constexpr auto far_future = std::chrono::steady_clock::time_point::max();
+
+static void
+Offer(FilterHotCache &cache, const std::string &key,
+      std::chrono::steady_clock::time_point expires=far_future)
+{
+	const StringMap headers;
+	const auto body = std::as_bytes(std::span{key});
+	cache.Offer(key, FilterHotCache::Hash(key), nullptr, expires,
+		    HTTP_STATUS_OK, headers, body);
+}
+
+static void
+Touch(FilterHotCache &cache, const std::string &key, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		cache.Touch(FilterHotCache::Hash(key));
+}
+
+static bool
+Contains(FilterHotCache &cache, const std::string &key)
+{
+	const auto now = std::chrono::steady_clock::now();
+	return cache.Get(key, FilterHotCache::Hash(key), now) != nullptr;
+}
+
+TEST(FilterHotCache, Admission)
+{
+	TestPool pool;
+	FilterHotCache cache(pool, 1024 * 1024);
+
+	/* requested only once: not admitted */
+	Touch(cache, "a", 1);
+	Offer(cache, "a");
+	EXPECT_FALSE(Contains(cache, "a"));
+
+	Touch(cache, "a", 1);
+	Offer(cache, "a");
+	EXPECT_TRUE(Contains(cache, "a"));
+
+	const auto *item = cache.Get("a"sv, FilterHotCache::Hash("a"sv),
+				     std::chrono::steady_clock::now());
+	ASSERT_NE(item, nullptr);
+	EXPECT_EQ(item->status, HTTP_STATUS_OK);
+	EXPECT_EQ(item->body.size(), 1U);
+
+	/* expired items are removed */
+	Touch(cache, "b", 2);
+	Offer(cache, "b", std::chrono::steady_clock::now());
+	EXPECT_FALSE(Contains(cache, "b"));
+
+	cache.Remove("a"sv, FilterHotCache::Hash("a"sv));
+	EXPECT_FALSE(Contains(cache, "a"));
+	EXPECT_EQ(cache.GetSize(), 0U);
+}
+
+TEST(FilterHotCache, Eviction)
+{
+	TestPool pool;
+	FilterHotCache cache(pool, 1024 * 1024);
+
+	/* fill the cache with moderately popular items */
+	for (std::size_t i = 0; i < FilterHotCache::MAX_ITEMS; ++i) {
+		const auto key = std::to_string(i);
+		Touch(cache, key, 3);
+		Offer(cache, key);
+	}
+
+	for (std::size_t i = 0; i < FilterHotCache::MAX_ITEMS; ++i)
+		ASSERT_TRUE(Contains(cache, std::to_string(i)));
+
+	/* a less popular candidate is rejected */
+	Touch(cache, "x", 2);
+	Offer(cache, "x");
+	EXPECT_FALSE(Contains(cache, "x"));
+
+	/* a more popular candidate displaces the least recently
+	   used item */
+	Touch(cache, "y", 10);
+	Offer(cache, "y");
+	EXPECT_TRUE(Contains(cache, "y"));
+	EXPECT_FALSE(Contains(cache, "0"));
+
+	/* remove every second item; the others must still be found
+	   (this verifies the hash table deletion) */
+	for (std::size_t i = 1; i < FilterHotCache::MAX_ITEMS; i += 2) {
+		const auto key = std::to_string(i);
+		cache.Remove(key, FilterHotCache::Hash(key));
+	}
+
+	for (std::size_t i = 2; i < FilterHotCache::MAX_ITEMS; ++i)
+		EXPECT_EQ(Contains(cache, std::to_string(i)), i % 2 == 0);
+
+	cache.Clear();
+	EXPECT_EQ(cache.GetSize(), 0U);
+	EXPECT_FALSE(Contains(cache, "y"));
+}
+
+TEST(FilterHotCache, SizeLimit)
+{
+	TestPool pool;
+
+	StringMap headers;
+	headers.Add(pool, "content-type", "text/plain");
+
+	const std::string body(1000, 'x');
+	const auto body_bytes = std::as_bytes(std::span{body});
+
+	/* all keys have the same length, therefore all items have
+	   the same size */
+	const std::size_t item_size =
+		FilterHotCache::CalcSize("k0", nullptr, headers, body_bytes);
+
+	FilterHotCache cache(pool, 3 * item_size);
+
+	for (unsigned i = 0; i < 5; ++i) {
+		const auto key = "k" + std::to_string(i);
+		Touch(cache, key, 2 + i);
+		cache.Offer(key, FilterHotCache::Hash(key), nullptr,
+			    far_future, HTTP_STATUS_OK, headers, body_bytes);
+
+		/* admission and accounting use the same measure */
+		EXPECT_LE(cache.GetSize(), 3 * item_size);
+		EXPECT_EQ(cache.GetSize() % item_size, 0U);
+	}
+
+	EXPECT_EQ(cache.GetSize(), 3 * item_size);
+	EXPECT_FALSE(Contains(cache, "k1"));
+	EXPECT_TRUE(Contains(cache, "k4"));
+
+	cache.Clear();
+}
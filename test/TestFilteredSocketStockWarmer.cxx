@@ -0,0 +1,171 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "fs/Warmer.hxx"
+#include "fs/Stock.hxx"
+#include "net/FailureRef.hxx"
+#include "memory/fb_pool.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "event/Loop.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct DummyFailureInfo final : ReferencedFailureInfo {
+protected:
+	void Destroy() noexcept override {}
+};
+
+struct Context {
+	EventLoop event_loop;
+
+	[[no_unique_address]]
+	const ScopeFbPoolInit fb_pool_init;
+
+	FineTimerEvent timer{event_loop, BIND_THIS_METHOD(OnTimer)};
+
+	FilteredSocketStock stock{event_loop, 0};
+
+	AllocatedSocketAddress address;
+
+	/**
+	 * A listener which never accepts; the kernel completes the
+	 * handshake, which is all the warmer needs.
+	 */
+	UniqueSocketDescriptor listener;
+
+	DummyFailureInfo failure;
+
+	explicit Context(const char *name, bool listen=true) {
+		address.SetLocal(("@beng-proxy-TestFilteredSocketStockWarmer-" +
+				  std::string{name} + "-" +
+				  std::to_string(getpid())).c_str());
+
+		if (listen &&
+		    (!listener.CreateNonBlock(AF_LOCAL, SOCK_STREAM, 0) ||
+		     !listener.Bind(address) || !listener.Listen(16)))
+			throw std::runtime_error("Failed to listen");
+	}
+
+	unsigned GetIdleCount() noexcept {
+		return stock.GetIdleCount("test");
+	}
+
+	/**
+	 * Run the #EventLoop until the predicate becomes true (or
+	 * until a timeout expires).
+	 */
+	template<typename P>
+	void RunUntil(P &&predicate) noexcept {
+		for (unsigned i = 0; i < 500 && !predicate(); ++i) {
+			timer.Schedule(std::chrono::milliseconds{10});
+			event_loop.Dispatch();
+		}
+	}
+
+	/**
+	 * Run the #EventLoop for the given number of milliseconds.
+	 */
+	void Run(unsigned ms) noexcept {
+		RunUntil([n = ms / 10]() mutable { return n-- == 0; });
+	}
+
+	void OnTimer() noexcept {
+		event_loop.Break();
+	}
+};
+
+TEST(FilteredSocketStockWarmer, MinIdle)
+{
+	Context c{"MinIdle"};
+
+	FilteredSocketStockWarmer warmer{c.stock, c.address, "test",
+					 c.failure, 2};
+
+	c.RunUntil([&c]{ return c.GetIdleCount() >= 2; });
+	EXPECT_EQ(c.GetIdleCount(), 2U);
+	EXPECT_TRUE(c.failure.Check(c.event_loop.SteadyNow()));
+
+	/* requests which find no idle connection raise the target
+	   with the next tick */
+	for (unsigned i = 0; i < 4; ++i)
+		warmer.OnRequest(0);
+
+	c.RunUntil([&c]{ return c.GetIdleCount() >= 4; });
+	EXPECT_EQ(c.GetIdleCount(), 4U);
+}
+
+TEST(FilteredSocketStockWarmer, Failed)
+{
+	Context c{"Failed"};
+
+	/* the member is known to be failing: don't connect */
+	c.failure.SetConnect(c.event_loop.SteadyNow(),
+			     std::chrono::seconds(20));
+
+	FilteredSocketStockWarmer warmer{c.stock, c.address, "test",
+					 c.failure, 2};
+
+	c.Run(200);
+	EXPECT_EQ(c.GetIdleCount(), 0U);
+
+	/* the member has recovered: the next tick tops up the
+	   stock */
+	c.failure.UnsetConnect();
+
+	c.RunUntil([&c]{ return c.GetIdleCount() >= 2; });
+	EXPECT_EQ(c.GetIdleCount(), 2U);
+}
+
+TEST(FilteredSocketStockWarmer, ConnectError)
+{
+	Context c{"ConnectError", false};
+
+	FilteredSocketStockWarmer warmer{c.stock, c.address, "test",
+					 c.failure, 2};
+
+	/* nobody listens: the failed connect is reported to the
+	   balancer */
+	c.RunUntil([&c]{
+		return !c.failure.CheckConnect(c.event_loop.SteadyNow());
+	});
+
+	EXPECT_FALSE(c.failure.CheckConnect(c.event_loop.SteadyNow()));
+	EXPECT_EQ(c.GetIdleCount(), 0U);
+}
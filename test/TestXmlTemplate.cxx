@@ -0,0 +1,235 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FailingResourceLoader.hxx"
+#include "PInstance.hxx"
+#include "bp/XmlProcessor.hxx"
+#include "bp/XmlTemplate.hxx"
+#include "bp/XmlTemplateCache.hxx"
+#include "parser/XmlParser.hxx"
+#include "widget/Context.hxx"
+#include "widget/Widget.hxx"
+#include "widget/Ptr.hxx"
+#include "istream/Sink.hxx"
+#include "istream/istream_string.hxx"
+#include "pool/pool.hxx"
+#include "pool/SharedPtr.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using std::string_view_literals::operator""sv;
+
+/**
+ * Logs all parser events as a string.  Consecutive character data
+ * is merged, because #XmlParser and #XmlTemplatePlayer may split it
+ * differently.
+ */
+class EventLog final : public XmlParserHandler, public XmlTemplateEntityHandler {
+	std::string cdata;
+
+public:
+	std::string log;
+
+	std::string Finish() noexcept {
+		FlushCdata();
+		return std::move(log);
+	}
+
+private:
+	void FlushCdata() noexcept {
+		if (!cdata.empty()) {
+			log += "[" + cdata + "]";
+			cdata.clear();
+		}
+	}
+
+	/* virtual methods from class XmlParserHandler */
+	bool OnXmlTagStart(const XmlParserTag &tag) noexcept override {
+		FlushCdata();
+		log += "<" + std::string{tag.name} + "@" +
+			std::to_string(tag.start);
+		return true;
+	}
+
+	bool OnXmlTagFinished(const XmlParserTag &tag) noexcept override {
+		log += "-" + std::to_string(tag.end) + "/" +
+			std::to_string(int(tag.type)) + ">";
+		return true;
+	}
+
+	void OnXmlAttributeFinished(const XmlParserAttribute &attr) noexcept override {
+		log += " " + std::string{attr.name} + "=" +
+			std::string{attr.value} + "@" +
+			std::to_string(attr.value_start) + "-" +
+			std::to_string(attr.value_end);
+	}
+
+	size_t OnXmlCdata(std::string_view text, bool,
+			  off_t) noexcept override {
+		cdata.append(text);
+		return text.size();
+	}
+
+	/* virtual methods from class XmlTemplateEntityHandler */
+	void OnXmlTemplateEntity(off_t start, off_t,
+				 std::string_view entity) noexcept override {
+		FlushCdata();
+		log += std::string{entity} + "@" + std::to_string(start);
+	}
+};
+
+struct StringSinkCollector final : IstreamSink {
+	std::string value;
+
+	explicit StringSinkCollector(UnusedIstreamPtr &&_input) noexcept
+		:IstreamSink(std::move(_input)) {}
+
+	void LoopRead() noexcept {
+		while (input.IsDefined())
+			input.Read();
+	}
+
+	/* virtual methods from class IstreamHandler */
+
+	size_t OnData(std::span<const std::byte> src) noexcept override {
+		value.append((const char *)src.data(), src.size());
+		return src.size();
+	}
+
+	void OnEof() noexcept override {
+		ClearInput();
+	}
+
+	void OnError(std::exception_ptr) noexcept override {
+		ClearInput();
+		value = "error";
+	}
+};
+
+TEST(XmlTemplate, Entities)
+{
+	PInstance instance;
+
+	EXPECT_TRUE(XmlTemplate::Compile("<p>&c:id;</p>"sv)->IsReplayable());
+	EXPECT_TRUE(XmlTemplate::Compile("<script>x='&c:uri;'</script>"sv)->IsReplayable());
+	EXPECT_TRUE(XmlTemplate::Compile("<p>&amp;&c:foo;</p>"sv)->IsReplayable());
+	EXPECT_FALSE(XmlTemplate::Compile("<a href=\"&c:uri;\">"sv)->IsReplayable());
+	EXPECT_FALSE(XmlTemplate::Compile("<!-- &c:id; -->"sv)->IsReplayable());
+	EXPECT_FALSE(XmlTemplate::Compile("<style>p{}&c:id;</style>"sv)->IsReplayable());
+	EXPECT_FALSE(XmlTemplate::Compile("<c:widget id=\"a\">&c:id;</c:widget>"sv)->IsReplayable());
+}
+
+TEST(XmlTemplate, Replay)
+{
+	PInstance instance;
+
+	static constexpr std::string_view src =
+		"<html lang=\"de\"><body class='x'>foo"
+		"<img src=a.png alt=\"\"/>bar<![CDATA[a]]b]]>"
+		"<br></body></html>"sv;
+
+	EventLog expected;
+	XmlParser parser(instance.root_pool, expected);
+	parser.Feed(src.data(), src.size());
+
+	auto t = XmlTemplate::Compile(src);
+	ASSERT_TRUE(t->IsReplayable());
+	ASSERT_EQ(t->GetSize(), off_t(src.size()));
+
+	/* feed the player one byte at a time */
+	EventLog actual;
+	XmlTemplatePlayer player(std::move(t), actual, actual);
+	for (std::size_t i = 0; i < src.size(); ++i)
+		ASSERT_TRUE(player.Feed(src.substr(i, 1)));
+
+	EXPECT_TRUE(player.IsComplete());
+	EXPECT_EQ(actual.Finish(), expected.Finish());
+}
+
+static std::string
+Process(PInstance &instance, std::string_view src,
+	XmlTemplateCache *template_cache)
+{
+	auto pool = pool_new_linear(instance.root_pool, "test", 8192);
+
+	FailingResourceLoader resource_loader;
+
+	auto ctx = SharedPoolPtr<WidgetContext>::Make
+		(*pool, instance.event_loop,
+		 resource_loader, resource_loader,
+		 nullptr,
+		 nullptr, nullptr,
+		 "localhost:8080",
+		 "localhost:8080",
+		 "/beng.html",
+		 "http://localhost:8080/beng.html",
+		 "/beng.html"sv,
+		 nullptr,
+		 nullptr, nullptr, SessionId{}, nullptr,
+		 nullptr);
+	auto &widget = ctx->AddRootWidget(MakeRootWidget(*pool, nullptr));
+
+	StringSinkCollector sink(processor_process(*pool, nullptr,
+						   istream_string_new(*pool, src),
+						   widget, std::move(ctx),
+						   PROCESSOR_REWRITE_URL|PROCESSOR_CONTAINER,
+						   template_cache, "test"));
+	sink.LoopRead();
+	return std::move(sink.value);
+}
+
+TEST(XmlTemplate, Processor)
+{
+	PInstance instance;
+
+	static constexpr std::string_view src =
+		"<html><head><script>if (a<b) x('&c:uri;');</script></head>"
+		"<body><p>&c:base; &c:session;</p>"
+		"<a href=\"foo\">bar</a></body></html>"sv;
+
+	const auto expected = Process(instance, src, nullptr);
+
+	XmlTemplateCache template_cache(instance.root_pool,
+					instance.event_loop);
+
+	/* the first call records the template */
+	EXPECT_EQ(Process(instance, src, &template_cache), expected);
+
+	const auto t = template_cache.Get("test");
+	ASSERT_TRUE(t);
+	ASSERT_TRUE(t->IsReplayable());
+
+	/* the second call replays it */
+	EXPECT_EQ(Process(instance, src, &template_cache), expected);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark for the per-handshake certificate setup: performs many
+ * TLS handshakes in memory (through a BIO pair), each with a
+ * different server certificate selected by the certificate
+ * callback, and prints the number of handshakes per second.  The
+ * "use" mode installs the certificate/key pair into each #SSL
+ * (like #CertCache used to do); the "switch" mode switches to a
+ * prebuilt per-certificate #SSL_CTX.
+ */
+
+#include "ssl/Basic.hxx"
+#include "ssl/CertCtx.hxx"
+#include "lib/openssl/Ctx.hxx"
+#include "lib/openssl/Dummy.hxx"
+#include "lib/openssl/Error.hxx"
+#include "lib/openssl/Key.hxx"
+#include "lib/openssl/UniqueEVP.hxx"
+#include "lib/openssl/UniqueSSL.hxx"
+#include "lib/openssl/UniqueX509.hxx"
+#include "util/PrintException.hxx"
+#include "util/StringAPI.hxx"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum class Mode {
+	USE,
+	SWITCH,
+};
+
+struct Certificate {
+	UniqueEVP_PKEY key;
+	UniqueX509 cert;
+	SslCtx ssl_ctx;
+
+	explicit Certificate(const char *name)
+		:key(GenerateEcKey()),
+		 cert(MakeSelfSignedDummyCert(*key, name)),
+		 ssl_ctx(MakeCertSslCtx(*cert, *key, nullptr)) {}
+};
+
+struct Context {
+	std::vector<Certificate> certificates;
+
+	Mode mode;
+
+	std::size_t next = 0;
+
+	bool error = false;
+
+	Certificate &Next() noexcept {
+		auto &c = certificates[next];
+		next = (next + 1) % certificates.size();
+		return c;
+	}
+
+	int OnCertCallback(SSL &ssl) noexcept
+	try {
+		auto &c = Next();
+
+		switch (mode) {
+		case Mode::USE:
+			ERR_clear_error();
+			if (SSL_use_PrivateKey(&ssl, c.key.get()) != 1)
+				throw SslError("SSL_use_PrivateKey() failed");
+			if (SSL_use_certificate(&ssl, c.cert.get()) != 1)
+				throw SslError("SSL_use_certificate() failed");
+			break;
+
+		case Mode::SWITCH:
+			SwitchSslCtx(ssl, *c.ssl_ctx);
+			break;
+		}
+
+		return 1;
+	} catch (...) {
+		PrintException(std::current_exception());
+		error = true;
+		return 0;
+	}
+
+	static int CertCallback(SSL *ssl, void *ctx) noexcept {
+		return ((Context *)ctx)->OnCertCallback(*ssl);
+	}
+};
+
+static void
+Handshake(SSL_CTX &server_ctx, SSL_CTX &client_ctx)
+{
+	UniqueSSL server(SSL_new(&server_ctx)), client(SSL_new(&client_ctx));
+	if (!server || !client)
+		throw SslError("SSL_new() failed");
+
+	BIO *a, *b;
+	if (BIO_new_bio_pair(&a, 0, &b, 0) != 1)
+		throw SslError("BIO_new_bio_pair() failed");
+
+	SSL_set_bio(client.get(), a, a);
+	SSL_set_bio(server.get(), b, b);
+
+	SSL_set_connect_state(client.get());
+	SSL_set_accept_state(server.get());
+
+	bool client_done = false, server_done = false;
+	while (!client_done || !server_done) {
+		ERR_clear_error();
+
+		if (!client_done) {
+			int result = SSL_do_handshake(client.get());
+			if (result == 1)
+				client_done = true;
+			else if (SSL_get_error(client.get(), result) != SSL_ERROR_WANT_READ)
+				throw SslError("Client handshake failed");
+		}
+
+		if (!server_done) {
+			int result = SSL_do_handshake(server.get());
+			if (result == 1)
+				server_done = true;
+			else if (SSL_get_error(server.get(), result) != SSL_ERROR_WANT_READ)
+				throw SslError("Server handshake failed");
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+try {
+	unsigned n_certificates = 1000;
+	unsigned n_handshakes = 10000;
+
+	for (int i = 1; i < argc;) {
+		if (StringIsEqual(argv[i], "--certs") && i + 1 < argc) {
+			n_certificates = strtoul(argv[i + 1], nullptr, 10);
+			i += 2;
+		} else if (StringIsEqual(argv[i], "--count") && i + 1 < argc) {
+			n_handshakes = strtoul(argv[i + 1], nullptr, 10);
+			i += 2;
+		} else {
+			fprintf(stderr, "Usage: bench_cert_switch [--certs N] [--count N]\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (n_certificates == 0 || n_handshakes == 0)
+		throw std::runtime_error("Counts must be positive");
+
+	Context context;
+	context.certificates.reserve(n_certificates);
+	for (unsigned i = 0; i < n_certificates; ++i) {
+		const auto name = "host" + std::to_string(i) + ".example.com";
+		context.certificates.emplace_back(name.c_str());
+	}
+
+	auto server_ctx = CreateBasicSslCtx(true);
+	SSL_CTX_set_cert_cb(server_ctx.get(), Context::CertCallback, &context);
+
+	auto client_ctx = CreateBasicSslCtx(false);
+
+	for (const Mode mode : {Mode::USE, Mode::SWITCH}) {
+		context.mode = mode;
+		context.next = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		for (unsigned i = 0; i < n_handshakes; ++i)
+			Handshake(*server_ctx, *client_ctx);
+
+		const std::chrono::duration<double> duration =
+			std::chrono::steady_clock::now() - start;
+
+		if (context.error)
+			return EXIT_FAILURE;
+
+		printf("%s: %u handshakes with %u certificates in %.3fs: %.0f handshakes/s\n",
+		       mode == Mode::USE ? "use" : "switch",
+		       n_handshakes, n_certificates, duration.count(),
+		       n_handshakes / duration.count());
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
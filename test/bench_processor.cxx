@@ -0,0 +1,267 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark for the XML processor: processes the template from
+ * stdin repeatedly, first without and then with the
+ * #XmlTemplateCache, and prints the average duration.
+ */
+
+#include "FailingResourceLoader.hxx"
+#include "PInstance.hxx"
+#include "memory/fb_pool.hxx"
+#include "bp/XmlProcessor.hxx"
+#include "bp/XmlTemplate.hxx"
+#include "bp/XmlTemplateCache.hxx"
+#include "widget/Context.hxx"
+#include "widget/Inline.hxx"
+#include "widget/Widget.hxx"
+#include "widget/Ptr.hxx"
+#include "widget/RewriteUri.hxx"
+#include "istream/Sink.hxx"
+#include "istream/istream_memory.hxx"
+#include "istream/istream_string.hxx"
+#include "pool/pool.hxx"
+#include "pool/SharedPtr.hxx"
+#include "util/PrintException.hxx"
+#include "util/SpanCast.hxx"
+#include "stopwatch.hxx"
+
+#include <chrono>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using std::string_view_literals::operator""sv;
+
+/*
+ * emulate missing libraries
+ *
+ */
+
+UnusedIstreamPtr
+embed_inline_widget(struct pool &pool,
+		    SharedPoolPtr<WidgetContext>,
+		    const StopwatchPtr &,
+		    gcc_unused bool plain_text,
+		    Widget &widget) noexcept
+{
+	const char *s = widget.GetIdPath();
+	if (s == nullptr)
+		s = "widget";
+
+	return istream_string_new(pool, s);
+}
+
+RewriteUriMode
+parse_uri_mode(std::string_view) noexcept
+{
+	return RewriteUriMode::DIRECT;
+}
+
+UnusedIstreamPtr
+rewrite_widget_uri(gcc_unused struct pool &pool,
+		   SharedPoolPtr<WidgetContext>, const StopwatchPtr &,
+		   gcc_unused Widget &widget,
+		   std::string_view,
+		   gcc_unused RewriteUriMode mode,
+		   gcc_unused bool stateful,
+		   gcc_unused const char *view,
+		   gcc_unused const struct escape_class *escape) noexcept
+{
+	return nullptr;
+}
+
+/**
+ * Collects the processor output in a std::string.
+ */
+struct StringCollector final : IstreamSink {
+	std::string value;
+	bool error = false;
+
+	explicit StringCollector(UnusedIstreamPtr &&_input) noexcept
+		:IstreamSink(std::move(_input)) {}
+
+	void LoopRead() noexcept {
+		while (input.IsDefined())
+			input.Read();
+	}
+
+	/* virtual methods from class IstreamHandler */
+
+	size_t OnData(std::span<const std::byte> src) noexcept override {
+		value.append((const char *)src.data(), src.size());
+		return src.size();
+	}
+
+	void OnEof() noexcept override {
+		ClearInput();
+	}
+
+	void OnError(std::exception_ptr ep) noexcept override {
+		ClearInput();
+		PrintException(ep);
+		error = true;
+	}
+};
+
+static std::string
+ReadStdin()
+{
+	std::string result;
+
+	char buffer[16384];
+	size_t nbytes;
+	while ((nbytes = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+		result.append(buffer, nbytes);
+
+	if (ferror(stdin))
+		throw std::runtime_error("Failed to read from stdin");
+
+	return result;
+}
+
+/**
+ * Process the template once and return the output.
+ */
+static std::string
+ProcessOnce(PInstance &instance, ResourceLoader &resource_loader,
+	    std::string_view src,
+	    XmlTemplateCache *template_cache)
+{
+	auto pool = pool_new_linear(instance.root_pool, "iteration", 16384);
+
+	auto ctx = SharedPoolPtr<WidgetContext>::Make
+		(*pool, instance.event_loop,
+		 resource_loader, resource_loader,
+		 nullptr,
+		 nullptr, nullptr,
+		 "localhost:8080",
+		 "localhost:8080",
+		 "/beng.html",
+		 "http://localhost:8080/beng.html",
+		 "/beng.html"sv,
+		 nullptr,
+		 nullptr, nullptr, SessionId{}, nullptr,
+		 nullptr);
+	auto &widget = ctx->AddRootWidget(MakeRootWidget(*pool, nullptr));
+
+	StringCollector sink(processor_process(*pool, nullptr,
+					       istream_memory_new(*pool, AsBytes(src)),
+					       widget, std::move(ctx),
+					       PROCESSOR_CONTAINER|PROCESSOR_REWRITE_URL,
+					       template_cache,
+					       template_cache != nullptr
+					       ? "bench" : nullptr));
+	sink.LoopRead();
+
+	if (sink.error)
+		throw std::runtime_error("Processor failed");
+
+	return std::move(sink.value);
+}
+
+/**
+ * @return the average duration of one iteration
+ */
+static std::chrono::duration<double>
+Benchmark(PInstance &instance, ResourceLoader &resource_loader,
+	  std::string_view src, XmlTemplateCache *template_cache,
+	  unsigned n_iterations)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < n_iterations; ++i)
+		ProcessOnce(instance, resource_loader, src, template_cache);
+
+	return (std::chrono::steady_clock::now() - start) / n_iterations;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [ITERATIONS] <TEMPLATE\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const unsigned n_iterations = argc > 1
+		? strtoul(argv[1], nullptr, 10)
+		: 1000;
+	if (n_iterations == 0)
+		throw std::runtime_error("Invalid number of iterations");
+
+	const auto src = ReadStdin();
+
+	const ScopeFbPoolInit fb_pool_init;
+	PInstance instance;
+
+	FailingResourceLoader resource_loader;
+
+	const auto cold_output = ProcessOnce(instance, resource_loader, src,
+					     nullptr);
+	const auto cold = Benchmark(instance, resource_loader, src,
+				    nullptr, n_iterations);
+
+	XmlTemplateCache template_cache(instance.root_pool,
+					instance.event_loop);
+
+	/* the first run records the template */
+	ProcessOnce(instance, resource_loader, src, &template_cache);
+
+	const auto t = template_cache.Get("bench");
+	if (!t)
+		throw std::runtime_error("Template was not recorded");
+
+	if (!t->IsReplayable())
+		fprintf(stderr, "Template cannot be replayed\n");
+
+	const auto warm_output = ProcessOnce(instance, resource_loader, src,
+					     &template_cache);
+	const auto warm = Benchmark(instance, resource_loader, src,
+				    &template_cache, n_iterations);
+
+	printf("cold: %.1f us\n"
+	       "warm: %.1f us\n",
+	       cold.count() * 1e6, warm.count() * 1e6);
+
+	if (warm_output != cold_output) {
+		fprintf(stderr, "Output of the cached template differs\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark for the WAS client: launches a WAS application (e.g.
+ * was_mirror) and sends many small requests over one connection
+ * sequentially, optionally using the shared memory ring transport,
+ * and prints the number of requests per second.
+ */
+
+#include "was/Client.hxx"
+#include "was/Launch.hxx"
+#include "was/Lease.hxx"
+#include "stopwatch.hxx"
+#include "http/ResponseHandler.hxx"
+#include "strmap.hxx"
+#include "istream/StringSink.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "istream/istream_memory.hxx"
+#include "memory/fb_pool.hxx"
+#include "pool/pool.hxx"
+#include "pool/Ptr.hxx"
+#include "PInstance.hxx"
+#include "spawn/Config.hxx"
+#include "spawn/ChildOptions.hxx"
+#include "spawn/Registry.hxx"
+#include "spawn/Local.hxx"
+#include "event/DeferEvent.hxx"
+#include "io/Logger.hxx"
+#include "io/SpliceSupport.hxx"
+#include "util/Cancellable.hxx"
+#include "util/PrintException.hxx"
+#include "util/SpanCast.hxx"
+#include "util/StringAPI.hxx"
+
+#include <chrono>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Context final
+	: PInstance, WasLease, HttpResponseHandler, StringSinkHandler {
+
+	WasProcess process;
+
+	DeferEvent defer_next;
+
+	PoolPtr request_pool;
+
+	std::string request_body;
+
+	unsigned remaining;
+
+	bool error = false;
+
+	CancellablePointer cancel_ptr;
+
+	Context(std::size_t body_size, unsigned n_requests) noexcept
+		:defer_next(event_loop, BIND_THIS_METHOD(SendRequest)),
+		 request_body(body_size, 'x'),
+		 remaining(n_requests) {}
+
+	void SendRequest() noexcept;
+
+	void Fail() noexcept {
+		error = true;
+		process.handle.reset();
+		process.Close();
+	}
+
+	/* virtual methods from class WasLease */
+	void ReleaseWas(bool reuse) override {
+		if (!reuse) {
+			fprintf(stderr, "WAS connection not reusable\n");
+			Fail();
+		}
+	}
+
+	void ReleaseWasStop(uint64_t) override {
+		ReleaseWas(false);
+	}
+
+	/* virtual methods from class HttpResponseHandler */
+	void OnHttpResponse(http_status_t status, StringMap &&headers,
+			    UnusedIstreamPtr body) noexcept override;
+	void OnHttpError(std::exception_ptr ep) noexcept override;
+
+	/* virtual methods from class StringSinkHandler */
+	void OnStringSinkSuccess(std::string &&value) noexcept override;
+	void OnStringSinkError(std::exception_ptr ep) noexcept override;
+};
+
+void
+Context::SendRequest() noexcept
+{
+	request_pool = pool_new_linear(root_pool, "request", 8192);
+
+	was_client_request(request_pool, event_loop, nullptr,
+			   process.control,
+			   process.input, process.output,
+			   process.shm.IsDefined() ? &process.shm : nullptr,
+			   *this,
+			   nullptr,
+			   HTTP_METHOD_POST, "/",
+			   nullptr,
+			   nullptr, nullptr,
+			   *strmap_new(request_pool),
+			   istream_memory_new(request_pool,
+					      AsBytes(std::string_view{request_body})),
+			   {},
+			   *this, cancel_ptr);
+}
+
+void
+Context::OnHttpResponse(http_status_t status, StringMap &&,
+			UnusedIstreamPtr body) noexcept
+{
+	if (status != HTTP_STATUS_OK || !body) {
+		fprintf(stderr, "unexpected response: %s\n",
+			http_status_to_string(status));
+		Fail();
+		return;
+	}
+
+	ReadStringSink(NewStringSink(request_pool, std::move(body),
+				     *this, cancel_ptr));
+}
+
+void
+Context::OnHttpError(std::exception_ptr ep) noexcept
+{
+	PrintException(ep);
+	Fail();
+}
+
+void
+Context::OnStringSinkSuccess(std::string &&value) noexcept
+{
+	if (value != request_body) {
+		fprintf(stderr, "response body mismatch\n");
+		Fail();
+		return;
+	}
+
+	if (--remaining == 0) {
+		process.handle.reset();
+		process.Close();
+		return;
+	}
+
+	/* don't start the next request from inside the current one's
+	   response handler */
+	defer_next.Schedule();
+}
+
+void
+Context::OnStringSinkError(std::exception_ptr ep) noexcept
+{
+	PrintException(ep);
+	Fail();
+}
+
+int
+main(int argc, char **argv)
+try {
+	SetLogLevel(1);
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: bench_was PATH [--shm] [--count N] [--size BYTES]\n");
+		return EXIT_FAILURE;
+	}
+
+	bool shm = false;
+	unsigned n_requests = 100000;
+	std::size_t body_size = 64;
+
+	for (int i = 2; i < argc;) {
+		if (StringIsEqual(argv[i], "--shm")) {
+			shm = true;
+			++i;
+		} else if (StringIsEqual(argv[i], "--count") && i + 1 < argc) {
+			n_requests = strtoul(argv[i + 1], nullptr, 10);
+			i += 2;
+		} else if (StringIsEqual(argv[i], "--size") && i + 1 < argc) {
+			body_size = strtoul(argv[i + 1], nullptr, 10);
+			i += 2;
+		} else
+			throw std::runtime_error("Unrecognized parameter");
+	}
+
+	if (n_requests == 0 || body_size == 0)
+		throw std::runtime_error("Count and size must be positive");
+
+	direct_global_init();
+
+	SpawnConfig spawn_config;
+
+	const ScopeFbPoolInit fb_pool_init;
+
+	Context context(body_size, n_requests);
+
+	ChildOptions child_options;
+	child_options.no_new_privs = true;
+
+	ChildProcessRegistry child_process_registry;
+	LocalSpawnService spawn_service(spawn_config, context.event_loop,
+					child_process_registry);
+
+	context.process = was_launch(spawn_service, "was",
+				     argv[1], {},
+				     child_options, {}, shm);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	context.SendRequest();
+	context.event_loop.Dispatch();
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	if (context.error)
+		return EXIT_FAILURE;
+
+	printf("%s: %u requests with %zu byte bodies in %.3fs: %.0f req/s\n",
+	       shm ? "shm" : "pipe",
+	       n_requests, body_size, duration.count(),
+	       n_requests / duration.count());
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	PrintException(e);
+	return EXIT_FAILURE;
+}
@@ -47,6 +47,8 @@
 #include "util/PrintException.hxx"
 #include "AllocatorPtr.hxx"
 
+#include <vector>
+
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -58,29 +60,39 @@ static StockMap *delegate_stock;
 class MyDelegateHandler final : public DelegateHandler {
 	DeferEvent defer_stop;
 
+	/**
+	 * The number of pending requests.
+	 */
+	unsigned pending;
+
 public:
-	MyDelegateHandler(EventLoop &event_loop)
-		:defer_stop(event_loop, BIND_THIS_METHOD(Stop)) {}
+	MyDelegateHandler(EventLoop &event_loop, unsigned _pending)
+		:defer_stop(event_loop, BIND_THIS_METHOD(Stop)),
+		 pending(_pending) {}
 
 	void Stop() noexcept {
 		delegate_stock_free(delegate_stock);
 	}
 
-	void OnDelegateSuccess(UniqueFileDescriptor) override {
-		defer_stop.Schedule();
+	void OnDelegateSuccess(UniqueFileDescriptor fd) override {
+		printf("%d\n", fd.Get());
+
+		if (--pending == 0)
+			defer_stop.Schedule();
 	}
 
 	void OnDelegateError(std::exception_ptr ep) override {
 		PrintException(ep);
 
-		defer_stop.Schedule();
+		if (--pending == 0)
+			defer_stop.Schedule();
 	}
 };
 
 int main(int argc, char **argv)
 {
-	if (argc != 2) {
-		fprintf(stderr, "usage: run-delegate PATH\n");
+	if (argc < 2) {
+		fprintf(stderr, "usage: run-delegate PATH...\n");
 		return 1;
 	}
 
@@ -93,17 +105,21 @@ int main(int argc, char **argv)
 	LocalSpawnService spawn_service(spawn_config, instance.event_loop,
 					child_process_registry);
 
-	delegate_stock = delegate_stock_new(instance.event_loop, spawn_service);
+	delegate_stock = delegate_stock_new(instance.event_loop, spawn_service,
+					    false);
 	const auto pool = pool_new_linear(instance.root_pool, "test", 8192);
 
 	ChildOptions child_options;
 
-	MyDelegateHandler handler(instance.event_loop);
-	CancellablePointer cancel_ptr;
-	delegate_stock_open(delegate_stock, AllocatorPtr{pool},
-			    helper_path, child_options,
-			    argv[1],
-			    handler, cancel_ptr);
+	/* all requests are pipelined over one helper connection */
+	const unsigned n = argc - 1;
+	MyDelegateHandler handler(instance.event_loop, n);
+	std::vector<CancellablePointer> cancel_ptrs(n);
+	for (unsigned i = 0; i < n; ++i)
+		delegate_stock_open(delegate_stock, AllocatorPtr{pool},
+				    helper_path, child_options,
+				    argv[1 + i],
+				    handler, cancel_ptrs[i]);
 
 	instance.event_loop.Dispatch();
 }
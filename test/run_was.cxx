@@ -231,12 +231,13 @@ try {
 
 	context.process = was_launch(spawn_service, "was",
 				     argv[1], {},
-				     child_options, {});
+				     child_options, {}, false);
 
 	was_client_request(context.root_pool, context.event_loop, nullptr,
 			   context.process.control,
 			   context.process.input,
 			   context.process.output,
+			   nullptr,
 			   context,
 			   nullptr,
 			   HTTP_METHOD_GET, uri,
@@ -45,6 +45,7 @@
 
 #include <gtest/gtest.h>
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -450,3 +451,241 @@ TEST(BalancerTest, StickyCookie)
 	ASSERT_NE(result, nullptr);
 	ASSERT_EQ(Find(al, result), 2);
 }
+
+static AddressList
+MakeStickyList(AllocatorPtr alloc, StickyMode sticky_mode,
+	       unsigned n) noexcept
+{
+	AddressListBuilder b;
+	b.SetStickyMode(sticky_mode);
+
+	for (unsigned i = 1; i <= n; ++i) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "10.0.0.%u", i);
+		b.Add(alloc, ParseSocketAddress(buffer, 80, false));
+	}
+
+	return b.Finish(alloc);
+}
+
+/**
+ * Verify that rendezvous hashing (used for "source_ip", "host" and
+ * "xhost") only reassigns the keys of a member which was added or
+ * which failed, and measure the percentage of remapped keys.
+ */
+TEST(BalancerTest, StickyRendezvous)
+{
+	FailureManager fm;
+	EventLoop event_loop;
+	MyBalancer balancer(fm);
+
+	TestPool pool;
+	const AllocatorPtr alloc{pool};
+
+	constexpr unsigned N_MEMBERS = 10, N_KEYS = 10000;
+
+	const auto al = MakeStickyList(alloc, StickyMode::SOURCE_IP,
+				       N_MEMBERS);
+	const auto al_added = MakeStickyList(alloc, StickyMode::SOURCE_IP,
+					     N_MEMBERS + 1);
+
+	unsigned counts[N_MEMBERS]{};
+	int picks[N_KEYS];
+
+	for (unsigned i = 0; i < N_KEYS; ++i) {
+		picks[i] = Find(al, balancer.Get(al, i + 1));
+		ASSERT_GE(picks[i], 0);
+		++counts[picks[i]];
+
+		/* stable */
+		ASSERT_EQ(Find(al, balancer.Get(al, i + 1)), picks[i]);
+	}
+
+	/* the keys are spread over all members */
+	for (unsigned count : counts) {
+		EXPECT_GT(count, N_KEYS / N_MEMBERS / 2);
+		EXPECT_LT(count, N_KEYS / N_MEMBERS * 2);
+	}
+
+	/* add a member: only keys which move to the new member may be
+	   remapped (PickModulo() would remap about 90% of them) */
+
+	unsigned moved = 0;
+	for (unsigned i = 0; i < N_KEYS; ++i) {
+		const int pick = Find(al_added, balancer.Get(al_added, i + 1));
+		if (pick != picks[i]) {
+			ASSERT_EQ(pick, int(N_MEMBERS));
+			++moved;
+		}
+	}
+
+	RecordProperty("remap_percent_added", moved * 100 / N_KEYS);
+	EXPECT_GT(moved, N_KEYS / (N_MEMBERS + 1) / 2);
+	EXPECT_LT(moved, N_KEYS / (N_MEMBERS + 1) * 2);
+
+	/* fail a member: only its own keys may be remapped, and none
+	   of them may stay on the failed member */
+
+	FailureAdd(fm, "10.0.0.4");
+
+	moved = 0;
+	for (unsigned i = 0; i < N_KEYS; ++i) {
+		const int pick = Find(al, balancer.Get(al, i + 1));
+		if (picks[i] == 3) {
+			ASSERT_NE(pick, 3);
+			++moved;
+		} else
+			ASSERT_EQ(pick, picks[i]);
+	}
+
+	RecordProperty("remap_percent_failed", moved * 100 / N_KEYS);
+	EXPECT_EQ(moved, counts[3]);
+
+	/* recovery moves the keys back */
+
+	FailureRemove(fm, "10.0.0.4");
+
+	for (unsigned i = 0; i < N_KEYS; ++i)
+		ASSERT_EQ(Find(al, balancer.Get(al, i + 1)), picks[i]);
+}
+
+TEST(BalancerTest, Outlier)
+{
+	using std::chrono::milliseconds;
+	using std::chrono::seconds;
+
+	FailureManager fm;
+	auto &info = fm.Make(ParseSocketAddress("192.168.0.1", 80, false));
+
+	const Expiry now = Expiry::Now();
+
+	/* disabled by default */
+
+	for (unsigned i = 0; i < 100; ++i)
+		info.AddResult(fm.GetOutlierConfig(), now, true, milliseconds(1));
+	ASSERT_EQ(info.GetStatus(now), FailureStatus::OK);
+
+	OutlierConfig config;
+	config.consecutive_errors = 5;
+	config.latency_factor = 10;
+	config.latency_samples = 3;
+	fm.SetOutlierConfig(config);
+
+	/* consecutive server errors; a success resets the counter */
+
+	info.AddResult(fm.GetOutlierConfig(), now, false, milliseconds(10));
+
+	for (unsigned i = 0; i < 4; ++i)
+		info.AddResult(fm.GetOutlierConfig(), now, true, milliseconds(1));
+	ASSERT_EQ(info.GetStatus(now), FailureStatus::OK);
+
+	info.AddResult(fm.GetOutlierConfig(), now, false, milliseconds(10));
+
+	for (unsigned i = 0; i < 4; ++i)
+		info.AddResult(fm.GetOutlierConfig(), now, true, milliseconds(1));
+	ASSERT_EQ(info.GetStatus(now), FailureStatus::OK);
+
+	info.AddResult(fm.GetOutlierConfig(), now, true, milliseconds(1));
+	ASSERT_EQ(info.GetStatus(now), FailureStatus::OUTLIER);
+	ASSERT_EQ(info.GetStatus(Expiry::Touched(now, seconds(9))),
+		  FailureStatus::OUTLIER);
+	ASSERT_EQ(info.GetStatus(Expiry::Touched(now, seconds(10))),
+		  FailureStatus::OK);
+
+	/* the second ejection lasts twice as long */
+
+	const Expiry later = Expiry::Touched(now, seconds(10));
+
+	for (unsigned i = 0; i < 5; ++i)
+		info.AddResult(fm.GetOutlierConfig(), later, true, milliseconds(1));
+	ASSERT_EQ(info.GetStatus(Expiry::Touched(later, seconds(19))),
+		  FailureStatus::OUTLIER);
+	ASSERT_EQ(info.GetStatus(Expiry::Touched(later, seconds(20))),
+		  FailureStatus::OK);
+
+	info.Unset(FailureStatus::OUTLIER);
+	ASSERT_EQ(info.GetStatus(later), FailureStatus::OK);
+
+	/* latency deviation: a sudden slowdown to 200 times the
+	   baseline ejects the host, but only after several slow
+	   responses in a row */
+
+	for (unsigned i = 0; i < 64; ++i)
+		info.AddResult(fm.GetOutlierConfig(), later, false, milliseconds(10));
+	ASSERT_EQ(info.GetStatus(later), FailureStatus::OK);
+
+	info.AddResult(fm.GetOutlierConfig(), later, false, seconds(2));
+	info.AddResult(fm.GetOutlierConfig(), later, false, seconds(2));
+	ASSERT_EQ(info.GetStatus(later), FailureStatus::OK);
+
+	/* a normal response resets the counter */
+	info.AddResult(fm.GetOutlierConfig(), later, false, milliseconds(10));
+	info.AddResult(fm.GetOutlierConfig(), later, false, seconds(2));
+	info.AddResult(fm.GetOutlierConfig(), later, false, seconds(2));
+	ASSERT_EQ(info.GetStatus(later), FailureStatus::OK);
+
+	/* responses without a meaningful latency are ignored */
+	info.AddResult(fm.GetOutlierConfig(), later, false, std::nullopt);
+	ASSERT_EQ(info.GetStatus(later), FailureStatus::OK);
+
+	info.AddResult(fm.GetOutlierConfig(), later, false, seconds(2));
+	ASSERT_EQ(info.GetStatus(later), FailureStatus::OUTLIER);
+}
+
+TEST(BalancerTest, SlowStart)
+{
+	FailureManager fm;
+	fm.SetSlowStart(std::chrono::minutes(1));
+
+	EventLoop event_loop;
+	MyBalancer balancer(fm);
+
+	TestPool pool;
+	const AllocatorPtr alloc{pool};
+
+	AddressListBuilder b;
+	b.Add(alloc, ParseSocketAddress("192.168.0.1", 80, false));
+	b.Add(alloc, ParseSocketAddress("192.168.0.2", 80, false));
+	b.Add(alloc, ParseSocketAddress("192.168.0.3", 80, false));
+	const auto al = b.Finish(alloc);
+
+	/* the second member has just recovered */
+
+	const auto recovered = ParseSocketAddress("192.168.0.2", 80, false);
+	auto &info = fm.Make(recovered);
+	info.SetMonitor();
+	info.UnsetMonitor();
+
+	ASSERT_EQ(fm.GetSlowStartWeight(Expiry::Now(), recovered), 1U);
+	ASSERT_EQ(fm.GetSlowStartWeight(Expiry::Touched(Expiry::Now(),
+							std::chrono::minutes(1)),
+					recovered),
+		  FailureInfo::SLOW_START_STEPS);
+
+	constexpr unsigned N = 240;
+	unsigned counts[3]{};
+
+	for (unsigned i = 0; i < N; ++i) {
+		const int pick = Find(al, balancer.Get(al));
+		ASSERT_GE(pick, 0);
+		++counts[pick];
+	}
+
+	/* it gets some traffic, but much less than its fair share */
+	EXPECT_GT(counts[1], 0U);
+	EXPECT_LT(counts[1], N / 3 / 2);
+	EXPECT_GT(counts[0], N / 3);
+	EXPECT_GT(counts[2], N / 3);
+
+	/* without slow start, it gets its fair share immediately */
+
+	fm.SetSlowStart({});
+
+	counts[0] = counts[1] = counts[2] = 0;
+	for (unsigned i = 0; i < N; ++i)
+		++counts[Find(al, balancer.Get(al))];
+
+	EXPECT_EQ(counts[0], N / 3);
+	EXPECT_EQ(counts[1], N / 3);
+	EXPECT_EQ(counts[2], N / 3);
+}
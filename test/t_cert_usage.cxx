@@ -0,0 +1,95 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ssl/CertUsage.hxx"
+
+#include <gtest/gtest.h>
+
+TEST(CertUsage, Key)
+{
+	EXPECT_EQ(CertUsage::MakeKey("example.com", {}), "example.com");
+	EXPECT_EQ(CertUsage::MakeKey("example.com", "ecdsa"), "example.com ecdsa");
+
+	auto [name, special] = CertUsage::SplitKey("example.com");
+	EXPECT_EQ(name, "example.com");
+	EXPECT_TRUE(special.empty());
+
+	std::tie(name, special) = CertUsage::SplitKey("*.example.com ecdsa");
+	EXPECT_EQ(name, "*.example.com");
+	EXPECT_EQ(special, "ecdsa");
+}
+
+TEST(CertUsage, Top)
+{
+	CertUsage usage;
+	usage.Add("a", 1);
+	usage.Add("b", 5);
+	usage.Add("c", 3);
+	usage.Add("a", 3);
+
+	EXPECT_EQ(usage.GetTop(2), (std::vector<std::string>{"b", "a"}));
+	EXPECT_EQ(usage.GetTop(10).size(), 3U);
+	EXPECT_TRUE(usage.GetTop(0).empty());
+}
+
+TEST(CertUsage, Decay)
+{
+	CertUsage usage;
+	usage.Add("a", 1);
+	usage.Add("b", 4);
+
+	usage.Decay();
+	EXPECT_EQ(usage.size(), 1U);
+	EXPECT_EQ(usage.GetTop(10), std::vector<std::string>{"b"});
+
+	usage.Decay();
+	usage.Decay();
+	EXPECT_TRUE(usage.empty());
+}
+
+TEST(CertUsage, ParseLine)
+{
+	CertUsage usage;
+	usage.ParseLine("3 example.com");
+	usage.ParseLine("7 example.org ecdsa");
+
+	/* malformed lines */
+	usage.ParseLine("");
+	usage.ParseLine("example.net");
+	usage.ParseLine("0 example.net");
+	usage.ParseLine("9example.net");
+	usage.ParseLine("9 ");
+	usage.ParseLine("9 a b c");
+
+	EXPECT_EQ(usage.GetTop(10),
+		  (std::vector<std::string>{"example.org ecdsa", "example.com"}));
+}
@@ -237,7 +237,7 @@ test_normal(PoolPtr pool, Context *c)
 		.ScriptName("env.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -263,7 +263,7 @@ test_tiny(PoolPtr pool, Context *c)
 		.ScriptName("tiny.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -291,7 +291,7 @@ test_close_early(PoolPtr pool, Context *c)
 		.ScriptName("env.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -319,7 +319,7 @@ test_close_late(PoolPtr pool, Context *c)
 		.ScriptName("env.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -347,7 +347,7 @@ test_close_data(PoolPtr pool, Context *c)
 		.ScriptName("env.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -375,7 +375,7 @@ test_post(PoolPtr pool, Context *c)
 		.ScriptName("cat.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_POST, &address,
 		nullptr, {},
 		UnusedIstreamPtr(OpenFileIstream(c->event_loop, *pool,
@@ -405,7 +405,7 @@ test_status(PoolPtr pool, Context *c)
 		.ScriptName("status.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -433,7 +433,7 @@ test_no_content(PoolPtr pool, Context *c)
 		.ScriptName("no_content.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -459,7 +459,7 @@ test_no_length(PoolPtr pool, Context *c)
 		.ScriptName("length0.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -483,7 +483,7 @@ test_length_ok(PoolPtr pool, Context *c)
 		.ScriptName("length1.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -509,7 +509,7 @@ test_length_ok_large(PoolPtr pool, Context *c)
 		.ScriptName("length5.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -533,7 +533,7 @@ test_length_too_small(PoolPtr pool, Context *c)
 		.ScriptName("length2.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -556,7 +556,7 @@ test_length_too_big(PoolPtr pool, Context *c)
 		.ScriptName("length3.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -580,7 +580,7 @@ test_length_too_small_late(PoolPtr pool, Context *c)
 		.ScriptName("length4.sh")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -611,7 +611,7 @@ test_large_header(PoolPtr pool, Context *c)
 		.ScriptName("large_header.py")
 		.DocumentRoot("/var/www");
 
-	cgi_new(c->spawn_service, c->event_loop,
+	cgi_new(c->spawn_service, nullptr, c->event_loop,
 		pool, nullptr, HTTP_METHOD_GET, &address,
 		nullptr, {}, nullptr,
 		*c, c->cancel_ptr);
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "cgi/Zygote.hxx"
+#include "PInstance.hxx"
+#include "spawn/Config.hxx"
+#include "spawn/ChildOptions.hxx"
+#include "spawn/ExitListener.hxx"
+#include "spawn/Local.hxx"
+#include "spawn/ProcessHandle.hxx"
+#include "spawn/Registry.hxx"
+#include "system/SetupProcess.hxx"
+#include "system/KernelVersion.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+static SpawnConfig spawn_config;
+
+struct Context : PInstance, ExitListener {
+	ChildProcessRegistry child_process_registry;
+	LocalSpawnService spawn_service;
+
+	FineTimerEvent timer;
+
+	int exit_status = -1;
+
+	Context()
+		:spawn_service(spawn_config, event_loop,
+			       child_process_registry),
+		 timer(event_loop, BIND_THIS_METHOD(OnTimer))
+	{
+	}
+
+	/**
+	 * Run the #EventLoop for a short while.
+	 */
+	void Step() noexcept {
+		timer.Schedule(std::chrono::milliseconds{10});
+		event_loop.Dispatch();
+	}
+
+	/**
+	 * Wait until the pool has a ready zygote for the given
+	 * options.
+	 */
+	CgiZygote *WaitReady(CgiZygotePool &pool,
+			     const ChildOptions &options) noexcept {
+		for (unsigned i = 0; i < 500; ++i) {
+			auto *zygote = pool.Get(options);
+			if (zygote != nullptr)
+				return zygote;
+
+			Step();
+		}
+
+		return nullptr;
+	}
+
+	void WaitExit() noexcept {
+		for (unsigned i = 0; i < 500 && exit_status < 0; ++i)
+			Step();
+	}
+
+	void OnTimer() noexcept {
+		event_loop.Break();
+	}
+
+	/* virtual methods from class ExitListener */
+	void OnChildProcessExit(int status) noexcept override {
+		exit_status = status;
+		event_loop.Break();
+	}
+};
+
+static const char *
+GetHelperPath() noexcept
+{
+	return getenv("CGI_ZYGOTE");
+}
+
+static std::string
+ReadAll(FileDescriptor fd) noexcept
+{
+	std::string result;
+	char buffer[256];
+	ssize_t nbytes;
+	while ((nbytes = fd.Read(buffer, sizeof(buffer))) > 0)
+		result.append(buffer, nbytes);
+	return result;
+}
+
+class CgiZygoteTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!IsKernelVersionOrNewer({5, 3}))
+			GTEST_SKIP() << "Kernel too old";
+
+		if (GetHelperPath() == nullptr)
+			GTEST_SKIP() << "CGI_ZYGOTE not set";
+
+		SetupProcess();
+	}
+};
+
+TEST_F(CgiZygoteTest, Disabled)
+{
+	Context c;
+	CgiZygotePool pool(c.event_loop, c.spawn_service, nullptr);
+	ChildOptions options;
+
+	for (unsigned i = 0; i < 4; ++i) {
+		ASSERT_EQ(pool.Get(options), nullptr);
+		c.Step();
+	}
+}
+
+TEST_F(CgiZygoteTest, Spawn)
+{
+	Context c;
+	CgiZygotePool pool(c.event_loop, c.spawn_service, GetHelperPath());
+	ChildOptions options;
+
+	/* the first request only records the demand */
+	ASSERT_EQ(pool.Get(options), nullptr);
+
+	auto *zygote = c.WaitReady(pool, options);
+	ASSERT_NE(zygote, nullptr);
+	ASSERT_TRUE(zygote->IsReady());
+	ASSERT_TRUE(zygote->IsIdle());
+
+	CgiZygoteCommand command;
+	command.Append("/bin/sh");
+	command.Append("-c");
+	command.Append("echo $FOO; exit 3");
+	command.SetEnv("FOO", "bar");
+
+	UniqueFileDescriptor r, w;
+	ASSERT_TRUE(UniqueFileDescriptor::CreatePipe(r, w));
+
+	auto handle = zygote->Spawn(command, {}, std::move(w));
+	ASSERT_FALSE(zygote->IsIdle());
+	handle->SetExitListener(c);
+
+	EXPECT_EQ(ReadAll(r), "bar\n");
+
+	c.WaitExit();
+	ASSERT_TRUE(WIFEXITED(c.exit_status));
+	EXPECT_EQ(WEXITSTATUS(c.exit_status), 3);
+	EXPECT_TRUE(zygote->IsIdle());
+}
+
+TEST_F(CgiZygoteTest, Kill)
+{
+	Context c;
+	CgiZygotePool pool(c.event_loop, c.spawn_service, GetHelperPath());
+	ChildOptions options;
+
+	ASSERT_EQ(pool.Get(options), nullptr);
+
+	auto *zygote = c.WaitReady(pool, options);
+	ASSERT_NE(zygote, nullptr);
+
+	CgiZygoteCommand command;
+	command.Append("/bin/sleep");
+	command.Append("60");
+
+	UniqueFileDescriptor r, w;
+	ASSERT_TRUE(UniqueFileDescriptor::CreatePipe(r, w));
+
+	auto handle = zygote->Spawn(command, {}, std::move(w));
+	handle->SetExitListener(c);
+	handle->Kill(SIGTERM);
+
+	c.WaitExit();
+	ASSERT_TRUE(WIFSIGNALED(c.exit_status));
+	EXPECT_EQ(WTERMSIG(c.exit_status), SIGTERM);
+}
+
+TEST_F(CgiZygoteTest, BadHelper)
+{
+	Context c;
+	CgiZygotePool pool(c.event_loop, c.spawn_service,
+			   "/nonexistent/cgi-zygote");
+	ChildOptions options;
+
+	/* the helper fails to start; all requests fall back to
+	   launching directly */
+	for (unsigned i = 0; i < 20; ++i) {
+		ASSERT_EQ(pool.Get(options), nullptr);
+		c.Step();
+	}
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DemoHttpServerConnection.hxx"
+#include "PInstance.hxx"
+#include "http/Pipeline.hxx"
+#include "http/Client.hxx"
+#include "http/ResponseHandler.hxx"
+#include "fs/FilteredSocket.hxx"
+#include "istream/UnusedPtr.hxx"
+#include "istream/sink_null.hxx"
+#include "memory/fb_pool.hxx"
+#include "memory/GrowingBuffer.hxx"
+#include "net/FailureRef.hxx"
+#include "net/SocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "pool/pool.hxx"
+#include "pool/UniquePtr.hxx"
+#include "system/Error.hxx"
+#include "io/SpliceSupport.hxx"
+#include "util/Cancellable.hxx"
+#include "strmap.hxx"
+#include "lease.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <memory>
+
+#include <sys/socket.h>
+
+namespace {
+
+struct DummyFailureInfo final : ReferencedFailureInfo {
+protected:
+	void Destroy() noexcept override {}
+};
+
+/**
+ * A connection to a #DemoHttpServerConnection which acts like an idle
+ * connection in the #FilteredSocketStock.
+ */
+struct Context final : PInstance, Lease, BufferedSocketHandler {
+	const ScopeFbPoolInit fb_pool_init;
+
+	FilteredSocket client_fs;
+
+	std::unique_ptr<DemoHttpServerConnection> server;
+
+	DummyFailureInfo failure;
+
+	HttpPipelineList pipelines;
+
+	bool released = false, reuse = false;
+
+	explicit Context(DemoHttpServerConnection::Mode mode)
+		:client_fs(event_loop)
+	{
+		UniqueSocketDescriptor client_socket, server_socket;
+		if (!UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL, SOCK_STREAM, 0,
+							      client_socket, server_socket))
+			throw MakeErrno("socketpair() failed");
+
+		server = std::make_unique<DemoHttpServerConnection>(root_pool, event_loop,
+								    UniquePoolPtr<FilteredSocket>::Make(root_pool,
+													event_loop,
+													std::move(server_socket),
+													FdType::FD_SOCKET),
+								    nullptr,
+								    mode);
+
+		client_socket.SetNonBlocking();
+		client_fs.InitDummy(client_socket.Release(), FdType::FD_SOCKET);
+		client_fs.Reinit(Event::Duration(-1), *this);
+	}
+
+	~Context() noexcept {
+		CloseClientSocket();
+		server.reset();
+	}
+
+	HttpPipeline *Find() noexcept {
+		return pipelines.Find(failure, event_loop.SteadyNow(), {});
+	}
+
+	HttpPipeline &NewPipeline(unsigned depth) noexcept {
+		return pipelines.Add(client_fs, *this, "localhost",
+				     failure, depth);
+	}
+
+	void CloseClientSocket() noexcept {
+		if (client_fs.IsValid()) {
+			if (client_fs.IsConnected())
+				client_fs.Close();
+			client_fs.Destroy();
+		}
+	}
+
+	/* virtual methods from class Lease */
+	void ReleaseLease(bool _reuse) noexcept override {
+		released = true;
+		reuse = _reuse;
+
+		if (reuse && client_fs.IsConnected()) {
+			client_fs.Reinit(Event::Duration(-1), *this);
+			client_fs.UnscheduleWrite();
+		}
+
+		event_loop.Break();
+	}
+
+	/* virtual methods from class BufferedSocketHandler */
+	BufferedResult OnBufferedData() override {
+		ADD_FAILURE() << "unexpected data in idle connection";
+		return BufferedResult::OK;
+	}
+
+	bool OnBufferedClosed() noexcept override {
+		return true;
+	}
+
+	bool OnBufferedWrite() override {
+		return true;
+	}
+
+	void OnBufferedError(std::exception_ptr) noexcept override {
+	}
+};
+
+struct Response final : HttpResponseHandler {
+	struct pool &pool;
+
+	CancellablePointer cancel_ptr;
+
+	http_status_t status{};
+
+	std::exception_ptr error;
+
+	explicit Response(struct pool &_pool) noexcept
+		:pool(_pool) {}
+
+	bool Send(HttpPipeline &pipeline, const StringMap &headers) noexcept {
+		return pipeline.SendRequest(pool, HTTP_METHOD_GET, "/",
+					    headers, {},
+					    *this, cancel_ptr);
+	}
+
+	/* virtual methods from class HttpResponseHandler */
+	void OnHttpResponse(http_status_t _status, StringMap &&,
+			    UnusedIstreamPtr body) noexcept override {
+		status = _status;
+
+		if (body)
+			sink_null_new(pool, std::move(body));
+	}
+
+	void OnHttpError(std::exception_ptr ep) noexcept override {
+		error = std::move(ep);
+	}
+};
+
+} // anonymous namespace
+
+TEST(HttpPipeline, CanPipeline)
+{
+	const StringMap headers;
+
+	EXPECT_TRUE(HttpPipeline::CanPipeline(HTTP_METHOD_GET, "/", headers, false));
+	EXPECT_TRUE(HttpPipeline::CanPipeline(HTTP_METHOD_HEAD, "/", headers, false));
+	EXPECT_FALSE(HttpPipeline::CanPipeline(HTTP_METHOD_GET, "/", headers, true));
+	EXPECT_FALSE(HttpPipeline::CanPipeline(HTTP_METHOD_POST, "/", headers, false));
+	EXPECT_FALSE(HttpPipeline::CanPipeline(HTTP_METHOD_DELETE, "/", headers, false));
+	EXPECT_FALSE(HttpPipeline::CanPipeline(HTTP_METHOD_GET, "foo", headers, false));
+}
+
+TEST(HttpPipeline, Basic)
+{
+	direct_global_init();
+
+	Context c(DemoHttpServerConnection::Mode::FIXED);
+	auto pool = pool_new_linear(c.root_pool, "test", 8192);
+	const StringMap headers;
+
+	auto &pipeline = c.NewPipeline(3);
+	EXPECT_TRUE(pipeline.IsAvailable(c.event_loop.SteadyNow(), {}));
+
+	std::array<Response, 3> responses{Response{*pool}, Response{*pool}, Response{*pool}};
+	for (auto &i : responses) {
+		ASSERT_TRUE(c.Find() == &pipeline);
+		EXPECT_TRUE(i.Send(pipeline, headers));
+	}
+
+	/* the depth is exhausted */
+	EXPECT_EQ(c.Find(), nullptr);
+
+	c.event_loop.Dispatch();
+
+	for (const auto &i : responses) {
+		EXPECT_EQ(i.status, HTTP_STATUS_OK);
+		EXPECT_FALSE(i.error);
+	}
+
+	EXPECT_TRUE(c.released);
+	EXPECT_TRUE(c.reuse);
+	EXPECT_EQ(c.Find(), nullptr);
+}
+
+/**
+ * Connections are only found for the member picked by the balancer,
+ * and only if that member is usable.
+ */
+TEST(HttpPipeline, MemberFailure)
+{
+	direct_global_init();
+
+	Context c(DemoHttpServerConnection::Mode::FIXED);
+	auto pool = pool_new_linear(c.root_pool, "test", 8192);
+	const StringMap headers;
+
+	auto &pipeline = c.NewPipeline(4);
+
+	/* another member has no connections */
+	DummyFailureInfo other;
+	EXPECT_EQ(c.pipelines.Find(other, c.event_loop.SteadyNow(), {}),
+		  nullptr);
+
+	/* a failed member gets no more requests */
+	c.failure.SetConnect(c.event_loop.SteadyNow(),
+			     std::chrono::seconds(20));
+	EXPECT_EQ(c.Find(), nullptr);
+
+	/* after recovering, the slow-start phase limits the depth */
+	c.failure.UnsetConnect();
+	EXPECT_EQ(c.Find(), &pipeline);
+
+	Response response{*pool};
+	EXPECT_TRUE(response.Send(pipeline, headers));
+
+	constexpr FailureInfo::Duration slow_start = std::chrono::minutes(1);
+	EXPECT_EQ(c.pipelines.Find(c.failure, c.event_loop.SteadyNow(),
+				   slow_start),
+		  nullptr);
+	EXPECT_EQ(c.Find(), &pipeline);
+
+	c.event_loop.Dispatch();
+
+	EXPECT_EQ(response.status, HTTP_STATUS_OK);
+	EXPECT_TRUE(c.released);
+	EXPECT_TRUE(c.reuse);
+}
+
+/**
+ * The server closes the connection after the first response; the
+ * other requests must fail with a retryable error.
+ */
+TEST(HttpPipeline, FailMidPipeline)
+{
+	direct_global_init();
+
+	Context c(DemoHttpServerConnection::Mode::FAILING_KEEPALIVE);
+	auto pool = pool_new_linear(c.root_pool, "test", 8192);
+	const StringMap headers;
+
+	auto &pipeline = c.NewPipeline(3);
+
+	std::array<Response, 3> responses{Response{*pool}, Response{*pool}, Response{*pool}};
+	for (auto &i : responses)
+		EXPECT_TRUE(i.Send(pipeline, headers));
+
+	while (!c.released)
+		c.event_loop.Dispatch();
+
+	EXPECT_FALSE(c.reuse);
+
+	EXPECT_EQ(responses[0].status, HTTP_STATUS_OK);
+	EXPECT_FALSE(responses[0].error);
+
+	for (std::size_t i = 1; i < responses.size(); ++i) {
+		EXPECT_EQ(responses[i].status, http_status_t{});
+		EXPECT_TRUE(responses[i].error);
+		EXPECT_TRUE(IsHttpClientRetryFailure(responses[i].error));
+	}
+
+	EXPECT_EQ(c.Find(), nullptr);
+}
+
+/**
+ * A request which is canceled while waiting for its turn must not
+ * disturb the following ones.
+ */
+TEST(HttpPipeline, CancelQueued)
+{
+	direct_global_init();
+
+	Context c(DemoHttpServerConnection::Mode::FIXED);
+	auto pool = pool_new_linear(c.root_pool, "test", 8192);
+	const StringMap headers;
+
+	auto &pipeline = c.NewPipeline(3);
+
+	std::array<Response, 3> responses{Response{*pool}, Response{*pool}, Response{*pool}};
+	for (auto &i : responses)
+		EXPECT_TRUE(i.Send(pipeline, headers));
+
+	responses[1].cancel_ptr.Cancel();
+
+	c.event_loop.Dispatch();
+
+	EXPECT_EQ(responses[0].status, HTTP_STATUS_OK);
+	EXPECT_EQ(responses[1].status, http_status_t{});
+	EXPECT_FALSE(responses[1].error);
+	EXPECT_EQ(responses[2].status, HTTP_STATUS_OK);
+
+	EXPECT_TRUE(c.released);
+	EXPECT_TRUE(c.reuse);
+}
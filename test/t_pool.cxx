@@ -33,12 +33,25 @@
 #include "pool/pool.hxx"
 #include "pool/Ptr.hxx"
 #include "pool/RootPool.hxx"
+#include "pool/NameStats.hxx"
 
 #include <gtest/gtest.h>
 
+#include <optional>
+
 #include <stdint.h>
 #include <stdlib.h>
 
+static std::optional<PoolNameStats>
+FindNameStats(std::string_view name) noexcept
+{
+	for (const auto &i : pool_get_name_stats())
+		if (i.name == name)
+			return i;
+
+	return std::nullopt;
+}
+
 TEST(PoolTest, Libc)
 {
 	RootPool pool;
@@ -107,3 +120,56 @@ TEST(PoolTest, Linear)
 #endif
 	ASSERT_EQ(size_t(2 * 1024 + 32 + 16 + 32), pool_netto_size(pool));
 }
+
+TEST(PoolTest, AdaptiveAreaSize)
+{
+	RootPool root_pool;
+
+	/* each pool needs roughly 3-4 kB, which doesn't fit in the
+	   1 kB area requested by the caller */
+	const auto allocate = [&root_pool]{
+		const auto pool = pool_new_linear(root_pool, "adaptive", 1024);
+		for (unsigned i = 0; i < 10; ++i)
+			ASSERT_NE(p_malloc(pool, 300), nullptr);
+	};
+
+	for (unsigned i = 0; i < 64; ++i)
+		allocate();
+
+	auto stats = FindNameStats("adaptive");
+	ASSERT_TRUE(stats);
+	ASSERT_EQ(stats->n_pools, 64U);
+	ASSERT_EQ(stats->n_spilled, 64U);
+	ASSERT_GE(stats->high_water, size_t(3000));
+	ASSERT_EQ(stats->area_size, size_t(4096));
+
+	/* new pools use the larger area size and need only one
+	   area */
+	allocate();
+
+	stats = FindNameStats("adaptive");
+	ASSERT_TRUE(stats);
+	ASSERT_EQ(stats->n_pools, 65U);
+	ASSERT_EQ(stats->n_spilled, 64U);
+}
+
+/**
+ * Names are looked up by pointer, but different pointers to equal
+ * strings must still share their statistics.
+ */
+TEST(PoolTest, NameStatsByValue)
+{
+	RootPool root_pool;
+
+	/* a copy of the string literal at a different address */
+	static constexpr char copy[] = "by_value";
+
+	for (const char *name : {"by_value", copy, "by_value"}) {
+		const auto pool = pool_new_linear(root_pool, name, 1024);
+		ASSERT_NE(p_malloc(pool, 100), nullptr);
+	}
+
+	auto stats = FindNameStats("by_value");
+	ASSERT_TRUE(stats);
+	ASSERT_EQ(stats->n_pools, 3U);
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "thread/Rcu.hxx"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Value {
+	unsigned a, b;
+
+	/* the destructor poisons the object, so readers which see a
+	   freed object (which is still mapped, usually) notice */
+	~Value() noexcept {
+		a = 1;
+		b = 2;
+	}
+};
+
+} // anonymous namespace
+
+TEST(Rcu, ReadersNeverSeeFreedData)
+{
+	RcuDomain rcu;
+	std::atomic<Value *> current{new Value{0, 0}};
+	std::atomic_bool stop{false}, failed{false};
+	std::atomic_uint running{0};
+
+	std::vector<std::thread> readers;
+	for (unsigned i = 0; i < 4; ++i)
+		readers.emplace_back([&]{
+			++running;
+			while (!stop.load(std::memory_order_relaxed)) {
+				const RcuReadLock lock{rcu};
+				const Value &v = *current.load();
+				const unsigned a = v.a;
+				std::this_thread::yield();
+				if (v.b != a)
+					failed = true;
+			}
+		});
+
+	while (running < readers.size())
+		std::this_thread::yield();
+
+	for (unsigned i = 1; i <= 20000; ++i) {
+		std::unique_ptr<Value> old{current.exchange(new Value{i * 2, i * 2})};
+		rcu.Synchronize();
+	}
+
+	stop = true;
+	for (auto &t : readers)
+		t.join();
+
+	delete current.load();
+
+	EXPECT_FALSE(failed);
+}
+
+TEST(Rcu, SynchronizeWithoutReaders)
+{
+	RcuDomain rcu;
+	rcu.Synchronize();
+
+	{
+		const RcuReadLock lock{rcu};
+	}
+
+	rcu.Synchronize();
+}
+
+TEST(Rcu, PollGracePeriod)
+{
+	RcuDomain rcu;
+
+	std::optional<RcuReadLock> lock;
+	lock.emplace(rcu);
+
+	const auto cookie = rcu.StartGracePeriod();
+	EXPECT_FALSE(rcu.PollGracePeriod(cookie));
+	EXPECT_FALSE(rcu.PollGracePeriod(cookie));
+
+	lock.reset();
+	EXPECT_TRUE(rcu.PollGracePeriod(cookie));
+	EXPECT_TRUE(rcu.PollGracePeriod(cookie));
+
+	/* Synchronize() works after polling */
+	rcu.Synchronize();
+	EXPECT_TRUE(rcu.PollGracePeriod(rcu.StartGracePeriod()));
+}
+
+/**
+ * Like ReadersNeverSeeFreedData, but the writer frees old versions
+ * with PollGracePeriod() instead of blocking in Synchronize().
+ */
+TEST(Rcu, DeferredReclamation)
+{
+	RcuDomain rcu;
+	std::atomic<Value *> current{new Value{0, 0}};
+	std::atomic_bool stop{false}, failed{false};
+	std::atomic_uint running{0};
+
+	std::vector<std::thread> readers;
+	for (unsigned i = 0; i < 4; ++i)
+		readers.emplace_back([&]{
+			++running;
+			while (!stop.load(std::memory_order_relaxed)) {
+				const RcuReadLock lock{rcu};
+				const Value &v = *current.load();
+				const unsigned a = v.a;
+				std::this_thread::yield();
+				if (v.b != a)
+					failed = true;
+			}
+		});
+
+	while (running < readers.size())
+		std::this_thread::yield();
+
+	std::deque<std::pair<uint64_t, std::unique_ptr<Value>>> retired;
+
+	for (unsigned i = 1; i <= 20000; ++i) {
+		retired.emplace_back(rcu.StartGracePeriod(),
+				     current.exchange(new Value{i * 2, i * 2}));
+
+		while (!retired.empty() &&
+		       rcu.PollGracePeriod(retired.front().first))
+			retired.pop_front();
+	}
+
+	stop = true;
+	for (auto &t : readers)
+		t.join();
+
+	retired.clear();
+	delete current.load();
+
+	EXPECT_FALSE(failed);
+}
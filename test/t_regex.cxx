@@ -32,6 +32,7 @@
 
 #include "lib/pcre/UniqueRegex.hxx"
 #include "pexpand.hxx"
+#include "RegexCache.hxx"
 #include "TestPool.hxx"
 #include "AllocatorPtr.hxx"
 
@@ -151,3 +152,32 @@ TEST(RegexTest, ExpandOptionalLast)
 	ASSERT_NE(e, nullptr);
 	ASSERT_EQ(strcmp(e, "a-b-"), 0);
 }
+
+TEST(RegexTest, Cache)
+{
+	RegexCache cache;
+
+	auto a = cache.Get("\\.jpg$", true, false);
+	ASSERT_TRUE(a);
+	ASSERT_TRUE(a->Match("/foo.jpg"));
+	ASSERT_FALSE(a->Match("/foo.html"));
+	ASSERT_EQ(cache.GetStats().misses, 1u);
+	ASSERT_EQ(cache.GetStats().hits, 0u);
+
+	/* same pattern, same flags: the compiled object is shared */
+	auto b = cache.Get("\\.jpg$", true, false);
+	ASSERT_EQ(a, b);
+	ASSERT_EQ(cache.GetStats().misses, 1u);
+	ASSERT_EQ(cache.GetStats().hits, 1u);
+
+	/* different flags: a separate object */
+	auto c = cache.Get("\\.jpg$", true, true);
+	ASSERT_NE(a, c);
+	ASSERT_EQ(cache.GetStats().misses, 2u);
+
+	/* errors are not cached */
+	ASSERT_ANY_THROW(cache.Get("(", true, false));
+	ASSERT_ANY_THROW(cache.Get("(", true, false));
+	ASSERT_EQ(cache.GetStats().misses, 4u);
+	ASSERT_EQ(cache.GetStats().hits, 1u);
+}
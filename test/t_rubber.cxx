@@ -295,3 +295,179 @@ TEST(RubberTest, FullTable)
 	for (unsigned i = 0; i < n; ++i)
 		r.Remove(ids[i]);
 }
+
+/**
+ * Compress incrementally with a small budget per step, and verify
+ * that pinned objects stay where they are.
+ */
+TEST(RubberTest, CompressStep)
+{
+	size_t total = 4 * 1024 * 1024;
+
+	Rubber r{total, "rubber"};
+
+	total = r.GetMaxSize();
+
+	static constexpr unsigned N = 64;
+	const size_t size = total / N;
+
+	unsigned ids[N];
+	for (unsigned i = 0; i < N; ++i) {
+		ids[i] = AddFillRubber(r, size);
+		ASSERT_GT(ids[i], 0u);
+	}
+
+	/* remove every other object */
+
+	for (unsigned i = 0; i < N; i += 2)
+		r.Remove(ids[i]);
+
+	ASSERT_EQ(r.GetNettoSize(), total / 2);
+	ASSERT_EQ(r.GetBruttoSize(), total);
+
+	/* pin one object in the middle */
+
+	const unsigned pinned = ids[N / 2 + 1];
+	const void *pinned_data = r.Read(pinned);
+	r.Pin(pinned);
+
+	/* the first step must not complete the pass */
+
+	ASSERT_FALSE(r.CompressStep(size));
+
+	/* allocating and removing between steps is allowed */
+
+	r.Remove(ids[N - 1]);
+
+	unsigned steps = 1;
+	while (!r.CompressStep(size)) {
+		++steps;
+		ASSERT_LT(steps, N * 2);
+	}
+
+	ASSERT_GT(steps, 2u);
+
+	ASSERT_EQ(r.Read(pinned), pinned_data);
+	ASSERT_EQ(r.GetNettoSize(), total / 2 - size);
+
+	/* the hole before the pinned object remains */
+	ASSERT_GT(r.GetBruttoSize(), r.GetNettoSize());
+
+	for (unsigned i = 1; i < N - 1; i += 2)
+		ASSERT_TRUE(CheckRubber(r, ids[i], size));
+
+	/* after unpinning, everything can be compressed */
+
+	r.Unpin(pinned);
+	r.Compress();
+
+	ASSERT_EQ(r.GetBruttoSize(), r.GetNettoSize());
+
+	for (unsigned i = 1; i < N - 1; i += 2) {
+		ASSERT_TRUE(CheckRubber(r, ids[i], size));
+		r.Remove(ids[i]);
+	}
+
+	ASSERT_EQ(r.GetNettoSize(), size_t(0u));
+	ASSERT_EQ(r.GetBruttoSize(), size_t(0u));
+}
+
+/**
+ * Verify that Add() does not move a pinned object at the tail into a
+ * hole.
+ */
+TEST(RubberTest, MoveLastPinned)
+{
+	size_t total = 4 * 1024 * 1024;
+
+	Rubber r{total, "rubber"};
+
+	total = r.GetMaxSize();
+
+	static constexpr unsigned N = 8;
+	const size_t size = total / (N * 4);
+
+	unsigned ids[N];
+	for (unsigned i = 0; i < N; ++i) {
+		ids[i] = AddFillRubber(r, size);
+		ASSERT_GT(ids[i], 0u);
+	}
+
+	/* create a hole at the start and pin the last object */
+
+	r.Remove(ids[0]);
+
+	const unsigned pinned = ids[N - 1];
+	const void *pinned_data = r.Read(pinned);
+	r.Pin(pinned);
+
+	/* this doesn't fit into the hole; without the pin, the last
+	   object would be moved there */
+
+	const unsigned big = AddFillRubber(r, size * 2);
+	ASSERT_GT(big, 0u);
+
+	ASSERT_EQ(r.Read(pinned), pinned_data);
+	ASSERT_TRUE(CheckRubber(r, pinned, size));
+
+	r.Unpin(pinned);
+
+	r.Remove(big);
+	for (unsigned i = 1; i < N; ++i)
+		r.Remove(ids[i]);
+
+	ASSERT_EQ(r.GetNettoSize(), size_t(0u));
+}
+
+/**
+ * Verify that Add() compresses only a bounded amount and leaves the
+ * rest to the incremental compression.
+ */
+TEST(RubberTest, AddBounded)
+{
+	size_t total = 4 * 1024 * 1024;
+
+	Rubber r{total, "rubber"};
+
+	total = r.GetMaxSize();
+
+	static constexpr unsigned N = 64;
+	const size_t size = total / N;
+
+	unsigned ids[N];
+	for (unsigned i = 0; i < N; ++i) {
+		ids[i] = AddFillRubber(r, size);
+		ASSERT_GT(ids[i], 0u);
+	}
+
+	/* remove every other object; the holes are too small for
+	   the next allocation, and moving all objects would take
+	   longer than one Add() call may */
+
+	for (unsigned i = 0; i < N; i += 2)
+		r.Remove(ids[i]);
+
+	ASSERT_EQ(AddFillRubber(r, total / 4), 0u);
+
+	/* the remaining objects have not been damaged */
+	for (unsigned i = 1; i < N; i += 2)
+		ASSERT_TRUE(CheckRubber(r, ids[i], size));
+
+	/* after the incremental compression has finished its pass,
+	   there is enough room */
+
+	while (!r.CompressStep(size)) {}
+
+	const unsigned big = AddFillRubber(r, total / 4);
+	ASSERT_GT(big, 0u);
+
+	ASSERT_TRUE(CheckRubber(r, big, total / 4));
+	for (unsigned i = 1; i < N; i += 2) {
+		ASSERT_TRUE(CheckRubber(r, ids[i], size));
+		r.Remove(ids[i]);
+	}
+
+	r.Remove(big);
+
+	ASSERT_EQ(r.GetNettoSize(), size_t(0u));
+}
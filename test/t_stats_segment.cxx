@@ -0,0 +1,217 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "stats/SegmentWriter.hxx"
+#include "stats/Segment.hxx"
+#include "io/UniqueFileDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * A temporary file which is deleted by the destructor.
+ */
+struct TempFile {
+	std::string path = "/tmp/t_stats_segment.XXXXXX";
+
+	TempFile() {
+		const int fd = mkstemp(path.data());
+		if (fd < 0)
+			throw std::runtime_error("mkstemp() failed");
+		close(fd);
+	}
+
+	~TempFile() noexcept {
+		unlink(path.c_str());
+	}
+};
+
+/**
+ * Maps the segment read-only, like the exporter does.
+ */
+class Reader {
+	const StatsSegment::Header *header;
+
+public:
+	explicit Reader(const char *path) {
+		UniqueFileDescriptor fd;
+		if (!fd.OpenReadOnly(path))
+			throw std::runtime_error("open() failed");
+
+		const void *p = mmap(nullptr, sizeof(*header), PROT_READ,
+				     MAP_SHARED, fd.Get(), 0);
+		if (p == MAP_FAILED)
+			throw std::runtime_error("mmap() failed");
+
+		header = static_cast<const StatsSegment::Header *>(p);
+	}
+
+	~Reader() noexcept {
+		munmap(const_cast<StatsSegment::Header *>(header),
+		       sizeof(*header));
+	}
+
+	Reader(const Reader &) = delete;
+	Reader &operator=(const Reader &) = delete;
+
+	const StatsSegment::Header &GetHeader() const noexcept {
+		return *header;
+	}
+
+	bool Read(StatsSegment::Data &dest) const noexcept {
+		return StatsSegment::Read(*header, dest);
+	}
+};
+
+} // anonymous namespace
+
+/* this is large; don't put it on the stack */
+static StatsSegment::Data data;
+
+TEST(StatsSegment, RoundTrip)
+{
+	const TempFile file;
+	StatsSegmentWriter writer{file.path.c_str(), "lb"};
+	const Reader reader{file.path.c_str()};
+
+	EXPECT_TRUE(reader.GetHeader().IsValid(sizeof(StatsSegment::Header)));
+
+	/* the initial (empty) data is readable right away */
+	ASSERT_TRUE(reader.Read(data));
+	EXPECT_STREQ(data.process, "lb");
+	EXPECT_EQ(data.n_http, 0U);
+
+	HttpStats stats;
+	stats.n_requests = 42;
+	stats.traffic_sent = 1234;
+
+	auto &w = writer.BeginUpdate();
+	w.control.http_requests = 7;
+	w.tcp_stock.busy = 3;
+	w.tcp_stock.idle = 5;
+	w.AddHttp("foo", nullptr, stats);
+	w.AddHttp("bar", "", stats);
+	w.AddHttp(std::string(100, 'x'), "tag", stats);
+
+	/* the writer is busy */
+	EXPECT_FALSE(reader.Read(data));
+
+	writer.EndUpdate();
+
+	ASSERT_TRUE(reader.Read(data));
+	EXPECT_STREQ(data.process, "lb");
+	EXPECT_GT(data.update_time, 0);
+	EXPECT_EQ(data.control.http_requests, 7U);
+	EXPECT_EQ(data.tcp_stock.busy, 3U);
+	EXPECT_EQ(data.tcp_stock.idle, 5U);
+	ASSERT_EQ(data.n_http, 3U);
+	EXPECT_EQ(data.n_http_dropped, 0U);
+
+	EXPECT_STREQ(data.http[0].listener, "foo");
+	EXPECT_FALSE(data.http[0].tagged);
+	EXPECT_EQ(data.http[0].stats.n_requests, 42U);
+	EXPECT_EQ(data.http[0].stats.traffic_sent, 1234U);
+
+	EXPECT_STREQ(data.http[1].listener, "bar");
+	EXPECT_TRUE(data.http[1].tagged);
+	EXPECT_STREQ(data.http[1].tag, "");
+
+	/* long names are truncated */
+	EXPECT_EQ(std::string{data.http[2].listener},
+		  std::string(StatsSegment::MAX_NAME - 1, 'x'));
+	EXPECT_STREQ(data.http[2].tag, "tag");
+
+	/* the next update replaces all entries */
+	writer.BeginUpdate().AddHttp("baz", nullptr, stats);
+	writer.EndUpdate();
+
+	ASSERT_TRUE(reader.Read(data));
+	ASSERT_EQ(data.n_http, 1U);
+	EXPECT_STREQ(data.http[0].listener, "baz");
+}
+
+TEST(StatsSegment, Dropped)
+{
+	const TempFile file;
+	StatsSegmentWriter writer{file.path.c_str(), "bp"};
+	const Reader reader{file.path.c_str()};
+
+	const HttpStats stats;
+	auto &w = writer.BeginUpdate();
+	for (std::size_t i = 0; i < StatsSegment::MAX_HTTP + 2; ++i)
+		w.AddHttp("foo", nullptr, stats);
+	writer.EndUpdate();
+
+	ASSERT_TRUE(reader.Read(data));
+	EXPECT_EQ(data.n_http, StatsSegment::MAX_HTTP);
+	EXPECT_EQ(data.n_http_dropped, 2U);
+}
+
+TEST(StatsSegment, Reuse)
+{
+	const TempFile file;
+
+	{
+		StatsSegmentWriter writer{file.path.c_str(), "bp"};
+		writer.BeginUpdate().AddHttp("foo", nullptr, {});
+		writer.EndUpdate();
+	}
+
+	/* a new process reuses the file, discarding the old data */
+	StatsSegmentWriter writer{file.path.c_str(), "lb"};
+	const Reader reader{file.path.c_str()};
+
+	ASSERT_TRUE(reader.Read(data));
+	EXPECT_STREQ(data.process, "lb");
+	EXPECT_EQ(data.n_http, 0U);
+}
+
+TEST(StatsSegment, RefuseSymlink)
+{
+	const TempFile file;
+	const std::string link = file.path + ".link";
+	ASSERT_EQ(symlink(file.path.c_str(), link.c_str()), 0);
+
+	EXPECT_THROW(StatsSegmentWriter(link.c_str(), "lb"),
+		     std::system_error);
+
+	unlink(link.c_str());
+}
@@ -49,6 +49,7 @@
 #include "spawn/NamespaceOptions.hxx"
 #include "pool/pool.hxx"
 #include "PInstance.hxx"
+#include "RegexCache.hxx"
 #include "util/Cancellable.hxx"
 #include "util/StringAPI.hxx"
 #include "stopwatch.hxx"
@@ -69,10 +70,11 @@ public:
 
 struct Instance : PInstance {
 	MyTranslationService ts;
+	RegexCache regex_cache;
 	TranslationCache cache;
 
 	Instance()
-		:cache(root_pool, event_loop, ts, 1024) {}
+		:cache(root_pool, event_loop, ts, regex_cache, 1024) {}
 };
 
 const TranslateResponse *next_response;
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "thread/Queue.hxx"
+#include "thread/Job.hxx"
+#include "thread/Worker.hxx"
+#include "event/Loop.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <forward_list>
+
+namespace {
+
+struct Counter {
+	EventLoop &event_loop;
+	unsigned remaining;
+};
+
+struct TestJob final : ThreadJob {
+	Counter *counter = nullptr;
+
+	std::atomic_uint n_run{0};
+	unsigned n_done = 0;
+
+	void Run() noexcept override {
+		++n_run;
+	}
+
+	void Done() noexcept override {
+		++n_done;
+
+		if (--counter->remaining == 0)
+			counter->event_loop.Break();
+	}
+};
+
+} // anonymous namespace
+
+TEST(ThreadQueue, Batch)
+{
+	EventLoop event_loop;
+	ThreadQueue queue(event_loop);
+
+	std::array<TestJob, 10> jobs;
+	Counter counter{event_loop, jobs.size()};
+
+	for (auto &job : jobs) {
+		job.counter = &counter;
+		queue.Add(job);
+	}
+
+	EXPECT_EQ(queue.GetStats().n_waiting, jobs.size());
+
+	/* drain the queue without sleeping; only the job being run
+	   is reserved, the others remain available */
+	ThreadJob *job = queue.Wait();
+	for (std::size_t n = 1;; ++n) {
+		ASSERT_NE(job, nullptr);
+		EXPECT_EQ(queue.GetStats().n_waiting, jobs.size() - n);
+
+		if (n == jobs.size()) {
+			queue.Done(*job);
+			break;
+		}
+
+		job = queue.DoneAndWait(*job);
+	}
+
+	/* all completions are handled in one wakeup */
+	event_loop.Run();
+
+	for (const auto &i : jobs)
+		EXPECT_EQ(i.n_done, 1U);
+
+	const auto stats = queue.GetStats();
+	EXPECT_EQ(stats.n_waiting, 0U);
+	EXPECT_EQ(stats.n_jobs, jobs.size());
+	EXPECT_EQ(stats.n_batches, 1U);
+	EXPECT_EQ(stats.n_wakeups, 1U);
+	EXPECT_EQ(stats.n_completions, jobs.size());
+
+	queue.Stop();
+}
+
+TEST(ThreadQueue, DoneBeforeNext)
+{
+	EventLoop event_loop;
+	ThreadQueue queue(event_loop);
+
+	std::array<TestJob, 3> jobs;
+	Counter counter{event_loop, 1};
+
+	for (auto &job : jobs) {
+		job.counter = &counter;
+		queue.Add(job);
+	}
+
+	ThreadJob *job = queue.Wait();
+	EXPECT_EQ(job, &jobs[0]);
+
+	/* the jobs behind the running one can still be canceled */
+	EXPECT_TRUE(queue.Cancel(jobs[2]));
+
+	/* the first job is completed while the second one runs */
+	job = queue.DoneAndWait(*job);
+	EXPECT_EQ(job, &jobs[1]);
+
+	event_loop.Run();
+	EXPECT_EQ(jobs[0].n_done, 1U);
+	EXPECT_EQ(jobs[1].n_done, 0U);
+
+	counter.remaining = 1;
+	queue.Done(*job);
+	event_loop.Run();
+	EXPECT_EQ(jobs[1].n_done, 1U);
+	EXPECT_EQ(jobs[2].n_done, 0U);
+
+	queue.Stop();
+}
+
+TEST(ThreadQueue, Cancel)
+{
+	EventLoop event_loop;
+	ThreadQueue queue(event_loop);
+
+	TestJob job;
+	queue.Add(job);
+	EXPECT_EQ(queue.GetStats().n_waiting, 1U);
+
+	EXPECT_TRUE(queue.Cancel(job));
+	EXPECT_TRUE(job.IsIdle());
+	EXPECT_EQ(queue.GetStats().n_waiting, 0U);
+
+	queue.Stop();
+}
+
+TEST(ThreadQueue, Workers)
+{
+	EventLoop event_loop;
+	ThreadQueue queue(event_loop);
+
+	std::forward_list<ThreadWorker> workers;
+	for (unsigned i = 0; i < 4; ++i)
+		workers.emplace_front(queue);
+
+	std::array<TestJob, 1000> jobs;
+	Counter counter{event_loop, jobs.size()};
+
+	for (auto &job : jobs) {
+		job.counter = &counter;
+		queue.Add(job);
+	}
+
+	event_loop.Run();
+
+	for (const auto &job : jobs) {
+		EXPECT_EQ(job.n_run, 1U);
+		EXPECT_EQ(job.n_done, 1U);
+	}
+
+	const auto stats = queue.GetStats();
+	EXPECT_EQ(stats.n_waiting, 0U);
+	EXPECT_EQ(stats.n_jobs, jobs.size());
+	EXPECT_LE(stats.n_batches, stats.n_jobs);
+	EXPECT_LE(stats.n_wakeups, stats.n_jobs);
+	EXPECT_EQ(stats.n_completions, jobs.size());
+
+	queue.Stop();
+
+	for (auto &worker : workers)
+		worker.Join();
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RecordingTranslateHandler.hxx"
+#include "translation/MuxStock.hxx"
+#include "translation/MuxProtocol.hxx"
+#include "translation/Protocol.hxx"
+#include "translation/Request.hxx"
+#include "translation/Response.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "event/SocketEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/Cancellable.hxx"
+#include "PInstance.hxx"
+#include "AllocatorPtr.hxx"
+#include "stopwatch.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * A minimal translation server which speaks the multiplexed
+ * protocol.  After it has received the configured number of
+ * requests, it responds to them in reverse order with "STATUS
+ * 200+n" (n being the order of arrival), or it closes the
+ * connection.
+ */
+class FakeMuxServer {
+	UniqueSocketDescriptor listener;
+	SocketEvent listener_event;
+
+	UniqueSocketDescriptor connection;
+	SocketEvent connection_event;
+
+	std::string input;
+
+	std::vector<uint32_t> ids;
+
+	const std::size_t n_requests;
+
+	const bool close;
+
+public:
+	unsigned n_connections = 0;
+
+	FakeMuxServer(EventLoop &event_loop, SocketAddress address,
+		      std::size_t _n_requests, bool _close=false)
+		:listener_event(event_loop, BIND_THIS_METHOD(OnAccept)),
+		 connection_event(event_loop, BIND_THIS_METHOD(OnData)),
+		 n_requests(_n_requests), close(_close)
+	{
+		if (!listener.CreateNonBlock(AF_LOCAL, SOCK_STREAM, 0) ||
+		    !listener.Bind(address) || !listener.Listen(16))
+			throw std::runtime_error("Failed to listen");
+
+		listener_event.Open(listener);
+		listener_event.ScheduleRead();
+	}
+
+private:
+	void OnAccept(unsigned) noexcept {
+		connection = listener.AcceptNonBlock();
+		if (!connection.IsDefined())
+			return;
+
+		++n_connections;
+		connection_event.Open(connection);
+		connection_event.ScheduleRead();
+	}
+
+	void OnData(unsigned) noexcept {
+		char buffer[4096];
+		ssize_t nbytes = connection.Read(buffer, sizeof(buffer));
+		if (nbytes <= 0) {
+			connection_event.Cancel();
+			connection.Close();
+			return;
+		}
+
+		input.append(buffer, nbytes);
+
+		while (input.size() >= sizeof(TranslationMuxHeader)) {
+			TranslationMuxHeader header;
+			memcpy(&header, input.data(), sizeof(header));
+			if (input.size() < sizeof(header) + header.length)
+				break;
+
+			input.erase(0, sizeof(header) + header.length);
+			ids.push_back(header.id);
+		}
+
+		if (ids.size() < n_requests)
+			return;
+
+		if (close) {
+			connection_event.Cancel();
+			connection.Close();
+			return;
+		}
+
+		for (std::size_t i = ids.size(); i-- > 0;)
+			SendResponse(ids[i], 200 + i);
+		ids.clear();
+	}
+
+	static void AppendPacket(std::string &dest, TranslationCommand command,
+				 const void *payload=nullptr,
+				 std::size_t length=0) {
+		const TranslationHeader header{uint16_t(length), command};
+		dest.append((const char *)&header, sizeof(header));
+		if (length > 0)
+			dest.append((const char *)payload, length);
+	}
+
+	void SendResponse(uint32_t id, uint16_t status) {
+		std::string packets;
+		AppendPacket(packets, TranslationCommand::BEGIN);
+		AppendPacket(packets, TranslationCommand::STATUS,
+			     &status, sizeof(status));
+		AppendPacket(packets, TranslationCommand::END);
+
+		const TranslationMuxHeader header{id, uint32_t(packets.size())};
+		std::string frame((const char *)&header, sizeof(header));
+		frame += packets;
+
+		ASSERT_EQ(connection.Write(frame.data(), frame.size()),
+			  ssize_t(frame.size()));
+	}
+};
+
+struct Context : PInstance {
+	FineTimerEvent timer{event_loop, BIND_THIS_METHOD(OnTimer)};
+
+	AllocatedSocketAddress address;
+
+	TranslateRequest request;
+
+	Context() {
+		address.SetLocal(("@beng-proxy-t_translation_mux-" +
+				  std::to_string(getpid())).c_str());
+		request.uri = "/";
+	}
+
+	/**
+	 * Run the #EventLoop until all handlers have finished (or
+	 * until a timeout expires).
+	 */
+	template<typename P>
+	void RunUntil(P &&predicate) noexcept {
+		for (unsigned i = 0; i < 500 && !predicate(); ++i) {
+			timer.Schedule(std::chrono::milliseconds{10});
+			event_loop.Dispatch();
+		}
+	}
+
+	void OnTimer() noexcept {
+		event_loop.Break();
+	}
+};
+
+TEST(TranslationMux, OutOfOrder)
+{
+	Context c;
+	FakeMuxServer server(c.event_loop, c.address, 3);
+	TranslationMuxStock stock(c.event_loop, c.address, 2);
+
+	std::vector<std::unique_ptr<RecordingTranslateHandler>> handlers;
+	CancellablePointer cancel_ptr[3];
+	for (auto &i : cancel_ptr) {
+		auto &handler = *handlers.emplace_back(std::make_unique<RecordingTranslateHandler>(c.root_pool));
+		stock.SendRequest(AllocatorPtr{handler.pool}, c.request,
+				  nullptr, handler, i);
+	}
+
+	c.RunUntil([&handlers]{
+		return std::all_of(handlers.begin(), handlers.end(),
+				   [](const auto &h){ return h->finished; });
+	});
+
+	/* all requests share one connection */
+	EXPECT_EQ(server.n_connections, 1U);
+
+	for (std::size_t i = 0; i < handlers.size(); ++i) {
+		ASSERT_TRUE(handlers[i]->finished);
+		ASSERT_FALSE(handlers[i]->error);
+		ASSERT_NE(handlers[i]->response, nullptr);
+		EXPECT_EQ(unsigned(handlers[i]->response->status), 200 + i);
+	}
+}
+
+TEST(TranslationMux, Cancel)
+{
+	Context c;
+	FakeMuxServer server(c.event_loop, c.address, 3);
+	TranslationMuxStock stock(c.event_loop, c.address, 1);
+
+	RecordingTranslateHandler handler1(c.root_pool),
+		handler2(c.root_pool), handler3(c.root_pool);
+	CancellablePointer cancel_ptr1, cancel_ptr2, cancel_ptr3;
+
+	stock.SendRequest(AllocatorPtr{handler1.pool}, c.request, nullptr,
+			  handler1, cancel_ptr1);
+	stock.SendRequest(AllocatorPtr{handler2.pool}, c.request, nullptr,
+			  handler2, cancel_ptr2);
+	stock.SendRequest(AllocatorPtr{handler3.pool}, c.request, nullptr,
+			  handler3, cancel_ptr3);
+
+	/* the response to this one will be discarded */
+	cancel_ptr2.Cancel();
+
+	c.RunUntil([&]{ return handler1.finished && handler3.finished; });
+
+	ASSERT_TRUE(handler1.finished);
+	ASSERT_NE(handler1.response, nullptr);
+	EXPECT_EQ(unsigned(handler1.response->status), 200U);
+
+	EXPECT_FALSE(handler2.finished);
+
+	ASSERT_TRUE(handler3.finished);
+	ASSERT_NE(handler3.response, nullptr);
+	EXPECT_EQ(unsigned(handler3.response->status), 202U);
+}
+
+TEST(TranslationMux, ServerClose)
+{
+	Context c;
+	FakeMuxServer server(c.event_loop, c.address, 2, true);
+	TranslationMuxStock stock(c.event_loop, c.address, 1);
+
+	RecordingTranslateHandler handler1(c.root_pool), handler2(c.root_pool);
+	CancellablePointer cancel_ptr1, cancel_ptr2;
+
+	stock.SendRequest(AllocatorPtr{handler1.pool}, c.request, nullptr,
+			  handler1, cancel_ptr1);
+	stock.SendRequest(AllocatorPtr{handler2.pool}, c.request, nullptr,
+			  handler2, cancel_ptr2);
+
+	c.RunUntil([&]{ return handler1.finished && handler2.finished; });
+
+	ASSERT_TRUE(handler1.finished);
+	EXPECT_TRUE(handler1.error);
+	ASSERT_TRUE(handler2.finished);
+	EXPECT_TRUE(handler2.error);
+}
+
+TEST(TranslationMux, ConnectFailure)
+{
+	Context c;
+	TranslationMuxStock stock(c.event_loop, c.address, 1);
+
+	RecordingTranslateHandler handler(c.root_pool);
+	CancellablePointer cancel_ptr;
+
+	stock.SendRequest(AllocatorPtr{handler.pool}, c.request, nullptr,
+			  handler, cancel_ptr);
+
+	ASSERT_TRUE(handler.finished);
+	EXPECT_TRUE(handler.error);
+}
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RecordingTranslateHandler.hxx"
+#include "translation/Replicated.hxx"
+#include "translation/Request.hxx"
+#include "translation/Response.hxx"
+#include "translation/Handler.hxx"
+#include "event/FineTimerEvent.hxx"
+#include "net/AllocatedSocketAddress.hxx"
+#include "net/FailureManager.hxx"
+#include "util/Cancellable.hxx"
+#include "PInstance.hxx"
+#include "AllocatorPtr.hxx"
+#include "stopwatch.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+/**
+ * A #TranslationService which responds after a delay, fails or never
+ * responds.
+ */
+class FakeTranslationService final : public TranslationService {
+	class Request;
+
+	EventLoop &event_loop;
+
+public:
+	enum class Mode {
+		RESPOND,
+		FAIL,
+		STALL,
+	} mode;
+
+	const http_status_t status;
+
+	unsigned n_requests = 0, n_canceled = 0;
+
+	FakeTranslationService(EventLoop &_event_loop, Mode _mode,
+			       http_status_t _status) noexcept
+		:event_loop(_event_loop), mode(_mode), status(_status) {}
+
+	/* virtual methods from class TranslationService */
+	void SendRequest(AllocatorPtr alloc,
+			 const TranslateRequest &request,
+			 const StopwatchPtr &parent_stopwatch,
+			 TranslateHandler &handler,
+			 CancellablePointer &cancel_ptr) noexcept override;
+};
+
+class FakeTranslationService::Request final : Cancellable {
+	FakeTranslationService &service;
+	const AllocatorPtr alloc;
+	TranslateHandler &handler;
+	FineTimerEvent timer;
+
+public:
+	Request(FakeTranslationService &_service, AllocatorPtr _alloc,
+		TranslateHandler &_handler,
+		CancellablePointer &cancel_ptr) noexcept
+		:service(_service), alloc(_alloc), handler(_handler),
+		 timer(service.event_loop, BIND_THIS_METHOD(OnTimer))
+	{
+		cancel_ptr = *this;
+
+		if (service.mode != Mode::STALL)
+			timer.Schedule(std::chrono::milliseconds{1});
+	}
+
+private:
+	void Destroy() noexcept {
+		this->~Request();
+	}
+
+	void OnTimer() noexcept {
+		auto &_handler = handler;
+
+		if (service.mode == Mode::FAIL) {
+			Destroy();
+			_handler.OnTranslateError(std::make_exception_ptr(std::runtime_error("Fake error")));
+			return;
+		}
+
+		auto *response = alloc.New<TranslateResponse>();
+		response->Clear();
+		response->status = service.status;
+
+		Destroy();
+		_handler.OnTranslateResponse(*response);
+	}
+
+	/* virtual methods from class Cancellable */
+	void Cancel() noexcept override {
+		++service.n_canceled;
+		Destroy();
+	}
+};
+
+void
+FakeTranslationService::SendRequest(AllocatorPtr alloc,
+				    const TranslateRequest &,
+				    const StopwatchPtr &,
+				    TranslateHandler &handler,
+				    CancellablePointer &cancel_ptr) noexcept
+{
+	++n_requests;
+	alloc.New<Request>(*this, alloc, handler, cancel_ptr);
+}
+
+struct Context : PInstance {
+	FineTimerEvent timer{event_loop, BIND_THIS_METHOD(OnTimer)};
+
+	FailureManager failure_manager;
+
+	AllocatedSocketAddress address_a, address_b;
+
+	std::shared_ptr<FakeTranslationService> a, b;
+
+	ReplicatedTranslationService service{event_loop, failure_manager};
+
+	TranslateRequest request;
+
+	Context(FakeTranslationService::Mode mode_a,
+		FakeTranslationService::Mode mode_b)
+		:a(std::make_shared<FakeTranslationService>(event_loop, mode_a,
+							    HTTP_STATUS_OK)),
+		 b(std::make_shared<FakeTranslationService>(event_loop, mode_b,
+							    HTTP_STATUS_ACCEPTED))
+	{
+		address_a.SetLocal("@replica-a");
+		address_b.SetLocal("@replica-b");
+
+		service.AddReplica(address_a, a);
+		service.AddReplica(address_b, b);
+
+		request.uri = "/";
+	}
+
+	void Send(RecordingTranslateHandler &handler,
+		  CancellablePointer &cancel_ptr) noexcept {
+		service.SendRequest(AllocatorPtr{handler.pool}, request,
+				    nullptr, handler, cancel_ptr);
+	}
+
+	/**
+	 * Run the #EventLoop for a short while.
+	 */
+	void Step() noexcept {
+		timer.Schedule(std::chrono::milliseconds{10});
+		event_loop.Dispatch();
+	}
+
+	/**
+	 * Run the #EventLoop until the given handler has finished
+	 * (or until a timeout expires).
+	 */
+	void Wait(const RecordingTranslateHandler &handler) noexcept {
+		for (unsigned i = 0; i < 500 && !handler.finished; ++i)
+			Step();
+	}
+
+	void OnTimer() noexcept {
+		event_loop.Break();
+	}
+};
+
+using Mode = FakeTranslationService::Mode;
+
+TEST(ReplicatedTranslation, Basic)
+{
+	Context c(Mode::RESPOND, Mode::RESPOND);
+
+	RecordingTranslateHandler handler(c.root_pool);
+	CancellablePointer cancel_ptr;
+	c.Send(handler, cancel_ptr);
+	c.Wait(handler);
+
+	ASSERT_TRUE(handler.finished);
+	ASSERT_NE(handler.response, nullptr);
+
+	/* a fast response does not trigger a hedged request */
+	EXPECT_EQ(c.a->n_requests + c.b->n_requests, 1U);
+}
+
+TEST(ReplicatedTranslation, Hedge)
+{
+	Context c(Mode::STALL, Mode::RESPOND);
+
+	RecordingTranslateHandler handler(c.root_pool);
+	CancellablePointer cancel_ptr;
+	c.Send(handler, cancel_ptr);
+
+	/* the first replica is asked first, stalls, and after the
+	   hedge delay, the second one responds */
+	EXPECT_EQ(c.a->n_requests, 1U);
+	EXPECT_EQ(c.b->n_requests, 0U);
+
+	c.Wait(handler);
+
+	ASSERT_TRUE(handler.finished);
+	ASSERT_NE(handler.response, nullptr);
+	EXPECT_EQ(handler.response->status, HTTP_STATUS_ACCEPTED);
+	EXPECT_EQ(c.b->n_requests, 1U);
+
+	/* the stalled request was abandoned */
+	EXPECT_EQ(c.a->n_canceled, 1U);
+}
+
+TEST(ReplicatedTranslation, Failover)
+{
+	Context c(Mode::FAIL, Mode::RESPOND);
+
+	RecordingTranslateHandler handler1(c.root_pool);
+	CancellablePointer cancel_ptr1;
+	c.Send(handler1, cancel_ptr1);
+	c.Wait(handler1);
+
+	ASSERT_TRUE(handler1.finished);
+	ASSERT_NE(handler1.response, nullptr);
+	EXPECT_EQ(handler1.response->status, HTTP_STATUS_ACCEPTED);
+	EXPECT_EQ(c.a->n_requests, 1U);
+	EXPECT_EQ(c.b->n_requests, 1U);
+
+	/* the failed replica is avoided now */
+	RecordingTranslateHandler handler2(c.root_pool);
+	CancellablePointer cancel_ptr2;
+	c.Send(handler2, cancel_ptr2);
+	c.Wait(handler2);
+
+	ASSERT_TRUE(handler2.finished);
+	ASSERT_NE(handler2.response, nullptr);
+	EXPECT_EQ(c.a->n_requests, 1U);
+	EXPECT_EQ(c.b->n_requests, 2U);
+}
+
+TEST(ReplicatedTranslation, AllFail)
+{
+	Context c(Mode::FAIL, Mode::FAIL);
+
+	RecordingTranslateHandler handler(c.root_pool);
+	CancellablePointer cancel_ptr;
+	c.Send(handler, cancel_ptr);
+	c.Wait(handler);
+
+	ASSERT_TRUE(handler.finished);
+	EXPECT_TRUE(handler.error);
+	EXPECT_EQ(c.a->n_requests, 1U);
+	EXPECT_EQ(c.b->n_requests, 1U);
+}
+
+TEST(ReplicatedTranslation, Cancel)
+{
+	Context c(Mode::STALL, Mode::STALL);
+
+	RecordingTranslateHandler handler(c.root_pool);
+	CancellablePointer cancel_ptr;
+	c.Send(handler, cancel_ptr);
+
+	/* wait for the hedged request */
+	for (unsigned i = 0; i < 500 && c.b->n_requests == 0; ++i)
+		c.Step();
+
+	EXPECT_EQ(c.b->n_requests, 1U);
+
+	cancel_ptr.Cancel();
+
+	EXPECT_FALSE(handler.finished);
+	EXPECT_EQ(c.a->n_canceled, 1U);
+	EXPECT_EQ(c.b->n_canceled, 1U);
+}
@@ -367,6 +367,7 @@ public:
 		lease = &_lease;
 		was_client_request(pool, GetEventLoop(), nullptr,
 				   socket.control, socket.input, socket.output,
+				   nullptr,
 				   *this,
 				   nullptr,
 				   method, uri, uri, nullptr, nullptr,
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2007-2022 CM4all GmbH
+ * All rights reserved.
+ *
+ * author: Max Kellermann <mk@cm4all.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the
+ * distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+ * FOUNDATION OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "was/Shm.hxx"
+#include "was/async/Error.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <numeric>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+static bool
+IsReadable(FileDescriptor fd) noexcept
+{
+	struct pollfd pfd{.fd = fd.Get(), .events = POLLIN, .revents = 0};
+	return poll(&pfd, 1, 0) > 0;
+}
+
+static auto
+MakeSocketPair()
+{
+	int sv[2];
+	if (socketpair(AF_LOCAL, SOCK_STREAM|SOCK_CLOEXEC, 0, sv) < 0)
+		throw std::runtime_error("socketpair() failed");
+
+	return std::make_pair(UniqueSocketDescriptor(sv[0]),
+			      UniqueSocketDescriptor(sv[1]));
+}
+
+TEST(WasShm, Ring)
+{
+	auto shm = WasShm::Create(4096);
+	auto &ring = shm.GetRequestRing();
+
+	std::array<std::byte, 3000> src;
+	for (std::size_t i = 0; i < src.size(); ++i)
+		src[i] = std::byte(i);
+
+	std::array<std::byte, 4096> dest;
+
+	/* let the ring wrap around a few times */
+	for (unsigned i = 0; i < 8; ++i) {
+		EXPECT_EQ(ring.Write(src), src.size());
+		EXPECT_EQ(ring.GetAvailable(), src.size());
+		EXPECT_EQ(ring.ReadTo(dest), src.size());
+		EXPECT_TRUE(std::equal(src.begin(), src.end(), dest.begin()));
+		EXPECT_EQ(ring.GetAvailable(), 0U);
+	}
+
+	/* fill it up */
+	EXPECT_EQ(ring.Write(src), src.size());
+	EXPECT_EQ(ring.Write(src), 4096 - src.size());
+	EXPECT_EQ(ring.Write(src), 0U);
+
+	EXPECT_EQ(ring.Discard(4000), 4000U);
+	EXPECT_EQ(ring.Discard(4000), 96U);
+	EXPECT_EQ(ring.Discard(4000), 0U);
+}
+
+TEST(WasShm, Wakeup)
+{
+	auto shm = WasShm::Create(4096);
+	auto &ring = shm.GetResponseRing();
+
+	const std::array<std::byte, 1024> src{};
+	std::array<std::byte, 1024> dest;
+
+	/* no wakeup if the consumer is not waiting */
+	EXPECT_EQ(ring.Write(src), src.size());
+	EXPECT_FALSE(IsReadable(ring.GetDataEvent()));
+
+	/* the ring is not empty, so the consumer doesn't need to
+	   wait */
+	EXPECT_FALSE(ring.PrepareRead());
+	EXPECT_EQ(ring.ReadTo(dest), src.size());
+
+	/* the consumer waits and gets woken up */
+	EXPECT_TRUE(ring.PrepareRead());
+	EXPECT_EQ(ring.Write(src), src.size());
+	EXPECT_TRUE(IsReadable(ring.GetDataEvent()));
+	WasShmRing::DrainEvent(ring.GetDataEvent());
+	EXPECT_FALSE(IsReadable(ring.GetDataEvent()));
+
+	/* the "waiting" flag has been cleared by the producer */
+	EXPECT_EQ(ring.Write(src), src.size());
+	EXPECT_FALSE(IsReadable(ring.GetDataEvent()));
+
+	/* fill the ring; the producer waits for space */
+	EXPECT_EQ(ring.Write(src), src.size());
+	EXPECT_EQ(ring.Write(src), src.size());
+	EXPECT_TRUE(ring.PrepareWrite());
+	EXPECT_FALSE(IsReadable(ring.GetSpaceEvent()));
+
+	EXPECT_EQ(ring.ReadTo(dest), src.size());
+	EXPECT_TRUE(IsReadable(ring.GetSpaceEvent()));
+	WasShmRing::DrainEvent(ring.GetSpaceEvent());
+	EXPECT_FALSE(ring.PrepareWrite());
+}
+
+/**
+ * The peer may write anything into the shared header; the ring must
+ * refuse counters which go backwards or are inconsistent.
+ */
+TEST(WasShm, CorruptHeader)
+{
+	WasShmRing::Header header{};
+	alignas(64) std::array<std::byte, 4096> data;
+
+	WasShmRing producer{header, data.data(), data.size(), {}, {}};
+	WasShmRing consumer{header, data.data(), data.size(), {}, {}};
+
+	std::array<std::byte, 1000> src{};
+	std::array<std::byte, 1000> dest;
+
+	EXPECT_EQ(producer.Write(src), src.size());
+
+	/* the tail is more than the capacity ahead of the head */
+	header.tail = 1000 + data.size();
+	EXPECT_FALSE(consumer.PrepareRead());
+	EXPECT_THROW(consumer.ReadTo(dest), WasProtocolError);
+	EXPECT_THROW(consumer.Discard(10), WasProtocolError);
+
+	header.tail = 1000;
+	EXPECT_EQ(consumer.ReadTo(dest), src.size());
+
+	/* the tail goes backwards */
+	header.tail = 500;
+	EXPECT_THROW(consumer.ReadTo(dest), WasProtocolError);
+	header.tail = 1000;
+
+	/* the head passes the tail */
+	header.head = 2000;
+	EXPECT_FALSE(producer.PrepareWrite());
+	EXPECT_THROW(producer.Write(src), WasProtocolError);
+
+	header.head = 1000;
+	EXPECT_EQ(producer.Write(src), src.size());
+
+	/* the head goes backwards */
+	header.head = 0;
+	EXPECT_THROW(producer.Write(src), WasProtocolError);
+	header.head = 1000;
+
+	/* the producer doesn't trust its own shared counter */
+	header.tail = 0;
+	EXPECT_EQ(producer.Write(src), src.size());
+	EXPECT_EQ(header.tail, 3000U);
+	EXPECT_EQ(consumer.ReadTo(dest), src.size());
+	EXPECT_EQ(consumer.ReadTo(dest), src.size());
+	EXPECT_EQ(consumer.ReadTo(dest), 0U);
+}
+
+TEST(WasShm, Offer)
+{
+	auto [client_socket, server_socket] = MakeSocketPair();
+
+	auto client = WasShm::Create(8192);
+	client.Offer(client_socket);
+	EXPECT_FALSE(client.IsAttached());
+
+	/* something else following the offer must not be consumed */
+	ASSERT_EQ(send(client_socket.Get(), "foo", 3, 0), 3);
+
+	auto server = WasShm::Accept(server_socket);
+	ASSERT_TRUE(server.IsDefined());
+	EXPECT_TRUE(client.IsAttached());
+
+	char buffer[16];
+	EXPECT_EQ(recv(server_socket.Get(), buffer, sizeof(buffer),
+		       MSG_DONTWAIT), 3);
+
+	/* both sides see the same rings */
+	std::array<std::byte, 100> src;
+	std::iota((unsigned char *)src.data(),
+		  (unsigned char *)src.data() + src.size(), 0);
+	std::array<std::byte, 100> dest;
+
+	EXPECT_TRUE(client.GetResponseRing().PrepareRead());
+	EXPECT_EQ(server.GetResponseRing().Write(src), src.size());
+	EXPECT_TRUE(IsReadable(client.GetResponseRing().GetDataEvent()));
+	EXPECT_EQ(client.GetResponseRing().ReadTo(dest), src.size());
+	EXPECT_EQ(src, dest);
+
+	EXPECT_EQ(client.GetRequestRing().Write(src), src.size());
+	EXPECT_EQ(server.GetRequestRing().ReadTo(dest), src.size());
+	EXPECT_EQ(src, dest);
+}
+
+TEST(WasShm, NoOffer)
+{
+	auto [client_socket, server_socket] = MakeSocketPair();
+
+	/* nothing was sent */
+	EXPECT_FALSE(WasShm::Accept(server_socket).IsDefined());
+
+	/* a regular packet must be left alone */
+	ASSERT_EQ(send(client_socket.Get(), "foobar12", 8, 0), 8);
+	EXPECT_FALSE(WasShm::Accept(server_socket).IsDefined());
+
+	char buffer[16];
+	EXPECT_EQ(recv(server_socket.Get(), buffer, sizeof(buffer),
+		       MSG_DONTWAIT), 8);
+}
@@ -38,6 +38,7 @@
 #include "net/SocketDescriptor.hxx"
 #include "io/Logger.hxx"
 #include "io/SpliceSupport.hxx"
+#include "util/PrintException.hxx"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -59,7 +60,7 @@ struct Instance final : PInstance, WasServerHandler {
 
 int
 main(int, char **)
-{
+try {
 	SetLogLevel(5);
 
 	WasSocket socket{
@@ -68,6 +69,9 @@ main(int, char **)
 		UniqueFileDescriptor(STDOUT_FILENO),
 	};
 
+	/* use the shared memory ring if the client offers one */
+	auto shm = WasShm::Accept(socket.control);
+
 	direct_global_init();
 	const ScopeFbPoolInit fb_pool_init;
 
@@ -77,9 +81,13 @@ main(int, char **)
 						 instance.root_pool,
 						 instance.event_loop,
 						 std::move(socket),
+						 std::move(shm),
 						 instance);
 
 	instance.event_loop.Dispatch();
 
 	instance.server->Free();
+} catch (const std::exception &e) {
+	PrintException(e);
+	return EXIT_FAILURE;
 }